@@ -0,0 +1,928 @@
+#include "asmgen.hpp"
+#include "bytecode.hpp"
+#include "decl.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+/// The machine registers available to the allocator. The callee-saved
+/// registers come first. rax, rcx, rdx, and r11 are reserved as scratch
+/// registers for instruction selection.
+char const* const machine_regs[] = {
+  "%rbx", "%r12", "%r13", "%r14", "%r15",
+  "%rsi", "%rdi", "%r8", "%r9", "%r10",
+};
+
+/// The number of callee-saved registers in machine_regs.
+constexpr int num_callee_saved = 5;
+
+/// The number of registers in machine_regs.
+constexpr int num_machine_regs = 10;
+
+/// The registers holding the first arguments of a call.
+char const* const arg_regs[] = {
+  "%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9",
+};
+
+/// The number of arguments passed in registers.
+constexpr int num_arg_regs = 6;
+
+
+/// Returns the number of arguments passed by the call `in` of `code`.
+/// The argument count of an indirect call is not recorded, so every
+/// register from the first argument up is passed. Surplus arguments are
+/// ignored by the callee. Tail calls record their argument count.
+int
+count_arguments(Code const& code, Instr const& in)
+{
+  if (in.op == tcall_op || in.op == tcalli_op)
+    return in.a;
+  if (in.op == call_op) {
+    Code const* callee = code.get_callee(in.b);
+    return callee ? callee->get_num_parameters() : 0;
+  }
+  return code.get_num_registers() - in.c;
+}
+
+/// Returns the number of arguments of `code` passed on the stack.
+int
+count_stack_parameters(Code const& code)
+{
+  return std::max(code.get_num_parameters() - num_arg_regs, 0);
+}
+
+/// Returns true if `code` contains a tail call.
+bool
+has_tail_calls(Code const& code)
+{
+  Instr const* first = code.get_instructions();
+  return std::any_of(first, first + code.size(), [](Instr const& in) {
+    return in.op == tcall_op || in.op == tcalli_op;
+  });
+}
+
+/// Calls `def(r)` and `use(r)` for each register defined and used by the
+/// instruction `in` of `code`. Uses are reported before definitions.
+template<typename Def, typename Use>
+void
+for_each_operand(Code const& code, Instr const& in, Def def, Use use)
+{
+  switch (in.op) {
+  case ldk_op:
+  case ldi_op:
+  case lds_op:
+  case gload_op:
+    def(in.a);
+    break;
+  case mov_op:
+  case lda_op:
+  case load_op:
+  case neg_i_op:
+  case rec_i_op:
+  case neg_f_op:
+  case rec_f_op:
+  case not_b_op:
+    use(in.b);
+    def(in.a);
+    break;
+  case store_op:
+    use(in.a);
+    use(in.b);
+    break;
+  case gstore_op:
+    use(in.b);
+    break;
+  case jmp_op:
+    break;
+  case jt_op:
+  case jf_op:
+  case ret_op:
+    use(in.a);
+    break;
+  case call_op:
+  case calli_op:
+    if (in.op == calli_op)
+      use(in.b);
+    for (int i = 0, n = count_arguments(code, in); i < n; ++i)
+      use(in.c + i);
+    def(in.a);
+    break;
+  case tcall_op:
+  case tcalli_op:
+    if (in.op == tcalli_op)
+      use(in.b);
+    for (int i = 0, n = count_arguments(code, in); i < n; ++i)
+      use(in.c + i);
+    break;
+  default:
+    use(in.b);
+    use(in.c);
+    def(in.a);
+    break;
+  }
+}
+
+
+/// The machine location of each register of a code.
+struct Allocation
+{
+  /// The location of one register.
+  struct Home
+  {
+    int reg;
+    /// The index of the machine register, or -1 for a stack slot.
+
+    int slot;
+    /// The stack slot.
+  };
+
+  /// The range of instructions over which a register is live.
+  struct Interval
+  {
+    int reg;
+    int start;
+    int end;
+    bool crosses_call;
+  };
+
+  Allocation(Code const& code);
+
+  void scan(std::vector<Interval> ivs);
+  /// Assigns homes to the intervals `ivs` by linear scan.
+
+  int spill(int r) { homes[r] = Home{-1, slots++}; return slots - 1; }
+  /// Places `r` in a new stack slot.
+
+  std::vector<Home> homes;
+  /// The home of each register.
+
+  int slots;
+  /// The number of stack slots.
+
+  bool used[num_machine_regs];
+  /// True for each machine register that is assigned.
+};
+
+Allocation::Allocation(Code const& code)
+  : homes(code.get_num_registers(), Home{-1, -1}), slots(), used()
+{
+  int n = code.get_num_registers();
+  std::vector<int> start(n, INT_MAX);
+  std::vector<int> end(n, INT_MIN);
+  std::vector<bool> addressed(n);
+  std::vector<int> calls;
+  auto touch = [&](int r, int i) {
+    start[r] = std::min(start[r], i);
+    end[r] = std::max(end[r], i);
+  };
+
+  // Parameters are defined on entry.
+  for (int r = 0; r < code.get_num_parameters(); ++r)
+    touch(r, -1);
+
+  Instr const* first = code.get_instructions();
+  std::vector<std::pair<int, int>> loops;
+  for (int i = 0; i < int(code.size()); ++i) {
+    Instr const& in = first[i];
+    auto at = [&](int r) { touch(r, i); };
+    for_each_operand(code, in, at, at);
+    if (in.op == lda_op)
+      addressed[in.b] = true;
+    if (in.op == call_op || in.op == calli_op)
+      calls.push_back(i);
+    int target = in.op == jmp_op ? in.a : (in.op == jt_op || in.op == jf_op) ? in.b : INT_MAX;
+    if (target <= i)
+      loops.emplace_back(target, i);
+  }
+
+  // A register live anywhere in a loop is live throughout it. Extending
+  // every interval that overlaps a loop is conservative, and repeating
+  // until nothing changes handles nested loops.
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (auto [head, tail] : loops) {
+      for (int r = 0; r < n; ++r) {
+        if (start[r] > tail || end[r] < head)
+          continue;
+        if (start[r] > head || end[r] < tail) {
+          start[r] = std::min(start[r], head);
+          end[r] = std::max(end[r], tail);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  std::vector<Interval> ivs;
+  for (int r = 0; r < n; ++r) {
+    if (start[r] > end[r])
+      continue;
+    if (addressed[r]) {
+      spill(r);
+      continue;
+    }
+    bool crosses = std::any_of(calls.begin(), calls.end(), [&](int c) {
+      return start[r] < c && c < end[r];
+    });
+    ivs.push_back(Interval{r, start[r], end[r], crosses});
+  }
+  scan(std::move(ivs));
+}
+
+void
+Allocation::scan(std::vector<Interval> ivs)
+{
+  std::sort(ivs.begin(), ivs.end(), [](Interval const& a, Interval const& b) {
+    return a.start < b.start;
+  });
+
+  bool busy[num_machine_regs] = {};
+  std::vector<Interval> active;
+  for (Interval const& iv : ivs) {
+    // Free the registers of intervals that have ended.
+    auto ended = [&](Interval const& a) { return a.end < iv.start; };
+    for (Interval const& a : active) {
+      if (ended(a))
+        busy[homes[a.reg].reg] = false;
+    }
+    active.erase(std::remove_if(active.begin(), active.end(), ended), active.end());
+
+    // Prefer caller-saved registers for intervals that do not span a
+    // call, saving the callee-saved ones for those that do.
+    int reg = -1;
+    for (int i = num_machine_regs - 1; i >= 0 && reg < 0; --i) {
+      if (!busy[i] && (i < num_callee_saved || !iv.crosses_call))
+        reg = i;
+    }
+
+    // Otherwise, take the register of the active interval that ends
+    // last, if it ends after this one.
+    if (reg < 0) {
+      auto victim = active.end();
+      for (auto a = active.begin(); a != active.end(); ++a) {
+        int r = homes[a->reg].reg;
+        if (iv.crosses_call && r >= num_callee_saved)
+          continue;
+        if (victim == active.end() || a->end > victim->end)
+          victim = a;
+      }
+      if (victim == active.end() || victim->end <= iv.end) {
+        spill(iv.reg);
+        continue;
+      }
+      reg = homes[victim->reg].reg;
+      spill(victim->reg);
+      active.erase(victim);
+    }
+
+    homes[iv.reg] = Home{reg, -1};
+    busy[reg] = true;
+    used[reg] = true;
+    active.push_back(iv);
+  }
+}
+
+} // namespace
+
+
+/// Translates bytecode to x86-64 assembly.
+///
+/// Instruction selection is by template: operands are loaded into the
+/// scratch registers, combined, and stored to the destination's home.
+///
+/// A tail call stores its stack arguments over those of the function
+/// making it and jumps to the callee, which returns to the original
+/// caller. So that any callee's arguments fit, a function that makes
+/// tail calls is always called with a stack argument area of at least
+/// the greatest number of stack parameters in the program.
+class Asm_translation
+{
+public:
+  Asm_translation(Bytecode const& bc, std::ostream& os);
+
+  void translate(Prog_decl const* p);
+  /// Writes the translation of `p`.
+
+private:
+  void function(Code const& code, std::string const& sym);
+  /// Writes the function `sym` for `code`.
+
+  void instruction(Code const& code, int i);
+  /// Writes the ith instruction of `code`.
+
+  void entry(Code const& code, int n);
+  /// Writes the entry point `rt_entry_<n>` for `code`.
+
+  void call(Code const& code, Instr const& in);
+  /// Writes the call `in`.
+
+  void tail_call(Code const& code, Instr const& in);
+  /// Writes the tail call `in`.
+
+  void leave();
+  /// Writes the restoration of the callee-saved registers and the
+  /// caller's frame pointer, leaving the return address on top of the
+  /// stack.
+
+  int reserve(Code const* callee, int stack) const;
+  /// Returns the number of stack slots to reserve for a call to `callee`
+  /// that passes `stack` arguments on the stack. If `callee` is null, it
+  /// is unknown. The result is even, keeping the stack aligned.
+
+  void divide(Instr const& in, bool rem);
+  /// Writes an integer division or remainder. Register rax holds the
+  /// dividend and rcx the divisor.
+
+  void compare(Instr const& in, char const* cc);
+  /// Writes an integer comparison setting on condition `cc`.
+
+  void compare_float(Instr const& in, char const* cc, bool swap);
+  /// Writes a floating point comparison setting on condition `cc`. If
+  /// `swap` is true, the operands are compared in reverse order.
+
+  void arithmetic_float(Instr const& in, char const* op);
+  /// Writes a floating point operation.
+
+  std::string loc(int r) const;
+  /// Returns the operand designating the home of `r`.
+
+  std::string label(int i) const;
+  /// Returns the label of the ith instruction of the current function.
+
+  std::string symbol(Code const* code) const;
+  /// Returns the symbol of `code`.
+
+  void load(int r, char const* reg) { emit("movq " + loc(r) + ", " + reg); }
+  /// Loads `r` into `reg`.
+
+  void store(char const* reg, int r) { emit(std::string("movq ") + reg + ", " + loc(r)); }
+  /// Stores `reg` into `r`.
+
+  void emit(std::string const& s) { m_os << "\t" << s << '\n'; }
+  /// Writes an instruction.
+
+  Bytecode const& m_bc;
+  /// The program.
+
+  std::ostream& m_os;
+  /// The output.
+
+  Allocation const* m_alloc;
+  /// The allocation of the current function.
+
+  std::string m_sym;
+  /// The symbol of the current function.
+
+  int m_saved;
+  /// The number of callee-saved registers pushed by the current function.
+
+  int m_area;
+  /// The least stack argument area of a function that makes tail calls.
+};
+
+Asm_translation::Asm_translation(Bytecode const& bc, std::ostream& os)
+  : m_bc(bc), m_os(os), m_alloc(), m_sym(), m_saved(), m_area()
+{ }
+
+std::string
+Asm_translation::loc(int r) const
+{
+  Allocation::Home h = m_alloc->homes[r];
+  if (h.reg >= 0)
+    return machine_regs[h.reg];
+  return std::to_string(-8 * (m_saved + h.slot + 1)) + "(%rbp)";
+}
+
+std::string
+Asm_translation::label(int i) const
+{
+  return ".L" + m_sym + "_" + std::to_string(i);
+}
+
+std::string
+Asm_translation::symbol(Code const* code) const
+{
+  if (!code)
+    return "rt_undefined";
+  if (!code->get_function())
+    return "rt_init";
+  return "fn" + std::to_string(code->get_index());
+}
+
+void
+Asm_translation::translate(Prog_decl const* p)
+{
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    if (Code const* code = m_bc.get_code(static_cast<Fn_decl const*>(d)))
+      m_area = std::max(m_area, count_stack_parameters(*code));
+  }
+
+  m_os << "\t.text\n";
+
+  int n = 0;
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    Code const* code = m_bc.get_code(fn);
+    if (!code)
+      continue;
+    function(*code, symbol(code));
+    if (Native_module::has_entry(fn))
+      entry(*code, n);
+    ++n;
+  }
+  function(*m_bc.get_init(), "rt_init");
+
+  // The runtime. rt_sp holds the stack pointer of the active entry
+  // point, from which a trap returns.
+  m_os << "\n\t.globl rt_start\n"
+       << "rt_start:\n";
+  entry(*m_bc.get_init(), -1);
+  m_os << "\nrt_undefined:\n"
+       << "\tmovl $2, %edi\n"
+       << "\tjmp rt_trap\n"
+       << "\nrt_div_zero:\n"
+       << "\tmovl $1, %edi\n"
+       << "rt_trap:\n"
+       << "\tmovq rt_sp(%rip), %rsp\n"
+       << "\tmovl %edi, %eax\n"
+       << "rt_leave:\n"
+       << "\taddq $8, %rsp\n"
+       << "\tpopq %r15\n"
+       << "\tpopq %r14\n"
+       << "\tpopq %r13\n"
+       << "\tpopq %r12\n"
+       << "\tpopq %rbx\n"
+       << "\tpopq %rbp\n"
+       << "\tret\n";
+
+  m_os << "\n\t.bss\n"
+       << "\t.p2align 3\n"
+       << "rt_sp:\n"
+       << "\t.zero 8\n"
+       << "rt_statics:\n"
+       << "\t.zero " << 8 * std::max(m_bc.get_num_statics(), 1) << '\n'
+       << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+}
+
+void
+Asm_translation::entry(Code const& code, int n)
+{
+  if (n >= 0)
+    m_os << "\n\t.globl rt_entry_" << n << "\n"
+         << "rt_entry_" << n << ":\n";
+
+  // Save the callee-saved registers and the result pointer, leaving the
+  // stack aligned.
+  emit("pushq %rbp");
+  emit("pushq %rbx");
+  emit("pushq %r12");
+  emit("pushq %r13");
+  emit("pushq %r14");
+  emit("pushq %r15");
+  emit("pushq %rsi");
+  emit("movq %rsp, rt_sp(%rip)");
+
+  int args = code.get_num_parameters();
+  int stack = count_stack_parameters(code);
+  int area = reserve(&code, stack);
+  if (area > stack)
+    emit("subq $" + std::to_string(8 * (area - stack)) + ", %rsp");
+  for (int i = args - 1; i >= num_arg_regs; --i)
+    emit("pushq " + std::to_string(8 * i) + "(%rdi)");
+  for (int i = std::min(args, num_arg_regs) - 1; i >= 0; --i)
+    emit("movq " + std::to_string(8 * i) + "(%rdi), " + arg_regs[i]);
+  emit("call " + symbol(&code));
+
+  emit("movq rt_sp(%rip), %rsp");
+  if (n >= 0) {
+    emit("movq (%rsp), %rsi");
+    emit("movq %rax, (%rsi)");
+  }
+  emit("xorl %eax, %eax");
+  emit("jmp rt_leave");
+}
+
+void
+Asm_translation::function(Code const& code, std::string const& sym)
+{
+  Allocation alloc(code);
+  m_alloc = &alloc;
+  m_sym = sym;
+  m_saved = std::count(alloc.used, alloc.used + num_callee_saved, true);
+
+  m_os << '\n' << sym << ":\n";
+  emit("pushq %rbp");
+  emit("movq %rsp, %rbp");
+  for (int i = 0; i < num_callee_saved; ++i) {
+    if (alloc.used[i])
+      emit(std::string("pushq ") + machine_regs[i]);
+  }
+  // Keep the stack aligned for calls.
+  int frame = 8 * alloc.slots;
+  if ((8 * m_saved + frame) % 16)
+    frame += 8;
+  if (frame)
+    emit("subq $" + std::to_string(frame) + ", %rsp");
+
+  // Move the parameters to their homes. Pushing them all first avoids
+  // overwriting an argument register that has not been read.
+  int params = code.get_num_parameters();
+  for (int i = 0; i < std::min(params, num_arg_regs); ++i)
+    emit(std::string("pushq ") + arg_regs[i]);
+  for (int i = std::min(params, num_arg_regs) - 1; i >= 0; --i)
+    emit("popq " + loc(i));
+  for (int i = num_arg_regs; i < params; ++i) {
+    emit("movq " + std::to_string(16 + 8 * (i - num_arg_regs)) + "(%rbp), %rax");
+    store("%rax", i);
+  }
+
+  // Only jump targets need labels.
+  std::vector<bool> targets(code.size());
+  Instr const* first = code.get_instructions();
+  for (std::size_t i = 0; i < code.size(); ++i) {
+    if (first[i].op == jmp_op)
+      targets[first[i].a] = true;
+    else if (first[i].op == jt_op || first[i].op == jf_op)
+      targets[first[i].b] = true;
+  }
+  for (std::size_t i = 0; i < code.size(); ++i) {
+    if (targets[i])
+      m_os << label(i) << ":\n";
+    instruction(code, i);
+  }
+
+  m_os << ".L" << sym << "_ret:\n";
+  leave();
+  emit("ret");
+  m_alloc = nullptr;
+}
+
+void
+Asm_translation::leave()
+{
+  emit("leaq " + std::to_string(-8 * m_saved) + "(%rbp), %rsp");
+  for (int i = num_callee_saved - 1; i >= 0; --i) {
+    if (m_alloc->used[i])
+      emit(std::string("popq ") + machine_regs[i]);
+  }
+  emit("popq %rbp");
+}
+
+int
+Asm_translation::reserve(Code const* callee, int stack) const
+{
+  int area = stack;
+  if (!callee || has_tail_calls(*callee))
+    area = std::max(area, m_area);
+  return area + area % 2;
+}
+
+void
+Asm_translation::instruction(Code const& code, int i)
+{
+  Instr const& in = code.get_instructions()[i];
+  switch (in.op) {
+  // Moves
+  case mov_op:
+    if (loc(in.a) != loc(in.b)) {
+      load(in.b, "%rax");
+      store("%rax", in.a);
+    }
+    break;
+  case ldk_op: {
+    Value v = code.get_constants()[in.b].to_value();
+    if (v.is_function()) {
+      emit("leaq " + symbol(m_bc.get_code(v.get_function())) + "(%rip), %rax");
+    }
+    else {
+      std::uint64_t bits = 0;
+      if (v.is_int())
+        bits = v.get_int();
+      else if (v.is_float()) {
+        Float_value f = v.get_float();
+        std::memcpy(&bits, &f, sizeof bits);
+      }
+      emit("movabsq $" + std::to_string(bits) + ", %rax");
+    }
+    store("%rax", in.a);
+    break;
+  }
+  case ldi_op:
+    emit("movq $" + std::to_string(in.b) + ", " + loc(in.a));
+    break;
+  case lda_op:
+    emit("leaq " + loc(in.b) + ", %rax");
+    store("%rax", in.a);
+    break;
+  case lds_op:
+    emit("leaq rt_statics+" + std::to_string(8 * in.b) + "(%rip), %rax");
+    store("%rax", in.a);
+    break;
+  case load_op:
+    load(in.b, "%rax");
+    emit("movq (%rax), %rax");
+    store("%rax", in.a);
+    break;
+  case store_op:
+    load(in.a, "%rax");
+    load(in.b, "%rcx");
+    emit("movq %rcx, (%rax)");
+    break;
+  case gload_op:
+    emit("movq rt_statics+" + std::to_string(8 * in.b) + "(%rip), %rax");
+    store("%rax", in.a);
+    break;
+  case gstore_op:
+    load(in.b, "%rax");
+    emit("movq %rax, rt_statics+" + std::to_string(8 * in.a) + "(%rip)");
+    break;
+
+  // Integer arithmetic
+  case add_i_op:
+  case sub_i_op:
+  case mul_i_op:
+    load(in.b, "%rax");
+    emit(std::string(in.op == add_i_op ? "addq " : in.op == sub_i_op ? "subq " : "imulq ")
+         + loc(in.c) + ", %rax");
+    store("%rax", in.a);
+    break;
+  case div_i_op:
+  case rem_i_op:
+    load(in.b, "%rax");
+    load(in.c, "%rcx");
+    divide(in, in.op == rem_i_op);
+    break;
+  case neg_i_op:
+    load(in.b, "%rax");
+    emit("negq %rax");
+    store("%rax", in.a);
+    break;
+  case rec_i_op:
+    emit("movl $1, %eax");
+    load(in.b, "%rcx");
+    divide(in, false);
+    break;
+
+  // Floating point arithmetic
+  case add_f_op:
+    arithmetic_float(in, "addsd");
+    break;
+  case sub_f_op:
+    arithmetic_float(in, "subsd");
+    break;
+  case mul_f_op:
+    arithmetic_float(in, "mulsd");
+    break;
+  case div_f_op:
+    arithmetic_float(in, "divsd");
+    break;
+  case neg_f_op:
+    load(in.b, "%rax");
+    emit("btcq $63, %rax");
+    store("%rax", in.a);
+    break;
+  case rec_f_op:
+    emit("movabsq $0x3ff0000000000000, %rax");
+    emit("movq %rax, %xmm0");
+    emit("movq " + loc(in.b) + ", %xmm1");
+    emit("divsd %xmm1, %xmm0");
+    emit("movq %xmm0, " + loc(in.a));
+    break;
+
+  // Comparison
+  case eq_i_op:
+  case eq_p_op:
+    compare(in, "e");
+    break;
+  case ne_i_op:
+  case ne_p_op:
+    compare(in, "ne");
+    break;
+  case lt_i_op:
+    compare(in, "l");
+    break;
+  case gt_i_op:
+    compare(in, "g");
+    break;
+  case le_i_op:
+    compare(in, "le");
+    break;
+  case ge_i_op:
+    compare(in, "ge");
+    break;
+  case eq_f_op:
+  case ne_f_op:
+    // Unordered operands set the parity flag.
+    emit("movq " + loc(in.b) + ", %xmm0");
+    emit("movq " + loc(in.c) + ", %xmm1");
+    emit("ucomisd %xmm1, %xmm0");
+    if (in.op == eq_f_op) {
+      emit("sete %al");
+      emit("setnp %cl");
+      emit("andb %cl, %al");
+    }
+    else {
+      emit("setne %al");
+      emit("setp %cl");
+      emit("orb %cl, %al");
+    }
+    emit("movzbl %al, %eax");
+    store("%rax", in.a);
+    break;
+  case lt_f_op:
+    compare_float(in, "a", true);
+    break;
+  case gt_f_op:
+    compare_float(in, "a", false);
+    break;
+  case le_f_op:
+    compare_float(in, "ae", true);
+    break;
+  case ge_f_op:
+    compare_float(in, "ae", false);
+    break;
+
+  // Logic
+  case not_b_op:
+    emit("xorl %eax, %eax");
+    emit("cmpq $0, " + loc(in.b));
+    emit("sete %al");
+    store("%rax", in.a);
+    break;
+
+  // Control
+  case jmp_op:
+    emit("jmp " + label(in.a));
+    break;
+  case jt_op:
+  case jf_op:
+    emit("cmpq $0, " + loc(in.a));
+    emit((in.op == jt_op ? "jne " : "je ") + label(in.b));
+    break;
+  case call_op:
+  case calli_op:
+    call(code, in);
+    break;
+  case ret_op:
+    load(in.a, "%rax");
+    emit("jmp .L" + m_sym + "_ret");
+    break;
+  case tcall_op:
+  case tcalli_op:
+    tail_call(code, in);
+    break;
+  }
+}
+
+void
+Asm_translation::call(Code const& code, Instr const& in)
+{
+  bool direct = in.op == call_op;
+  Code const* callee = direct ? code.get_callee(in.b) : nullptr;
+  if (direct && !callee) {
+    emit("jmp rt_undefined");
+    return;
+  }
+  if (!direct)
+    load(in.b, "%r11");
+
+  // Push the arguments and pop the first into registers. This reads
+  // every argument before any argument register is written.
+  int args = count_arguments(code, in);
+  int stack = std::max(args - num_arg_regs, 0);
+  int area = reserve(callee, stack);
+  if (area > stack)
+    emit("subq $" + std::to_string(8 * (area - stack)) + ", %rsp");
+  for (int i = args - 1; i >= 0; --i)
+    emit("pushq " + loc(in.c + i));
+  for (int i = 0; i < std::min(args, num_arg_regs); ++i)
+    emit(std::string("popq ") + arg_regs[i]);
+
+  if (direct) {
+    emit("call " + symbol(callee));
+  }
+  else {
+    emit("testq %r11, %r11");
+    emit("je rt_undefined");
+    emit("call *%r11");
+  }
+  if (area)
+    emit("addq $" + std::to_string(8 * area) + ", %rsp");
+  store("%rax", in.a);
+}
+
+void
+Asm_translation::tail_call(Code const& code, Instr const& in)
+{
+  int args = count_arguments(code, in);
+  if (in.op == tcall_op && !code.get_callee(in.b)) {
+    emit("jmp rt_undefined");
+    return;
+  }
+  if (in.op == tcalli_op) {
+    load(in.b, "%r11");
+    emit("testq %r11, %r11");
+    emit("je rt_undefined");
+  }
+  // The stack arguments replace this function's own, which were copied
+  // to their homes on entry. This function was called with an area large
+  // enough for them.
+  for (int i = args - 1; i >= 0; --i)
+    emit("pushq " + loc(in.c + i));
+  for (int i = 0; i < std::min(args, num_arg_regs); ++i)
+    emit(std::string("popq ") + arg_regs[i]);
+  for (int i = num_arg_regs; i < args; ++i) {
+    emit("popq %rax");
+    emit("movq %rax, " + std::to_string(16 + 8 * (i - num_arg_regs)) + "(%rbp)");
+  }
+
+  // The callee returns directly to this function's caller.
+  leave();
+  if (in.op == tcall_op)
+    emit("jmp " + symbol(code.get_callee(in.b)));
+  else
+    emit("jmp *%r11");
+}
+
+void
+Asm_translation::divide(Instr const& in, bool rem)
+{
+  // Division by -1 is done separately because the quotient of the least
+  // integer overflows, which faults.
+  emit("testq %rcx, %rcx");
+  emit("je rt_div_zero");
+  emit("cmpq $-1, %rcx");
+  emit("jne 1f");
+  emit(rem ? "xorl %eax, %eax" : "negq %rax");
+  emit("jmp 2f");
+  m_os << "1:\n";
+  emit("cqto");
+  emit("idivq %rcx");
+  if (rem)
+    emit("movq %rdx, %rax");
+  m_os << "2:\n";
+  store("%rax", in.a);
+}
+
+void
+Asm_translation::compare(Instr const& in, char const* cc)
+{
+  load(in.b, "%rcx");
+  emit("xorl %eax, %eax");
+  emit("cmpq " + loc(in.c) + ", %rcx");
+  emit(std::string("set") + cc + " %al");
+  store("%rax", in.a);
+}
+
+void
+Asm_translation::compare_float(Instr const& in, char const* cc, bool swap)
+{
+  emit("movq " + loc(swap ? in.c : in.b) + ", %xmm0");
+  emit("movq " + loc(swap ? in.b : in.c) + ", %xmm1");
+  emit("xorl %eax, %eax");
+  emit("ucomisd %xmm1, %xmm0");
+  emit(std::string("set") + cc + " %al");
+  store("%rax", in.a);
+}
+
+void
+Asm_translation::arithmetic_float(Instr const& in, char const* op)
+{
+  emit("movq " + loc(in.b) + ", %xmm0");
+  emit("movq " + loc(in.c) + ", %xmm1");
+  emit(std::string(op) + " %xmm1, %xmm0");
+  emit("movq %xmm0, " + loc(in.a));
+}
+
+
+void
+translate_to_assembly(Prog_decl const* p, Bytecode const& bc, std::ostream& os)
+{
+  Asm_translation(bc, os).translate(p);
+}
+
+
+Asm_module::Asm_module(Prog_decl const* p, Bytecode const& bc)
+  : m_source(translate(p, bc)),
+    m_native(p, m_source, ".s", "as -o %o.o %i && ld -shared -o %o %o.o")
+{ }
+
+std::string
+Asm_module::translate(Prog_decl const* p, Bytecode const& bc)
+{
+  std::ostringstream ss;
+  translate_to_assembly(p, bc, ss);
+  return ss.str();
+}
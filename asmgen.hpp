@@ -0,0 +1,54 @@
+#pragma once
+
+#include "native.hpp"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Bytecode;
+class Fn_decl;
+class Prog_decl;
+
+
+void translate_to_assembly(Prog_decl const* p, Bytecode const& bc, std::ostream& os);
+/// Writes x86-64 assembly for `p`, whose bytecode is `bc`, in the syntax
+/// of the GNU assembler. Each function follows the System V calling
+/// convention, with every value passed in a general purpose register or
+/// stack slot as its 64-bit encoding. The unit exports the entry points
+/// described by Native_module.
+
+
+/// A program compiled to native code through assembly.
+///
+/// The bytecode of each function is translated to x86-64 instructions
+/// after allocating its registers to machine registers by linear scan.
+/// Bytecode registers whose intervals span a call are placed in
+/// callee-saved registers. Registers whose address is taken, and those
+/// that do not fit, are placed in stack slots. A tail call releases the
+/// frame and jumps to the callee, reusing the caller's stack argument
+/// area, so tail recursion runs in constant stack space. The result is
+/// assembled and linked with the host's `as` and `ld`, and loaded.
+class Asm_module
+{
+public:
+  Asm_module(Prog_decl const* p, Bytecode const& bc);
+  /// Compiles `p`, whose bytecode is `bc`. Throws a runtime error if the
+  /// host tools fail or the library cannot be loaded.
+
+  Value call(Fn_decl const* fn, std::vector<Value> const& args) { return m_native.call(fn, args); }
+  /// Calls `fn` with `args` and returns the result.
+
+  std::string const& get_source() const { return m_source; }
+  /// Returns the generated assembly.
+
+private:
+  static std::string translate(Prog_decl const* p, Bytecode const& bc);
+  /// Returns the translation of `p`.
+
+  std::string m_source;
+  /// The generated assembly.
+
+  Native_module m_native;
+  /// The compiled program.
+};
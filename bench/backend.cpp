@@ -0,0 +1,66 @@
+// Compares the native backends with the bytecode machine on recursive
+// calls and on a loop, reporting the time to compile the program with
+// each backend, the time per operation of each engine, and the speedup
+// of each backend over the machine. The C backend is compiled at -O2,
+// where the C compiler partly unrolls the recursion of fib, so its time
+// per call there is a lower bound rather than the cost of one call.
+//
+// Usage: backend [scale]
+
+#include "programs.hpp"
+
+#include "asmgen.hpp"
+#include "bytecode.hpp"
+#include "cgen.hpp"
+#include "vm.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+int
+main(int argc, char* argv[])
+{
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+  Builder b;
+  Bench_program p(b);
+  Bytecode bc(p.prog, p.statics);
+  Machine vm(bc);
+  std::unique_ptr<C_module> cm;
+  std::unique_ptr<Asm_module> am;
+  double compiled = measure([&] { cm.reset(new C_module(p.prog)); });
+  double assembled = measure([&] { am.reset(new Asm_module(p.prog, bc)); });
+
+  struct Workload
+  {
+    char const* name;
+    Fn_decl* fn;
+    Int_value arg;
+    double ops;
+  };
+  int fib_n = 27;
+  Int_value loop_n = 10000000 * scale;
+  Workload work[] = {
+    {"fib(27)", p.fib, fib_n, fib_calls(fib_n)},
+    {"loop", p.loop, loop_n, double(loop_n)},
+  };
+
+  std::cout << "compile c: " << compiled << " ms\n"
+            << "compile asm: " << assembled << " ms\n";
+  for (Workload const& w : work) {
+    Value r1, r2, r3;
+    double t1 = measure([&] { r1 = vm.call(w.fn, {Value(w.arg)}); });
+    double t2 = measure([&] { r2 = cm->call(w.fn, {Value(w.arg)}); });
+    double t3 = measure([&] { r3 = am->call(w.fn, {Value(w.arg)}); });
+    if (r1.get_int() != r2.get_int() || r1.get_int() != r3.get_int()) {
+      std::cerr << w.name << ": results differ\n";
+      return 1;
+    }
+    std::cout << w.name << '\n';
+    report("  machine", t1, w.ops);
+    report("  c", t2, w.ops);
+    report("  asm", t3, w.ops);
+    std::cout << "  speedup c: " << t1 / t2 << "x\n"
+              << "  speedup asm: " << t1 / t3 << "x\n";
+  }
+}
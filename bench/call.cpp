@@ -0,0 +1,127 @@
+// Compares checking call expressions with the old make_call, which
+// copied the argument vector and copy initialized a dummy Var_decl for
+// each argument, against the current one, which converts the arguments
+// in place. Half of the parameters are references, so those arguments
+// are bound and the others are converted to values, and every call has
+// a nested call as an argument.
+//
+// Usage: call [calls] [rounds]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// The call as checked before arguments were converted in place.
+Expr*
+old_make_call(Builder& b, std::vector<Expr*> const& es)
+{
+  std::vector<Expr*> conv = es;
+
+  Expr*& fn = conv[0];
+  fn = b.require_function(fn);
+  if (Builder::is_error(fn))
+    return fn;
+
+  Fn_type* ft = static_cast<Fn_type*>(fn->get_type());
+
+  if (ft->get_num_parameters() < conv.size() - 1)
+    return b.error("too many arguments");
+  if (ft->get_num_parameters() > conv.size() - 1)
+    return b.error("too few arguments");
+
+  auto ai = conv.begin() + 1;
+  for (Type* p : ft->get_parameter_types()) {
+    Var_decl dummy(nullptr, p);
+    b.copy_initialize(&dummy, *ai);
+    *ai = dummy.get_initializer();
+    if (Builder::is_error(*ai))
+      return *ai;
+    ++ai;
+  }
+
+  return new Call_expr(ft->get_return_type(), std::move(conv));
+}
+
+struct Old
+{
+  Expr* operator()(Builder& b, std::vector<Expr*>&& es) const { return old_make_call(b, es); }
+};
+
+struct New
+{
+  Expr* operator()(Builder& b, std::vector<Expr*>&& es) const { return b.make_call(std::move(es)); }
+};
+
+/// Builds `calls` pairs of calls of the form `f(x, y, g(z, w), z)`, where
+/// the first two parameters of `f` and `g` are references, using `call`
+/// to make each one. Returns the time taken by the calls in milliseconds.
+template<typename Call>
+double
+run(Call call, int calls, std::size_t& errors)
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  Type* r = b.get_reference_type(i);
+  Fn_decl* f = b.make_function(b.get_name("f"), b.get_function_type({r, r, i, i, i}));
+  Fn_decl* g = b.make_function(b.get_name("g"), b.get_function_type({r, r, i}));
+  std::vector<Var_decl*> vars;
+  for (int n = 0; n < 16; ++n) {
+    std::string name = "x" + std::to_string(n);
+    vars.push_back(b.make_variable(b.get_name(name.c_str()), i));
+  }
+
+  // The operands are made first so that only the calls are timed.
+  std::vector<std::vector<Expr*>> inner(calls);
+  std::vector<std::vector<Expr*>> outer(calls);
+  for (int n = 0; n < calls; ++n) {
+    Var_decl* const* v = vars.data() + n % 12;
+    inner[n] = {b.make_id(g), b.make_id(v[2]), b.make_id(v[3])};
+    outer[n] = {b.make_id(f), b.make_id(v[0]), b.make_id(v[1]), nullptr, b.make_id(v[4])};
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < calls; ++n) {
+    outer[n][3] = call(b, std::move(inner[n]));
+    call(b, std::move(outer[n]));
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  errors += b.get_diagnostics().size();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int calls = argc > 1 ? std::atoi(argv[1]) : 200000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  // Alternate the two paths and keep the best time of each.
+  std::size_t errors = 0;
+  double old_ms = 1e300;
+  double new_ms = 1e300;
+  for (int k = 0; k < rounds; ++k) {
+    old_ms = std::min(old_ms, run(Old(), calls, errors));
+    new_ms = std::min(new_ms, run(New(), calls, errors));
+  }
+
+  std::cout << "calls: " << 2 * calls << '\n'
+            << "copy and dummy Var_decl: " << old_ms << " ms\n"
+            << "in place: " << new_ms << " ms\n"
+            << "speedup: " << old_ms / new_ms << '\n'
+            << "errors: " << errors << '\n';
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Measures how check_functions scales with the number of jobs and of
+// threads. Each job builds a body of arithmetic over its parameters,
+// so it is dominated by conversions and type lookups in the shared
+// Type_table, and each interns a function type of its own.
+//
+// Usage: checker [statements] [max-threads]
+
+#include "builder.hpp"
+#include "checker.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int params = 8;
+/// The number of parameters of each function.
+
+std::vector<Check_job>
+make_jobs(Builder& b, int n, int stmts)
+{
+  Type* i = b.get_int_type();
+  std::vector<Check_job> jobs;
+  for (int k = 0; k < n; ++k) {
+    std::string name = "f" + std::to_string(k);
+    Fn_decl* fn = b.make_function(b.get_name(name.c_str()),
+                                  b.get_function_type(std::vector<Type*>(params + 1, i)));
+    std::vector<Decl*> ps;
+    for (int p = 0; p < params; ++p) {
+      ps.push_back(b.make_variable(b.get_name("p"), i));
+      fn->add_parameter(ps.back());
+    }
+    jobs.push_back({fn, [k, stmts, ps](Builder& b, Fn_decl*) -> Stmt* {
+      Type* i = b.get_int_type();
+      b.get_function_type({b.get_reference_type(i), b.get_float_type(), i,
+                           b.get_type_table().get_type(k % 4)});
+      std::vector<Stmt*> ss;
+      for (int n = 0; n < stmts; ++n) {
+        Decl* const* v = ps.data() + n % 4;
+        Expr* sum = b.make_add(b.make_id(v[0]), b.make_id(v[1]));
+        Expr* diff = b.make_sub(b.make_id(v[2]), b.make_id(v[3]));
+        Expr* cmp = b.make_lt(b.make_mul(sum, diff), b.make_id(v[4]));
+        Expr* sel = b.make_conditional(cmp, b.make_id(v[2]), b.make_id(v[3]));
+        ss.push_back(b.make_expression(b.make_assign(b.make_id(v[0]), sel)));
+      }
+      return b.make_block(ss);
+    }});
+  }
+  return jobs;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int stmts = argc > 1 ? std::atoi(argv[1]) : 200;
+  unsigned max_threads = argc > 2 ? std::atoi(argv[2]) : 32;
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << '\n'
+            << std::setw(8) << "jobs" << std::setw(10) << "threads"
+            << std::setw(12) << "ms" << std::setw(10) << "speedup" << '\n';
+  int errors = 0;
+  for (int n : {64, 256, 1024}) {
+    double serial = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+      Type_table types;
+      Builder b(types);
+      std::vector<Check_job> jobs = make_jobs(b, n, stmts);
+
+      auto start = std::chrono::steady_clock::now();
+      errors += check_functions(types, jobs, threads).size();
+      auto stop = std::chrono::steady_clock::now();
+      double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+      if (threads == 1)
+        serial = ms;
+
+      std::cout << std::setw(8) << n << std::setw(10) << threads
+                << std::setw(12) << std::fixed << std::setprecision(2) << ms
+                << std::setw(10) << serial / ms << '\n';
+    }
+  }
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+// Measures the evaluator on recursive calls, a loop, and a chain of
+// nested calls, reporting the time of each and the time per operation:
+// per call for fib and calls, and per iteration for loop.
+//
+// Usage: eval [scale]
+
+#include "programs.hpp"
+
+#include "eval.hpp"
+
+#include <cstdlib>
+
+int
+main(int argc, char* argv[])
+{
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+  Builder b;
+  Bench_program p(b);
+  Evaluator ev(p.prog, p.statics);
+
+  int fib_n = 25;
+  Int_value loop_n = 1000000 * scale;
+  Int_value calls_n = 100000 * scale;
+  Value v;
+
+  double t = measure([&] { v = ev.call(p.fib, {Value(Int_value(fib_n))}); });
+  report("fib(25)", t, fib_calls(fib_n));
+  t = measure([&] { v = ev.call(p.loop, {Value(loop_n)}); });
+  report("loop", t, loop_n);
+  t = measure([&] { v = ev.call(p.calls, {Value(calls_n)}); });
+  report("calls", t, 7.0 * calls_n);
+}
@@ -0,0 +1,143 @@
+// Compares the pointer layout of expressions with Flat_tree: the bytes
+// per node, the time to flatten, and the time of a bottom-up pass over
+// each layout. The pass computes the height of every expression and the
+// sum of its integer literals, as an analysis over the tree would.
+//
+// Usage: flat [expressions] [repetitions]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "flat.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// Returns a random arithmetic expression of `depth` levels over `x`.
+Expr*
+make_expr(Builder& b, std::mt19937& gen, Var_decl* x, int depth)
+{
+  if (depth == 0) {
+    if (gen() % 2)
+      return b.make_int(gen() % 100);
+    return b.convert_to_value(b.make_id(x));
+  }
+  Expr* l = make_expr(b, gen, x, depth - 1);
+  Expr* r = make_expr(b, gen, x, gen() % depth);
+  switch (gen() % 4) {
+  case 0: return b.make_add(l, r);
+  case 1: return b.make_sub(l, r);
+  case 2: return b.make_mul(l, r);
+  default: return b.make_neg(l);
+  }
+}
+
+/// The result of the pass.
+struct Summary
+{
+  long height = 0;
+  long sum = 0;
+};
+
+/// Returns the height of `e` and adds its literals to `s`.
+int
+visit(Expr const* e, Summary& s)
+{
+  if (e->get_kind() == Expr::int_lit) {
+    s.sum += static_cast<Literal_expr const*>(e)->get_value().get_int();
+    return 1;
+  }
+  int h = 0;
+  for (Expr const* c : e->get_children())
+    h = std::max(h, visit(c, s));
+  return h + 1;
+}
+
+/// Computes the heights of all nodes of `t` in one forward sweep.
+Summary
+sweep(Flat_tree const& t, std::vector<std::uint32_t> const& roots, std::vector<int>& heights)
+{
+  Summary s;
+  heights.resize(t.size());
+  for (std::uint32_t n = 0; n < t.size(); ++n) {
+    Flat_node const& node = t.get_node(n);
+    if (node.kind == Expr::int_lit)
+      s.sum += t.get_value(n).get_int();
+    int h = 0;
+    for (int i = 0; i < node.arity; ++i)
+      h = std::max(h, heights[t.get_operand(n, i)]);
+    heights[n] = h + 1;
+  }
+  for (std::uint32_t r : roots)
+    s.height += heights[r];
+  return s;
+}
+
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::atoi(argv[1]) : 20000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  Builder b;
+  Var_decl* x = b.make_variable(b.get_name("x"), b.get_int_type());
+  std::mt19937 gen(42);
+  std::vector<Expr*> exprs;
+  enable_node_stats(false);
+  for (int k = 0; k < count; ++k)
+    exprs.push_back(make_expr(b, gen, x, 8));
+  disable_node_stats();
+  Node_count nodes = get_node_total(expr_node);
+
+  Flat_tree t;
+  std::vector<std::uint32_t> roots;
+  double flattened = measure([&] {
+    for (Expr const* e : exprs)
+      roots.push_back(t.add(e));
+  });
+
+  Summary s1, s2;
+  double pointer = measure([&] {
+    for (int n = 0; n < reps; ++n) {
+      s1 = Summary();
+      for (Expr const* e : exprs)
+        s1.height += visit(e, s1);
+    }
+  });
+  std::vector<int> heights;
+  double flat = measure([&] {
+    for (int n = 0; n < reps; ++n)
+      s2 = sweep(t, roots, heights);
+  });
+  if (s1.height != s2.height || s1.sum != s2.sum) {
+    std::cerr << "results differ\n";
+    return 1;
+  }
+
+  std::cout << "nodes: " << t.size() << '\n'
+            << "pointer bytes/node: " << double(nodes.bytes) / nodes.constructed << '\n'
+            << "flat bytes/node: " << double(t.get_bytes()) / t.size() << '\n'
+            << "flatten: " << flattened << " ms\n"
+            << "pointer pass: " << pointer / reps << " ms\n"
+            << "flat pass: " << flat / reps << " ms\n";
+}
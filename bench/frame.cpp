@@ -0,0 +1,74 @@
+// Compares pushing and popping frames on the call stack, which takes
+// them from a contiguous arena, with allocating each frame and its local
+// store on the heap. Frames are pushed to a fixed depth and popped again,
+// as a recursion would, and each binds its parameter.
+//
+// Usage: frame [calls] [depth]
+
+#include "programs.hpp"
+
+#include "frame.hpp"
+#include "object.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+
+/// A frame whose local store is allocated on the heap.
+struct Heap_frame
+{
+  Heap_frame(Frame* prev, Fn_decl* fn)
+    : objs(new Object[fn->get_frame_size()]),
+      slots(new Object*[fn->get_frame_size()]()),
+      frame(new Frame(prev, fn, objs.get(), slots.get()))
+  { }
+
+  std::unique_ptr<Object[]> objs;
+  std::unique_ptr<Object*[]> slots;
+  std::unique_ptr<Frame> frame;
+};
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int calls = argc > 1 ? std::atoi(argv[1]) : 10000000;
+  int depth = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  Builder b;
+  Bench_program p(b);
+  Fn_decl* fn = p.calls;
+  Decl* parm = *fn->get_parameters().begin();
+  int rounds = calls / depth;
+
+  Call_stack stack;
+  double arena = measure([&] {
+    for (int r = 0; r < rounds; ++r) {
+      for (int d = 0; d < depth; ++d)
+        stack.push(fn)->allocate_local(parm);
+      for (int d = 0; d < depth; ++d)
+        stack.pop();
+    }
+  });
+
+  std::vector<std::unique_ptr<Heap_frame>> frames;
+  double heap = measure([&] {
+    for (int r = 0; r < rounds; ++r) {
+      for (int d = 0; d < depth; ++d) {
+        Frame* prev = frames.empty() ? nullptr : frames.back()->frame.get();
+        frames.emplace_back(new Heap_frame(prev, fn));
+        frames.back()->frame->allocate_local(parm);
+      }
+      for (int d = 0; d < depth; ++d)
+        frames.pop_back();
+    }
+  });
+
+  double ops = double(rounds) * depth;
+  std::cout << "frame size: " << fn->get_frame_size() << " objects\n";
+  report("arena", arena, ops);
+  report("heap", heap, ops);
+}
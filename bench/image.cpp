@@ -0,0 +1,129 @@
+// Compares loading a program from its image with building and checking
+// it again. The program has many functions, each with a loop, a branch,
+// and calls, built through Builder as the front end would.
+//
+// Usage: image [functions] [repetitions]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "image.hpp"
+#include "stmt.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// Builds a program of `count` functions. Function k is
+///
+///   fun fk(n : int) -> int {
+///     var s = 0; var i = 0;
+///     while (i < n) { if (i % 2 == 0) s = s + fj(i); else s = s - i; i = i + 1; }
+///     return s * 3 + n;
+///   }
+///
+/// where fj is the previous function, or fk itself for the first.
+Prog_decl*
+build(Builder& b, int count)
+{
+  Type* t = b.get_int_type();
+  Type* ft = b.get_function_type({t, t});
+  std::vector<Decl*> fns;
+  Fn_decl* prev = nullptr;
+  for (int k = 0; k < count; ++k) {
+    std::string name = "f" + std::to_string(k);
+    Fn_decl* fn = b.make_function(b.get_name(name.c_str()), ft);
+    Var_decl* n = b.make_variable(b.get_name("n"), t);
+    fn->add_parameter(n);
+    fn->set_return(b.make_variable(b.get_name("ret"), t));
+    Fn_decl* callee = prev ? prev : fn;
+
+    Var_decl* s = b.make_variable(b.get_name("s"), t);
+    Var_decl* i = b.make_variable(b.get_name("i"), t);
+    b.copy_initialize(s, b.make_int(0));
+    b.copy_initialize(i, b.make_int(0));
+    Stmt* step = b.make_if(
+      b.make_eq(b.make_rem(b.make_id(i), b.make_int(2)), b.make_int(0)),
+      b.make_expression(b.make_assign(b.make_id(s),
+        b.make_add(b.make_id(s), b.make_call({b.make_id(callee), b.make_id(i)})))),
+      b.make_expression(b.make_assign(b.make_id(s), b.make_sub(b.make_id(s), b.make_id(i)))));
+    fn->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(i),
+      b.make_while(b.make_lt(b.make_id(i), b.make_id(n)), b.make_block({
+        step,
+        b.make_expression(b.make_assign(b.make_id(i), b.make_add(b.make_id(i), b.make_int(1)))),
+      })),
+      b.make_return(b.make_variable(nullptr, t),
+                    b.make_add(b.make_mul(b.make_id(s), b.make_int(3)), b.make_id(n))),
+    }));
+    fns.push_back(fn);
+    prev = fn;
+  }
+  return new Prog_decl(fns);
+}
+
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+  double built = measure([&] {
+    for (int n = 0; n < reps; ++n) {
+      Builder b;
+      build(b, count);
+    }
+  });
+
+  Builder b;
+  Prog_decl* prog = build(b, count);
+  std::ostringstream os;
+  double written = measure([&] {
+    write_image(os, prog);
+  });
+  std::string data = os.str();
+
+  double read = measure([&] {
+    for (int n = 0; n < reps; ++n) {
+      Builder c;
+      read_image(c, data.data(), data.size());
+    }
+  });
+
+  std::string path = "image.bench.tmp";
+  write_image(path, prog);
+  double mapped = measure([&] {
+    for (int n = 0; n < reps; ++n) {
+      Builder c;
+      Image_file file(path);
+      read_image(c, file);
+    }
+  });
+  std::remove(path.c_str());
+
+  std::cout << "functions: " << count << '\n'
+            << "image: " << data.size() << " bytes\n"
+            << "build: " << built / reps << " ms\n"
+            << "write: " << written << " ms\n"
+            << "read: " << read / reps << " ms\n"
+            << "read mapped: " << mapped / reps << " ms\n";
+}
@@ -0,0 +1,58 @@
+// Compares a helper-heavy workload before and after inlining, on the
+// evaluator and on the bytecode machine. Each iteration of calls makes
+// seven calls to the small functions outer, middle, and inner, which
+// the inliner replaces with their bodies.
+//
+// Usage: inline [scale]
+
+#include "programs.hpp"
+
+#include "bytecode.hpp"
+#include "eval.hpp"
+#include "inline.hpp"
+#include "vm.hpp"
+
+#include <cstdlib>
+
+int
+main(int argc, char* argv[])
+{
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+  Builder b1;
+  Builder b2;
+  Bench_program p1(b1);
+  Bench_program p2(b2);
+  std::size_t inlined = 0;
+  double transformed = measure([&] { inlined = inline_calls(b2, p2.prog); });
+
+  Evaluator ev1(p1.prog, p1.statics);
+  Evaluator ev2(p2.prog, p2.statics);
+  Bytecode bc1(p1.prog, p1.statics);
+  Bytecode bc2(p2.prog, p2.statics);
+  Machine vm1(bc1);
+  Machine vm2(bc2);
+
+  Int_value n = 100000 * scale;
+  double ops = 7.0 * n;
+  Value r1, r2, r3, r4;
+  double t1 = measure([&] { r1 = ev1.call(p1.calls, {Value(n)}); });
+  double t2 = measure([&] { r2 = ev2.call(p2.calls, {Value(n)}); });
+  double t3 = measure([&] { r3 = vm1.call(p1.calls, {Value(n)}); });
+  double t4 = measure([&] { r4 = vm2.call(p2.calls, {Value(n)}); });
+  if (r1.get_int() != r2.get_int() || r1.get_int() != r3.get_int() ||
+      r1.get_int() != r4.get_int()) {
+    std::cerr << "results differ\n";
+    return 1;
+  }
+
+  std::cout << "inlined: " << inlined << " calls in " << transformed << " ms\n"
+            << "evaluator\n";
+  report("  calls", t1, ops);
+  report("  inlined", t2, ops);
+  std::cout << "  speedup: " << t1 / t2 << "x\n"
+            << "machine\n";
+  report("  calls", t3, ops);
+  report("  inlined", t4, ops);
+  std::cout << "  speedup: " << t3 / t4 << "x\n";
+}
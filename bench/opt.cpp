@@ -0,0 +1,70 @@
+// Measures the IR machine on each workload at each optimization level,
+// reporting the time, the time per operation, and the speedup over
+// level 0. The size of the optimized program is reported as well.
+//
+// Usage: opt [scale]
+
+#include "programs.hpp"
+
+#include "ir_machine.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+
+namespace
+{
+
+/// Returns the number of instructions in `p`.
+std::size_t
+count_instructions(Ir_program const& p)
+{
+  std::size_t n = 0;
+  for (auto const& fn : p.get_functions())
+    n += fn->count_instructions();
+  return n;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+  Builder b;
+  Bench_program p(b);
+
+  struct Workload
+  {
+    char const* name;
+    Fn_decl* fn;
+    Int_value arg;
+    double ops;
+  };
+  int fib_n = 25;
+  Int_value loop_n = 1000000 * scale;
+  Int_value calls_n = 100000 * scale;
+  Workload work[] = {
+    {"fib(25)", p.fib, fib_n, fib_calls(fib_n)},
+    {"loop", p.loop, loop_n, double(loop_n)},
+    {"calls", p.calls, calls_n, 7.0 * calls_n},
+    {"kernel", p.kernel, loop_n, double(loop_n)},
+  };
+
+  double base[std::size(work)];
+  std::cout << std::setprecision(3);
+  for (int level = 0; level <= 3; ++level) {
+    Ir_machine ir(p.prog, level);
+    std::cout << "-O" << level << " (" << count_instructions(ir.get_program())
+              << " instructions)\n";
+    for (std::size_t n = 0; n < std::size(work); ++n) {
+      Workload const& w = work[n];
+      double t = measure([&] { ir.call(w.fn, {Value(w.arg)}); });
+      if (level == 0)
+        base[n] = t;
+      std::cout << "  ";
+      report(w.name, t, w.ops);
+      std::cout << "    speedup: " << base[n] / t << "x\n";
+    }
+  }
+}
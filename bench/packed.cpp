@@ -0,0 +1,117 @@
+// Compares arithmetic loops over values stored as Value with the same
+// loops over values stored as Packed_value. Each pass reads two arrays
+// of values and writes one, as a loop over locals in the store does, so
+// the arrays are sized past the caches to expose memory traffic.
+//
+// Usage: packed [elements] [passes]
+
+#include "packed.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+// Each loop computes x[i] = x[i] * 3 + y[i], masked to 16 bits for
+// integers so that none is boxed, and returns a checksum.
+
+Int_value
+loop_int(std::vector<Value>& x, std::vector<Value> const& y)
+{
+  Int_value sum = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = Value((x[i].get_int() * 3 + y[i].get_int()) & 0xffff);
+    sum += x[i].get_int();
+  }
+  return sum;
+}
+
+Int_value
+loop_int(std::vector<Packed_value>& x, std::vector<Packed_value> const& y)
+{
+  Int_value sum = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = Packed_value(Int_value((x[i].get_int() * 3 + y[i].get_int()) & 0xffff));
+    sum += x[i].get_int();
+  }
+  return sum;
+}
+
+Float_value
+loop_float(std::vector<Value>& x, std::vector<Value> const& y)
+{
+  Float_value sum = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = Value(x[i].get_float() * 0.5 + y[i].get_float());
+    sum += x[i].get_float();
+  }
+  return sum;
+}
+
+Float_value
+loop_float(std::vector<Packed_value>& x, std::vector<Packed_value> const& y)
+{
+  Float_value sum = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    x[i] = Packed_value(x[i].get_float() * 0.5 + y[i].get_float());
+    sum += x[i].get_float();
+  }
+  return sum;
+}
+
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+/// Runs the integer and float loops over arrays of `V` and reports the
+/// time of each. Returns the checksums.
+template<typename V>
+std::pair<Int_value, Float_value>
+run(char const* name, std::size_t n, int passes)
+{
+  std::vector<V> xi, yi, xf, yf;
+  for (std::size_t i = 0; i < n; ++i) {
+    xi.emplace_back(Int_value(i % 7));
+    yi.emplace_back(Int_value(i % 5) - 2);
+    xf.emplace_back(Float_value(i % 7));
+    yf.emplace_back(Float_value(i % 5));
+  }
+
+  Int_value si = 0;
+  Float_value sf = 0;
+  double ti = measure([&] {
+    for (int p = 0; p < passes; ++p)
+      si += loop_int(xi, yi);
+  });
+  double tf = measure([&] {
+    for (int p = 0; p < passes; ++p)
+      sf += loop_float(xf, yf);
+  });
+
+  std::cout << name << " (" << sizeof(V) << " bytes): "
+            << "int " << ti << " ms, float " << tf << " ms\n";
+  return {si, sf};
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  std::size_t n = argc > 1 ? std::atol(argv[1]) : 1 << 22;
+  int passes = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  std::cout << "elements: " << n << '\n';
+  auto r1 = run<Value>("Value", n, passes);
+  auto r2 = run<Packed_value>("Packed_value", n, passes);
+  return r1 == r2 ? 0 : 1;
+}
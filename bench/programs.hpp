@@ -0,0 +1,223 @@
+// Programs and timing shared by the benchmarks of the execution engines.
+
+#pragma once
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "value.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/// A checked and laid out program whose functions are the workloads of
+/// the engine benchmarks:
+///
+///   fun fib(n : int) -> int {
+///     if (n < 2) return n; return fib(n - 1) + fib(n - 2);
+///   }
+///   fun loop(n : int) -> int {
+///     var s = 0; var i = 0;
+///     while (i < n) { s = s + i * 3 % 7; i = i + 1; }
+///     return s;
+///   }
+///   fun inner(x : int) -> int { return x + 1; }
+///   fun middle(x : int) -> int { return inner(x) + inner(x + 1); }
+///   fun outer(x : int) -> int { return middle(x) + middle(x + 2); }
+///   fun calls(n : int) -> int {
+///     var s = 0; var i = 0;
+///     while (i < n) { s = s + outer(i); i = i + 1; }
+///     return s;
+///   }
+///   fun kernel(n : int) -> int {
+///     var s = 0; var i = 0; var k = n % 13 + 2;
+///     while (i < n) { s = s + (k * k + i) * (k * k + i) % 7 + 4 * 5; i = i + 1; }
+///     return s;
+///   }
+///
+/// A call of calls(n) makes 7n calls. The loop of kernel has a constant
+/// to fold, an invariant to hoist, and a redundant expression.
+class Bench_program
+{
+public:
+  explicit Bench_program(Builder& b);
+
+  Builder& b;
+  Fn_decl* fib;
+  Fn_decl* loop;
+  Fn_decl* inner;
+  Fn_decl* middle;
+  Fn_decl* outer;
+  Fn_decl* calls;
+  Fn_decl* kernel;
+
+  Prog_decl* prog;
+  int statics;
+
+private:
+  Fn_decl* function(char const* name);
+  Expr* parm(Fn_decl* fn);
+  Expr* num(int n) { return b.make_int(n); }
+  Expr* call(Fn_decl* fn, Expr* arg) { return b.make_call({b.make_id(fn), arg}); }
+  Stmt* ret(Fn_decl* fn, Expr* e);
+  Stmt* assign(Var_decl* v, Expr* e);
+};
+
+inline
+Bench_program::Bench_program(Builder& b)
+  : b(b)
+{
+  Type* i = b.get_int_type();
+
+  fib = function("fib");
+  fib->set_body(b.make_block({
+    b.make_if(b.make_lt(parm(fib), num(2)), ret(fib, parm(fib)), nullptr),
+    ret(fib, b.make_add(call(fib, b.make_sub(parm(fib), num(1))),
+                        call(fib, b.make_sub(parm(fib), num(2))))),
+  }));
+
+  loop = function("loop");
+  {
+    Var_decl* s = b.make_variable(b.get_name("s"), i);
+    Var_decl* k = b.make_variable(b.get_name("i"), i);
+    b.copy_initialize(s, num(0));
+    b.copy_initialize(k, num(0));
+    loop->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(k),
+      b.make_while(b.make_lt(b.make_id(k), parm(loop)), b.make_block({
+        assign(s, b.make_add(b.make_id(s),
+                             b.make_rem(b.make_mul(b.make_id(k), num(3)), num(7)))),
+        assign(k, b.make_add(b.make_id(k), num(1))),
+      })),
+      ret(loop, b.make_id(s)),
+    }));
+  }
+
+  inner = function("inner");
+  inner->set_body(b.make_block({
+    ret(inner, b.make_add(parm(inner), num(1))),
+  }));
+
+  middle = function("middle");
+  middle->set_body(b.make_block({
+    ret(middle, b.make_add(call(inner, parm(middle)),
+                           call(inner, b.make_add(parm(middle), num(1))))),
+  }));
+
+  outer = function("outer");
+  outer->set_body(b.make_block({
+    ret(outer, b.make_add(call(middle, parm(outer)),
+                          call(middle, b.make_add(parm(outer), num(2))))),
+  }));
+
+  calls = function("calls");
+  {
+    Var_decl* s = b.make_variable(b.get_name("s"), i);
+    Var_decl* k = b.make_variable(b.get_name("i"), i);
+    b.copy_initialize(s, num(0));
+    b.copy_initialize(k, num(0));
+    calls->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(k),
+      b.make_while(b.make_lt(b.make_id(k), parm(calls)), b.make_block({
+        assign(s, b.make_add(b.make_id(s), call(outer, b.make_id(k)))),
+        assign(k, b.make_add(b.make_id(k), num(1))),
+      })),
+      ret(calls, b.make_id(s)),
+    }));
+  }
+
+  kernel = function("kernel");
+  {
+    Var_decl* s = b.make_variable(b.get_name("s"), i);
+    Var_decl* k = b.make_variable(b.get_name("i"), i);
+    Var_decl* c = b.make_variable(b.get_name("k"), i);
+    b.copy_initialize(s, num(0));
+    b.copy_initialize(k, num(0));
+    b.copy_initialize(c, b.make_add(b.make_rem(parm(kernel), num(13)), num(2)));
+    auto term = [&] {
+      return b.make_add(b.make_mul(b.make_id(c), b.make_id(c)), b.make_id(k));
+    };
+    kernel->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(k),
+      b.make_declaration(c),
+      b.make_while(b.make_lt(b.make_id(k), parm(kernel)), b.make_block({
+        assign(s, b.make_add(b.make_id(s),
+                             b.make_add(b.make_rem(b.make_mul(term(), term()), num(7)),
+                                        b.make_mul(num(4), num(5))))),
+        assign(k, b.make_add(b.make_id(k), num(1))),
+      })),
+      ret(kernel, b.make_id(s)),
+    }));
+  }
+
+  prog = new Prog_decl({fib, loop, inner, middle, outer, calls, kernel});
+  statics = b.layout_program(prog);
+}
+
+/// Returns a function taking and returning an int.
+inline Fn_decl*
+Bench_program::function(char const* name)
+{
+  Type* i = b.get_int_type();
+  Fn_decl* fn = b.make_function(b.get_name(name), b.get_function_type({i, i}));
+  fn->add_parameter(b.make_variable(b.get_name("n"), i));
+  fn->set_return(b.make_variable(b.get_name("ret"), i));
+  return fn;
+}
+
+/// Returns the value of the parameter of `fn`.
+inline Expr*
+Bench_program::parm(Fn_decl* fn)
+{
+  return b.make_id(*fn->get_parameters().begin());
+}
+
+/// Returns a statement returning `e` from `fn`. Each return initializes
+/// its own variable.
+inline Stmt*
+Bench_program::ret(Fn_decl* fn, Expr* e)
+{
+  return b.make_return(b.make_variable(nullptr, b.get_int_type()), e);
+}
+
+inline Stmt*
+Bench_program::assign(Var_decl* v, Expr* e)
+{
+  return b.make_expression(b.make_assign(b.make_id(v), e));
+}
+
+/// Returns the time taken by `f`, in milliseconds.
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+/// Writes a line reporting `ms` for a workload of `ops` operations.
+inline void
+report(char const* name, double ms, double ops)
+{
+  std::cout << name << ": " << ms << " ms, " << ms * 1e6 / ops << " ns/op\n";
+}
+
+/// Returns the number of calls made by fib(n).
+inline double
+fib_calls(int n)
+{
+  double a = 1, b = 1;
+  for (int k = 1; k < n; ++k) {
+    double c = a + b + 1;
+    a = b;
+    b = c;
+  }
+  return b;
+}
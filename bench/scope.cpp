@@ -0,0 +1,120 @@
+// Compares Scope_stack and Resolver on deeply nested blocks. Each block
+// declares a few symbols and looks up symbols declared in the outermost
+// block, as in a reference to a parameter from a nested loop body.
+//
+// Usage: scope [depth] [repetitions]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "scope.hpp"
+#include "symbol.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr int locals = 4;
+/// The number of symbols declared in each block.
+
+constexpr int uses = 16;
+/// The number of lookups made in each block.
+
+struct Input
+{
+  std::vector<Symbol> syms;
+  Decl* decl;
+};
+
+/// Returns the symbol declared `n`th in the block at `depth`.
+Symbol
+get_local(Input const& in, int depth, int n)
+{
+  return in.syms[depth * locals + n];
+}
+
+/// Returns a symbol declared in the outermost block.
+Symbol
+get_outer(Input const& in, int n)
+{
+  return in.syms[n % locals];
+}
+
+std::size_t
+run_stack(Input const& in, int depth)
+{
+  std::size_t found = 0;
+  Scope_stack ss;
+  for (int d = 0; d < depth; ++d) {
+    ss.emplace_back();
+    for (int n = 0; n < locals; ++n)
+      ss.back().declare(get_local(in, d, n), in.decl);
+    for (int n = 0; n < uses; ++n)
+      found += ss.lookup(get_outer(in, n)) != nullptr;
+  }
+  return found;
+}
+
+std::size_t
+run_resolver(Resolver& r, Input const& in, int depth)
+{
+  std::size_t found = 0;
+  for (int d = 0; d < depth; ++d) {
+    r.enter_scope();
+    for (int n = 0; n < locals; ++n)
+      r.declare(get_local(in, d, n), in.decl);
+    for (int n = 0; n < uses; ++n)
+      found += r.lookup(get_outer(in, n)) != nullptr;
+  }
+  for (int d = 0; d < depth; ++d)
+    r.leave_scope();
+  return found;
+}
+
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int depth = argc > 1 ? std::atoi(argv[1]) : 64;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 10000;
+
+  Builder b;
+  Symbol_table table;
+  Input in;
+  in.decl = b.make_variable(b.get_name("x"), b.get_int_type());
+  for (int n = 0; n < depth * locals; ++n)
+    in.syms.push_back(table.get("x" + std::to_string(n)));
+
+  std::size_t found1 = 0;
+  double stack = measure([&] {
+    for (int n = 0; n < reps; ++n)
+      found1 += run_stack(in, depth);
+  });
+
+  std::size_t found2 = 0;
+  Resolver r;
+  double resolver = measure([&] {
+    for (int n = 0; n < reps; ++n)
+      found2 += run_resolver(r, in, depth);
+  });
+
+  std::cout << "depth: " << depth << '\n'
+            << "Scope_stack: " << stack << " ms\n"
+            << "Resolver: " << resolver << " ms\n";
+  return found1 == found2 ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+// Measures building and type checking expressions over many
+// id-expressions. Each id-expression asks for a reference type and each
+// operator compares types, so this is dominated by type lookup.
+//
+// Usage: typecheck [iterations]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "type.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int
+main(int argc, char* argv[])
+{
+  int iters = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+  Builder b;
+  Type* i = b.get_int_type();
+  std::vector<Var_decl*> vars;
+  for (int n = 0; n < 16; ++n) {
+    std::string name = "x" + std::to_string(n);
+    vars.push_back(b.make_variable(b.get_name(name.c_str()), i));
+  }
+  Fn_decl* fn = b.make_function(b.get_name("f"), b.get_function_type({i, i, i}));
+
+  auto start = std::chrono::steady_clock::now();
+  std::size_t nodes = 0;
+  for (int n = 0; n < iters; ++n) {
+    // x0 = (x1 + x2) * (x3 - x4) < x5 ? x6 : x7 ...
+    Var_decl* const* v = vars.data() + (n % 8);
+    Expr* sum = b.make_add(b.make_id(v[1]), b.make_id(v[2]));
+    Expr* diff = b.make_sub(b.make_id(v[3]), b.make_id(v[4]));
+    Expr* cmp = b.make_lt(b.make_mul(sum, diff), b.make_id(v[5]));
+    Expr* sel = b.make_conditional(cmp, b.make_id(v[6]), b.make_id(v[7]));
+    b.make_assign(b.make_id(v[0]), b.make_call({b.make_id(fn), sel, b.make_id(v[8])}));
+    nodes += 13;
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+  std::cout << "expressions: " << nodes << '\n'
+            << "time: " << ms << " ms\n"
+            << "types: " << b.get_type_table().size() << '\n'
+            << "errors: " << b.get_diagnostics().size() << '\n';
+}
@@ -0,0 +1,160 @@
+// Compares dispatch through Const_expr_visitor with a hand-written switch
+// on the kind of each expression. Both evaluate the same random
+// arithmetic expressions over a variable, so they differ only in how the
+// handler for each node is reached. The expressions fit in cache, and
+// each is timed as the best of several rounds, so that the difference is
+// not hidden by memory latency or by warming up.
+//
+// Usage: visitor [expressions] [repetitions]
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "visitor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+/// Returns a random arithmetic expression of `depth` levels over `x`.
+Expr*
+make_expr(Builder& b, std::mt19937& gen, Var_decl* x, int depth)
+{
+  if (depth == 0) {
+    if (gen() % 2)
+      return b.make_int(gen() % 100);
+    return b.convert_to_value(b.make_id(x));
+  }
+  Expr* l = make_expr(b, gen, x, depth - 1);
+  Expr* r = make_expr(b, gen, x, gen() % depth);
+  switch (gen() % 4) {
+  case 0: return b.make_add(l, r);
+  case 1: return b.make_sub(l, r);
+  case 2: return b.make_mul(l, r);
+  default: return b.make_neg(l);
+  }
+}
+
+/// Returns the number of nodes in `e`.
+std::size_t
+count_nodes(Expr const* e)
+{
+  std::size_t n = 1;
+  for (Expr const* c : e->get_children())
+    n += count_nodes(c);
+  return n;
+}
+
+/// Returns the value of `e` when the variable is `x`, dispatching with a
+/// switch. Arithmetic wraps.
+unsigned long
+eval_switch(Expr const* e, unsigned long x)
+{
+  switch (e->get_kind()) {
+  case Expr::int_lit:
+    return static_cast<Int_expr const*>(e)->get_int_value();
+  case Expr::value_conv:
+    return x;
+  case Expr::add_expr: {
+    Add_expr const* a = static_cast<Add_expr const*>(e);
+    return eval_switch(a->get_child(0), x) + eval_switch(a->get_child(1), x);
+  }
+  case Expr::sub_expr: {
+    Sub_expr const* s = static_cast<Sub_expr const*>(e);
+    return eval_switch(s->get_child(0), x) - eval_switch(s->get_child(1), x);
+  }
+  case Expr::mul_expr: {
+    Mul_expr const* m = static_cast<Mul_expr const*>(e);
+    return eval_switch(m->get_child(0), x) * eval_switch(m->get_child(1), x);
+  }
+  case Expr::neg_expr:
+    return -eval_switch(static_cast<Neg_expr const*>(e)->get_child(0), x);
+  default:
+    throw std::logic_error("unexpected expression");
+  }
+}
+
+/// Returns the value of an expression when the variable is `x`,
+/// dispatching with a visitor.
+struct Eval_visitor : Const_expr_visitor<Eval_visitor, unsigned long>
+{
+  explicit Eval_visitor(unsigned long x) : x(x) { }
+
+  unsigned long visit_int_lit(Int_expr const* e) { return e->get_int_value(); }
+  unsigned long visit_value_conv(Value_conv const*) { return x; }
+  unsigned long visit_add_expr(Add_expr const* e) { return visit(e->get_child(0)) + visit(e->get_child(1)); }
+  unsigned long visit_sub_expr(Sub_expr const* e) { return visit(e->get_child(0)) - visit(e->get_child(1)); }
+  unsigned long visit_mul_expr(Mul_expr const* e) { return visit(e->get_child(0)) * visit(e->get_child(1)); }
+  unsigned long visit_neg_expr(Neg_expr const* e) { return -visit(e->get_child(0)); }
+
+  template<typename T>
+  unsigned long visit_expr(T) { throw std::logic_error("unexpected expression"); }
+
+  unsigned long x;
+};
+
+template<typename F>
+double
+measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 200;
+
+  Builder b;
+  Var_decl* x = b.make_variable(b.get_name("x"), b.get_int_type());
+  std::mt19937 gen(42);
+  std::vector<Expr*> exprs;
+  for (int n = 0; n < count; ++n)
+    exprs.push_back(make_expr(b, gen, x, 8));
+  std::size_t nodes = 0;
+  for (Expr const* e : exprs)
+    nodes += count_nodes(e);
+
+  unsigned long r1 = 0;
+  unsigned long r2 = 0;
+  double t1 = 1e300;
+  double t2 = 1e300;
+  for (int round = 0; round < 3; ++round) {
+    r1 = 0;
+    t1 = std::min(t1, measure([&] {
+      for (int k = 0; k < reps; ++k)
+        for (Expr const* e : exprs)
+          r1 += eval_switch(e, k);
+    }));
+    r2 = 0;
+    t2 = std::min(t2, measure([&] {
+      for (int k = 0; k < reps; ++k) {
+        Eval_visitor v(k);
+        for (Expr const* e : exprs)
+          r2 += v.visit(e);
+      }
+    }));
+  }
+
+  if (r1 != r2) {
+    std::cerr << "results differ\n";
+    return 1;
+  }
+  double visits = double(nodes) * reps;
+  std::cout << "nodes: " << nodes << '\n'
+            << "switch: " << t1 << " ms, " << t1 * 1e6 / visits << " ns/node\n"
+            << "visitor: " << t2 << " ms, " << t2 * 1e6 / visits << " ns/node\n";
+}
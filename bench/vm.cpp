@@ -0,0 +1,54 @@
+// Compares the bytecode machine with the evaluator on each workload,
+// reporting the time per operation of each and the speedup of the
+// machine. The time to lower the program to bytecode is reported too.
+//
+// Usage: vm [scale]
+
+#include "programs.hpp"
+
+#include "bytecode.hpp"
+#include "eval.hpp"
+#include "vm.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+int
+main(int argc, char* argv[])
+{
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+
+  Builder b;
+  Bench_program p(b);
+  Evaluator ev(p.prog, p.statics);
+  std::unique_ptr<Bytecode> bc;
+  double lowered = measure([&] { bc.reset(new Bytecode(p.prog, p.statics)); });
+  Machine vm(*bc);
+
+  struct Workload
+  {
+    char const* name;
+    Fn_decl* fn;
+    Int_value arg;
+    double ops;
+  };
+  int fib_n = 25;
+  Int_value loop_n = 1000000 * scale;
+  Int_value calls_n = 100000 * scale;
+  Workload work[] = {
+    {"fib(25)", p.fib, fib_n, fib_calls(fib_n)},
+    {"loop", p.loop, loop_n, double(loop_n)},
+    {"calls", p.calls, calls_n, 7.0 * calls_n},
+    {"kernel", p.kernel, loop_n, double(loop_n)},
+  };
+
+  std::cout << "lower: " << lowered << " ms\n";
+  for (Workload const& w : work) {
+    double t1 = measure([&] { ev.call(w.fn, {Value(w.arg)}); });
+    double t2 = measure([&] { vm.call(w.fn, {Value(w.arg)}); });
+    std::cout << w.name << '\n';
+    report("  evaluator", t1, w.ops);
+    report("  machine", t2, w.ops);
+    std::cout << "  speedup: " << t1 / t2 << "x\n";
+  }
+}
@@ -2,6 +2,27 @@
 #include "type.hpp"
 #include "expr.hpp"
 
+Expr*
+Builder::make_error()
+{
+  if (!m_error)
+    m_error = new Error_expr(get_error_type());
+  return m_error;
+}
+
+Expr*
+Builder::error(char const* msg)
+{
+  m_diags.emplace_back(msg);
+  return make_error();
+}
+
+bool
+Builder::is_error(Expr const* e)
+{
+  return e->get_type()->is_error();
+}
+
 Expr*
 Builder::require_bool(Expr* e)
 {
@@ -11,13 +32,15 @@ Builder::require_bool(Expr* e)
   // If the type is not bool, emit an error.
   Type* t = c->get_type();
   if (!t->is_bool()) {
-    if(t->is_reference()) 
-      throw std::runtime_error("operand not boolean, found reference.");
-    if(t->is_object())
-      throw std::runtime_error("Found object expected arithmetic");
-    if(t->is_arithmetic()) 
-      throw std::runtime_error("Found arithmetic expected boolean");
-    throw std::runtime_error("operand not boolean");
+    if (t->is_error())
+      return c;
+    if (t->is_reference())
+      return error("operand not boolean, found reference.");
+    if (t->is_arithmetic())
+      return error("Found arithmetic expected boolean");
+    if (t->is_object())
+      return error("Found object expected boolean");
+    return error("operand not boolean");
   }
   return c;
 }
@@ -30,16 +53,17 @@ Builder::require_arithmetic(Expr* e)
 
   // If the type is not arithmetic, emit an error.
   Type* t = c->get_type();
-  if (!t->is_arithmetic())
-    if(t->is_bool()) 
-      throw std::runtime_error("Found bool expected arithmetic");
-    if(t->is_reference())
-      throw std::runtime_error("Found reference expected arithmetic");
-    if(t->is_object()) 
-      throw std::runtime_error("Found object expected arithmetic");
-
-    throw std::runtime_error("operand not arithmetic");
-
+  if (!t->is_arithmetic()) {
+    if (t->is_error())
+      return c;
+    if (t->is_bool())
+      return error("Found bool expected arithmetic");
+    if (t->is_reference())
+      return error("Found reference expected arithmetic");
+    if (t->is_object())
+      return error("Found object expected arithmetic");
+    return error("operand not arithmetic");
+  }
   return c;
 }
 
@@ -48,26 +72,25 @@ Builder::require_function(Expr* e)
 {
   Expr* c = convert_to_value(e);
   Type* t = c->get_type();
-  if(!t->is_function()) { 
-    if(t->is_bool()) 
-      throw std::runtime_error("not  a function. Found bool.");
-    if(t->is_reference())
-      throw std::runtime_error("Found reference instead of function");
-    if(t->is_object())
-      throw std::runtime_error("Found object instead of function");
-    if(t->is_arithmetic())
-      throw std::runtime_error("Found arithmetic instead of function");
+  if (!t->is_function()) {
+    if (t->is_error())
+      return c;
+    if (t->is_bool())
+      return error("not  a function. Found bool.");
+    if (t->is_reference())
+      return error("Found reference instead of function");
+    if (t->is_arithmetic())
+      return error("Found arithmetic instead of function");
+    return error("Found object instead of function");
   }
-
-  if (t->is_function())
-    return c;
+  return c;
 }
 
 Expr*
 Builder::require_type(Expr* e, Type* t)
 {
   if (t->is_reference())
-    return require_reference_to(e, t);
+    return require_reference_to(e, static_cast<Ref_type*>(t)->get_object_type());
   else
     return require_value_of(e, t);
 }
@@ -78,9 +101,11 @@ Builder::require_value_of(Expr* e, Type* t)
   assert(t->is_object());
 
   e = convert_to_value(e);
+  if (is_error(e))
+    return e;
 
   if (!e->get_type()->is_same_as(t))
-    throw std::runtime_error("invalid operand");
+    return error("invalid operand");
 
   return e;
 }
@@ -88,19 +113,27 @@ Builder::require_value_of(Expr* e, Type* t)
 Expr*
 Builder::require_reference_to(Expr* e, Type* t)
 {
+  if (is_error(e))
+    return e;
+
   Type* t1 = e->get_type();
   if (t1->is_reference_to(t))
     return e;
-  throw std::runtime_error("invalid operand reference");
+  return error("invalid operand reference");
 }
 
 std::pair<Expr*, Expr*>
 Builder::require_same(Expr* e1, Expr* e2)
 {
+  if (is_error(e1) || is_error(e2))
+    return {make_error(), make_error()};
+
   Type* t1 = e1->get_type();
   Type* t2 = e2->get_type();
-  if (!t1->is_same_as(t2))
-    throw std::runtime_error("operands have different type");
+  if (!t1->is_same_as(t2)) {
+    Expr* err = error("operands have different type");
+    return {err, err};
+  }
   return {e1, e2};
 }
 
@@ -120,9 +153,11 @@ Builder::require_same_arithmetic(Expr* e1, Expr* e2)
   auto p = require_same(e1, e2);
 
   Type* t = p.first->get_type();
-  if (!t->is_arithmetic())
-    throw std::runtime_error("operands are not arithmetic");
-  
+  if (!t->is_arithmetic() && !t->is_error()) {
+    Expr* err = error("operands are not arithmetic");
+    return {err, err};
+  }
+
   return p;
 }
 
@@ -131,7 +166,7 @@ Builder::require_common(Expr* e1, Expr* e2)
 {
   Type* t1 = e1->get_type();
   Type* t2 = e2->get_type();
-  
+
   // If both expressions have reference type, they must refer to the
   // the same type of object.
   if (t1->is_reference() && t2->is_reference())
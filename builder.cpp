@@ -5,6 +5,14 @@
 #include "stmt.hpp"
 #include "decl.hpp"
 
+Builder::Builder()
+  : m_own(new Type_table()), m_types(m_own.get())
+{ }
+
+Builder::Builder(Type_table& types)
+  : m_types(&types)
+{ }
+
 Name*
 Builder::get_name(char const* str)
 {
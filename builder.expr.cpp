@@ -3,7 +3,99 @@
 #include "expr.hpp"
 #include "decl.hpp"
 
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <tuple>
+
+// Folding
+//
+// When folding is enabled, operators whose operands are integer or
+// boolean literals are evaluated as they are built. Integer arithmetic
+// wraps on overflow.
+
+static bool
+is_literal(Expr const* e)
+{
+  return e->get_kind() == Expr::bool_lit || e->get_kind() == Expr::int_lit;
+}
+
+static Int_value
+get_literal(Expr const* e)
+{
+  return static_cast<Literal_expr const*>(e)->get_value().get_int();
+}
+
+static Expr*
+fold_unary(Builder& b, Expr::Kind k, Expr* e1)
+{
+  if (!b.is_folding() || !is_literal(e1))
+    return nullptr;
+
+  std::uint64_t n = get_literal(e1);
+  switch (k) {
+  case Expr::neg_expr:
+    return new Int_expr(b.get_int_type(), Value(Int_value(-n)));
+  case Expr::not_expr:
+    return b.make_bool(!n);
+  default:
+    break;
+  }
+  return nullptr;
+}
+
+static Expr*
+fold_binary(Builder& b, Expr::Kind k, Expr* e1, Expr* e2)
+{
+  if (!b.is_folding() || !is_literal(e1) || !is_literal(e2))
+    return nullptr;
+
+  Int_value n1 = get_literal(e1);
+  Int_value n2 = get_literal(e2);
+  std::uint64_t u1 = n1;
+  std::uint64_t u2 = n2;
+  Int_value r;
+  switch (k) {
+  case Expr::add_expr:
+    r = Int_value(u1 + u2);
+    break;
+  case Expr::sub_expr:
+    r = Int_value(u1 - u2);
+    break;
+  case Expr::mul_expr:
+    r = Int_value(u1 * u2);
+    break;
+  case Expr::div_expr:
+    if (n2 == 0)
+      return b.error("division by zero");
+    r = n2 == -1 ? Int_value(-u1) : n1 / n2;
+    break;
+  case Expr::rem_expr:
+    if (n2 == 0)
+      return b.error("division by zero");
+    r = n2 == -1 ? 0 : n1 % n2;
+    break;
+  case Expr::eq_expr:
+    return b.make_bool(n1 == n2);
+  case Expr::ne_expr:
+    return b.make_bool(n1 != n2);
+  case Expr::lt_expr:
+    return b.make_bool(n1 < n2);
+  case Expr::gt_expr:
+    return b.make_bool(n1 > n2);
+  case Expr::le_expr:
+    return b.make_bool(n1 <= n2);
+  case Expr::ge_expr:
+    return b.make_bool(n1 >= n2);
+  case Expr::and_expr:
+    return b.make_bool(n1 && n2);
+  case Expr::or_expr:
+    return b.make_bool(n1 || n2);
+  default:
+    return nullptr;
+  }
+  return new Int_expr(b.get_int_type(), Value(r));
+}
 
 Expr*
 Builder::make_bool(bool b)
@@ -34,6 +126,10 @@ Builder::make_and(Expr* e1, Expr* e2)
 {
   e1 = require_bool(e1);
   e2 = require_bool(e2);
+  if (is_error(e1) || is_error(e2))
+    return make_error();
+  if (Expr* r = fold_binary(*this, Expr::and_expr, e1, e2))
+    return r;
   return new And_expr(e1->get_type(), e1, e2);
 }
 
@@ -42,6 +138,10 @@ Builder::make_or(Expr* e1, Expr* e2)
 {
   e1 = require_bool(e1);
   e2 = require_bool(e2);
+  if (is_error(e1) || is_error(e2))
+    return make_error();
+  if (Expr* r = fold_binary(*this, Expr::or_expr, e1, e2))
+    return r;
   return new Or_expr(e1->get_type(), e1, e2);
 }
 
@@ -49,6 +149,10 @@ Expr*
 Builder::make_not(Expr* e1)
 {
   e1 = require_bool(e1);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_unary(*this, Expr::not_expr, e1))
+    return r;
   return new Not_expr(e1->get_type(), e1);
 }
 
@@ -57,6 +161,8 @@ Builder::make_conditional(Expr* e1, Expr* e2, Expr* e3)
 {
   e1 = require_bool(e1);
   std::tie(e2, e3) = require_common(e2, e3);
+  if (is_error(e1) || is_error(e2))
+    return make_error();
   return new Cond_expr(e2->get_type(), e1, e2, e3);
 }
 
@@ -64,9 +170,9 @@ Expr*
 Builder::make_id(Decl* d)
 {
   Type* t;
-  if (d->is_object() || d->is_reference())
+  if (d->is_object())
     t = get_reference_type(d->get_type());
-  else if (d->is_function())
+  else if (d->is_reference() || d->is_function())
     t = d->get_type();
   else
     throw std::logic_error("invalid id-expression");
@@ -78,6 +184,10 @@ Expr*
 Builder::make_eq(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::eq_expr, e1, e2))
+    return r;
   return new Eq_expr(get_bool_type(), e1, e2);
 }
 
@@ -85,6 +195,10 @@ Expr*
 Builder::make_ne(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::ne_expr, e1, e2))
+    return r;
   return new Ne_expr(get_bool_type(), e1, e2);
 }
 
@@ -92,6 +206,10 @@ Expr*
 Builder::make_lt(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::lt_expr, e1, e2))
+    return r;
   return new Lt_expr(get_bool_type(), e1, e2);
 }
 
@@ -99,6 +217,10 @@ Expr*
 Builder::make_gt(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::gt_expr, e1, e2))
+    return r;
   return new Gt_expr(get_bool_type(), e1, e2);
 }
 
@@ -106,6 +228,10 @@ Expr*
 Builder::make_le(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::le_expr, e1, e2))
+    return r;
   return new Le_expr(get_bool_type(), e1, e2);
 }
 
@@ -113,6 +239,10 @@ Expr*
 Builder::make_ge(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_value(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::ge_expr, e1, e2))
+    return r;
   return new Ge_expr(get_bool_type(), e1, e2);
 }
 
@@ -120,6 +250,10 @@ Expr*
 Builder::make_add(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_arithmetic(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::add_expr, e1, e2))
+    return r;
   return new Add_expr(e1->get_type(), e1, e2);
 }
 
@@ -127,6 +261,10 @@ Expr*
 Builder::make_sub(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_arithmetic(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::sub_expr, e1, e2))
+    return r;
   return new Sub_expr(e1->get_type(), e1, e2);
 }
 
@@ -134,6 +272,10 @@ Expr*
 Builder::make_mul(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_arithmetic(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::mul_expr, e1, e2))
+    return r;
   return new Mul_expr(e1->get_type(), e1, e2);
 }
 
@@ -141,6 +283,10 @@ Expr*
 Builder::make_div(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_arithmetic(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::div_expr, e1, e2))
+    return r;
   return new Div_expr(e1->get_type(), e1, e2);
 }
 
@@ -148,6 +294,10 @@ Expr*
 Builder::make_rem(Expr* e1, Expr* e2)
 {
   std::tie(e1, e2) = require_same_arithmetic(e1, e2);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_binary(*this, Expr::rem_expr, e1, e2))
+    return r;
   return new Rem_expr(e1->get_type(), e1, e2);
 }
 
@@ -155,50 +305,68 @@ Expr*
 Builder::make_neg(Expr* e1)
 {
   e1 = require_arithmetic(e1);
+  if (is_error(e1))
+    return e1;
+  if (Expr* r = fold_unary(*this, Expr::neg_expr, e1))
+    return r;
   return new Neg_expr(e1->get_type(), e1);
 }
 
 Expr*
 Builder::make_assign(Expr* e1, Expr* e2)
 {
+  // Both operands are diagnosed. When the right operand is ill-formed,
+  // the left must still be a reference, though to an unknown type.
   e2 = convert_to_value(e2);
+  if (is_error(e2)) {
+    if (!is_error(e1) && !e1->get_type()->is_reference())
+      error("invalid operand reference");
+    return e2;
+  }
   e1 = require_reference_to(e1, e2->get_type());
+  if (is_error(e1))
+    return e1;
   return new Assign_expr(e1->get_type(), e1, e2);
 }
 
-// FIXME: Check arguments.
 Expr*
 Builder::make_call(std::vector<Expr*> const& es)
 {
-  // Create a new vector to store the converted arguments.
-  std::vector<Expr*> conv = es;
+  return make_call(std::vector<Expr*>(es));
+}
 
-  Expr*& fn = conv[0];
-  fn = require_function(fn);
+Expr*
+Builder::make_call(std::vector<Expr*>&& es)
+{
+  // Function names already have function type, so only convert the
+  // callee when it is something else.
+  Expr*& fn = es[0];
+  if (!fn->get_type()->is_function()) {
+    fn = require_function(fn);
+    if (is_error(fn))
+      return fn;
+  }
 
   Fn_type* ft = static_cast<Fn_type*>(fn->get_type());
 
-  auto parms = ft->get_parameter_types();
-  auto args = tail(conv);
-
   // Quick reject for parameter/argument mismatch.
-  if (parms.size() < args.size())
-    throw std::runtime_error("too many arguments");
-  if (parms.size() > args.size())
-    throw std::runtime_error("too few arguments");
-
-  auto pi = parms.begin();
-  auto ai = args.begin();
-  while (pi != parms.end()) {
-    // Copy initialize each parameter. We do this with a dummy object
-    // and then get the resulting initializer.
-    Var_decl dummy(nullptr, *pi);
-    copy_initialize(&dummy, *ai);
-    *ai = dummy.get_initializer();
-    ++pi;
-    ++ai;
+  std::size_t nargs = es.size() - 1;
+  if (ft->get_num_parameters() < nargs)
+    return error("too many arguments");
+  if (ft->get_num_parameters() > nargs)
+    return error("too few arguments");
+
+  // Convert each argument in place to its parameter type. This is the
+  // same conversion performed by copy initialization. Every argument is
+  // diagnosed before the call is rejected.
+  bool ok = true;
+  auto pi = ft->get_parameter_types().begin();
+  for (std::size_t i = 1; i != es.size(); ++i, ++pi) {
+    es[i] = require_type(es[i], *pi);
+    ok &= !is_error(es[i]);
   }
-  
-  return new Call_expr(ft->get_return_type(), std::move(conv));
-}
+  if (!ok)
+    return make_error();
 
+  return new Call_expr(ft->get_return_type(), std::move(es));
+}
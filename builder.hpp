@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "type.hpp"
@@ -11,11 +13,19 @@ class Stmt;
 class Decl;
 class Var_decl;
 class Fn_decl;
+class Prog_decl;
 
 
 class Builder
 {
 public:
+  Builder();
+  /// Constructs a builder with its own type table.
+
+  explicit Builder(Type_table& types);
+  /// Constructs a builder that shares `types` with other builders.
+  /// Builders sharing a table may be used from different threads.
+
   // Names
 
   Name* get_name(char const* str);
@@ -23,15 +33,21 @@ public:
 
   // Types
 
-  Type* get_bool_type() { return &m_bool_type; }
+  Type_table& get_type_table() { return *m_types; }
+  /// Returns the table of unique types.
+
+  Type* get_bool_type() { return m_types->get_bool_type(); }
   /// Returns the type `bool`.
   
-  Type* get_int_type() { return &m_int_type; }
+  Type* get_int_type() { return m_types->get_int_type(); }
   /// Returns the type `int`.
   
-  Type* get_float_type() { return &m_float_type; }
+  Type* get_float_type() { return m_types->get_float_type(); }
   /// Returns the type `float`.
 
+  Type* get_error_type() { return m_types->get_error_type(); }
+  /// Returns the type of ill-formed expressions.
+
   Type* get_reference_type(Type* t);
   /// Returns the type `ref t`.
 
@@ -39,7 +55,10 @@ public:
   /// Returns the type `(t1, t2, ..., tn) -> tr`.
 
   // Expressions
-  
+
+  Expr* make_error();
+  /// Returns the error expression.
+
   Expr* make_bool(bool b);
   /// Returns a new boolean literal.
 
@@ -117,7 +136,20 @@ public:
   /// Returns the expression `e1 = e2`.
 
   Expr* make_call(std::vector<Expr*> const& es);
-  /// Returns the expression `e1(e2, e3, ..., en).
+  /// Returns the expression `e1(e2, e3, ..., en)`.
+
+  Expr* make_call(std::vector<Expr*>&& es);
+  /// Returns the expression `e1(e2, e3, ..., en)`. The arguments are
+  /// converted in place and `es` is moved into the new expression.
+
+  // Folding
+
+  void set_folding(bool b) { m_fold = b; }
+  /// When `b` is true, operators applied to literal operands are
+  /// evaluated as they are built instead of allocating a new node.
+
+  bool is_folding() const { return m_fold; }
+  /// Returns true if constant folding is enabled.
 
   // Statements
 
@@ -159,7 +191,28 @@ public:
   Fn_decl* make_function(Name* n, Type* t);
   /// Returns a new function definition.
 
+  // Diagnostics
+
+  Expr* error(char const* msg);
+  /// Records the diagnostic `msg` and returns the error expression.
+
+  bool has_errors() const { return !m_diags.empty(); }
+  /// Returns true if any diagnostics have been recorded.
+
+  std::vector<std::string> const& get_diagnostics() const { return m_diags; }
+  /// Returns the recorded diagnostics in the order they were issued.
+
+  void clear_diagnostics() { m_diags.clear(); }
+  /// Discards all recorded diagnostics.
+
   // Typing
+  //
+  // When an operand is ill-formed, these functions record a diagnostic
+  // and return the error expression. An operand that is already an error
+  // is returned without further diagnosis.
+
+  static bool is_error(Expr const* e);
+  /// Returns true if `e` is ill-formed.
 
   Expr* require_bool(Expr* e);
   /// Return `e` if its converted type is `bool`.
@@ -204,13 +257,31 @@ public:
   void reference_initialize(Decl* d, Expr* e);
   /// Bind `d` to the expression `e`. Returns the converted expression.
 
+  // Layout
+
+  void layout_function(Fn_decl* fn);
+  /// Assigns a frame slot to each parameter, the return value, and each
+  /// local variable of `fn`, and sets its frame size. Parameters come
+  /// first, followed by the return value and then the locals. Locals of
+  /// blocks that are not nested share slots.
+
+  int layout_program(Prog_decl* p);
+  /// Assigns a static slot to each variable in `p` and lays out each of
+  /// its functions. Returns the number of static slots.
+
 private:
-  Bool_type m_bool_type;
-  /// The type `bool`.
+  std::unique_ptr<Type_table> m_own;
+  /// The type table, if it is owned by this builder.
+
+  Type_table* m_types;
+  /// The unique types of the program.
+
+  Expr* m_error = nullptr;
+  /// The error expression, shared by all ill-formed expressions.
 
-  Int_type m_int_type;
-  /// The type `int`.
+  std::vector<std::string> m_diags;
+  /// The diagnostics issued while building.
 
-  Float_type m_float_type;
-  /// The type `float`.
+  bool m_fold = false;
+  /// True if literal operands are folded.
 };
@@ -0,0 +1,79 @@
+#include "builder.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "visitor.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+/// Assigns slots to the local variables of a function body. Slots are
+/// allocated in declaration order and released at the end of each
+/// block, so the frame size is the greatest number of locals live at
+/// any point.
+struct Layout_stmt : Const_stmt_visitor<Layout_stmt>
+{
+  Layout_stmt(int n) : next(n), size(n) { }
+
+  void visit_block_stmt(Block_stmt const* s) { layout_block(s); }
+  void visit_if_stmt(If_stmt const* s) { layout_if(s); }
+  void visit_while_stmt(While_stmt const* s) { visit(s->get_body()); }
+  void visit_decl_stmt(Decl_stmt const* s) { layout_var(s->get_declaration()); }
+  void visit_stmt(Stmt const* s) { }
+
+  void layout_block(Block_stmt const* s)
+  {
+    int mark = next;
+    for (Stmt const* sub : *s)
+      visit(sub);
+    next = mark;
+  }
+
+  void layout_if(If_stmt const* s)
+  {
+    visit(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement())
+      visit(f);
+  }
+
+  void layout_var(Decl* d)
+  {
+    assert(d->is_variable());
+    static_cast<Var_decl*>(d)->set_slot(next++);
+    size = std::max(size, next);
+  }
+
+  int next;
+  int size;
+};
+
+} // namespace
+
+void
+Builder::layout_function(Fn_decl* fn)
+{
+  int n = 0;
+  for (Decl* p : fn->get_parameters())
+    static_cast<Var_decl*>(p)->set_slot(n++);
+  if (Decl* r = fn->get_return())
+    static_cast<Var_decl*>(r)->set_slot(n++);
+
+  Layout_stmt layout(n);
+  if (Stmt* s = fn->get_body())
+    layout.visit(s);
+  fn->set_frame_size(layout.size);
+}
+
+int
+Builder::layout_program(Prog_decl* p)
+{
+  int n = 0;
+  for (Decl* d : p->get_children()) {
+    if (d->is_variable())
+      static_cast<Var_decl*>(d)->set_static_slot(n++);
+    else if (d->is_function())
+      layout_function(static_cast<Fn_decl*>(d));
+  }
+  return n;
+}
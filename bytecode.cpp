@@ -0,0 +1,697 @@
+#include "bytecode.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "name.hpp"
+#include "visitor.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+char const*
+get_opcode_name(Opcode op)
+{
+  switch (op) {
+#define def_op(K) case K##_op: return #K;
+#include "bytecode.def"
+  }
+  assert(false && "invalid opcode");
+  return nullptr;
+}
+
+Code::Code(Fn_decl const* fn, int n)
+  : m_fn(fn), m_index(n),
+    m_params(fn ? fn->get_num_parameters() : 0),
+    m_regs(fn ? fn->get_frame_size() : 0),
+    m_instrs(), m_consts(), m_callees()
+{ }
+
+void
+Code::dump(std::ostream& os) const
+{
+  if (m_fn)
+    os << "function " << *m_fn->get_name();
+  else
+    os << "globals";
+  os << " (" << m_params << " parameters, " << m_regs << " registers)\n";
+  for (std::size_t i = 0; i < m_consts.size(); ++i)
+    os << "  k" << i << " = " << m_consts[i] << '\n';
+  for (std::size_t i = 0; i < m_instrs.size(); ++i) {
+    Instr const& in = m_instrs[i];
+    os << "  " << i << ": " << get_opcode_name(in.op)
+       << ' ' << in.a << ", " << in.b << ", " << in.c << '\n';
+  }
+}
+
+
+/// Lowers function bodies and global initializers to bytecode.
+///
+/// Expressions are lowered into registers. Temporaries are allocated
+/// above the variables of the frame in stack order, and each is released
+/// when the expression that needs it is complete. The value of a variable
+/// with object type is used directly from its register when no later
+/// operand of the same expression can change it.
+class Lowering
+{
+public:
+  Lowering(Bytecode const& bc, Code& code);
+
+  void lower_function(Fn_decl const* fn);
+  /// Lowers the body of `fn`.
+
+  void lower_globals(Prog_decl const* p);
+  /// Lowers the initializers of the global variables of `p`.
+
+private:
+  /// The location of an object.
+  struct Loc
+  {
+    enum Kind
+    {
+      reg_loc,
+      /// The object is held in register n.
+
+      cell_loc,
+      /// Register n holds the address of the object.
+
+      static_loc,
+      /// The object is static slot n.
+    };
+
+    Kind kind;
+    int n;
+  };
+
+  /// A loop being lowered.
+  struct Loop
+  {
+    int start;
+    /// The first instruction of the condition.
+
+    std::vector<int> breaks;
+    /// The jumps to be patched to the end of the loop.
+  };
+
+  struct Lower_value;
+  struct Lower_location;
+  struct Lower_stmt;
+
+  // Instructions
+
+  int emit(Opcode op, int a = 0, int b = 0, int c = 0);
+  /// Appends an instruction and returns its index.
+
+  int here() const { return m_code.m_instrs.size(); }
+  /// Returns the index of the next instruction.
+
+  void patch(int i, int target);
+  /// Sets the target of the jump at `i`.
+
+  int constant(Packed_value const& v);
+  /// Returns the index of `v` in the constant pool.
+
+  int callee(Fn_decl const* fn);
+  /// Returns the index of `fn` in the callee table.
+
+  // Registers
+
+  int temp();
+  /// Allocates a temporary register.
+
+  void release(int mark) { m_next = mark; }
+  /// Releases the temporaries allocated since `mark`.
+
+  // Expressions
+
+  int operand(Expr const* e, bool stable);
+  /// Returns a register holding the value of `e`. If `stable` is true,
+  /// this may be the register of a variable.
+
+  void value(Expr const* e, int dst);
+  /// Lowers `e`, which has object type, into `dst`. The register is
+  /// written only after all operands have been evaluated.
+
+  Loc location(Expr const* e);
+  /// Lowers `e`, which has reference type, and returns the location of
+  /// the object it designates.
+
+  Loc locate(Decl const* d);
+  /// Returns the location of the variable `d`.
+
+  void address(Loc loc, int dst);
+  /// Stores the address of the object at `loc` in `dst`.
+
+  void call(Call_expr const* e, int dst, bool tail = false);
+  /// Lowers the call `e`, storing the result in `dst`. If `tail` is true,
+  /// the call is a tail call, which returns its result from the current
+  /// function instead.
+
+  void bind(Var_decl const* var);
+  /// Lowers the initialization of the local variable `var`.
+
+  void statement(Stmt const* s);
+  /// Lowers `s`.
+
+  Bytecode const& m_bc;
+  /// The program's bytecode, used to resolve callees.
+
+  Code& m_code;
+  /// The code being generated.
+
+  int m_next;
+  /// The next free register.
+
+  std::vector<Loop> m_loops;
+  /// The enclosing loops.
+};
+
+
+/// Lowers expressions with object type into a destination register.
+struct Lowering::Lower_value : Const_expr_visitor<Lower_value>
+{
+  Lower_value(Lowering& lw, int dst) : lw(lw), dst(dst) { }
+
+  void visit_bool_lit(Bool_expr const* e) { lw.emit(ldi_op, dst, e->get_bool_value()); }
+  void visit_int_lit(Int_expr const* e) { lower_int(e); }
+  void visit_float_lit(Float_expr const* e) { lw.emit(ldk_op, dst, lw.constant(Packed_value(e->get_float_value()))); }
+  void visit_id_expr(Id_expr const* e) { lower_id(e); }
+  void visit_add_expr(Add_expr const* e) { arithmetic(e, add_i_op, add_f_op); }
+  void visit_sub_expr(Sub_expr const* e) { arithmetic(e, sub_i_op, sub_f_op); }
+  void visit_mul_expr(Mul_expr const* e) { arithmetic(e, mul_i_op, mul_f_op); }
+  void visit_div_expr(Div_expr const* e) { arithmetic(e, div_i_op, div_f_op); }
+  void visit_rem_expr(Rem_expr const* e) { binary(e, rem_i_op); }
+  void visit_neg_expr(Neg_expr const* e) { unary(e, is_float(e) ? neg_f_op : neg_i_op); }
+  void visit_rec_expr(Rec_expr const* e) { unary(e, is_float(e) ? rec_f_op : rec_i_op); }
+  void visit_eq_expr(Eq_expr const* e) { equality(e, eq_i_op, eq_f_op, eq_p_op); }
+  void visit_ne_expr(Ne_expr const* e) { equality(e, ne_i_op, ne_f_op, ne_p_op); }
+  void visit_lt_expr(Lt_expr const* e) { relational(e, lt_i_op, lt_f_op); }
+  void visit_gt_expr(Gt_expr const* e) { relational(e, gt_i_op, gt_f_op); }
+  void visit_le_expr(Le_expr const* e) { relational(e, le_i_op, le_f_op); }
+  void visit_ge_expr(Ge_expr const* e) { relational(e, ge_i_op, ge_f_op); }
+  void visit_cond_expr(Cond_expr const* e) { lower_cond(e); }
+  void visit_and_expr(And_expr const* e) { logical(e, jf_op, false); }
+  void visit_or_expr(Or_expr const* e) { logical(e, jt_op, true); }
+  void visit_not_expr(Not_expr const* e) { unary(e, not_b_op); }
+  void visit_assign_expr(Assign_expr const* e) { throw std::logic_error("invalid value expression"); }
+  void visit_call_expr(Call_expr const* e) { lw.call(e, dst); }
+  void visit_value_conv(Value_conv const* e) { lower_load(e); }
+  void visit_error_expr(Error_expr const* e) { throw std::logic_error("lowering invalid expression"); }
+
+  static bool is_float(Expr const* e) { return e->get_type()->is_float(); }
+
+  void lower_int(Int_expr const* e)
+  {
+    Int_value n = e->get_value().get_int();
+    if (std::numeric_limits<std::int32_t>::min() <= n && n <= std::numeric_limits<std::int32_t>::max())
+      lw.emit(ldi_op, dst, n);
+    else
+      lw.emit(ldk_op, dst, lw.constant(Packed_value(n)));
+  }
+
+  void lower_id(Id_expr const* e)
+  {
+    Decl* d = e->get_declaration();
+    if (!d->is_function())
+      throw std::logic_error("invalid value expression");
+    lw.emit(ldk_op, dst, lw.constant(Packed_value(static_cast<Fn_decl*>(d))));
+  }
+
+  void unary(Unary_expr const* e, Opcode op)
+  {
+    int mark = lw.m_next;
+    int a = lw.operand(e->get_child(), true);
+    lw.emit(op, dst, a);
+    lw.release(mark);
+  }
+
+  void binary(Binary_expr const* e, Opcode op)
+  {
+    int mark = lw.m_next;
+    int a = lw.operand(e->get_child(0), is_pure(e->get_child(1)));
+    int b = lw.operand(e->get_child(1), true);
+    lw.emit(op, dst, a, b);
+    lw.release(mark);
+  }
+
+  void arithmetic(Binary_expr const* e, Opcode i, Opcode f)
+  {
+    binary(e, is_float(e) ? f : i);
+  }
+
+  void equality(Binary_expr const* e, Opcode i, Opcode f, Opcode p)
+  {
+    Type const* t = e->get_child(0)->get_type();
+    binary(e, t->is_int() ? i : t->is_float() ? f : p);
+  }
+
+  void relational(Binary_expr const* e, Opcode i, Opcode f)
+  {
+    binary(e, is_float(e->get_child(0)) ? f : i);
+  }
+
+  void lower_cond(Cond_expr const* e)
+  {
+    int mark = lw.m_next;
+    int c = lw.operand(e->get_condition(), true);
+    int j1 = lw.emit(jf_op, c);
+    lw.release(mark);
+    lw.value(e->get_true_value(), dst);
+    int j2 = lw.emit(jmp_op);
+    lw.patch(j1, lw.here());
+    lw.value(e->get_false_value(), dst);
+    lw.patch(j2, lw.here());
+  }
+
+  /// Lowers a short-circuit operator. The jump `op` skips the second
+  /// operand, producing `skip` as the result.
+  void logical(Binary_expr const* e, Opcode op, bool skip)
+  {
+    int mark = lw.m_next;
+    int a = lw.operand(e->get_child(0), true);
+    int j1 = lw.emit(op, a);
+    lw.release(mark);
+    lw.value(e->get_child(1), dst);
+    int j2 = lw.emit(jmp_op);
+    lw.patch(j1, lw.here());
+    lw.emit(ldi_op, dst, skip);
+    lw.patch(j2, lw.here());
+  }
+
+  void lower_load(Value_conv const* e)
+  {
+    int mark = lw.m_next;
+    Loc loc = lw.location(e->get_source());
+    switch (loc.kind) {
+    case Loc::reg_loc:
+      if (loc.n != dst)
+        lw.emit(mov_op, dst, loc.n);
+      break;
+    case Loc::cell_loc:
+      lw.emit(load_op, dst, loc.n);
+      break;
+    case Loc::static_loc:
+      lw.emit(gload_op, dst, loc.n);
+      break;
+    }
+    lw.release(mark);
+  }
+
+  Lowering& lw;
+  int dst;
+};
+
+
+/// Lowers expressions with reference type to the location of the object
+/// they designate.
+struct Lowering::Lower_location : Const_expr_visitor<Lowering::Lower_location, Lowering::Loc>
+{
+  Lower_location(Lowering& lw) : lw(lw) { }
+
+  Loc visit_id_expr(Id_expr const* e) { return lw.locate(e->get_declaration()); }
+  Loc visit_cond_expr(Cond_expr const* e) { return lower_cond(e); }
+  Loc visit_assign_expr(Assign_expr const* e) { return lower_assign(e); }
+  Loc visit_call_expr(Call_expr const* e) { return lower_call(e); }
+  Loc visit_error_expr(Error_expr const* e) { throw std::logic_error("lowering invalid expression"); }
+  Loc visit_expr(Expr const* e) { throw std::logic_error("invalid reference expression"); }
+
+  Loc lower_cond(Cond_expr const* e)
+  {
+    int t = lw.temp();
+    int c = lw.operand(e->get_condition(), true);
+    int j1 = lw.emit(jf_op, c);
+    lw.release(t + 1);
+    lw.address(lw.location(e->get_true_value()), t);
+    lw.release(t + 1);
+    int j2 = lw.emit(jmp_op);
+    lw.patch(j1, lw.here());
+    lw.address(lw.location(e->get_false_value()), t);
+    lw.release(t + 1);
+    lw.patch(j2, lw.here());
+    return Loc{Loc::cell_loc, t};
+  }
+
+  Loc lower_assign(Assign_expr const* e)
+  {
+    Loc loc = lw.location(e->get_child(0));
+    int mark = lw.m_next;
+    switch (loc.kind) {
+    case Loc::reg_loc:
+      lw.value(e->get_child(1), loc.n);
+      break;
+    case Loc::cell_loc:
+      lw.emit(store_op, loc.n, lw.operand(e->get_child(1), true));
+      break;
+    case Loc::static_loc:
+      lw.emit(gstore_op, loc.n, lw.operand(e->get_child(1), true));
+      break;
+    }
+    lw.release(mark);
+    return loc;
+  }
+
+  Loc lower_call(Call_expr const* e)
+  {
+    int t = lw.temp();
+    lw.call(e, t);
+    return Loc{Loc::cell_loc, t};
+  }
+
+  Lowering& lw;
+};
+
+
+/// Lowers statements.
+struct Lowering::Lower_stmt : Const_stmt_visitor<Lower_stmt>
+{
+  Lower_stmt(Lowering& lw) : lw(lw) { }
+
+  void visit_skip_stmt(Skip_stmt const* s) { }
+  void visit_block_stmt(Block_stmt const* s) { for (Stmt const* sub : *s) lw.statement(sub); }
+  void visit_if_stmt(If_stmt const* s) { lower_if(s); }
+  void visit_while_stmt(While_stmt const* s) { lower_while(s); }
+  void visit_break_stmt(Break_stmt const* s) { lw.m_loops.back().breaks.push_back(lw.emit(jmp_op)); }
+  void visit_cont_stmt(Cont_stmt const* s) { lw.emit(jmp_op, lw.m_loops.back().start); }
+  void visit_ret_stmt(Ret_stmt const* s) { lower_ret(s); }
+  void visit_expr_stmt(Expr_stmt const* s) { lower_expr(s); }
+  void visit_decl_stmt(Decl_stmt const* s) { lower_decl(s); }
+
+  void lower_if(If_stmt const* s)
+  {
+    int mark = lw.m_next;
+    int c = lw.operand(s->get_condition(), true);
+    int j1 = lw.emit(jf_op, c);
+    lw.release(mark);
+    lw.statement(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement()) {
+      int j2 = lw.emit(jmp_op);
+      lw.patch(j1, lw.here());
+      lw.statement(f);
+      lw.patch(j2, lw.here());
+    }
+    else {
+      lw.patch(j1, lw.here());
+    }
+  }
+
+  void lower_while(While_stmt const* s)
+  {
+    int mark = lw.m_next;
+    int start = lw.here();
+    int c = lw.operand(s->get_condition(), true);
+    int j = lw.emit(jf_op, c);
+    lw.release(mark);
+    lw.m_loops.push_back(Loop{start, {}});
+    lw.statement(s->get_body());
+    lw.emit(jmp_op, start);
+    lw.patch(j, lw.here());
+    for (int b : lw.m_loops.back().breaks)
+      lw.patch(b, lw.here());
+    lw.m_loops.pop_back();
+  }
+
+  void lower_ret(Ret_stmt const* s)
+  {
+    int mark = lw.m_next;
+    Expr const* e = s->get_return_value();
+    if (Call_expr const* c = get_tail_call(lw.m_code.get_function(), s)) {
+      lw.call(c, 0, true);
+    }
+    else if (e->get_type()->is_reference()) {
+      int t = lw.temp();
+      lw.address(lw.location(e), t);
+      lw.emit(ret_op, t);
+    }
+    else {
+      lw.emit(ret_op, lw.operand(e, true));
+    }
+    lw.release(mark);
+  }
+
+  void lower_expr(Expr_stmt const* s)
+  {
+    int mark = lw.m_next;
+    Expr const* e = s->get_expression();
+    if (e->get_type()->is_reference())
+      lw.location(e);
+    else
+      lw.value(e, lw.temp());
+    lw.release(mark);
+  }
+
+  void lower_decl(Decl_stmt const* s)
+  {
+    Decl const* d = s->get_declaration();
+    if (d->is_variable())
+      lw.bind(static_cast<Var_decl const*>(d));
+  }
+
+  Lowering& lw;
+};
+
+
+Lowering::Lowering(Bytecode const& bc, Code& code)
+  : m_bc(bc), m_code(code), m_next(code.m_regs), m_loops()
+{ }
+
+int
+Lowering::emit(Opcode op, int a, int b, int c)
+{
+  m_code.m_instrs.push_back(Instr{op, a, b, c});
+  return m_code.m_instrs.size() - 1;
+}
+
+void
+Lowering::patch(int i, int target)
+{
+  Instr& in = m_code.m_instrs[i];
+  if (in.op == jmp_op)
+    in.a = target;
+  else
+    in.b = target;
+}
+
+int
+Lowering::constant(Packed_value const& v)
+{
+  std::vector<Packed_value>& ks = m_code.m_consts;
+  for (std::size_t i = 0; i < ks.size(); ++i) {
+    if (ks[i].get_bits() == v.get_bits())
+      return i;
+  }
+  ks.push_back(v);
+  return ks.size() - 1;
+}
+
+int
+Lowering::callee(Fn_decl const* fn)
+{
+  std::vector<Code const*>& cs = m_code.m_callees;
+  Code const* code = m_bc.get_code(fn);
+  auto iter = std::find(cs.begin(), cs.end(), code);
+  if (iter != cs.end() && code)
+    return iter - cs.begin();
+  cs.push_back(code);
+  return cs.size() - 1;
+}
+
+int
+Lowering::temp()
+{
+  int r = m_next++;
+  m_code.m_regs = std::max(m_code.m_regs, m_next);
+  return r;
+}
+
+int
+Lowering::operand(Expr const* e, bool stable)
+{
+  if (stable && e->get_kind() == Expr::value_conv) {
+    Expr const* src = static_cast<Value_conv const*>(e)->get_source();
+    if (src->get_kind() == Expr::id_expr) {
+      Loc loc = locate(static_cast<Id_expr const*>(src)->get_declaration());
+      if (loc.kind == Loc::reg_loc)
+        return loc.n;
+    }
+  }
+  int t = temp();
+  value(e, t);
+  return t;
+}
+
+void
+Lowering::value(Expr const* e, int dst)
+{
+  Lower_value(*this, dst).visit(e);
+}
+
+Lowering::Loc
+Lowering::location(Expr const* e)
+{
+  return Lower_location(*this).visit(e);
+}
+
+Lowering::Loc
+Lowering::locate(Decl const* d)
+{
+  assert(d->is_variable());
+  Var_decl const* var = static_cast<Var_decl const*>(d);
+  if (var->has_static_storage()) {
+    if (!var->is_reference())
+      return Loc{Loc::static_loc, var->get_slot()};
+    int t = temp();
+    emit(gload_op, t, var->get_slot());
+    return Loc{Loc::cell_loc, t};
+  }
+  if (var->is_reference())
+    return Loc{Loc::cell_loc, var->get_slot()};
+  return Loc{Loc::reg_loc, var->get_slot()};
+}
+
+void
+Lowering::address(Loc loc, int dst)
+{
+  switch (loc.kind) {
+  case Loc::reg_loc:
+    emit(lda_op, dst, loc.n);
+    break;
+  case Loc::cell_loc:
+    if (loc.n != dst)
+      emit(mov_op, dst, loc.n);
+    break;
+  case Loc::static_loc:
+    emit(lds_op, dst, loc.n);
+    break;
+  }
+}
+
+void
+Lowering::call(Call_expr const* e, int dst, bool tail)
+{
+  int mark = m_next;
+
+  // Resolve the callee before evaluating arguments, as the evaluator does.
+  Expr const* f = e->get_function();
+  Opcode op = tail ? tcalli_op : calli_op;
+  int fn;
+  Decl const* d = nullptr;
+  if (f->get_kind() == Expr::id_expr)
+    d = static_cast<Id_expr const*>(f)->get_declaration();
+  if (d && d->is_function()) {
+    op = tail ? tcall_op : call_op;
+    fn = callee(static_cast<Fn_decl const*>(d));
+  }
+  else {
+    fn = operand(f, true);
+  }
+
+  // Arguments are evaluated into consecutive registers, which are copied
+  // to the parameters of the callee.
+  auto args = e->get_arguments();
+  int base = m_next;
+  for (std::size_t i = 0; i < args.size(); ++i)
+    temp();
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    Expr const* arg = args.at(i);
+    int inner = m_next;
+    if (arg->get_type()->is_reference())
+      address(location(arg), base + i);
+    else
+      value(arg, base + i);
+    release(inner);
+  }
+  // A tail call has no destination, so it records the argument count.
+  emit(op, tail ? int(args.size()) : dst, fn, base);
+  release(mark);
+}
+
+void
+Lowering::bind(Var_decl const* var)
+{
+  int mark = m_next;
+  int r = var->get_slot();
+  if (Expr const* e = var->get_initializer()) {
+    if (var->is_reference())
+      address(location(e), r);
+    else
+      value(e, r);
+  }
+  else {
+    emit(ldk_op, r, constant(Packed_value()));
+  }
+  release(mark);
+}
+
+void
+Lowering::statement(Stmt const* s)
+{
+  Lower_stmt(*this).visit(s);
+}
+
+void
+Lowering::lower_function(Fn_decl const* fn)
+{
+  statement(fn->get_body());
+
+  // Falling off the end returns an indeterminate value.
+  int t = temp();
+  emit(ldk_op, t, constant(Packed_value()));
+  emit(ret_op, t);
+}
+
+void
+Lowering::lower_globals(Prog_decl const* p)
+{
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_variable())
+      continue;
+    Var_decl const* var = static_cast<Var_decl const*>(d);
+    int mark = m_next;
+    int t = temp();
+    if (Expr const* e = var->get_initializer()) {
+      if (var->is_reference())
+        address(location(e), t);
+      else
+        value(e, t);
+    }
+    else {
+      emit(ldk_op, t, constant(Packed_value()));
+    }
+    emit(gstore_op, var->get_slot(), t);
+    release(mark);
+  }
+  int t = temp();
+  emit(ldi_op, t, 0);
+  emit(ret_op, t);
+}
+
+
+Bytecode::Bytecode(Prog_decl const* p, int statics)
+  : m_statics(statics), m_init(new Code(nullptr, -1)), m_codes(), m_index()
+{
+  // Create all code first so that calls can refer to functions that are
+  // defined later.
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    if (!fn->get_body())
+      continue;
+    m_codes.emplace_back(new Code(fn, m_codes.size()));
+    m_index.emplace(fn, m_codes.back().get());
+  }
+
+  for (auto& code : m_codes)
+    Lowering(*this, *code).lower_function(code->get_function());
+  Lowering(*this, *m_init).lower_globals(p);
+}
+
+void
+Bytecode::dump(std::ostream& os) const
+{
+  m_init->dump(os);
+  for (auto const& code : m_codes)
+    code->dump(os);
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "packed.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Fn_decl;
+class Prog_decl;
+
+
+/// The operations of the bytecode.
+enum Opcode : std::uint8_t
+{
+#define def_op(K) K##_op,
+#include "bytecode.def"
+};
+
+char const* get_opcode_name(Opcode op);
+/// Returns the mnemonic of `op`.
+
+
+/// A bytecode instruction. Operands are register numbers, indexes into the
+/// tables of the enclosing code, immediates, or jump targets, depending on
+/// the opcode (see bytecode.def).
+struct Instr
+{
+  Opcode op;
+  /// The operation.
+
+  std::int32_t a;
+  std::int32_t b;
+  std::int32_t c;
+  /// The operands.
+};
+
+
+/// The compiled form of a function.
+///
+/// Registers are numbered from 0 in each frame. The first registers are
+/// the slots of the function's variables (see Builder::layout_function),
+/// so the arguments of a call are in registers 0 through n - 1. A variable
+/// with object type holds its value in its register, and a variable with
+/// reference type holds the address of the object it is bound to. The
+/// remaining registers hold temporaries.
+class Code
+{
+public:
+  Code(Fn_decl const* fn, int n);
+  /// Constructs empty code for `fn`, which is the nth function of its
+  /// program. The function is null and `n` is -1 for the initializers of
+  /// a program's global variables.
+
+  Fn_decl const* get_function() const { return m_fn; }
+  /// Returns the compiled function.
+
+  int get_index() const { return m_index; }
+  /// Returns the index of the function in its program.
+
+  int get_num_parameters() const { return m_params; }
+  /// Returns the number of parameters.
+
+  int get_num_registers() const { return m_regs; }
+  /// Returns the number of registers in a frame.
+
+  Instr const* get_instructions() const { return m_instrs.data(); }
+  /// Returns the first instruction.
+
+  std::size_t size() const { return m_instrs.size(); }
+  /// Returns the number of instructions.
+
+  Packed_value const* get_constants() const { return m_consts.data(); }
+  /// Returns the constant pool.
+
+  Code const* get_callee(int n) const { return m_callees[n]; }
+  /// Returns the nth directly called function.
+
+  void dump(std::ostream& os) const;
+  /// Writes a listing of the code.
+
+private:
+  friend class Lowering;
+
+  Fn_decl const* m_fn;
+  /// The function.
+
+  int m_index;
+  /// The index of the function.
+
+  int m_params;
+  /// The number of parameters.
+
+  int m_regs;
+  /// The number of registers.
+
+  std::vector<Instr> m_instrs;
+  /// The instructions.
+
+  std::vector<Packed_value> m_consts;
+  /// The constant pool.
+
+  std::vector<Code const*> m_callees;
+  /// The functions called directly. An entry is null if the function
+  /// has no definition.
+};
+
+
+/// The bytecode for a program.
+///
+/// The program must have been checked and laid out (see
+/// Builder::layout_program). Each defined function is lowered to Code,
+/// and the initializers of global variables are lowered to a code that
+/// runs once before any other.
+class Bytecode
+{
+public:
+  Bytecode(Prog_decl const* p, int statics);
+  /// Lowers `p`, which has `statics` static slots.
+
+  Bytecode(Bytecode const&) = delete;
+  Bytecode& operator=(Bytecode const&) = delete;
+
+  int get_num_statics() const { return m_statics; }
+  /// Returns the number of slots in the static store.
+
+  Code const* get_init() const { return m_init.get(); }
+  /// Returns the code that initializes global variables.
+
+  Code const* get_code(Fn_decl const* fn) const;
+  /// Returns the code for `fn`, or null if `fn` has no definition.
+
+  std::size_t get_num_functions() const { return m_codes.size(); }
+  /// Returns the number of defined functions.
+
+  void dump(std::ostream& os) const;
+  /// Writes a listing of all code.
+
+private:
+  int m_statics;
+  /// The number of static slots.
+
+  std::unique_ptr<Code> m_init;
+  /// The initializers of global variables.
+
+  std::vector<std::unique_ptr<Code>> m_codes;
+  /// The code of each defined function, in declaration order.
+
+  std::unordered_map<Fn_decl const*, Code*> m_index;
+  /// Maps functions to their code.
+};
+
+inline Code const*
+Bytecode::get_code(Fn_decl const* fn) const
+{
+  auto iter = m_index.find(fn);
+  if (iter == m_index.end())
+    return nullptr;
+  return iter->second;
+}
@@ -0,0 +1,108 @@
+#include "cache.hpp"
+#include "builder.hpp"
+#include "token.hpp"
+
+#include <cassert>
+#include <iostream>
+
+// Fingerprints are 64-bit FNV-1a hashes.
+static constexpr Fingerprint fnv_basis = 0xcbf29ce484222325ull;
+static constexpr Fingerprint fnv_prime = 0x100000001b3ull;
+
+static void
+mix(Fingerprint& h, unsigned char const* p, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i) {
+    h ^= p[i];
+    h *= fnv_prime;
+  }
+}
+
+static void
+mix(Fingerprint& h, std::uint64_t n)
+{
+  mix(h, reinterpret_cast<unsigned char const*>(&n), sizeof n);
+}
+
+static void
+mix(Fingerprint& h, Token const& tok)
+{
+  mix(h, tok.get_name());
+
+  // Only identifiers and literals are distinguished by their spelling.
+  switch (tok.get_name()) {
+  case Token::identifier:
+  case Token::integer_literal:
+  case Token::float_literal: {
+    std::string const& str = tok.get_lexeme().str();
+    mix(h, str.size());
+    mix(h, reinterpret_cast<unsigned char const*>(str.data()), str.size());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+Fingerprint
+fingerprint(Token const* first, Token const* last)
+{
+  Fingerprint h = fnv_basis;
+  for (; first != last; ++first)
+    mix(h, *first);
+  return h;
+}
+
+Fingerprint
+fingerprint(Token const* first, Token const* last, Signature_map const& sigs)
+{
+  Fingerprint h = fnv_basis;
+  for (; first != last; ++first) {
+    mix(h, *first);
+    if (first->get_name() == Token::identifier) {
+      auto iter = sigs.find(first->get_lexeme());
+      if (iter != sigs.end())
+        mix(h, iter->second);
+    }
+  }
+  return h;
+}
+
+Body_cache::Body_cache(Type_table& types)
+  : m_types(&types), m_entries(), m_gen(0),
+    m_reused(0), m_rebuilt(0), m_spent(), m_saved()
+{ }
+
+void
+Body_cache::begin_build(Builder& b)
+{
+  // A builder over another table would make types that never compare
+  // equal to those of the reused declarations.
+  assert(&b.get_type_table() == m_types);
+  ++m_gen;
+  m_reused = 0;
+  m_rebuilt = 0;
+  m_spent = {};
+  m_saved = {};
+}
+
+void
+Body_cache::end_build()
+{
+  for (auto iter = m_entries.begin(); iter != m_entries.end(); ) {
+    if (iter->second.gen != m_gen)
+      iter = m_entries.erase(iter);
+    else
+      ++iter;
+  }
+}
+
+void
+Body_cache::report(std::ostream& os) const
+{
+  using Ms = std::chrono::duration<double, std::milli>;
+  os << "functions: " << m_reused + m_rebuilt
+     << " (" << m_rebuilt << " rebuilt, " << m_reused << " reused)\n";
+  os << "build time: " << Ms(m_spent).count() << " ms, "
+     << "skipped: " << Ms(m_saved).count() << " ms\n";
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "symbol.hpp"
+#include "decl.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
+
+class Builder;
+class Token;
+class Stmt;
+class Type_table;
+
+
+/// A hash of a sequence of tokens.
+using Fingerprint = std::uint64_t;
+
+
+/// Maps the names of declarations to the fingerprints of their
+/// signatures.
+using Signature_map = std::unordered_map<Symbol, Fingerprint>;
+
+
+Fingerprint fingerprint(Token const* first, Token const* last);
+/// Returns the fingerprint of the tokens in `[first, last)`.
+
+Fingerprint fingerprint(Token const* first, Token const* last,
+                        Signature_map const& sigs);
+/// Returns the fingerprint of the function body spelled by the tokens in
+/// `[first, last)`. Each identifier that names a declaration in `sigs`
+/// also contributes the fingerprint of that declaration's signature, so
+/// the result changes when the signature of anything the body refers to
+/// changes.
+
+
+/// Caches checked function definitions between builds of a program.
+///
+/// Each global declaration is cached under its name along with the
+/// fingerprint of its signature, and each function also with the
+/// fingerprint of its body. A build first declares every global variable
+/// and function, then defines each body. A declaration is reused when
+/// its signature is unchanged, so bodies that refer to it remain valid. A
+/// body is reused when its fingerprint is unchanged. Because body
+/// fingerprints include the signatures they refer to, the dependents of a
+/// changed signature are rebuilt along with it.
+///
+/// Global variables must be declared through the cache like functions,
+/// since a reused body refers to the declarations of the build that
+/// created it. The signature of a variable covers its type and its
+/// initializer, which is part of the reused declaration.
+///
+/// Reused declarations and bodies hold types interned in the Type_table
+/// of the build that made them, and types are compared by address. Every
+/// build must therefore use a Builder over the same table, which must
+/// outlive the cache.
+class Body_cache
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit Body_cache(Type_table& types);
+  /// Constructs a cache for builds whose types are interned in `types`.
+
+  void begin_build(Builder& b);
+  /// Starts a new build with `b`, which must use the cache's type table,
+  /// and resets the statistics.
+
+  void end_build();
+  /// Ends the build. Declarations that were not made during the build
+  /// are removed from the cache.
+
+  template<typename D>
+  auto declare(Symbol name, Fingerprint sig, D make_decl) -> decltype(make_decl());
+  /// Returns the cached declaration of `name` if its signature has the
+  /// fingerprint `sig`. Otherwise, returns and caches `make_decl()`,
+  /// which returns a new global Var_decl or Fn_decl.
+
+  template<typename B>
+  void define(Symbol name, Fingerprint body, B make_body);
+  /// Defines the function `name`, which must have been declared as a
+  /// function in this build. If the cached body has the fingerprint `body`, it is reused.
+  /// Otherwise, the body is set to `make_body(fn)`.
+
+  // Statistics
+
+  std::size_t get_num_reused() const { return m_reused; }
+  /// Returns the number of bodies reused in this build.
+
+  std::size_t get_num_rebuilt() const { return m_rebuilt; }
+  /// Returns the number of bodies rebuilt in this build.
+
+  Clock::duration get_time_spent() const { return m_spent; }
+  /// Returns the time spent rebuilding bodies in this build.
+
+  Clock::duration get_time_saved() const { return m_saved; }
+  /// Returns the time last taken to build the reused bodies.
+
+  void report(std::ostream& os) const;
+  /// Writes a summary of the work done and skipped in this build.
+
+private:
+  struct Entry
+  {
+    Decl* decl = nullptr;
+    /// The cached declaration.
+
+    Fingerprint sig = 0;
+    /// The fingerprint of the signature.
+
+    Fingerprint body = 0;
+    /// The fingerprint of the body, if it is a function that has been
+    /// defined.
+
+    Clock::duration cost = {};
+    /// The time taken to build the body.
+
+    unsigned gen = 0;
+    /// The last build in which the function was declared.
+  };
+
+  Type_table* m_types;
+  /// The table in which every cached type is interned.
+
+  std::unordered_map<Symbol, Entry> m_entries;
+  /// The cached declarations.
+
+  unsigned m_gen;
+  /// The current build.
+
+  std::size_t m_reused;
+  std::size_t m_rebuilt;
+  Clock::duration m_spent;
+  Clock::duration m_saved;
+};
+
+template<typename D>
+auto
+Body_cache::declare(Symbol name, Fingerprint sig, D make_decl) -> decltype(make_decl())
+{
+  Entry& ent = m_entries[name];
+  ent.gen = m_gen;
+  if (!ent.decl || ent.sig != sig) {
+    ent.decl = make_decl();
+    ent.sig = sig;
+    ent.body = 0;
+  }
+  return static_cast<decltype(make_decl())>(ent.decl);
+}
+
+template<typename B>
+void
+Body_cache::define(Symbol name, Fingerprint body, B make_body)
+{
+  auto iter = m_entries.find(name);
+  assert(iter != m_entries.end() && iter->second.gen == m_gen);
+  Entry& ent = iter->second;
+  assert(ent.decl->is_function());
+  Fn_decl* fn = static_cast<Fn_decl*>(ent.decl);
+
+  if (fn->get_body() && ent.body == body) {
+    ++m_reused;
+    m_saved += ent.cost;
+    return;
+  }
+
+  // Return statements initialize the return variable, which still holds
+  // the value returned by the old body.
+  static_cast<Var_decl*>(fn->get_return())->replace_initializer(nullptr);
+  Clock::time_point start = Clock::now();
+  fn->replace_body(make_body(fn));
+  ent.cost = Clock::now() - start;
+  ent.body = body;
+  ++m_rebuilt;
+  m_spent += ent.cost;
+}
@@ -0,0 +1,837 @@
+#include "cgen.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "name.hpp"
+#include "visitor.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+/// The definitions preceding every translation unit.
+static char const* prelude =
+  "#include <math.h>\n"
+  "#include <setjmp.h>\n"
+  "#include <stdbool.h>\n"
+  "#include <stdint.h>\n"
+  "#include <string.h>\n"
+  "\n"
+  "typedef void (*rt_fn)(void);\n"
+  "\n"
+  "static jmp_buf rt_env;\n"
+  "\n"
+  "static _Noreturn void rt_trap(int e) { longjmp(rt_env, e); }\n"
+  "\n"
+  "#if defined(__clang__) && defined(__has_attribute)\n"
+  "#if __has_attribute(musttail)\n"
+  "#define RT_MUSTTAIL __attribute__((musttail))\n"
+  "#endif\n"
+  "#endif\n"
+  "#ifndef RT_MUSTTAIL\n"
+  "#define RT_MUSTTAIL\n"
+  "#endif\n"
+  "\n"
+  "static inline int64_t rt_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }\n"
+  "static inline int64_t rt_sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }\n"
+  "static inline int64_t rt_mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }\n"
+  "static inline int64_t rt_neg(int64_t a) { return (int64_t)(0 - (uint64_t)a); }\n"
+  "\n"
+  "static inline int64_t rt_div(int64_t a, int64_t b)\n"
+  "{\n"
+  "  if (b == 0) rt_trap(1);\n"
+  "  if (b == -1) return rt_neg(a);\n"
+  "  return a / b;\n"
+  "}\n"
+  "\n"
+  "static inline int64_t rt_rem(int64_t a, int64_t b)\n"
+  "{\n"
+  "  if (b == 0) rt_trap(1);\n"
+  "  if (b == -1) return 0;\n"
+  "  return a % b;\n"
+  "}\n"
+  "\n"
+  "static inline double rt_to_float(uint64_t u) { double d; memcpy(&d, &u, 8); return d; }\n"
+  "static inline uint64_t rt_from_float(double d) { uint64_t u; memcpy(&u, &d, 8); return u; }\n";
+
+/// Translates a program to C.
+///
+/// Expressions with object type become C expressions of the corresponding
+/// scalar type, and expressions with reference type become pointers to
+/// the objects they designate. C leaves the order of evaluation of
+/// operands unspecified, so an operand other than the last is saved in a
+/// temporary with the comma operator whenever it or a later operand of
+/// the same expression could change an object. Temporaries are declared
+/// at the top of the function using them.
+///
+/// A tail call of the function being translated assigns its arguments to
+/// the parameters and jumps back to the start of the body, so the frame
+/// is reused whatever the C compiler does. A tail call of another
+/// function of the same type is marked musttail where the compiler
+/// supports it, which requires matching prototypes. Other tail calls are
+/// written as `return f(...)`, which optimizing compilers usually, but
+/// not always, make sibling calls.
+class C_translation
+{
+public:
+  C_translation(std::ostream& os);
+
+  void translate(Prog_decl const* p);
+  /// Writes the translation of `p`.
+
+private:
+  struct Emit_value;
+  struct Emit_location;
+  struct Emit_stmt;
+
+  // Names and types
+
+  std::string type(Type const* t) const;
+  /// Returns the C type of objects of type `t`.
+
+  std::string declare(Type const* t, std::string const& name) const;
+  /// Returns a declaration of `name` with type `t`.
+
+  std::string name(Decl const* d);
+  /// Returns the C name of `d`, creating it on first use.
+
+  std::string temp(Type const* t);
+  /// Returns a new temporary of type `t` in the current function.
+
+  std::string signature(Fn_decl const* fn);
+  /// Returns the declarator of `fn`.
+
+  // Expressions
+
+  std::string value(Expr const* e);
+  /// Returns the C expression computing `e`, which has object type.
+
+  std::string location(Expr const* e);
+  /// Returns the C expression computing the address of the object
+  /// designated by `e`, which has reference type.
+
+  std::string operand(Expr const* e);
+  /// Returns `e` as a value or a location, depending on its type.
+
+  std::string sequence(Expr const* e, bool pure, std::string& pre);
+  /// Returns `e` as an operand. If `pure` is false, the operand is saved
+  /// in a temporary and its assignment appended to `pre`. The caller
+  /// passes whether neither `e` nor any later operand can change an
+  /// object.
+
+  std::string call(Call_expr const* e);
+  /// Returns the C expression for the call `e`.
+
+  std::string pointer_cast(Type const* t) const;
+  /// Returns the cast of a value of function type `t`, or a reference to
+  /// one, to a pointer to the C function.
+
+  bool is_self_call(Call_expr const* e) const;
+  /// Returns true if `e` calls the function being translated by name.
+
+  bool is_sibling_call(Call_expr const* e) const;
+  /// Returns true if `e` calls a function of the same type as the
+  /// function being translated.
+
+  // Statements
+
+  void statement(Stmt const* s);
+  /// Writes `s`.
+
+  void bind(Var_decl const* var);
+  /// Writes the declaration of the local variable `var`.
+
+  void restart(Call_expr const* e);
+  /// Writes the tail call `e` of the function being translated as the
+  /// assignment of its arguments to the parameters and a jump to the
+  /// start of the body.
+
+  void sibling(Call_expr const* e);
+  /// Writes the tail call `e`, which must be a sibling call, as a return
+  /// that must be compiled as a jump where the compiler supports it.
+
+  void line(std::string const& s);
+  /// Writes `s` on its own line in the body being generated.
+
+  void function(Fn_decl const* fn);
+  /// Writes the definition of `fn`.
+
+  void entry(Fn_decl const* fn, int n);
+  /// Writes the entry point of `fn`, the nth defined function.
+
+  void globals(Prog_decl const* p);
+  /// Writes the initialization of the global variables of `p`.
+
+  std::ostream& m_os;
+  /// The output.
+
+  std::unordered_map<Decl const*, std::string> m_names;
+  /// The names of functions and variables.
+
+  int m_next_name;
+  /// The number of names created.
+
+  Fn_decl const* m_fn;
+  /// The function being generated, if any.
+
+  bool m_restart;
+  /// True if the function being generated jumps back to its start.
+
+  std::ostringstream m_body;
+  /// The body of the function being generated.
+
+  std::vector<std::string> m_temps;
+  /// The temporaries of the function being generated.
+
+  int m_depth;
+  /// The indentation of the body.
+};
+
+
+/// Translates expressions with object type.
+struct C_translation::Emit_value : Const_expr_visitor<Emit_value, std::string>
+{
+  Emit_value(C_translation& tr) : tr(tr) { }
+
+  std::string visit_bool_lit(Bool_expr const* e) { return e->get_bool_value() ? "true" : "false"; }
+  std::string visit_int_lit(Int_expr const* e) { return emit_int(e->get_value().get_int()); }
+  std::string visit_float_lit(Float_expr const* e) { return emit_float(e->get_float_value()); }
+  std::string visit_id_expr(Id_expr const* e) { return emit_id(e); }
+  std::string visit_add_expr(Add_expr const* e) { return arithmetic(e, "rt_add", "+"); }
+  std::string visit_sub_expr(Sub_expr const* e) { return arithmetic(e, "rt_sub", "-"); }
+  std::string visit_mul_expr(Mul_expr const* e) { return arithmetic(e, "rt_mul", "*"); }
+  std::string visit_div_expr(Div_expr const* e) { return arithmetic(e, "rt_div", "/"); }
+  std::string visit_rem_expr(Rem_expr const* e) { return arithmetic(e, "rt_rem", "%"); }
+  std::string visit_neg_expr(Neg_expr const* e) { return emit_neg(e); }
+  std::string visit_rec_expr(Rec_expr const* e) { return emit_rec(e); }
+  std::string visit_eq_expr(Eq_expr const* e) { return infix(e, "=="); }
+  std::string visit_ne_expr(Ne_expr const* e) { return infix(e, "!="); }
+  std::string visit_lt_expr(Lt_expr const* e) { return infix(e, "<"); }
+  std::string visit_gt_expr(Gt_expr const* e) { return infix(e, ">"); }
+  std::string visit_le_expr(Le_expr const* e) { return infix(e, "<="); }
+  std::string visit_ge_expr(Ge_expr const* e) { return infix(e, ">="); }
+  std::string visit_cond_expr(Cond_expr const* e) { return emit_cond(e); }
+  std::string visit_and_expr(And_expr const* e) { return "(" + tr.value(e->get_child(0)) + " && " + tr.value(e->get_child(1)) + ")"; }
+  std::string visit_or_expr(Or_expr const* e) { return "(" + tr.value(e->get_child(0)) + " || " + tr.value(e->get_child(1)) + ")"; }
+  std::string visit_not_expr(Not_expr const* e) { return "(!" + tr.value(e->get_child()) + ")"; }
+  std::string visit_assign_expr(Assign_expr const* e) { throw std::logic_error("invalid value expression"); }
+  std::string visit_call_expr(Call_expr const* e) { return tr.call(e); }
+  std::string visit_value_conv(Value_conv const* e) { return emit_load(e); }
+  std::string visit_error_expr(Error_expr const* e) { throw std::logic_error("translating invalid expression"); }
+
+  static bool is_float(Expr const* e) { return e->get_type()->is_float(); }
+
+  static std::string emit_int(Int_value n)
+  {
+    if (n == std::numeric_limits<Int_value>::min())
+      return "INT64_MIN";
+    return "INT64_C(" + std::to_string(n) + ")";
+  }
+
+  static std::string emit_float(Float_value n)
+  {
+    if (std::isnan(n))
+      return "NAN";
+    if (std::isinf(n))
+      return n < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+    // Hexadecimal literals are exact.
+    char buf[64];
+    std::snprintf(buf, sizeof buf, "%a", n);
+    return buf;
+  }
+
+  std::string emit_id(Id_expr const* e)
+  {
+    Decl const* d = e->get_declaration();
+    if (!d->is_function())
+      throw std::logic_error("invalid value expression");
+    return "((rt_fn)&" + tr.name(d) + ")";
+  }
+
+  /// Returns `op` applied to the operands of `e`. Operators are infix
+  /// if `prefix` is false.
+  std::string binary(Binary_expr const* e, char const* op, bool prefix)
+  {
+    std::string pre;
+    bool pure = is_pure(e->get_child(0)) && is_pure(e->get_child(1));
+    std::string a = tr.sequence(e->get_child(0), pure, pre);
+    std::string b = tr.value(e->get_child(1));
+    std::string s;
+    if (prefix)
+      s = std::string(op) + "(" + a + ", " + b + ")";
+    else
+      s = "(" + a + " " + op + " " + b + ")";
+    if (pre.empty())
+      return s;
+    return "(" + pre + s + ")";
+  }
+
+  std::string arithmetic(Binary_expr const* e, char const* i, char const* f)
+  {
+    if (is_float(e))
+      return binary(e, f, false);
+    return binary(e, i, true);
+  }
+
+  std::string infix(Binary_expr const* e, char const* op)
+  {
+    return binary(e, op, false);
+  }
+
+  std::string emit_neg(Neg_expr const* e)
+  {
+    std::string a = tr.value(e->get_child());
+    if (is_float(e))
+      return "(-" + a + ")";
+    return "rt_neg(" + a + ")";
+  }
+
+  std::string emit_rec(Rec_expr const* e)
+  {
+    std::string a = tr.value(e->get_child());
+    if (is_float(e))
+      return "(1.0 / " + a + ")";
+    return "rt_div(1, " + a + ")";
+  }
+
+  std::string emit_cond(Cond_expr const* e)
+  {
+    return "(" + tr.value(e->get_condition()) + " ? " + tr.value(e->get_true_value())
+         + " : " + tr.value(e->get_false_value()) + ")";
+  }
+
+  std::string emit_load(Value_conv const* e)
+  {
+    Expr const* src = e->get_source();
+    if (src->get_kind() == Expr::id_expr) {
+      Decl const* d = static_cast<Id_expr const*>(src)->get_declaration();
+      if (d->is_reference())
+        return "(*" + tr.name(d) + ")";
+      return tr.name(d);
+    }
+    return "(*" + tr.location(src) + ")";
+  }
+
+  C_translation& tr;
+};
+
+
+/// Translates expressions with reference type.
+struct C_translation::Emit_location : Const_expr_visitor<Emit_location, std::string>
+{
+  Emit_location(C_translation& tr) : tr(tr) { }
+
+  std::string visit_id_expr(Id_expr const* e) { return emit_id(e); }
+  std::string visit_cond_expr(Cond_expr const* e) { return emit_cond(e); }
+  std::string visit_assign_expr(Assign_expr const* e) { return emit_assign(e); }
+  std::string visit_call_expr(Call_expr const* e) { return tr.call(e); }
+  std::string visit_error_expr(Error_expr const* e) { throw std::logic_error("translating invalid expression"); }
+  std::string visit_expr(Expr const* e) { throw std::logic_error("invalid reference expression"); }
+
+  std::string emit_id(Id_expr const* e)
+  {
+    Decl const* d = e->get_declaration();
+    if (d->is_reference())
+      return tr.name(d);
+    return "(&" + tr.name(d) + ")";
+  }
+
+  std::string emit_cond(Cond_expr const* e)
+  {
+    return "(" + tr.value(e->get_condition()) + " ? " + tr.location(e->get_true_value())
+         + " : " + tr.location(e->get_false_value()) + ")";
+  }
+
+  std::string emit_assign(Assign_expr const* e)
+  {
+    // Assignment to a variable needs no temporary for its address.
+    Expr const* lhs = e->get_child(0);
+    if (lhs->get_kind() == Expr::id_expr) {
+      std::string p = emit_id(static_cast<Id_expr const*>(lhs));
+      return "(*" + p + " = " + tr.value(e->get_child(1)) + ", " + p + ")";
+    }
+    std::string p = tr.temp(lhs->get_type());
+    return "(" + p + " = " + tr.location(lhs) + ", *" + p + " = "
+         + tr.value(e->get_child(1)) + ", " + p + ")";
+  }
+
+  C_translation& tr;
+};
+
+
+/// Translates statements.
+struct C_translation::Emit_stmt : Const_stmt_visitor<Emit_stmt>
+{
+  Emit_stmt(C_translation& tr) : tr(tr) { }
+
+  void visit_skip_stmt(Skip_stmt const* s) { tr.line(";"); }
+  void visit_block_stmt(Block_stmt const* s) { emit_block(s); }
+  void visit_if_stmt(If_stmt const* s) { emit_if(s); }
+  void visit_while_stmt(While_stmt const* s) { emit_while(s); }
+  void visit_break_stmt(Break_stmt const* s) { tr.line("break;"); }
+  void visit_cont_stmt(Cont_stmt const* s) { tr.line("continue;"); }
+  void visit_ret_stmt(Ret_stmt const* s) { emit_ret(s); }
+  void visit_expr_stmt(Expr_stmt const* s) { emit_expr(s); }
+  void visit_decl_stmt(Decl_stmt const* s) { emit_decl(s); }
+
+  void emit_block(Block_stmt const* s)
+  {
+    tr.line("{");
+    ++tr.m_depth;
+    for (Stmt const* sub : *s)
+      tr.statement(sub);
+    --tr.m_depth;
+    tr.line("}");
+  }
+
+  void nested(Stmt const* s)
+  {
+    // Braces keep a nested declaration valid C.
+    if (s->get_kind() == Stmt::block_stmt) {
+      tr.statement(s);
+      return;
+    }
+    tr.line("{");
+    ++tr.m_depth;
+    tr.statement(s);
+    --tr.m_depth;
+    tr.line("}");
+  }
+
+  void emit_if(If_stmt const* s)
+  {
+    tr.line("if (" + tr.value(s->get_condition()) + ")");
+    nested(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement()) {
+      tr.line("else");
+      nested(f);
+    }
+  }
+
+  void emit_while(While_stmt const* s)
+  {
+    tr.line("while (" + tr.value(s->get_condition()) + ")");
+    nested(s->get_body());
+  }
+
+  void emit_ret(Ret_stmt const* s)
+  {
+    Call_expr const* c = get_tail_call(tr.m_fn, s);
+    if (c && tr.is_self_call(c))
+      tr.restart(c);
+    else if (c && tr.is_sibling_call(c))
+      tr.sibling(c);
+    else
+      tr.line("return " + tr.operand(s->get_return_value()) + ";");
+  }
+
+  void emit_expr(Expr_stmt const* s)
+  {
+    // Write assignments to variables as statements.
+    Expr const* e = s->get_expression();
+    if (e->get_kind() == Expr::assign_expr) {
+      Expr const* lhs = static_cast<Assign_expr const*>(e)->get_child(0);
+      if (lhs->get_kind() == Expr::id_expr) {
+        Decl const* d = static_cast<Id_expr const*>(lhs)->get_declaration();
+        std::string rhs = tr.value(static_cast<Assign_expr const*>(e)->get_child(1));
+        tr.line((d->is_reference() ? "*" : "") + tr.name(d) + " = " + rhs + ";");
+        return;
+      }
+    }
+    tr.line("(void)" + tr.operand(e) + ";");
+  }
+
+  void emit_decl(Decl_stmt const* s)
+  {
+    Decl const* d = s->get_declaration();
+    if (d->is_variable())
+      tr.bind(static_cast<Var_decl const*>(d));
+  }
+
+  C_translation& tr;
+};
+
+
+C_translation::C_translation(std::ostream& os)
+  : m_os(os), m_names(), m_next_name(), m_fn(), m_restart(), m_body(),
+    m_temps(), m_depth()
+{ }
+
+std::string
+C_translation::type(Type const* t) const
+{
+  switch (t->get_kind()) {
+  case Type::bool_type:
+    return "bool";
+  case Type::int_type:
+    return "int64_t";
+  case Type::float_type:
+    return "double";
+  case Type::ref_type:
+    return type(static_cast<Ref_type const*>(t)->get_object_type()) + "*";
+  case Type::fn_type:
+    return "rt_fn";
+  default:
+    break;
+  }
+  throw std::logic_error("translating invalid type");
+}
+
+std::string
+C_translation::declare(Type const* t, std::string const& name) const
+{
+  return type(t) + " " + name;
+}
+
+std::string
+C_translation::name(Decl const* d)
+{
+  auto iter = m_names.find(d);
+  if (iter != m_names.end())
+    return iter->second;
+  std::ostringstream ss;
+  if (d->is_function())
+    ss << "fn";
+  else if (static_cast<Var_decl const*>(d)->has_static_storage())
+    ss << "g";
+  else
+    ss << "v";
+  ss << m_next_name++;
+  if (Name const* n = d->get_name())
+    ss << '_' << *n;
+  return m_names.emplace(d, ss.str()).first->second;
+}
+
+std::string
+C_translation::temp(Type const* t)
+{
+  std::string n = "t" + std::to_string(m_temps.size());
+  m_temps.push_back(declare(t, n));
+  return n;
+}
+
+std::string
+C_translation::signature(Fn_decl const* fn)
+{
+  std::string s = declare(fn->get_return()->get_type(), name(fn)) + "(";
+  bool first = true;
+  for (Decl const* p : fn->get_parameters()) {
+    if (!first)
+      s += ", ";
+    s += declare(p->get_type(), name(p));
+    first = false;
+  }
+  if (first)
+    s += "void";
+  return s + ")";
+}
+
+std::string
+C_translation::value(Expr const* e)
+{
+  return Emit_value(*this).visit(e);
+}
+
+std::string
+C_translation::location(Expr const* e)
+{
+  return Emit_location(*this).visit(e);
+}
+
+std::string
+C_translation::operand(Expr const* e)
+{
+  if (e->get_type()->is_reference())
+    return location(e);
+  return value(e);
+}
+
+std::string
+C_translation::sequence(Expr const* e, bool pure, std::string& pre)
+{
+  std::string s = operand(e);
+  if (pure || e->get_kind() == Expr::bool_lit || e->get_kind() == Expr::int_lit
+      || e->get_kind() == Expr::float_lit)
+    return s;
+  std::string t = temp(e->get_type());
+  pre += t + " = " + s + ", ";
+  return t;
+}
+
+std::string
+C_translation::call(Call_expr const* e)
+{
+  auto args = e->get_arguments();
+
+  // pure[i] is true if no argument from i on can change an object. The
+  // last argument is complete before the call, so it is never saved.
+  std::vector<bool> pure(args.size() + 1, true);
+  for (std::size_t i = args.size(); i > 0; --i)
+    pure[i - 1] = pure[i] && is_pure(args.at(i - 1));
+  if (!args.empty())
+    pure[args.size() - 1] = true;
+
+  // Resolve the callee before evaluating arguments, as the evaluator does.
+  std::string pre;
+  std::string f;
+  Expr const* fe = e->get_function();
+  Decl const* d = nullptr;
+  if (fe->get_kind() == Expr::id_expr)
+    d = static_cast<Id_expr const*>(fe)->get_declaration();
+  if (d && d->is_function()) {
+    f = name(d);
+  }
+  else {
+    f = "(" + pointer_cast(fe->get_type()) + sequence(fe, is_pure(fe) && pure[0], pre) + ")";
+  }
+
+  std::string s = f + "(";
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (i)
+      s += ", ";
+    s += sequence(args.at(i), pure[i], pre);
+  }
+  s += ")";
+  if (pre.empty())
+    return s;
+  return "(" + pre + s + ")";
+}
+
+std::string
+C_translation::pointer_cast(Type const* t) const
+{
+  if (t->is_reference())
+    t = static_cast<Ref_type const*>(t)->get_object_type();
+  Fn_type const* ft = static_cast<Fn_type const*>(t);
+  std::string cast = "(" + type(ft->get_return_type()) + " (*)(";
+  bool first = true;
+  for (Type const* p : ft->get_parameter_types()) {
+    if (!first)
+      cast += ", ";
+    cast += type(p);
+    first = false;
+  }
+  if (first)
+    cast += "void";
+  return cast + "))";
+}
+
+bool
+C_translation::is_sibling_call(Call_expr const* e) const
+{
+  // Types are unique, so equal types have equal C prototypes.
+  Type const* t = e->get_function()->get_type();
+  if (t->is_reference())
+    t = static_cast<Ref_type const*>(t)->get_object_type();
+  return t == m_fn->get_type();
+}
+
+bool
+C_translation::is_self_call(Call_expr const* e) const
+{
+  Expr const* f = e->get_function();
+  return f->get_kind() == Expr::id_expr
+      && static_cast<Id_expr const*>(f)->get_declaration() == m_fn;
+}
+
+void
+C_translation::statement(Stmt const* s)
+{
+  Emit_stmt(*this).visit(s);
+}
+
+void
+C_translation::bind(Var_decl const* var)
+{
+  std::string init = "0";
+  if (Expr const* e = var->get_initializer())
+    init = operand(e);
+  line(declare(var->get_type(), name(var)) + " = " + init + ";");
+}
+
+void
+C_translation::restart(Call_expr const* e)
+{
+  // Evaluate every argument before assigning any parameter, since the
+  // arguments may read the parameters.
+  std::vector<std::string> ts;
+  Expr const* const* ai = e->get_arguments().begin();
+  for (Decl const* p : m_fn->get_parameters()) {
+    std::string t = temp(p->get_type());
+    line(t + " = " + operand(*ai++) + ";");
+    ts.push_back(t);
+  }
+  auto ti = ts.begin();
+  for (Decl const* p : m_fn->get_parameters())
+    line(name(p) + " = " + *ti++ + ";");
+  line("goto rt_restart;");
+  m_restart = true;
+}
+
+void
+C_translation::sibling(Call_expr const* e)
+{
+  // musttail requires the returned expression to be the call itself, so
+  // the callee and arguments are evaluated into temporaries first.
+  Expr const* fe = e->get_function();
+  Decl const* d = nullptr;
+  if (fe->get_kind() == Expr::id_expr)
+    d = static_cast<Id_expr const*>(fe)->get_declaration();
+  std::string f;
+  if (d && d->is_function()) {
+    f = name(d);
+  }
+  else {
+    f = temp(fe->get_type());
+    line(f + " = " + operand(fe) + ";");
+    f = "(" + pointer_cast(fe->get_type()) + f + ")";
+  }
+  std::string s = f + "(";
+  bool first = true;
+  for (Expr const* a : e->get_arguments()) {
+    std::string t = temp(a->get_type());
+    line(t + " = " + operand(a) + ";");
+    if (!first)
+      s += ", ";
+    s += t;
+    first = false;
+  }
+  line("RT_MUSTTAIL return " + s + ");");
+}
+
+void
+C_translation::line(std::string const& s)
+{
+  m_body << std::string(2 * m_depth, ' ') << s << '\n';
+}
+
+void
+C_translation::function(Fn_decl const* fn)
+{
+  m_fn = fn;
+  m_restart = false;
+  m_body.str("");
+  m_temps.clear();
+  m_depth = 1;
+  statement(fn->get_body());
+
+  // Falling off the end returns an indeterminate value.
+  line("return 0;");
+
+  m_os << "\nstatic " << signature(fn) << "\n{\n";
+  for (std::string const& t : m_temps)
+    m_os << "  " << t << ";\n";
+  if (m_restart)
+    m_os << "rt_restart:;\n";
+  m_os << m_body.str() << "}\n";
+  m_fn = nullptr;
+}
+
+void
+C_translation::entry(Fn_decl const* fn, int n)
+{
+  m_os << "\nint rt_entry_" << n << "(uint64_t const* args, uint64_t* ret)\n{\n"
+       << "  int e = setjmp(rt_env);\n"
+       << "  if (e)\n"
+       << "    return e;\n"
+       << "  " << declare(fn->get_return()->get_type(), "r") << " = " << name(fn) << "(";
+  int i = 0;
+  for (Decl const* p : fn->get_parameters()) {
+    if (i)
+      m_os << ", ";
+    Type const* t = p->get_type();
+    if (t->is_float())
+      m_os << "rt_to_float(args[" << i << "])";
+    else if (t->is_bool())
+      m_os << "args[" << i << "] != 0";
+    else
+      m_os << "(int64_t)args[" << i << "]";
+    ++i;
+  }
+  m_os << ");\n";
+  if (fn->get_return()->get_type()->is_float())
+    m_os << "  *ret = rt_from_float(r);\n";
+  else
+    m_os << "  *ret = (uint64_t)r;\n";
+  m_os << "  return 0;\n}\n";
+}
+
+void
+C_translation::globals(Prog_decl const* p)
+{
+  m_body.str("");
+  m_temps.clear();
+  m_depth = 1;
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_variable())
+      continue;
+    Var_decl const* var = static_cast<Var_decl const*>(d);
+    if (Expr const* e = var->get_initializer())
+      line(name(var) + " = " + operand(e) + ";");
+  }
+
+  m_os << "\nint rt_start(void)\n{\n";
+  for (std::string const& t : m_temps)
+    m_os << "  " << t << ";\n";
+  m_os << "  int e = setjmp(rt_env);\n"
+       << "  if (e)\n"
+       << "    return e;\n"
+       << m_body.str()
+       << "  return 0;\n}\n";
+}
+
+void
+C_translation::translate(Prog_decl const* p)
+{
+  m_os << prelude << '\n';
+
+  // Declare everything first so that definitions can refer to functions
+  // and variables declared later.
+  for (Decl const* d : p->get_children()) {
+    if (d->is_variable())
+      m_os << "static " << declare(d->get_type(), name(d)) << ";\n";
+    else if (d->is_function())
+      m_os << "static " << signature(static_cast<Fn_decl const*>(d)) << ";\n";
+  }
+
+  int n = 0;
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    if (!fn->get_body()) {
+      m_os << "\nstatic " << signature(fn) << "\n{\n  rt_trap(2);\n}\n";
+      continue;
+    }
+    function(fn);
+    if (Native_module::has_entry(fn))
+      entry(fn, n);
+    ++n;
+  }
+  globals(p);
+}
+
+
+void
+translate_to_c(Prog_decl const* p, std::ostream& os)
+{
+  C_translation(os).translate(p);
+}
+
+
+C_module::C_module(Prog_decl const* p, std::string const& cc)
+  : m_source(translate(p)),
+    m_native(p, m_source, ".c", cc + " -std=c11 -shared -fPIC -o %o %i")
+{ }
+
+std::string
+C_module::translate(Prog_decl const* p)
+{
+  std::ostringstream ss;
+  translate_to_c(p, ss);
+  return ss.str();
+}
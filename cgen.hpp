@@ -0,0 +1,51 @@
+#pragma once
+
+#include "native.hpp"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Fn_decl;
+class Prog_decl;
+
+
+void translate_to_c(Prog_decl const* p, std::ostream& os);
+/// Writes a C translation unit equivalent to `p`, which must have been
+/// checked. The unit is self-contained C11 and exports the entry points
+/// described by Native_module.
+
+
+/// A program compiled to native code through C.
+///
+/// The program is translated to C (see translate_to_c), compiled to a
+/// shared library with the host C compiler, and loaded.
+///
+/// Tail calls of a function to itself always run in constant stack space.
+/// Under clang, so do tail calls between functions of the same type.
+/// Other tail calls rely on the compiler's sibling call optimization,
+/// which GCC and clang perform at -O2 in most but not all cases. Deep
+/// mutual recursion through such calls may exhaust the native stack.
+class C_module
+{
+public:
+  C_module(Prog_decl const* p, std::string const& cc = "cc -O2");
+  /// Compiles `p` using the compiler command `cc`. Throws a runtime error
+  /// if the compiler fails or the library cannot be loaded.
+
+  Value call(Fn_decl const* fn, std::vector<Value> const& args) { return m_native.call(fn, args); }
+  /// Calls `fn` with `args` and returns the result.
+
+  std::string const& get_source() const { return m_source; }
+  /// Returns the generated C.
+
+private:
+  static std::string translate(Prog_decl const* p);
+  /// Returns the translation of `p`.
+
+  std::string m_source;
+  /// The generated C.
+
+  Native_module m_native;
+  /// The compiled program.
+};
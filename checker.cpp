@@ -0,0 +1,69 @@
+#include "checker.hpp"
+#include "builder.hpp"
+#include "decl.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+
+std::vector<std::string>
+check_functions(Type_table& types, std::vector<Check_job> const& jobs,
+                unsigned threads)
+{
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  if (node_stats_enabled)
+    threads = 1;
+  if (threads > jobs.size())
+    threads = std::max<std::size_t>(1, jobs.size());
+
+  std::vector<std::vector<std::string>> diags(jobs.size());
+  std::vector<std::exception_ptr> errors(jobs.size());
+  std::atomic<std::size_t> next(0);
+
+  // An exception must not escape a worker, so each job's exception is
+  // kept and rethrown once all workers have finished.
+  auto work = [&]() {
+    Builder b(types);
+    for (std::size_t i = next++; i < jobs.size(); i = next++) {
+      Check_job const& job = jobs[i];
+      try {
+        job.fn->replace_body(job.build(b, job.fn));
+        diags[i] = b.get_diagnostics();
+      }
+      catch (...) {
+        errors[i] = std::current_exception();
+      }
+      b.clear_diagnostics();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned i = 1; i < threads; ++i) {
+    try {
+      workers.emplace_back(work);
+    }
+    catch (std::system_error const&) {
+      // Run the jobs on the workers already started.
+      break;
+    }
+  }
+  work();
+  for (std::thread& t : workers)
+    t.join();
+
+  for (std::exception_ptr const& e : errors) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  std::vector<std::string> result;
+  for (std::vector<std::string>& ds : diags)
+    for (std::string& d : ds)
+      result.push_back(std::move(d));
+  return result;
+}
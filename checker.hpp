@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class Builder;
+class Type_table;
+class Stmt;
+class Fn_decl;
+
+
+/// A function whose body is to be built and checked. The `build`
+/// function constructs the body of `fn` using the given builder.
+struct Check_job
+{
+  Fn_decl* fn;
+  /// The function to define.
+
+  std::function<Stmt*(Builder&, Fn_decl*)> build;
+  /// Builds the body of the function.
+};
+
+
+std::vector<std::string> check_functions(Type_table& types,
+                                         std::vector<Check_job> const& jobs,
+                                         unsigned threads = 0);
+/// Builds and checks the body of each function in `jobs` using up to
+/// `threads` worker threads, or one per hardware thread if `threads`
+/// is 0. The declarations of all functions must already exist. Each
+/// worker has its own builder sharing `types`, and jobs are claimed in
+/// order as workers become free.
+///
+/// Returns the diagnostics of all jobs. The diagnostics of each job are
+/// kept together and jobs appear in the order given, so the result does
+/// not depend on scheduling. When node statistics are enabled, the jobs
+/// are run on the calling thread.
+///
+/// If building any body throws, the remaining jobs are still run, and
+/// then the exception of the first such job in the order given is
+/// rethrown.
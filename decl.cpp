@@ -10,11 +10,17 @@
 char const*
 Decl::get_kind_name() const
 {
-  switch (m_kind) {
-  case prog_decl: return "prog_decl";
-  case var_decl: return "var_decl";
-  case fn_decl: return "fn_decl";
+  return get_kind_name(m_kind);
+}
+
+char const*
+Decl::get_kind_name(Kind k)
+{
+  switch (k) {
+#define def_decl(K, T) case K: return #K;
+#include "decl.def"
   }
+  return "<unknown>";
 }
 
 bool
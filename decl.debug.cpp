@@ -4,6 +4,7 @@
 #include "expr.hpp"
 #include "stmt.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -48,17 +49,26 @@ debug_fn(Printer& p, Fn_decl const* d)
   p.undent();
 }
 
+namespace
+{
+
+struct Debug_kids : Const_decl_visitor<Debug_kids>
+{
+  Debug_kids(Printer& p) : p(p) { }
+
+  void visit_prog_decl(Prog_decl const* d) { debug_kids_real(p, d); }
+  void visit_fn_decl(Fn_decl const* d) { debug_fn(p, d); }
+  void visit_decl(Decl const* d) { }
+
+  Printer& p;
+};
+
+} // namespace
+
 static void
 debug_kids(Printer& p, Decl const* d)
 {
-  switch (d->get_kind()) {
-  default:
-    return;
-  case Decl::fn_decl:
-    return debug_fn(p, static_cast<Fn_decl const*>(d));
-  case Decl::prog_decl:
-    return debug_kids_real(p, static_cast<Prog_decl const*>(d));
-  }
+  Debug_kids(p).visit(d);
 }
 
 void
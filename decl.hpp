@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tree.hpp"
+#include "stats.hpp"
 
 class Name;
 class Type;
@@ -20,9 +21,8 @@ class Decl
 public:
   enum Kind
   {
-    prog_decl,
-    var_decl,
-    fn_decl,
+#define def_decl(K, T) K,
+#include "decl.def"
   };
 
 protected:
@@ -37,6 +37,9 @@ public:
   char const* get_kind_name() const;
   /// Returns the spelling of the kind.
 
+  static char const* get_kind_name(Kind k);
+  /// Returns the spelling of the kind `k`.
+
   bool is_variable() const { return m_kind == var_decl; }
   /// Returns true if this is a variable (i.e., an object or reference).
 
@@ -83,7 +86,9 @@ private:
 inline
 Decl::Decl(Kind k)
   : m_kind(k)
-{ }
+{
+  note_node(decl_node, k);
+}
 
 
 // Helper classes
@@ -132,6 +137,9 @@ public:
 
   Node_range<Decl const> get_children() const { return Base::get_children(); }
   /// Returns the children of the expression.
+
+  void add_child(Decl* d);
+  /// Adds a child to the declaration.
 };
 
 inline
@@ -142,17 +150,30 @@ Kary_decl::Kary_decl(Kind k)
 inline
 Kary_decl::Kary_decl(Kind k, std::initializer_list<Decl*> list)
   : Decl(k), Base(list)
-{ }
+{
+  note_operands(decl_node, k, get_arity());
+}
 
 inline
 Kary_decl::Kary_decl(Kind k, std::vector<Decl*> const& vec)
   : Decl(k), Base(vec)
-{ }
+{
+  note_operands(decl_node, k, get_arity());
+}
 
 inline
 Kary_decl::Kary_decl(Kind k, std::vector<Decl*>&& vec)
   : Decl(k), Base(std::move(vec))
-{ }
+{
+  note_operands(decl_node, k, get_arity());
+}
+
+inline void
+Kary_decl::add_child(Decl* d)
+{
+  note_operands(decl_node, get_kind(), 1);
+  Base::add_child(d);
+}
 
 
 /// The base class of all declarations that can have values.
@@ -198,20 +219,44 @@ public:
   void set_initializer(Expr* e);
   /// Sets the initializer of the variable.
 
+  void replace_initializer(Expr* e);
+  /// Replaces the initializer of the variable with `e`. This is used when
+  /// the initializer is rewritten but the variable is unchanged.
+
   Name* get_name() const override { return Value_decl::get_name(); }
   /// Returns the name of the declaration, if any.
 
   Type* get_type() const override { return Value_decl::get_type(); }  
   /// Returns the type of the declaration, if any.
 
+  int get_slot() const { return m_slot; }
+  /// Returns the index of the variable in its frame or store, or -1 if
+  /// no layout has been computed.
+
+  void set_slot(int n) { m_slot = n; }
+  /// Sets the index of the variable in its frame or store.
+
+  bool has_static_storage() const { return m_static; }
+  /// Returns true if the variable resides in the static store.
+
+  void set_static_slot(int n) { m_slot = n; m_static = true; }
+  /// Sets the index of the variable in the static store.
+
 private:
   Expr* m_init;
   /// The initializer of the declaration.
+
+  int m_slot;
+  /// The index of the variable in its frame or store.
+
+  bool m_static;
+  /// True if the variable is declared at program scope.
 };
 
 inline 
 Var_decl::Var_decl(Name* n, Type* t)
-  : Nullary_decl(var_decl), Value_decl(n, t), m_init()
+  : Nullary_decl(var_decl), Value_decl(n, t), m_init(), m_slot(-1),
+    m_static(false)
 { }
 
 inline void
@@ -221,6 +266,12 @@ Var_decl::set_initializer(Expr* e)
   m_init = e;
 }
 
+inline void
+Var_decl::replace_initializer(Expr* e)
+{
+  m_init = e;
+}
+
 
 /// Represents declarations of the form `fun x (<decl-seq>) -> t s`.
 ///
@@ -282,14 +333,43 @@ public:
   void set_body(Stmt* s);
   /// Sets the body of the function.
 
+  void replace_body(Stmt* s);
+  /// Replaces the body of the function with `s`. This is used when a
+  /// body is rebuilt but the function's signature is unchanged.
+
+  // Layout
+
+  int get_frame_size() const { return m_frame_size; }
+  /// Returns the number of slots in the function's frame.
+
+  void set_frame_size(int n) { m_frame_size = n; }
+  /// Sets the number of slots in the function's frame.
+
+  // Profiling
+
+  unsigned get_call_count() const { return m_calls; }
+  /// Returns the number of calls counted by count_call.
+
+  unsigned count_call() const { return ++m_calls; }
+  /// Counts a call of the function and returns the new count. This is
+  /// used by the virtual machine to find hot functions, and by the
+  /// evaluator to profile calls for the inliner.
+
 private:
   Stmt* m_body;
   /// The body of the function.
+
+  int m_frame_size;
+  /// The number of slots in the function's frame.
+
+  mutable unsigned m_calls;
+  /// The number of calls counted.
 };
 
 inline
 Fn_decl::Fn_decl(Name* n, Type* t)
-  : Kary_decl(fn_decl), Value_decl(n, t), m_body()
+  : Kary_decl(fn_decl), Value_decl(n, t), m_body(), m_frame_size(),
+    m_calls()
 { }
 
 inline  void
@@ -299,6 +379,12 @@ Fn_decl::set_body(Stmt* s)
   m_body = s;
 }
 
+inline void
+Fn_decl::replace_body(Stmt* s)
+{
+  m_body = s;
+}
+
 
 /// A program declaration is a list of declarations.
 class Prog_decl : public Kary_decl
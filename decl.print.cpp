@@ -4,6 +4,7 @@
 #include "expr.hpp"
 #include "stmt.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -47,19 +48,26 @@ print_prog(Printer& p, Prog_decl const* d)
     print_decl(p, member);
 }
 
+namespace
+{
+
+struct Print_decl : Const_decl_visitor<Print_decl>
+{
+  Print_decl(Printer& p) : p(p) { }
+
+  void visit_prog_decl(Prog_decl const* d) { print_prog(p, d); }
+  void visit_var_decl(Var_decl const* d) { print_var(p, d); }
+  void visit_fn_decl(Fn_decl const* d) { print_fn(p, d); }
+
+  Printer& p;
+};
+
+} // namespace
+
 void
 print_decl(Printer& p, Decl const* d)
 {
-  switch (d->get_kind()) {
-  case Decl::obj_decl:
-    return print_var(p, static_cast<Obj_decl const*>(d));
-  case Decl::ref_decl:
-    return print_var(p, static_cast<Ref_decl const*>(d));
-  case Decl::fn_decl:
-    return print_fn(p, static_cast<Fn_decl const*>(d));
-  case Decl::prog_decl:
-    return print_prog(p, static_cast<Prog_decl const*>(d));
-  }
+  Print_decl(p).visit(d);
 }
 
 std::ostream&
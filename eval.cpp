@@ -0,0 +1,493 @@
+#include "eval.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "visitor.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+// Arithmetic
+//
+// Integer arithmetic wraps on overflow, as it does when folding.
+
+static Packed_value
+compute_add(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(Int_value(std::uint64_t(a.get_int()) + std::uint64_t(b.get_int())));
+  return Packed_value(a.get_float() + b.get_float());
+}
+
+static Packed_value
+compute_sub(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(Int_value(std::uint64_t(a.get_int()) - std::uint64_t(b.get_int())));
+  return Packed_value(a.get_float() - b.get_float());
+}
+
+static Packed_value
+compute_mul(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(Int_value(std::uint64_t(a.get_int()) * std::uint64_t(b.get_int())));
+  return Packed_value(a.get_float() * b.get_float());
+}
+
+static Packed_value
+compute_div(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int()) {
+    if (b.get_int() == 0)
+      throw std::runtime_error("division by zero");
+    if (b.get_int() == -1)
+      return Packed_value(Int_value(-std::uint64_t(a.get_int())));
+    return Packed_value(a.get_int() / b.get_int());
+  }
+  return Packed_value(a.get_float() / b.get_float());
+}
+
+static Packed_value
+compute_rem(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int()) {
+    if (b.get_int() == 0)
+      throw std::runtime_error("division by zero");
+    if (b.get_int() == -1)
+      return Packed_value(Int_value(0));
+    return Packed_value(a.get_int() % b.get_int());
+  }
+  throw std::logic_error("remainder of floating point value");
+}
+
+static Packed_value
+compute_neg(Packed_value const& a)
+{
+  if (a.is_int())
+    return Packed_value(Int_value(-std::uint64_t(a.get_int())));
+  return Packed_value(-a.get_float());
+}
+
+static Packed_value
+compute_rec(Packed_value const& a)
+{
+  if (a.is_int())
+    return compute_div(Packed_value(Int_value(1)), a);
+  return Packed_value(1.0 / a.get_float());
+}
+
+// Comparison
+
+static Packed_value
+compute_eq(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(a.get_int() == b.get_int());
+  if (a.is_float())
+    return Packed_value(a.get_float() == b.get_float());
+  return Packed_value(a.get_function() == b.get_function());
+}
+
+static Packed_value
+compute_ne(Packed_value const& a, Packed_value const& b)
+{
+  return Packed_value(!compute_eq(a, b).get_int());
+}
+
+static Packed_value
+compute_lt(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(a.get_int() < b.get_int());
+  return Packed_value(a.get_float() < b.get_float());
+}
+
+static Packed_value
+compute_gt(Packed_value const& a, Packed_value const& b)
+{
+  return compute_lt(b, a);
+}
+
+static Packed_value
+compute_le(Packed_value const& a, Packed_value const& b)
+{
+  if (a.is_int())
+    return Packed_value(a.get_int() <= b.get_int());
+  return Packed_value(a.get_float() <= b.get_float());
+}
+
+static Packed_value
+compute_ge(Packed_value const& a, Packed_value const& b)
+{
+  return compute_le(b, a);
+}
+
+static bool
+test(Packed_value const& v)
+{
+  return v.get_int() != 0;
+}
+
+/// Stores `v` in `obj`, which may not have been initialized yet.
+static void
+assign(Object* obj, Packed_value const& v)
+{
+  if (obj->is_uninitialized())
+    obj->initialize(v);
+  else
+    obj->store(v);
+}
+
+
+/// Computes the value of expressions with object type.
+struct Evaluator::Eval_value : Const_expr_visitor<Eval_value, Packed_value>
+{
+  Eval_value(Evaluator& ev) : ev(ev) { }
+
+  Packed_value visit_bool_lit(Bool_expr const* e) { return Packed_value(e->get_value().get_int()); }
+  Packed_value visit_int_lit(Int_expr const* e) { return Packed_value(e->get_value().get_int()); }
+  Packed_value visit_float_lit(Float_expr const* e) { return Packed_value(e->get_value().get_float()); }
+  Packed_value visit_id_expr(Id_expr const* e) { return eval_id(e); }
+  Packed_value visit_add_expr(Add_expr const* e) { return binary(e, compute_add); }
+  Packed_value visit_sub_expr(Sub_expr const* e) { return binary(e, compute_sub); }
+  Packed_value visit_mul_expr(Mul_expr const* e) { return binary(e, compute_mul); }
+  Packed_value visit_div_expr(Div_expr const* e) { return binary(e, compute_div); }
+  Packed_value visit_rem_expr(Rem_expr const* e) { return binary(e, compute_rem); }
+  Packed_value visit_neg_expr(Neg_expr const* e) { return compute_neg(ev.eval(e->get_child())); }
+  Packed_value visit_rec_expr(Rec_expr const* e) { return compute_rec(ev.eval(e->get_child())); }
+  Packed_value visit_eq_expr(Eq_expr const* e) { return binary(e, compute_eq); }
+  Packed_value visit_ne_expr(Ne_expr const* e) { return binary(e, compute_ne); }
+  Packed_value visit_lt_expr(Lt_expr const* e) { return binary(e, compute_lt); }
+  Packed_value visit_gt_expr(Gt_expr const* e) { return binary(e, compute_gt); }
+  Packed_value visit_le_expr(Le_expr const* e) { return binary(e, compute_le); }
+  Packed_value visit_ge_expr(Ge_expr const* e) { return binary(e, compute_ge); }
+  Packed_value visit_cond_expr(Cond_expr const* e) { return eval_cond(e); }
+  Packed_value visit_and_expr(And_expr const* e) { return eval_and(e); }
+  Packed_value visit_or_expr(Or_expr const* e) { return eval_or(e); }
+  Packed_value visit_not_expr(Not_expr const* e) { return Packed_value(!test(ev.eval(e->get_child()))); }
+  Packed_value visit_call_expr(Call_expr const* e) { ev.eval_call(e); return ev.m_ret; }
+  Packed_value visit_value_conv(Value_conv const* e) { return ev.locate(e->get_source())->load(); }
+  Packed_value visit_expr(Expr const* e) { throw std::logic_error("invalid value expression"); }
+
+  /// Evaluates the operands of `e` in order and applies `f`.
+  template<typename F>
+  Packed_value binary(Binary_expr const* e, F f)
+  {
+    Packed_value a = ev.eval(e->get_child(0));
+    Packed_value b = ev.eval(e->get_child(1));
+    return f(a, b);
+  }
+
+  Packed_value eval_id(Id_expr const* e)
+  {
+    Decl* d = e->get_declaration();
+    if (!d->is_function())
+      throw std::logic_error("invalid value expression");
+    return Packed_value(static_cast<Fn_decl*>(d));
+  }
+
+  Packed_value eval_cond(Cond_expr const* e)
+  {
+    if (test(ev.eval(e->get_condition())))
+      return ev.eval(e->get_true_value());
+    return ev.eval(e->get_false_value());
+  }
+
+  Packed_value eval_and(And_expr const* e)
+  {
+    if (!test(ev.eval(e->get_child(0))))
+      return Packed_value(false);
+    return Packed_value(test(ev.eval(e->get_child(1))));
+  }
+
+  Packed_value eval_or(Or_expr const* e)
+  {
+    if (test(ev.eval(e->get_child(0))))
+      return Packed_value(true);
+    return Packed_value(test(ev.eval(e->get_child(1))));
+  }
+
+  Evaluator& ev;
+};
+
+
+/// Computes the object designated by expressions with reference type.
+struct Evaluator::Eval_address : Const_expr_visitor<Eval_address, Object*>
+{
+  Eval_address(Evaluator& ev) : ev(ev) { }
+
+  Object* visit_id_expr(Id_expr const* e) { return ev.locate(e->get_declaration()); }
+  Object* visit_cond_expr(Cond_expr const* e) { return eval_cond(e); }
+  Object* visit_assign_expr(Assign_expr const* e) { return eval_assign(e); }
+  Object* visit_call_expr(Call_expr const* e) { ev.eval_call(e); return ev.m_ret_obj; }
+  Object* visit_expr(Expr const* e) { throw std::logic_error("invalid reference expression"); }
+
+  Object* eval_cond(Cond_expr const* e)
+  {
+    if (test(ev.eval(e->get_condition())))
+      return ev.locate(e->get_true_value());
+    return ev.locate(e->get_false_value());
+  }
+
+  Object* eval_assign(Assign_expr const* e)
+  {
+    Object* obj = ev.locate(e->get_child(0));
+    assign(obj, ev.eval(e->get_child(1)));
+    return obj;
+  }
+
+  Evaluator& ev;
+};
+
+
+/// Executes statements.
+struct Evaluator::Exec_stmt : Const_stmt_visitor<Exec_stmt, Control>
+{
+  Exec_stmt(Evaluator& ev) : ev(ev) { }
+
+  Control visit_skip_stmt(Skip_stmt const* s) { return next_ctl; }
+  Control visit_block_stmt(Block_stmt const* s) { return exec_block(s); }
+  Control visit_if_stmt(If_stmt const* s) { return exec_if(s); }
+  Control visit_while_stmt(While_stmt const* s) { return exec_while(s); }
+  Control visit_break_stmt(Break_stmt const* s) { return break_ctl; }
+  Control visit_cont_stmt(Cont_stmt const* s) { return cont_ctl; }
+  Control visit_ret_stmt(Ret_stmt const* s) { return exec_ret(s); }
+  Control visit_expr_stmt(Expr_stmt const* s) { return exec_expr(s); }
+  Control visit_decl_stmt(Decl_stmt const* s) { return exec_decl(s); }
+
+  Control exec_block(Block_stmt const* s)
+  {
+    for (Stmt const* sub : *s) {
+      Control c = ev.exec(sub);
+      if (c != next_ctl)
+        return c;
+    }
+    return next_ctl;
+  }
+
+  Control exec_if(If_stmt const* s)
+  {
+    if (test(ev.eval(s->get_condition())))
+      return ev.exec(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement())
+      return ev.exec(f);
+    return next_ctl;
+  }
+
+  Control exec_while(While_stmt const* s)
+  {
+    while (test(ev.eval(s->get_condition()))) {
+      Control c = ev.exec(s->get_body());
+      if (c == break_ctl)
+        break;
+      if (c == ret_ctl)
+        return c;
+    }
+    return next_ctl;
+  }
+
+  Control exec_ret(Ret_stmt const* s)
+  {
+    Fn_decl const* fn = static_cast<Fn_decl const*>(ev.m_frame->get_function());
+    if (Call_expr const* c = get_tail_call(fn, s)) {
+      ev.eval_tail_call(c);
+      return ret_ctl;
+    }
+    Expr const* e = s->get_return_value();
+    if (e->get_type()->is_reference())
+      ev.m_ret_obj = ev.locate(e);
+    else
+      ev.m_ret = ev.eval(e);
+    return ret_ctl;
+  }
+
+  Control exec_expr(Expr_stmt const* s)
+  {
+    Expr const* e = s->get_expression();
+    if (e->get_type()->is_reference())
+      ev.locate(e);
+    else
+      ev.eval(e);
+    return next_ctl;
+  }
+
+  Control exec_decl(Decl_stmt const* s)
+  {
+    Decl* d = s->get_declaration();
+    if (d->is_variable())
+      ev.bind(ev.m_frame->get_locals(), d, static_cast<Var_decl*>(d)->get_initializer());
+    return next_ctl;
+  }
+
+  Evaluator& ev;
+};
+
+
+/// Restores the state of the evaluator when a call returns or is
+/// abandoned by an exception. The caller's frame becomes current again,
+/// the frames pushed for the call are popped, and any tail call
+/// arguments saved during the call are discarded.
+struct Evaluator::Call_guard
+{
+  explicit Call_guard(Evaluator& ev)
+    : ev(ev), frame(ev.m_frame), top(ev.m_stack.get_top()), args(ev.m_args.size())
+  { }
+
+  ~Call_guard()
+  {
+    ev.m_frame = frame;
+    while (ev.m_stack.get_top() != top)
+      ev.m_stack.pop();
+    ev.m_args.resize(args);
+    ev.m_tail = nullptr;
+  }
+
+  Call_guard(Call_guard const&) = delete;
+  Call_guard& operator=(Call_guard const&) = delete;
+
+  Evaluator& ev;
+  Frame* frame;
+  Frame* top;
+  std::size_t args;
+};
+
+
+Evaluator::Evaluator(Prog_decl const* p, int statics)
+  : m_statics(statics), m_stack(), m_frame(), m_ret(), m_ret_obj(),
+    m_tail(), m_args()
+{
+  for (Decl const* d : p->get_children()) {
+    if (d->is_variable()) {
+      Var_decl* var = const_cast<Var_decl*>(static_cast<Var_decl const*>(d));
+      bind(m_statics, var, var->get_initializer());
+    }
+  }
+}
+
+Value
+Evaluator::call(Fn_decl* fn, std::vector<Value> const& args)
+{
+  assert(args.size() == fn->get_num_parameters());
+  for (Decl* p : fn->get_parameters()) {
+    if (p->is_reference())
+      throw std::logic_error("cannot bind reference parameter to a value");
+  }
+
+  Call_guard guard(*this);
+  Frame* f = m_stack.push(fn);
+  auto ai = args.begin();
+  for (Decl* p : fn->get_parameters())
+    f->allocate_local(p)->initialize(Packed_value(*ai++));
+  invoke(fn, f);
+  return m_ret.to_value();
+}
+
+Packed_value
+Evaluator::eval(Expr const* e)
+{
+  return Eval_value(*this).visit(e);
+}
+
+Object*
+Evaluator::locate(Expr const* e)
+{
+  return Eval_address(*this).visit(e);
+}
+
+Evaluator::Control
+Evaluator::exec(Stmt const* s)
+{
+  return Exec_stmt(*this).visit(s);
+}
+
+void
+Evaluator::bind(Monotonic_store& s, Decl* d, Expr const* e)
+{
+  if (d->is_reference()) {
+    assert(e);
+    s.alias(d, locate(e));
+    return;
+  }
+  Object* obj = s.allocate(d);
+  if (e)
+    obj->initialize(eval(e));
+}
+
+Object*
+Evaluator::locate(Decl* d)
+{
+  assert(d->is_variable());
+  Var_decl* var = static_cast<Var_decl*>(d);
+  if (var->has_static_storage())
+    return m_statics.locate(var);
+  return m_frame->locate_local(var);
+}
+
+void
+Evaluator::eval_call(Call_expr const* e)
+{
+  Fn_decl* fn = eval(e->get_function()).get_function();
+  fn->count_call();
+
+  // Arguments are evaluated in the caller's frame and bound in the
+  // callee's frame, which is already on the stack.
+  Call_guard guard(*this);
+  Frame* f = m_stack.push(fn);
+  Expr const* const* ai = e->get_arguments().begin();
+  for (Decl* p : fn->get_parameters())
+    bind(f->get_locals(), p, *ai++);
+  invoke(fn, f);
+}
+
+void
+Evaluator::eval_tail_call(Call_expr const* e)
+{
+  Fn_decl* fn = eval(e->get_function()).get_function();
+  fn->count_call();
+
+  Expr const* const* ai = e->get_arguments().begin();
+  for (Decl* p : fn->get_parameters()) {
+    Expr const* a = *ai++;
+    if (p->is_reference())
+      m_args.push_back(Argument{Packed_value(), locate(a)});
+    else
+      m_args.push_back(Argument{eval(a), nullptr});
+  }
+  m_tail = fn;
+}
+
+Frame*
+Evaluator::enter(Fn_decl* fn)
+{
+  Frame* f = m_stack.push(fn);
+  std::size_t base = m_args.size() - fn->get_num_parameters();
+  Argument* ai = m_args.data() + base;
+  for (Decl* p : fn->get_parameters()) {
+    if (p->is_reference())
+      f->alias_local(p, ai->obj);
+    else
+      f->allocate_local(p)->initialize(std::move(ai->value));
+    ++ai;
+  }
+  m_args.resize(base);
+  return f;
+}
+
+void
+Evaluator::invoke(Fn_decl* fn, Frame* f)
+{
+  m_frame = f;
+  exec(fn->get_body());
+
+  // The callee of a tail call takes the place of the returning function,
+  // so the stack does not grow. No saved argument refers to the popped
+  // frame.
+  while (Fn_decl* callee = m_tail) {
+    m_tail = nullptr;
+    m_stack.pop();
+    m_frame = enter(callee);
+    exec(callee->get_body());
+  }
+}
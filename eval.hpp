@@ -0,0 +1,127 @@
+#pragma once
+
+#include "packed.hpp"
+#include "store.hpp"
+#include "frame.hpp"
+
+#include <vector>
+
+class Expr;
+class Call_expr;
+class Stmt;
+class Decl;
+class Fn_decl;
+class Prog_decl;
+
+
+/// Executes checked programs by walking their trees.
+///
+/// The program must have been laid out (see Builder::layout_program).
+/// Reference-typed expressions are evaluated to the object they
+/// designate, and all other expressions to a value. Statements return
+/// a control code instead of throwing, so break, continue, and return
+/// unwind through ordinary returns. Evaluation allocates only when a
+/// function is called.
+///
+/// A return statement whose value is a tail call (see get_tail_call)
+/// replaces the frame of the returning function with the callee's
+/// instead of nesting it, so tail recursion runs in constant space.
+///
+/// An exception raised during a call (e.g., division by zero) unwinds
+/// the frames of the call, so the evaluator can be used again.
+class Evaluator
+{
+public:
+  Evaluator(Prog_decl const* p, int statics);
+  /// Constructs an evaluator for `p`, which has `statics` static slots,
+  /// and initializes its global variables.
+
+  Value call(Fn_decl* fn, std::vector<Value> const& args);
+  /// Calls `fn` with `args`, which must be values of its parameter types,
+  /// and returns the result.
+
+  Packed_value eval(Expr const* e);
+  /// Returns the value of `e`, which must have object type.
+
+  Object* locate(Expr const* e);
+  /// Returns the object designated by `e`, which must have reference type.
+
+  Call_stack const& get_stack() const { return m_stack; }
+  /// Returns the stack of active frames.
+
+private:
+  /// The result of executing a statement.
+  enum Control
+  {
+    next_ctl,
+    break_ctl,
+    cont_ctl,
+    ret_ctl,
+  };
+
+  /// An argument of a tail call, saved while the frame is replaced.
+  struct Argument
+  {
+    Packed_value value;
+    /// The value of an object parameter.
+
+    Object* obj;
+    /// The object bound to a reference parameter.
+  };
+
+  struct Eval_value;
+  struct Eval_address;
+  struct Exec_stmt;
+  struct Call_guard;
+
+  Control exec(Stmt const* s);
+  /// Executes `s` in the current frame.
+
+  void bind(Monotonic_store& s, Decl* d, Expr const* e);
+  /// Allocates or binds `d` in `s` and initializes it with `e`. The
+  /// initializer is evaluated in the current frame.
+
+  Object* locate(Decl* d);
+  /// Returns the object for the variable `d` in the current frame.
+
+  void eval_call(Call_expr const* e);
+  /// Calls the function designated by `e`. The result is left in `m_ret`
+  /// or `m_ret_obj`.
+
+  void eval_tail_call(Call_expr const* e);
+  /// Evaluates the callee and arguments of the tail call `e` in the
+  /// current frame and saves them. The call is made by invoke once the
+  /// current function has returned.
+
+  Frame* enter(Fn_decl* fn);
+  /// Pushes a frame for `fn` and binds its parameters to the arguments
+  /// saved by eval_tail_call.
+
+  void invoke(Fn_decl* fn, Frame* f);
+  /// Executes the body of `fn` in the frame `f`, which must be on top of
+  /// the stack. Tail calls made by the body are made in place of `f`.
+  /// The frame is popped by the Call_guard of the call.
+
+  Monotonic_store m_statics;
+  /// The static store.
+
+  Call_stack m_stack;
+  /// The active frames.
+
+  Frame* m_frame;
+  /// The frame in which names are resolved.
+
+  Packed_value m_ret;
+  /// The value returned by the last return statement.
+
+  Object* m_ret_obj;
+  /// The object returned by the last return statement of a function
+  /// returning a reference.
+
+  Fn_decl* m_tail;
+  /// The function of the pending tail call, if any.
+
+  std::vector<Argument> m_args;
+  /// The saved arguments of pending tail calls. The arguments of a call
+  /// made while evaluating those of another are saved above them.
+};
@@ -1,32 +1,59 @@
 #include "expr.hpp"
+#include "visitor.hpp"
 
-char const* 
+char const*
 Expr::get_kind_name() const
 {
-  switch (m_kind) {
-  case bool_lit: return "bool_lit";
-  case int_lit: return "int_lit";
-  case float_lit: return "float_lit";
-  case id_expr: return "id_expr";
-  case add_expr: return "add_expr";
-  case sub_expr: return "sub_expr";
-  case mul_expr: return "mul_expr";
-  case div_expr: return "div_expr";
-  case rem_expr: return "rem_expr";
-  case neg_expr: return "neg_expr";
-  case rec_expr: return "rec_expr";
-  case eq_expr: return "eq_expr";
-  case ne_expr: return "ne_expr";
-  case lt_expr: return "lt_expr";
-  case gt_expr: return "gt_expr";
-  case le_expr: return "le_expr";
-  case ge_expr: return "ge_expr";
-  case cond_expr: return "cond_expr";
-  case and_expr: return "and_expr";
-  case or_expr: return "or_expr";
-  case not_expr: return "not_expr";
-  case assign_expr: return "assign_expr";
-  case call_expr: return "call_expr";
-  case value_conv: return "value_conv";
-  };
+  return get_kind_name(m_kind);
+}
+
+char const*
+Expr::get_kind_name(Kind k)
+{
+  switch (k) {
+#define def_expr(K, T) case K: return #K;
+#include "expr.def"
+  }
+  return "<unknown>";
+}
+
+
+namespace
+{
+
+/// Computes the result of is_pure.
+struct Is_pure : Const_expr_visitor<Is_pure, bool>
+{
+  bool visit_bool_lit(Bool_expr const* e) { return true; }
+  bool visit_int_lit(Int_expr const* e) { return true; }
+  bool visit_float_lit(Float_expr const* e) { return true; }
+  bool visit_id_expr(Id_expr const* e) { return true; }
+  bool visit_unary_expr(Unary_expr const* e) { return visit(e->get_child()); }
+  bool visit_binary_expr(Binary_expr const* e) { return visit(e->get_child(0)) && visit(e->get_child(1)); }
+  bool visit_neg_expr(Neg_expr const* e) { return visit_unary_expr(e); }
+  bool visit_rec_expr(Rec_expr const* e) { return visit_unary_expr(e); }
+  bool visit_not_expr(Not_expr const* e) { return visit_unary_expr(e); }
+  bool visit_add_expr(Add_expr const* e) { return visit_binary_expr(e); }
+  bool visit_sub_expr(Sub_expr const* e) { return visit_binary_expr(e); }
+  bool visit_mul_expr(Mul_expr const* e) { return visit_binary_expr(e); }
+  bool visit_div_expr(Div_expr const* e) { return visit_binary_expr(e); }
+  bool visit_rem_expr(Rem_expr const* e) { return visit_binary_expr(e); }
+  bool visit_eq_expr(Eq_expr const* e) { return visit_binary_expr(e); }
+  bool visit_ne_expr(Ne_expr const* e) { return visit_binary_expr(e); }
+  bool visit_lt_expr(Lt_expr const* e) { return visit_binary_expr(e); }
+  bool visit_gt_expr(Gt_expr const* e) { return visit_binary_expr(e); }
+  bool visit_le_expr(Le_expr const* e) { return visit_binary_expr(e); }
+  bool visit_ge_expr(Ge_expr const* e) { return visit_binary_expr(e); }
+  bool visit_and_expr(And_expr const* e) { return visit_binary_expr(e); }
+  bool visit_or_expr(Or_expr const* e) { return visit_binary_expr(e); }
+  bool visit_value_conv(Value_conv const* e) { return visit(e->get_source()); }
+  bool visit_expr(Expr const* e) { return false; }
+};
+
+} // namespace
+
+bool
+is_pure(Expr const* e)
+{
+  return Is_pure().visit(e);
 }
@@ -3,6 +3,7 @@
 #include "type.hpp"
 #include "decl.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -21,39 +22,29 @@ debug_value(Printer& p, Literal_expr const* e)
   p.get_stream() << "value=" << e->get_value() << ' ';
 }
 
+namespace
+{
+
+/// Prints the attributes of literals. Other expressions have none.
+struct Debug_attrs : Const_expr_visitor<Debug_attrs>
+{
+  Debug_attrs(Printer& p) : p(p) { }
+
+  void visit_bool_lit(Bool_expr const* e) { debug_value(p, e); }
+  void visit_int_lit(Int_expr const* e) { debug_value(p, e); }
+  void visit_float_lit(Float_expr const* e) { debug_value(p, e); }
+  void visit_expr(Expr const* e) { }
+
+  Printer& p;
+};
+
+} // namespace
+
 static void
 debug_attrs(Printer& p, Expr const* e)
 {
   Print_final_newline nl(p);
-
-  switch (e->get_kind()) {
-  case Expr::bool_lit:
-  case Expr::int_lit:
-  case Expr::float_lit:
-    return debug_value(p, static_cast<Literal_expr const*>(e));
-  case Expr::id_expr:
-  case Expr::add_expr:
-  case Expr::sub_expr:
-  case Expr::mul_expr:
-  case Expr::div_expr:
-  case Expr::rem_expr:
-  case Expr::neg_expr:
-  case Expr::rec_expr:
-  case Expr::eq_expr:
-  case Expr::ne_expr:
-  case Expr::lt_expr:
-  case Expr::gt_expr:
-  case Expr::le_expr:
-  case Expr::ge_expr:
-  case Expr::cond_expr:
-  case Expr::and_expr:
-  case Expr::or_expr:
-  case Expr::not_expr:
-  case Expr::assign_expr:
-  case Expr::call_expr:
-  case Expr::value_conv:
-    break;
-  }
+  Debug_attrs(p).visit(e);
 }
 
 static void
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tree.hpp"
+#include "stats.hpp"
 #include "value.hpp"
 
 class Printer;
@@ -13,30 +14,8 @@ class Expr
 public:
   enum Kind
   {
-    bool_lit,
-    int_lit,
-    float_lit,
-    id_expr,
-    add_expr,
-    sub_expr,
-    mul_expr,
-    div_expr,
-    rem_expr,
-    neg_expr,
-    rec_expr,
-    eq_expr,
-    ne_expr,
-    lt_expr,
-    gt_expr,
-    le_expr,
-    ge_expr,
-    cond_expr,
-    and_expr,
-    or_expr,
-    not_expr,
-    assign_expr,
-    call_expr,
-    value_conv,
+#define def_expr(K, T) K,
+#include "expr.def"
   };
 
 protected:
@@ -49,6 +28,9 @@ public:
   char const* get_kind_name() const;
   /// Returns a string representing the kind.
 
+  static char const* get_kind_name(Kind k);
+  /// Returns the spelling of the kind `k`.
+
   // Typing
   Type* get_type() const { return m_type; }
   /// Returns the type of the expression.
@@ -77,7 +59,9 @@ private:
 inline
 Expr::Expr(Kind k, Type* t)
   : m_kind(k), m_type(t)
-{ }
+{
+  note_node(expr_node, k);
+}
 
 
 
@@ -196,17 +180,23 @@ public:
 inline
 Kary_expr::Kary_expr(Kind k, Type* t, std::initializer_list<Expr*> list)
   : Expr(k, t), Dynamic_arity_node<Expr>(list)
-{ }
+{
+  note_operands(expr_node, k, get_arity());
+}
 
 inline
 Kary_expr::Kary_expr(Kind k, Type* t, std::vector<Expr*> const& vec)
   : Expr(k, t), Dynamic_arity_node<Expr>(vec)
-{ }
+{
+  note_operands(expr_node, k, get_arity());
+}
 
 inline
 Kary_expr::Kary_expr(Kind k, Type* t, std::vector<Expr*>&& vec)
   : Expr(k, t), Dynamic_arity_node<Expr>(std::move(vec))
-{ }
+{
+  note_operands(expr_node, k, get_arity());
+}
 
 
 // Literals
@@ -280,7 +270,7 @@ public:
 
 inline
 Float_expr::Float_expr(Type* t, Value const& val)
-  : Literal_expr(int_lit, t, val)
+  : Literal_expr(float_lit, t, val)
 { }
 
 
@@ -400,7 +390,7 @@ public:
 
 inline
 Rec_expr::Rec_expr(Type* t, Expr* e1)
-  : Unary_expr(neg_expr, t, e1)
+  : Unary_expr(rec_expr, t, e1)
 { }
 
 
@@ -633,8 +623,26 @@ Value_conv::Value_conv(Type* t, Expr* e1)
 { }
 
 
+/// Represents an ill-formed expression. The diagnostic for the error
+/// has already been issued.
+class Error_expr : public Nullary_expr
+{
+public:
+  Error_expr(Type* t);
+  /// Constructs the error expression with the error type `t`.
+};
+
+inline
+Error_expr::Error_expr(Type* t)
+  : Nullary_expr(error_expr, t)
+{ }
+
+
 // Operations
 
+bool is_pure(Expr const* e);
+/// Returns true if evaluating `e` cannot change the value of any object.
+
 void print_expr(Printer& p, Expr const* e);
 /// Print `d` using the given printer.
 
@@ -3,6 +3,7 @@
 #include "type.hpp"
 #include "decl.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -33,40 +34,32 @@ print_id(Printer& p, Id_expr const* e)
   p.get_stream() << e->get_declaration()->get_name()->get_string();
 }
 
+namespace
+{
+
+/// Prints literals and id-expressions.
+///
+/// \todo Print operators.
+struct Print_expr : Const_expr_visitor<Print_expr>
+{
+  Print_expr(Printer& p) : p(p) { }
+
+  void visit_bool_lit(Bool_expr const* e) { print_bool(p, e); }
+  void visit_int_lit(Int_expr const* e) { print_int(p, e); }
+  void visit_float_lit(Float_expr const* e) { print_float(p, e); }
+  void visit_id_expr(Id_expr const* e) { print_id(p, e); }
+  void visit_error_expr(Error_expr const* e) { p.get_stream() << "<error>"; }
+  void visit_expr(Expr const* e) { }
+
+  Printer& p;
+};
+
+} // namespace
+
 void
 print_expr(Printer& p, Expr const* e)
 {
-  switch (e->get_kind()) {
-  case Expr::bool_lit:
-    return print_bool(p, static_cast<Bool_expr const*>(e));
-  case Expr::int_lit:
-    return print_int(p, static_cast<Int_expr const*>(e));
-  case Expr::float_lit:
-    return print_float(p, static_cast<Float_expr const*>(e));
-  case Expr::id_expr:
-    return print_id(p, static_cast<Id_expr const*>(e));
-  case Expr::add_expr:
-  case Expr::sub_expr:
-  case Expr::mul_expr:
-  case Expr::div_expr:
-  case Expr::rem_expr:
-  case Expr::neg_expr:
-  case Expr::rec_expr:
-  case Expr::eq_expr:
-  case Expr::ne_expr:
-  case Expr::lt_expr:
-  case Expr::gt_expr:
-  case Expr::le_expr:
-  case Expr::ge_expr:
-  case Expr::cond_expr:
-  case Expr::and_expr:
-  case Expr::or_expr:
-  case Expr::not_expr:
-  case Expr::assign_expr:
-  case Expr::call_expr:
-  case Expr::value_conv:
-    break;
-  }
+  Print_expr(p).visit(e);
 }
 
 
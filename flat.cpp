@@ -0,0 +1,88 @@
+#include "flat.hpp"
+#include "type.hpp"
+
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+Flat_tree::Flat_tree()
+  : m_types(), m_type_ids(), m_nodes(), m_ops(), m_values(), m_decls()
+{ }
+
+std::uint32_t
+Flat_tree::add(Expr const* e)
+{
+  Flat_node node {};
+  node.kind = e->get_kind();
+  node.type = intern(e->get_type());
+
+  switch (e->get_kind()) {
+  case Expr::bool_lit:
+  case Expr::int_lit:
+  case Expr::float_lit:
+    node.data = m_values.size();
+    m_values.push_back(static_cast<Literal_expr const*>(e)->get_value());
+    break;
+
+  case Expr::id_expr:
+    node.data = m_decls.size();
+    m_decls.push_back(static_cast<Id_expr const*>(e)->get_declaration());
+    break;
+
+  default: {
+    // Reserve the operand indexes before flattening the operands, whose
+    // own operands are appended after them.
+    auto kids = e->get_children();
+    if (kids.size() > std::numeric_limits<std::uint16_t>::max())
+      throw std::runtime_error("too many operands");
+    node.arity = kids.size();
+    node.data = m_ops.size();
+    m_ops.resize(m_ops.size() + kids.size());
+    std::uint32_t i = node.data;
+    for (Expr const* c : kids) {
+      std::uint32_t n = add(c);
+      m_ops[i++] = n;
+    }
+    break;
+  }
+  }
+
+  m_nodes.push_back(node);
+  return m_nodes.size() - 1;
+}
+
+void
+Flat_tree::clear()
+{
+  m_nodes.clear();
+  m_ops.clear();
+  m_values.clear();
+  m_decls.clear();
+  m_types.clear();
+  m_type_ids.clear();
+}
+
+std::uint32_t
+Flat_tree::intern(Type* t)
+{
+  std::size_t n = t->get_id();
+  if (n >= m_type_ids.size())
+    m_type_ids.resize(n + 1);
+  if (std::uint32_t id = m_type_ids[n]) {
+    assert(m_types[id - 1] == t && "types from different tables");
+    return id - 1;
+  }
+  m_types.push_back(t);
+  m_type_ids[n] = m_types.size();
+  return m_types.size() - 1;
+}
+
+std::size_t
+Flat_tree::get_bytes() const
+{
+  return m_nodes.size() * sizeof(Flat_node) +
+         m_ops.size() * sizeof(std::uint32_t) +
+         m_values.size() * sizeof(Value) +
+         m_decls.size() * sizeof(Decl*) +
+         m_types.size() * sizeof(Type*);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "expr.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class Type;
+class Decl;
+
+
+/// A packed expression node. The first 8 bytes are a header holding the
+/// kind, the number of operands, and the id of the node's type in its
+/// tree. The remaining word is interpreted according to the kind:
+/// for literals, it is an index into the tree's values; for id-expressions,
+/// it is an index into the tree's declarations; otherwise, it is the
+/// index of the node's first operand in the tree's operand array.
+struct Flat_node
+{
+  std::uint8_t kind;
+  /// The kind of expression.
+
+  std::uint8_t flags;
+  /// Reserved.
+
+  std::uint16_t arity;
+  /// The number of operands.
+
+  std::uint32_t type;
+  /// The id of the type of the expression.
+
+  std::uint32_t data;
+  /// The literal, declaration, or operand index.
+};
+
+static_assert(sizeof(Flat_node) == 12, "unexpected flat node size");
+
+
+/// A flat tree stores expressions as an array of packed nodes linked by
+/// 32-bit indexes instead of pointers. Nodes are stored in postorder, so
+/// the operands of a node always precede it; a bottom-up pass over an
+/// expression is a forward sweep over the array.
+///
+/// Type ids index the distinct types of the tree's nodes, which are
+/// interned by their ids in the type table. The types of all nodes must
+/// come from the same table.
+class Flat_tree
+{
+public:
+  Flat_tree();
+  /// Constructs an empty tree.
+
+  std::uint32_t add(Expr const* e);
+  /// Appends `e` and all of its operands. Returns the index of `e`.
+
+  void clear();
+  /// Removes all nodes and the types they refer to. Storage is kept for
+  /// reuse.
+
+  // Nodes
+
+  std::size_t size() const { return m_nodes.size(); }
+  /// Returns the number of nodes in the tree.
+
+  Flat_node const& get_node(std::uint32_t n) const { return m_nodes[n]; }
+  /// Returns the nth node.
+
+  Expr::Kind get_kind(std::uint32_t n) const;
+  /// Returns the kind of the nth node.
+
+  Type* get_type(std::uint32_t n) const { return m_types[m_nodes[n].type]; }
+  /// Returns the type of the nth node.
+
+  std::uint32_t get_operand(std::uint32_t n, int i) const;
+  /// Returns the index of the ith operand of the nth node.
+
+  Value const& get_value(std::uint32_t n) const;
+  /// Returns the value of the nth node, which must be a literal.
+
+  Decl* get_declaration(std::uint32_t n) const;
+  /// Returns the declaration of the nth node, which must be an id-expression.
+
+  // Memory
+
+  std::size_t get_bytes() const;
+  /// Returns the number of bytes used to store the tree's nodes,
+  /// operands, values, declarations, and types.
+
+private:
+  std::uint32_t intern(Type* t);
+  /// Returns the id of `t` in the tree.
+
+  std::vector<Type*> m_types;
+  /// The types referred to by type ids.
+
+  std::vector<std::uint32_t> m_type_ids;
+  /// The id in the tree of each type, indexed by its id in the type
+  /// table. An entry is zero if the type has not been interned, and the
+  /// id plus one otherwise.
+
+  std::vector<Flat_node> m_nodes;
+  /// The nodes of the tree, in postorder.
+
+  std::vector<std::uint32_t> m_ops;
+  /// The operands of all non-leaf nodes.
+
+  std::vector<Value> m_values;
+  /// The values of literals.
+
+  std::vector<Decl*> m_decls;
+  /// The declarations named by id-expressions.
+};
+
+inline Expr::Kind
+Flat_tree::get_kind(std::uint32_t n) const
+{
+  return Expr::Kind(m_nodes[n].kind);
+}
+
+inline std::uint32_t
+Flat_tree::get_operand(std::uint32_t n, int i) const
+{
+  assert(0 <= i && i < m_nodes[n].arity);
+  return m_ops[m_nodes[n].data + i];
+}
+
+inline Value const&
+Flat_tree::get_value(std::uint32_t n) const
+{
+  assert(get_kind(n) == Expr::bool_lit ||
+         get_kind(n) == Expr::int_lit ||
+         get_kind(n) == Expr::float_lit);
+  return m_values[m_nodes[n].data];
+}
+
+inline Decl*
+Flat_tree::get_declaration(std::uint32_t n) const
+{
+  assert(get_kind(n) == Expr::id_expr);
+  return m_decls[m_nodes[n].data];
+}
@@ -1,6 +1,18 @@
 #include "frame.hpp"
+#include "decl.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
+#include <memory>
+#include <new>
+
+Frame::Frame(Frame* prev, Decl* d, Object* objs, Object** slots)
+  : m_prev(prev), m_fn(d), m_index(prev ? (prev->m_index + 1) : 0),
+    m_locals(static_cast<Fn_decl*>(d)->get_frame_size(), objs, slots)
+{
+  assert(d->is_function());
+}
 
 Object*
 Frame::allocate_local(Decl* d)
@@ -20,10 +32,56 @@ Frame::alias_local(Decl* d, Object* obj)
   m_locals.alias(d, obj);
 }
 
+/// The minimum size of a chunk of the call stack.
+static constexpr std::size_t min_chunk_size = 64 * 1024;
+
+/// Rounds `n` up to a multiple of the alignment of frames.
+static constexpr std::size_t
+align_frame(std::size_t n)
+{
+  constexpr std::size_t a = alignof(std::max_align_t);
+  return (n + a - 1) & ~(a - 1);
+}
+
+char*
+Call_stack::allocate(std::size_t n)
+{
+  if (std::size_t(m_end - m_ptr) < n) {
+    // Move to the next chunk that is large enough, dropping any that
+    // are too small to be useful.
+    std::size_t next = m_ptr ? m_chunk + 1 : 0;
+    while (next < m_chunks.size() && m_chunks[next].size < n)
+      m_chunks.erase(m_chunks.begin() + next);
+    if (next == m_chunks.size()) {
+      std::size_t size = std::max(n, min_chunk_size);
+      m_chunks.push_back(Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    }
+    m_chunk = next;
+    m_ptr = m_chunks[next].data.get();
+    m_end = m_ptr + m_chunks[next].size;
+  }
+  char* p = m_ptr;
+  m_ptr += n;
+  return p;
+}
+
 Frame*
 Call_stack::push(Decl* fn)
 {
-  m_top = new Frame(m_top, fn);
+  int n = static_cast<Fn_decl*>(fn)->get_frame_size();
+  std::size_t objs = align_frame(sizeof(Frame));
+  std::size_t slots = objs + align_frame(n * sizeof(Object));
+  std::size_t size = slots + align_frame(n * sizeof(Object*));
+
+  m_marks.push_back(Mark{m_chunk, m_ptr});
+  char* p = allocate(size);
+
+  Object* os = reinterpret_cast<Object*>(p + objs);
+  std::uninitialized_fill_n(os, n, Object());
+  Object** ss = reinterpret_cast<Object**>(p + slots);
+  std::uninitialized_fill_n(ss, n, nullptr);
+
+  m_top = new (p) Frame(m_top, fn, os, ss);
   m_frames.push_back(m_top);
   return m_top;
 }
@@ -31,7 +89,21 @@ Call_stack::push(Decl* fn)
 void
 Call_stack::pop()
 {
-  m_top = m_top->get_caller();
-  delete m_frames.back();
+  Frame* f = m_top;
+  m_top = f->get_caller();
+  int n = static_cast<Fn_decl*>(f->get_function())->get_frame_size();
+  f->~Frame();
+
+  // The objects of the frame may own storage (see Packed_value).
+  char* p = reinterpret_cast<char*>(f);
+  std::destroy_n(reinterpret_cast<Object*>(p + align_frame(sizeof(Frame))), n);
   m_frames.pop_back();
+
+  // Restore the top of the stack. The chunk that held the frame stays
+  // allocated for reuse.
+  Mark m = m_marks.back();
+  m_marks.pop_back();
+  m_chunk = m.chunk;
+  m_ptr = m.ptr;
+  m_end = m_ptr ? m_chunks[m_chunk].data.get() + m_chunks[m_chunk].size : nullptr;
 }
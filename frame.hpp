@@ -2,14 +2,19 @@
 
 #include "store.hpp"
 
+#include <memory>
+#include <vector>
+
 /// Represents a stack frame or activation record in the call stack. Each
 /// frame has a local store containing the local, automatic variables for
 /// its corresponding function definition.
 class Frame
 {
 public:
-  Frame(Frame* prev, Decl* fn);
-  /// Constructs the stack frame.
+  Frame(Frame* prev, Decl* fn, Object* objs, Object** slots);
+  /// Constructs the stack frame, with a slot for each variable in the
+  /// layout of `fn`. The storage for those slots is given by `objs` and
+  /// `slots` (see Monotonic_store).
 
   Frame* get_caller() const { return m_prev; }
   /// Returns the frame for the calling function or null if this is the
@@ -47,18 +52,21 @@ private:
   /// The automatic storage for the stack frame.
 };
 
-inline
-Frame::Frame(Frame* prev, Decl* d)
-  : m_prev(prev), m_fn(d), m_index(prev ? (prev->m_index + 1) : 0)
-{ }
 
 
-/// The call stack is a vector of frames. 
+/// The call stack allocates frames from a stack of memory chunks. Each
+/// frame is placed directly before the objects and slot pointers of its
+/// local store, so a call is a pointer bump and a return resets the
+/// pointer. Chunks are kept when the stack shrinks and reused by later
+/// calls.
 class Call_stack 
 {
 public:
   Call_stack();
 
+  Call_stack(Call_stack const&) = delete;
+  Call_stack& operator=(Call_stack const&) = delete;
+
   Frame* push(Decl* fn);
   /// Push a new frame for onto the call stack.
 
@@ -71,15 +79,51 @@ public:
   Frame* get_frame(int n) const { return m_frames[n]; }
   /// Returns the nth frame on the stack.
 
+  std::size_t size() const { return m_frames.size(); }
+  /// Returns the number of frames on the stack.
+
 private:
+  char* allocate(std::size_t n);
+  /// Returns `n` bytes from the top of the stack.
+
+  struct Chunk
+  {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+  };
+  /// A block of memory holding frames.
+
+  struct Mark
+  {
+    std::size_t chunk;
+    char* ptr;
+  };
+  /// The top of the stack before a frame was pushed.
+
   Frame* m_top;
   /// Points to the current frame.
 
   std::vector<Frame*> m_frames;
   /// Indexes into the call stack for efficient object location.
+
+  std::vector<Mark> m_marks;
+  /// The top of the stack before each frame was pushed.
+
+  std::vector<Chunk> m_chunks;
+  /// The chunks of the stack.
+
+  std::size_t m_chunk;
+  /// The index of the chunk containing the top of the stack.
+
+  char* m_ptr;
+  /// The first free byte in the current chunk.
+
+  char* m_end;
+  /// The end of the current chunk.
 };
 
 inline
 Call_stack::Call_stack()
-  : m_top(), m_frames()
-{ }
\ No newline at end of file
+  : m_top(), m_frames(), m_marks(), m_chunks(),
+    m_chunk(), m_ptr(), m_end()
+{ }
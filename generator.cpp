@@ -1,11 +1,23 @@
 #include "generator.hpp"
 #include "symbol.hpp"
 
-#include <iostream>
+#include <cstdint>
+#include <stdexcept>
+
+/// Returns the value of a decimal integer literal, wrapping on overflow
+/// as the generated arithmetic does.
+static Int_value
+parse_integer(std::string const& str)
+{
+  std::uint64_t n = 0;
+  for (char c : str)
+    n = n * 10 + (c - '0');
+  return Int_value(n);
+}
 
 Generator::Generator(Symbol_table& syms, 
                std::string const& input)
-  : m_lex(syms, input)
+  : m_lex(syms, input), m_code()
 {
   // Pull all of the tokens in one shot.
   while (Token tok = m_lex.get_next_token())
@@ -73,11 +85,11 @@ Generator::parse_additive_expression()
   while (true) {
     if (match(Token::plus)) {
       parse_multiplicative_expression();
-      std::cout << "add\n";
+      m_code.emit(add_sop);
     }
     else if (match(Token::minus)) {
       parse_multiplicative_expression();
-      std::cout << "sub\n";
+      m_code.emit(sub_sop);
     }
     else
       break;
@@ -137,19 +149,19 @@ Generator::parse_multiplicative_expression_rest()
 {
   if (match(Token::star)) {
     parse_prefix_expression();
-    std::cout << "mul\n";
+    m_code.emit(mul_sop);
     parse_multiplicative_expression_rest();
     return;
   }
   if (match(Token::slash)) {
     parse_prefix_expression();
-    std::cout << "div\n";
+    m_code.emit(div_sop);
     parse_multiplicative_expression_rest();
     return;
   }
   if (match(Token::percent)) {
     parse_prefix_expression();
-    std::cout << "rem\n";
+    m_code.emit(rem_sop);
     parse_multiplicative_expression_rest();
     return;
   }
@@ -162,15 +174,15 @@ void
 Generator::parse_prefix_expression()
 {
   if (match(Token::minus)) {
-    std::cout << "push 0\n"; // Emits 0 - n
+    m_code.emit_push(0); // Emits 0 - n
     parse_prefix_expression();
-    std::cout << "sub\n";
+    m_code.emit(sub_sop);
     return;
   }
   if (match(Token::slash)) {
-    std::cout << "push 1\n"; // Emits 1 / n
+    m_code.emit_push(1); // Emits 1 / n
     parse_prefix_expression();
-    std::cout << "div\n";
+    m_code.emit(div_sop);
     return;
   }
   parse_postfix_expression();
@@ -207,7 +219,7 @@ void
 Generator::parse_primary_expression()
 {
   if (Token tok = match(Token::integer_literal)) {
-    std::cout << "push " << tok.get_lexeme().str() << '\n';
+    m_code.emit_push(parse_integer(tok.get_lexeme().str()));
     return;
   }
 
@@ -2,6 +2,7 @@
 
 #include "token.hpp"
 #include "lexer.hpp"
+#include "stack_code.hpp"
 
 #include <cassert>
 #include <vector>
@@ -18,6 +19,8 @@ class Generator
 public:
   Generator(Symbol_table& syms, std::string const& input);
 
+  Stack_code const& get_code() const { return m_code; }
+  /// Returns the code generated for the parsed expression.
 
 private:
   // Helper functions
@@ -28,8 +31,8 @@ private:
   const Token& peek() const { return *m_lookahead; }
   /// Peeks at the lookahead token.
 
-  Token::Name lookahead() const { return peek().get_name(); }
-  /// Returns the name of the lookahead token.
+  Token::Name lookahead() const { return is_eof() ? Token::eof : peek().get_name(); }
+  /// Returns the name of the lookahead token, or eof at the end of input.
 
   bool next_token_is(Token::Name n) const { return lookahead() == n; }
   /// True if the lookahead is n.
@@ -106,6 +109,9 @@ private:
 
   Token* m_last;
   /// Points past the end of the token buffer.
+
+  Stack_code m_code;
+  /// The generated code.
 };
 
 
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+class Builder;
+class Prog_decl;
+
+
+/// The fixed header of a module image.
+///
+/// A module image is a compact binary encoding of a checked program. The
+/// header is followed by a table of string offsets, the (padded) string
+/// data, and a sequence of 32-bit words containing, in order, the type,
+/// declaration, expression, statement, and link sections. Every reference
+/// between nodes is an index into the section of the referenced node, so
+/// loading an image is a single forward pass that allocates each node and
+/// resolves indexes to pointers.
+///
+/// Nodes cannot be used in place from a mapped image. They are polymorphic
+/// objects that point to each other, to types interned in the reader's
+/// type table, and to separately allocated operand arrays. Loading
+/// therefore constructs every node. It is faster than building the program
+/// again only because it skips checking and takes nodes from an arena,
+/// and it takes time proportional to the size of the program.
+///
+/// Images are written in the byte order of the host and are not portable
+/// across architectures.
+struct Image_header
+{
+  char magic[4];
+  /// Always "BRSI".
+
+  std::uint32_t version;
+  /// The version of the encoding.
+
+  std::uint32_t num_strings;
+  /// The number of entries in the string table.
+
+  std::uint32_t string_bytes;
+  /// The size of the string data, including padding.
+
+  std::uint32_t num_types;
+  /// The number of type records.
+
+  std::uint32_t num_decls;
+  /// The number of declaration records.
+
+  std::uint32_t num_exprs;
+  /// The number of expression records.
+
+  std::uint32_t num_stmts;
+  /// The number of statement records.
+
+  std::uint32_t num_words;
+  /// The number of words in the node sections.
+
+  std::uint32_t root;
+  /// The index of the program declaration.
+};
+
+
+/// A read-only mapping of a module image file.
+class Image_file
+{
+public:
+  Image_file(std::string const& path);
+  /// Maps the image at `path` into memory.
+
+  Image_file(Image_file const&) = delete;
+  Image_file& operator=(Image_file const&) = delete;
+
+  ~Image_file();
+  /// Unmaps the image.
+
+  char const* data() const { return m_data; }
+  /// Returns the first byte of the image.
+
+  std::size_t size() const { return m_size; }
+  /// Returns the size of the image in bytes.
+
+private:
+  char const* m_data;
+  /// The mapped image.
+
+  std::size_t m_size;
+  /// The size of the mapping.
+};
+
+
+// Operations
+
+void write_image(std::ostream& os, Prog_decl const* prog);
+/// Write the image of `prog` to the output stream.
+
+void write_image(std::string const& path, Prog_decl const* prog);
+/// Write the image of `prog` to the file at `path`.
+
+Prog_decl* read_image(Builder& b, char const* data, std::size_t size);
+/// Reconstructs the program in the image `data`. Types are obtained from
+/// `b` so that they remain unique. Names are copied from the image's
+/// string table, so the image need not outlive the program. The image is
+/// read as 32-bit words in place, so `data` must be aligned to 4 bytes, as
+/// a mapping or any operator new allocation is. Throws
+/// std::runtime_error if the image is misaligned or malformed. The structure of the
+/// image is checked, but not that the program it holds is well typed.
+
+Prog_decl* read_image(Builder& b, Image_file const& file);
+/// Reconstructs the program in the mapped image `file`.
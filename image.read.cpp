@@ -0,0 +1,516 @@
+#include "image.hpp"
+#include "builder.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// The index used for absent nodes.
+static constexpr std::uint32_t null_index = ~std::uint32_t(0);
+
+Image_file::Image_file(std::string const& path)
+  : m_data(), m_size()
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("cannot open image");
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot stat image");
+  }
+  m_size = st.st_size;
+
+  void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+    throw std::runtime_error("cannot map image");
+  m_data = static_cast<char const*>(p);
+}
+
+Image_file::~Image_file()
+{
+  ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+namespace
+{
+
+/// Storage for the nodes read from an image. Nodes are allocated by
+/// bumping a pointer through large chunks, which is most of the gain of
+/// reading over building. Nodes are never destroyed, so, as for nodes
+/// allocated with new, the chunks are never freed.
+class Node_arena
+{
+public:
+  void* allocate(std::size_t n, std::size_t a);
+  /// Returns `n` bytes aligned to `a`.
+
+private:
+  static constexpr std::size_t chunk_size = 1 << 16;
+
+  char* m_next = nullptr;
+  char* m_last = nullptr;
+};
+
+void*
+Node_arena::allocate(std::size_t n, std::size_t a)
+{
+  std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(m_next) + a - 1) & ~(a - 1);
+  if (!m_next || p + n > reinterpret_cast<std::uintptr_t>(m_last)) {
+    std::size_t size = std::max(chunk_size, n);
+    m_next = static_cast<char*>(::operator new(size));
+    m_last = m_next + size;
+    p = reinterpret_cast<std::uintptr_t>(m_next);
+  }
+  m_next = reinterpret_cast<char*>(p + n);
+  return reinterpret_cast<void*>(p);
+}
+
+/// Reconstructs a program from its image. Each section is read in a
+/// single forward pass; the only fixups are the translation of indexes
+/// into the tables of previously constructed nodes.
+class Image_reader
+{
+public:
+  Image_reader(Builder& b, char const* data, std::size_t size);
+
+  Prog_decl* read();
+
+private:
+  std::uint32_t next();
+  std::uint32_t count();
+
+  template<typename T, typename... Args>
+  T* make(Args&&... args);
+
+  template<typename T>
+  T* get(std::vector<T*> const& table, std::uint32_t n);
+
+  template<typename T>
+  T* get_required(std::vector<T*> const& table, std::uint32_t n);
+
+  void read_strings();
+  Type* read_type();
+  Decl* read_decl();
+  Expr* read_expr();
+  Stmt* read_stmt();
+  void read_links(Decl* d);
+
+  Builder& m_build;
+  Node_arena m_arena;
+  Image_header m_hdr;
+  char const* m_data;
+  std::size_t m_size;
+
+  std::uint32_t const* m_first;
+  std::uint32_t const* m_last;
+
+  std::vector<Name*> m_names;
+  std::vector<Type*> m_types;
+  std::vector<Decl*> m_decls;
+  std::vector<Expr*> m_exprs;
+  std::vector<Stmt*> m_stmts;
+};
+
+Image_reader::Image_reader(Builder& b, char const* data, std::size_t size)
+  : m_build(b), m_data(data), m_size(size)
+{
+  // The tables and sections are read as words in place.
+  if (reinterpret_cast<std::uintptr_t>(data) % alignof(std::uint32_t) != 0)
+    throw std::runtime_error("misaligned image");
+  if (size < sizeof m_hdr)
+    throw std::runtime_error("truncated image");
+  std::memcpy(&m_hdr, data, sizeof m_hdr);
+  if (std::memcmp(m_hdr.magic, "BRSI", 4) != 0)
+    throw std::runtime_error("not an image");
+  if (m_hdr.version != 1)
+    throw std::runtime_error("unsupported image version");
+
+  std::size_t words = sizeof m_hdr +
+                      sizeof(std::uint32_t) * m_hdr.num_strings +
+                      m_hdr.string_bytes;
+  if (size < words + sizeof(std::uint32_t) * m_hdr.num_words)
+    throw std::runtime_error("truncated image");
+  m_first = reinterpret_cast<std::uint32_t const*>(data + words);
+  m_last = m_first + m_hdr.num_words;
+
+  // Every record takes at least one word, so no section can have more
+  // records than there are words. This bounds the tables reserved by
+  // read.
+  std::uint64_t records = std::uint64_t(m_hdr.num_types) + m_hdr.num_decls +
+                          m_hdr.num_exprs + m_hdr.num_stmts;
+  if (m_hdr.string_bytes % sizeof(std::uint32_t) != 0 || records > m_hdr.num_words)
+    throw std::runtime_error("invalid image header");
+}
+
+std::uint32_t
+Image_reader::next()
+{
+  if (m_first == m_last)
+    throw std::runtime_error("truncated image");
+  return *m_first++;
+}
+
+/// Returns the next word, which is the number of operands that follow.
+/// A count cannot exceed the number of remaining words, which keeps a
+/// corrupt count from sizing a huge table.
+std::uint32_t
+Image_reader::count()
+{
+  std::uint32_t n = next();
+  if (n > std::size_t(m_last - m_first))
+    throw std::runtime_error("truncated image");
+  return n;
+}
+
+/// Constructs a node in the arena.
+template<typename T, typename... Args>
+T*
+Image_reader::make(Args&&... args)
+{
+  return new (m_arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+T*
+Image_reader::get(std::vector<T*> const& table, std::uint32_t n)
+{
+  if (n == null_index)
+    return nullptr;
+  if (n >= table.size())
+    throw std::runtime_error("invalid image reference");
+  return table[n];
+}
+
+/// Returns the node at index `n` of `table`, which cannot be absent.
+template<typename T>
+T*
+Image_reader::get_required(std::vector<T*> const& table, std::uint32_t n)
+{
+  if (n == null_index)
+    throw std::runtime_error("invalid image reference");
+  return get(table, n);
+}
+
+void
+Image_reader::read_strings()
+{
+  auto offsets = reinterpret_cast<std::uint32_t const*>(m_data + sizeof m_hdr);
+  char const* strings = reinterpret_cast<char const*>(offsets + m_hdr.num_strings);
+  m_names.reserve(m_hdr.num_strings);
+  for (std::uint32_t i = 0; i < m_hdr.num_strings; ++i) {
+    // The string must be terminated within the string section.
+    if (offsets[i] >= m_hdr.string_bytes)
+      throw std::runtime_error("invalid image string");
+    char const* str = strings + offsets[i];
+    if (!std::memchr(str, '\0', m_hdr.string_bytes - offsets[i]))
+      throw std::runtime_error("invalid image string");
+    m_names.push_back(m_build.get_name(str));
+  }
+}
+
+Type*
+Image_reader::read_type()
+{
+  std::uint32_t k = next();
+  std::uint32_t n = count();
+  std::vector<Type*> kids(n);
+  for (Type*& t : kids)
+    t = get_required(m_types, next());
+
+  switch (k) {
+  case Type::bool_type:
+    return m_build.get_bool_type();
+  case Type::int_type:
+    return m_build.get_int_type();
+  case Type::float_type:
+    return m_build.get_float_type();
+  case Type::ref_type:
+    if (n != 1)
+      break;
+    return m_build.get_reference_type(kids[0]);
+  case Type::fn_type:
+    if (n == 0)
+      break;
+    return m_build.get_function_type(kids);
+  case Type::error_type:
+    return m_build.get_error_type();
+  }
+  throw std::runtime_error("invalid image type");
+}
+
+Decl*
+Image_reader::read_decl()
+{
+  std::uint32_t k = next();
+  Name* n = get(m_names, next());
+  std::uint32_t t = next();
+
+  switch (k) {
+  case Decl::var_decl:
+    return m_build.make_variable(n, get_required(m_types, t));
+  case Decl::fn_decl: {
+    Type* ft = get_required(m_types, t);
+    if (ft->get_kind() != Type::fn_type)
+      break;
+    return m_build.make_function(n, ft);
+  }
+  case Decl::prog_decl:
+    return make<Prog_decl>(std::vector<Decl*>());
+  }
+  throw std::runtime_error("invalid image declaration");
+}
+
+Expr*
+Image_reader::read_expr()
+{
+  std::uint32_t k = next();
+  Type* t = get_required(m_types, next());
+
+  switch (k) {
+  case Expr::bool_lit:
+  case Expr::int_lit:
+  case Expr::float_lit: {
+    std::uint32_t vk = next();
+    std::uint64_t bits = next();
+    bits |= std::uint64_t(next()) << 32;
+    Value val;
+    if (vk == Value::int_val) {
+      Int_value n;
+      std::memcpy(&n, &bits, sizeof n);
+      val = Value(n);
+    }
+    else if (vk == Value::float_val) {
+      Float_value n;
+      std::memcpy(&n, &bits, sizeof n);
+      val = Value(n);
+    }
+    if (k == Expr::bool_lit)
+      return make<Bool_expr>(t, val);
+    if (k == Expr::int_lit)
+      return make<Int_expr>(t, val);
+    return make<Float_expr>(t, val);
+  }
+
+  case Expr::id_expr: {
+    Decl* d = get_required(m_decls, next());
+    if (d->get_kind() == Decl::prog_decl)
+      throw std::runtime_error("invalid image expression");
+    return make<Id_expr>(t, d);
+  }
+
+  default:
+    break;
+  }
+
+  std::uint32_t n = count();
+  if (k == Expr::call_expr) {
+    if (n == 0)
+      throw std::runtime_error("invalid image expression");
+    std::vector<Expr*> es(n);
+    for (Expr*& e : es)
+      e = get_required(m_exprs, next());
+    return make<Call_expr>(t, std::move(es));
+  }
+
+  // Other expressions have at most three operands.
+  if (n > 3)
+    throw std::runtime_error("invalid image expression");
+  Expr* kids[3] = {};
+  for (std::uint32_t i = 0; i < n; ++i)
+    kids[i] = get_required(m_exprs, next());
+
+  // Make sure we have the right number of operands before building.
+  auto arity = [n](std::uint32_t m) {
+    if (n != m)
+      throw std::runtime_error("invalid image expression");
+  };
+
+  switch (k) {
+  case Expr::add_expr:
+    arity(2); return make<Add_expr>(t, kids[0], kids[1]);
+  case Expr::sub_expr:
+    arity(2); return make<Sub_expr>(t, kids[0], kids[1]);
+  case Expr::mul_expr:
+    arity(2); return make<Mul_expr>(t, kids[0], kids[1]);
+  case Expr::div_expr:
+    arity(2); return make<Div_expr>(t, kids[0], kids[1]);
+  case Expr::rem_expr:
+    arity(2); return make<Rem_expr>(t, kids[0], kids[1]);
+  case Expr::neg_expr:
+    arity(1); return make<Neg_expr>(t, kids[0]);
+  case Expr::rec_expr:
+    arity(1); return make<Rec_expr>(t, kids[0]);
+  case Expr::eq_expr:
+    arity(2); return make<Eq_expr>(t, kids[0], kids[1]);
+  case Expr::ne_expr:
+    arity(2); return make<Ne_expr>(t, kids[0], kids[1]);
+  case Expr::lt_expr:
+    arity(2); return make<Lt_expr>(t, kids[0], kids[1]);
+  case Expr::gt_expr:
+    arity(2); return make<Gt_expr>(t, kids[0], kids[1]);
+  case Expr::le_expr:
+    arity(2); return make<Le_expr>(t, kids[0], kids[1]);
+  case Expr::ge_expr:
+    arity(2); return make<Ge_expr>(t, kids[0], kids[1]);
+  case Expr::cond_expr:
+    arity(3); return make<Cond_expr>(t, kids[0], kids[1], kids[2]);
+  case Expr::and_expr:
+    arity(2); return make<And_expr>(t, kids[0], kids[1]);
+  case Expr::or_expr:
+    arity(2); return make<Or_expr>(t, kids[0], kids[1]);
+  case Expr::not_expr:
+    arity(1); return make<Not_expr>(t, kids[0]);
+  case Expr::assign_expr:
+    arity(2); return make<Assign_expr>(t, kids[0], kids[1]);
+  case Expr::value_conv:
+    arity(1); return make<Value_conv>(t, kids[0]);
+  case Expr::error_expr:
+    arity(0); return make<Error_expr>(t);
+  }
+  throw std::runtime_error("invalid image expression");
+}
+
+Stmt*
+Image_reader::read_stmt()
+{
+  switch (next()) {
+  case Stmt::skip_stmt:
+    return make<Skip_stmt>();
+  case Stmt::block_stmt: {
+    std::vector<Stmt*> ss(count());
+    for (Stmt*& s : ss)
+      s = get_required(m_stmts, next());
+    return make<Block_stmt>(std::move(ss));
+  }
+  case Stmt::if_stmt: {
+    Expr* e = get_required(m_exprs, next());
+    Stmt* s1 = get_required(m_stmts, next());
+    Stmt* s2 = get(m_stmts, next());
+    return make<If_stmt>(e, s1, s2);
+  }
+  case Stmt::while_stmt: {
+    Expr* e = get_required(m_exprs, next());
+    Stmt* s = get_required(m_stmts, next());
+    return make<While_stmt>(e, s);
+  }
+  case Stmt::break_stmt:
+    return make<Break_stmt>();
+  case Stmt::cont_stmt:
+    return make<Cont_stmt>();
+  case Stmt::ret_stmt:
+    return make<Ret_stmt>(get_required(m_exprs, next()));
+  case Stmt::expr_stmt:
+    return make<Expr_stmt>(get_required(m_exprs, next()));
+  case Stmt::decl_stmt: {
+    Decl* d = get_required(m_decls, next());
+    if (d->get_kind() == Decl::prog_decl)
+      break;
+    return make<Decl_stmt>(d);
+  }
+  }
+  throw std::runtime_error("invalid image statement");
+}
+
+void
+Image_reader::read_links(Decl* d)
+{
+  switch (d->get_kind()) {
+  case Decl::var_decl:
+    if (Expr* e = get(m_exprs, next()))
+      static_cast<Var_decl*>(d)->set_initializer(e);
+    break;
+
+  case Decl::fn_decl: {
+    // A function links to each of its parameters and to its return
+    // object, all of which are variables.
+    Fn_decl* fn = static_cast<Fn_decl*>(d);
+    std::uint32_t n = next();
+    if (n != fn->get_num_parameters() + 1)
+      throw std::runtime_error("invalid image function");
+    for (std::uint32_t i = 0; i < n; ++i) {
+      Decl* p = get_required(m_decls, next());
+      if (p->get_kind() != Decl::var_decl)
+        throw std::runtime_error("invalid image function");
+      if (i < fn->get_num_parameters())
+        fn->add_parameter(p);
+      else
+        fn->set_return(p);
+    }
+    if (Stmt* s = get(m_stmts, next()))
+      fn->set_body(s);
+    break;
+  }
+
+  case Decl::prog_decl: {
+    Prog_decl* prog = static_cast<Prog_decl*>(d);
+    std::uint32_t n = next();
+    for (std::uint32_t i = 0; i < n; ++i) {
+      Decl* c = get_required(m_decls, next());
+      if (c->get_kind() == Decl::prog_decl)
+        throw std::runtime_error("invalid image program");
+      prog->add_child(c);
+    }
+    break;
+  }
+  }
+}
+
+Prog_decl*
+Image_reader::read()
+{
+  read_strings();
+
+  m_types.reserve(m_hdr.num_types);
+  for (std::uint32_t i = 0; i < m_hdr.num_types; ++i)
+    m_types.push_back(read_type());
+
+  m_decls.reserve(m_hdr.num_decls);
+  for (std::uint32_t i = 0; i < m_hdr.num_decls; ++i)
+    m_decls.push_back(read_decl());
+
+  m_exprs.reserve(m_hdr.num_exprs);
+  for (std::uint32_t i = 0; i < m_hdr.num_exprs; ++i)
+    m_exprs.push_back(read_expr());
+
+  m_stmts.reserve(m_hdr.num_stmts);
+  for (std::uint32_t i = 0; i < m_hdr.num_stmts; ++i)
+    m_stmts.push_back(read_stmt());
+
+  for (Decl* d : m_decls)
+    read_links(d);
+
+  Decl* root = get(m_decls, m_hdr.root);
+  if (!root || root->get_kind() != Decl::prog_decl)
+    throw std::runtime_error("invalid image root");
+  return static_cast<Prog_decl*>(root);
+}
+
+} // namespace
+
+Prog_decl*
+read_image(Builder& b, char const* data, std::size_t size)
+{
+  Image_reader r(b, data, size);
+  return r.read();
+}
+
+Prog_decl*
+read_image(Builder& b, Image_file const& file)
+{
+  return read_image(b, file.data(), file.size());
+}
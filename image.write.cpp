@@ -0,0 +1,353 @@
+#include "image.hpp"
+#include "name.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "flat.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+/// The index used for absent nodes.
+static constexpr std::uint32_t null_index = ~std::uint32_t(0);
+
+namespace
+{
+
+/// Accumulates the sections of an image. Each node is assigned an index
+/// in its section the first time it is encountered. Types are emitted
+/// after their children and expressions and statements are emitted in
+/// postorder so that the reader never sees a forward reference within a
+/// section. Declarations are emitted as shells; their initializers,
+/// members, and bodies are recorded in the link section.
+///
+/// Each expression is first flattened, which puts its nodes in the order
+/// of their records, and then written by a forward sweep.
+class Image_writer
+{
+public:
+  void write_program(Prog_decl const* prog);
+  void write(std::ostream& os);
+
+private:
+  std::uint32_t write_string(Name const* n);
+  std::uint32_t write_type(Type const* t);
+  std::uint32_t write_decl(Decl const* d);
+  std::uint32_t write_expr(Expr const* e);
+  std::uint32_t write_stmt(Stmt const* s);
+  void write_value(Value const& val);
+  void write_links(Decl const* d);
+
+  std::vector<std::string> m_strings;
+  std::unordered_map<std::string, std::uint32_t> m_string_ids;
+
+  std::vector<std::uint32_t> m_types;
+  std::unordered_map<Type const*, std::uint32_t> m_type_ids;
+
+  std::vector<std::uint32_t> m_decls;
+  std::vector<Decl const*> m_decl_list;
+  std::unordered_map<Decl const*, std::uint32_t> m_decl_ids;
+
+  std::vector<std::uint32_t> m_exprs;
+  std::uint32_t m_num_exprs = 0;
+  Flat_tree m_flat;
+
+  std::vector<std::uint32_t> m_stmts;
+  std::uint32_t m_num_stmts = 0;
+
+  std::vector<std::uint32_t> m_links;
+
+  std::uint32_t m_root = null_index;
+};
+
+std::uint32_t
+Image_writer::write_string(Name const* n)
+{
+  if (!n)
+    return null_index;
+  std::string str = n->get_string();
+  auto iter = m_string_ids.find(str);
+  if (iter != m_string_ids.end())
+    return iter->second;
+  std::uint32_t id = m_strings.size();
+  m_strings.push_back(str);
+  m_string_ids.emplace(str, id);
+  return id;
+}
+
+/// Type records have the form `kind n t1 ... tn`.
+std::uint32_t
+Image_writer::write_type(Type const* t)
+{
+  if (!t)
+    return null_index;
+  auto iter = m_type_ids.find(t);
+  if (iter != m_type_ids.end())
+    return iter->second;
+
+  std::vector<std::uint32_t> kids;
+  for (Type const* c : t->get_children())
+    kids.push_back(write_type(c));
+
+  m_types.push_back(t->get_kind());
+  m_types.push_back(kids.size());
+  m_types.insert(m_types.end(), kids.begin(), kids.end());
+
+  std::uint32_t id = m_type_ids.size();
+  m_type_ids.emplace(t, id);
+  return id;
+}
+
+/// Declaration records have the form `kind name type`.
+std::uint32_t
+Image_writer::write_decl(Decl const* d)
+{
+  if (!d)
+    return null_index;
+  auto iter = m_decl_ids.find(d);
+  if (iter != m_decl_ids.end())
+    return iter->second;
+
+  m_decls.push_back(d->get_kind());
+  m_decls.push_back(write_string(d->get_name()));
+  m_decls.push_back(write_type(d->get_type()));
+
+  std::uint32_t id = m_decl_list.size();
+  m_decl_list.push_back(d);
+  m_decl_ids.emplace(d, id);
+  return id;
+}
+
+/// Values are written as `kind lo hi`.
+void
+Image_writer::write_value(Value const& val)
+{
+  std::uint64_t bits;
+  switch (val.get_kind()) {
+  case Value::non_val:
+    bits = 0;
+    break;
+  case Value::int_val: {
+    Int_value n = val.get_int();
+    std::memcpy(&bits, &n, sizeof bits);
+    break;
+  }
+  case Value::float_val: {
+    Float_value n = val.get_float();
+    std::memcpy(&bits, &n, sizeof bits);
+    break;
+  }
+  default:
+    throw std::logic_error("invalid literal value");
+  }
+  m_exprs.push_back(val.get_kind());
+  m_exprs.push_back(bits & 0xffffffff);
+  m_exprs.push_back(bits >> 32);
+}
+
+/// Literal records have the form `kind type value` and id-expressions
+/// have the form `kind type decl`. All other expressions have the form
+/// `kind type n e1 ... en`.
+std::uint32_t
+Image_writer::write_expr(Expr const* e)
+{
+  if (!e)
+    return null_index;
+
+  // The nodes of the flat tree are numbered from the first record
+  // written for the expression.
+  m_flat.clear();
+  std::uint32_t root = m_flat.add(e);
+  std::uint32_t base = m_num_exprs;
+  for (std::uint32_t n = 0; n < m_flat.size(); ++n) {
+    Flat_node const& node = m_flat.get_node(n);
+    switch (m_flat.get_kind(n)) {
+    case Expr::bool_lit:
+    case Expr::int_lit:
+    case Expr::float_lit:
+      m_exprs.push_back(node.kind);
+      m_exprs.push_back(write_type(m_flat.get_type(n)));
+      write_value(m_flat.get_value(n));
+      break;
+
+    case Expr::id_expr: {
+      std::uint32_t decl = write_decl(m_flat.get_declaration(n));
+      m_exprs.push_back(node.kind);
+      m_exprs.push_back(write_type(m_flat.get_type(n)));
+      m_exprs.push_back(decl);
+      break;
+    }
+
+    default:
+      m_exprs.push_back(node.kind);
+      m_exprs.push_back(write_type(m_flat.get_type(n)));
+      m_exprs.push_back(node.arity);
+      for (int i = 0; i < node.arity; ++i)
+        m_exprs.push_back(base + m_flat.get_operand(n, i));
+      break;
+    }
+  }
+  m_num_exprs += m_flat.size();
+  return base + root;
+}
+
+/// Statement records have the form `kind` followed by their operands.
+/// Block statements are written as `kind n s1 ... sn`.
+std::uint32_t
+Image_writer::write_stmt(Stmt const* s)
+{
+  if (!s)
+    return null_index;
+
+  std::vector<std::uint32_t> ops;
+  switch (s->get_kind()) {
+  case Stmt::skip_stmt:
+  case Stmt::break_stmt:
+  case Stmt::cont_stmt:
+    break;
+
+  case Stmt::block_stmt:
+    for (Stmt const* c : s->get_children())
+      ops.push_back(write_stmt(c));
+    ops.insert(ops.begin(), ops.size());
+    break;
+
+  case Stmt::if_stmt: {
+    If_stmt const* s1 = static_cast<If_stmt const*>(s);
+    ops.push_back(write_expr(s1->get_condition()));
+    ops.push_back(write_stmt(s1->get_true_statement()));
+    ops.push_back(write_stmt(s1->get_false_statement()));
+    break;
+  }
+
+  case Stmt::while_stmt: {
+    While_stmt const* s1 = static_cast<While_stmt const*>(s);
+    ops.push_back(write_expr(s1->get_condition()));
+    ops.push_back(write_stmt(s1->get_body()));
+    break;
+  }
+
+  case Stmt::ret_stmt:
+    ops.push_back(write_expr(static_cast<Ret_stmt const*>(s)->get_return_value()));
+    break;
+
+  case Stmt::expr_stmt:
+    ops.push_back(write_expr(static_cast<Expr_stmt const*>(s)->get_expression()));
+    break;
+
+  case Stmt::decl_stmt:
+    ops.push_back(write_decl(static_cast<Decl_stmt const*>(s)->get_declaration()));
+    break;
+  }
+
+  m_stmts.push_back(s->get_kind());
+  m_stmts.insert(m_stmts.end(), ops.begin(), ops.end());
+  return m_num_stmts++;
+}
+
+/// Variables link to their initializer. Functions link to their
+/// parameters, return object, and body as `n d1 ... dn body`. Programs
+/// link to their members as `n d1 ... dn`.
+void
+Image_writer::write_links(Decl const* d)
+{
+  std::vector<std::uint32_t> ops;
+  switch (d->get_kind()) {
+  case Decl::var_decl:
+    ops.push_back(write_expr(static_cast<Var_decl const*>(d)->get_initializer()));
+    break;
+
+  case Decl::fn_decl: {
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    for (Decl const* c : fn->get_children())
+      ops.push_back(write_decl(c));
+    ops.insert(ops.begin(), ops.size());
+    ops.push_back(write_stmt(fn->get_body()));
+    break;
+  }
+
+  case Decl::prog_decl:
+    for (Decl const* c : d->get_children())
+      ops.push_back(write_decl(c));
+    ops.insert(ops.begin(), ops.size());
+    break;
+  }
+  m_links.insert(m_links.end(), ops.begin(), ops.end());
+}
+
+void
+Image_writer::write_program(Prog_decl const* prog)
+{
+  m_root = write_decl(prog);
+
+  // Writing links can discover new declarations (e.g., locals), which
+  // are appended to the list and linked in turn.
+  for (std::size_t i = 0; i < m_decl_list.size(); ++i)
+    write_links(m_decl_list[i]);
+}
+
+template<typename T>
+static void
+write_words(std::ostream& os, std::vector<T> const& vec)
+{
+  os.write(reinterpret_cast<char const*>(vec.data()), vec.size() * sizeof(T));
+}
+
+void
+Image_writer::write(std::ostream& os)
+{
+  std::vector<std::uint32_t> offsets;
+  std::string data;
+  for (std::string const& str : m_strings) {
+    offsets.push_back(data.size());
+    data += str;
+    data += '\0';
+  }
+  data.resize((data.size() + 3) & ~std::size_t(3), '\0');
+
+  Image_header hdr {
+    {'B', 'R', 'S', 'I'},
+    1,
+    (std::uint32_t)m_strings.size(),
+    (std::uint32_t)data.size(),
+    (std::uint32_t)m_type_ids.size(),
+    (std::uint32_t)m_decl_list.size(),
+    m_num_exprs,
+    m_num_stmts,
+    (std::uint32_t)(m_types.size() + m_decls.size() + m_exprs.size() +
+                    m_stmts.size() + m_links.size()),
+    m_root,
+  };
+  os.write(reinterpret_cast<char const*>(&hdr), sizeof hdr);
+  write_words(os, offsets);
+  os.write(data.data(), data.size());
+  write_words(os, m_types);
+  write_words(os, m_decls);
+  write_words(os, m_exprs);
+  write_words(os, m_stmts);
+  write_words(os, m_links);
+}
+
+} // namespace
+
+void
+write_image(std::ostream& os, Prog_decl const* prog)
+{
+  Image_writer w;
+  w.write_program(prog);
+  w.write(os);
+}
+
+void
+write_image(std::string const& path, Prog_decl const* prog)
+{
+  std::ofstream os(path, std::ios::binary);
+  if (!os)
+    throw std::runtime_error("cannot open image for writing");
+  write_image(os, prog);
+}
@@ -0,0 +1,698 @@
+#include "inline.hpp"
+#include "builder.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "visitor.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+
+/// Calls `f` on each statement of `s`, in preorder.
+template<typename F>
+void
+for_each_stmt(Stmt* s, F const& f)
+{
+  f(s);
+  for (Stmt* sub : s->get_children()) {
+    if (sub)
+      for_each_stmt(sub, f);
+  }
+}
+
+/// Calls `f` on each node of `e`, in preorder.
+template<typename F>
+void
+for_each_expr(Expr* e, F const& f)
+{
+  f(e);
+  for (Expr* sub : e->get_children())
+    for_each_expr(sub, f);
+}
+
+/// Returns the expression that appears directly in `s`, or null if there
+/// is none.
+Expr*
+get_expression(Stmt* s)
+{
+  switch (s->get_kind()) {
+  case Stmt::if_stmt:
+    return static_cast<If_stmt*>(s)->get_condition();
+  case Stmt::while_stmt:
+    return static_cast<While_stmt*>(s)->get_condition();
+  case Stmt::ret_stmt:
+    return static_cast<Ret_stmt*>(s)->get_return_value();
+  case Stmt::expr_stmt:
+    return static_cast<Expr_stmt*>(s)->get_expression();
+  case Stmt::decl_stmt: {
+    Decl* d = static_cast<Decl_stmt*>(s)->get_declaration();
+    if (d->is_variable())
+      return static_cast<Var_decl*>(d)->get_initializer();
+    return nullptr;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+/// Returns the number of statements and expressions in `s`.
+std::size_t
+measure(Stmt* s)
+{
+  std::size_t n = 0;
+  for_each_stmt(s, [&n](Stmt* x) {
+    ++n;
+    if (Expr* e = get_expression(x))
+      for_each_expr(e, [&n](Expr*) { ++n; });
+  });
+  return n;
+}
+
+/// Returns the function called by `e` if it is named directly, or null.
+Fn_decl*
+get_callee(Call_expr const* e)
+{
+  Expr const* f = e->get_function();
+  if (f->get_kind() != Expr::id_expr)
+    return nullptr;
+  Decl* d = static_cast<Id_expr const*>(f)->get_declaration();
+  if (!d->is_function())
+    return nullptr;
+  return static_cast<Fn_decl*>(d);
+}
+
+/// Returns true if `e` is a literal.
+bool
+is_literal(Expr const* e)
+{
+  return e->get_kind() <= Expr::float_lit;
+}
+
+/// Returns true if evaluating `e` can trap. Only integer division does.
+bool
+can_trap(Expr* e)
+{
+  bool trap = false;
+  for_each_expr(e, [&trap](Expr* x) {
+    switch (x->get_kind()) {
+    case Expr::div_expr:
+    case Expr::rem_expr:
+    case Expr::rec_expr:
+      trap |= x->get_type()->is_int();
+      break;
+    default:
+      break;
+    }
+  });
+  return trap;
+}
+
+
+/// The parts of a function body that can be inlined.
+struct Inline_body
+{
+  std::vector<Stmt*> stmts;
+  /// The statements preceding the return.
+
+  Expr* result = nullptr;
+  /// The returned expression, or null if the body cannot be inlined.
+};
+
+/// Returns the parts of the body of `fn`. The body can be inlined if
+/// its last statement is its only return statement.
+Inline_body
+get_inline_body(Fn_decl const* fn)
+{
+  Inline_body body;
+  Stmt* s = fn->get_body();
+  if (s->get_kind() == Stmt::ret_stmt) {
+    body.result = static_cast<Ret_stmt*>(s)->get_return_value();
+    return body;
+  }
+  if (s->get_kind() != Stmt::block_stmt)
+    return body;
+  Node_range<Stmt> stmts = s->get_children();
+  if (stmts.empty() || stmts.back()->get_kind() != Stmt::ret_stmt)
+    return body;
+  for (Stmt* sub : stmts.rtail()) {
+    bool ret = false;
+    for_each_stmt(sub, [&ret](Stmt* x) { ret |= x->get_kind() == Stmt::ret_stmt; });
+    if (ret)
+      return body;
+    body.stmts.push_back(sub);
+  }
+  body.result = static_cast<Ret_stmt*>(stmts.back())->get_return_value();
+  return body;
+}
+
+
+/// Copies the statements and expressions of a callee into a caller.
+///
+/// Declarations in `decls` are replaced by their mapped declarations. A
+/// name of a declaration in `locs` is replaced by a copy of the mapped
+/// expression, and a read of a declaration in `vals` is replaced by a
+/// copy of the mapped value. Any other use of a declaration in `vals`
+/// makes the copy fail.
+struct Copier
+{
+  Expr* copy(Expr const* e);
+  Stmt* copy(Stmt const* s);
+
+  Expr* copy_id(Id_expr const* e);
+  Expr* copy_value(Value_conv const* e);
+  Stmt* copy_decl(Decl_stmt const* s);
+
+  std::unordered_map<Decl const*, Decl*> decls;
+  std::unordered_map<Decl const*, Expr*> locs;
+  std::unordered_map<Decl const*, Expr*> vals;
+  bool failed = false;
+};
+
+
+/// Copies expressions.
+struct Copy_expr : Const_expr_visitor<Copy_expr, Expr*>
+{
+  Copy_expr(Copier& c) : c(c) { }
+
+  Expr* visit_bool_lit(Bool_expr const* e) { return new Bool_expr(e->get_type(), e->get_value()); }
+  Expr* visit_int_lit(Int_expr const* e) { return new Int_expr(e->get_type(), e->get_value()); }
+  Expr* visit_float_lit(Float_expr const* e) { return new Float_expr(e->get_type(), e->get_value()); }
+  Expr* visit_id_expr(Id_expr const* e) { return c.copy_id(e); }
+  Expr* visit_add_expr(Add_expr const* e) { return binary(e); }
+  Expr* visit_sub_expr(Sub_expr const* e) { return binary(e); }
+  Expr* visit_mul_expr(Mul_expr const* e) { return binary(e); }
+  Expr* visit_div_expr(Div_expr const* e) { return binary(e); }
+  Expr* visit_rem_expr(Rem_expr const* e) { return binary(e); }
+  Expr* visit_neg_expr(Neg_expr const* e) { return unary(e); }
+  Expr* visit_rec_expr(Rec_expr const* e) { return unary(e); }
+  Expr* visit_eq_expr(Eq_expr const* e) { return binary(e); }
+  Expr* visit_ne_expr(Ne_expr const* e) { return binary(e); }
+  Expr* visit_lt_expr(Lt_expr const* e) { return binary(e); }
+  Expr* visit_gt_expr(Gt_expr const* e) { return binary(e); }
+  Expr* visit_le_expr(Le_expr const* e) { return binary(e); }
+  Expr* visit_ge_expr(Ge_expr const* e) { return binary(e); }
+  Expr* visit_cond_expr(Cond_expr const* e) { return copy_cond(e); }
+  Expr* visit_and_expr(And_expr const* e) { return binary(e); }
+  Expr* visit_or_expr(Or_expr const* e) { return binary(e); }
+  Expr* visit_not_expr(Not_expr const* e) { return unary(e); }
+  Expr* visit_assign_expr(Assign_expr const* e) { return binary(e); }
+  Expr* visit_call_expr(Call_expr const* e) { return copy_call(e); }
+  Expr* visit_value_conv(Value_conv const* e) { return c.copy_value(e); }
+  Expr* visit_error_expr(Error_expr const* e) { return new Error_expr(e->get_type()); }
+
+  template<typename T>
+  Expr* unary(T const* e)
+  {
+    return new T(e->get_type(), c.copy(e->get_child(0)));
+  }
+
+  template<typename T>
+  Expr* binary(T const* e)
+  {
+    Expr* e1 = c.copy(e->get_child(0));
+    Expr* e2 = c.copy(e->get_child(1));
+    return new T(e->get_type(), e1, e2);
+  }
+
+  Expr* copy_cond(Cond_expr const* e)
+  {
+    Expr* e1 = c.copy(e->get_condition());
+    Expr* e2 = c.copy(e->get_true_value());
+    Expr* e3 = c.copy(e->get_false_value());
+    return new Cond_expr(e->get_type(), e1, e2, e3);
+  }
+
+  Expr* copy_call(Call_expr const* e)
+  {
+    std::vector<Expr*> es;
+    for (Expr const* sub : e->get_children())
+      es.push_back(c.copy(sub));
+    return new Call_expr(e->get_type(), std::move(es));
+  }
+
+  Copier& c;
+};
+
+
+/// Copies statements.
+struct Copy_stmt : Const_stmt_visitor<Copy_stmt, Stmt*>
+{
+  Copy_stmt(Copier& c) : c(c) { }
+
+  Stmt* visit_skip_stmt(Skip_stmt const* s) { return new Skip_stmt(); }
+  Stmt* visit_block_stmt(Block_stmt const* s) { return copy_block(s); }
+  Stmt* visit_if_stmt(If_stmt const* s) { return copy_if(s); }
+  Stmt* visit_while_stmt(While_stmt const* s) { return copy_while(s); }
+  Stmt* visit_break_stmt(Break_stmt const* s) { return new Break_stmt(); }
+  Stmt* visit_cont_stmt(Cont_stmt const* s) { return new Cont_stmt(); }
+  Stmt* visit_ret_stmt(Ret_stmt const* s) { return new Ret_stmt(c.copy(s->get_return_value())); }
+  Stmt* visit_expr_stmt(Expr_stmt const* s) { return new Expr_stmt(c.copy(s->get_expression())); }
+  Stmt* visit_decl_stmt(Decl_stmt const* s) { return c.copy_decl(s); }
+
+  Stmt* copy_block(Block_stmt const* s)
+  {
+    std::vector<Stmt*> ss;
+    for (Stmt const* sub : s->get_children())
+      ss.push_back(c.copy(sub));
+    return new Block_stmt(std::move(ss));
+  }
+
+  Stmt* copy_if(If_stmt const* s)
+  {
+    Expr* e = c.copy(s->get_condition());
+    Stmt* s1 = c.copy(s->get_true_statement());
+    Stmt* s2 = s->get_false_statement() ? c.copy(s->get_false_statement()) : nullptr;
+    return new If_stmt(e, s1, s2);
+  }
+
+  Stmt* copy_while(While_stmt const* s)
+  {
+    Expr* e = c.copy(s->get_condition());
+    return new While_stmt(e, c.copy(s->get_body()));
+  }
+
+  Copier& c;
+};
+
+
+Expr*
+Copier::copy(Expr const* e)
+{
+  return Copy_expr(*this).visit(e);
+}
+
+Stmt*
+Copier::copy(Stmt const* s)
+{
+  return Copy_stmt(*this).visit(s);
+}
+
+Expr*
+Copier::copy_id(Id_expr const* e)
+{
+  Decl* d = e->get_declaration();
+  auto loc = locs.find(d);
+  if (loc != locs.end())
+    return copy(loc->second);
+  if (vals.count(d))
+    failed = true;
+  auto iter = decls.find(d);
+  if (iter != decls.end())
+    d = iter->second;
+  return new Id_expr(e->get_type(), d);
+}
+
+Expr*
+Copier::copy_value(Value_conv const* e)
+{
+  Expr const* src = e->get_source();
+  if (src->get_kind() == Expr::id_expr) {
+    auto val = vals.find(static_cast<Id_expr const*>(src)->get_declaration());
+    if (val != vals.end())
+      return copy(val->second);
+  }
+  return new Value_conv(e->get_type(), copy(src));
+}
+
+Stmt*
+Copier::copy_decl(Decl_stmt const* s)
+{
+  Decl* d = s->get_declaration();
+  if (!d->is_variable())
+    return new Decl_stmt(d);
+  Var_decl const* var = static_cast<Var_decl const*>(d);
+  Var_decl* v = new Var_decl(var->get_name(), var->get_type());
+  if (Expr const* init = var->get_initializer())
+    v->set_initializer(copy(init));
+  decls[var] = v;
+  return new Decl_stmt(v);
+}
+
+
+/// Inlines the calls of a program.
+class Inliner
+{
+public:
+  Inliner(Builder& b, Inline_options const& opts);
+
+  std::size_t run(Prog_decl* p);
+  /// Inlines calls in each function of `p`. Returns the number of calls
+  /// inlined.
+
+private:
+  void find_recursive();
+  /// Finds the functions that can call themselves directly or through
+  /// other named functions.
+
+  void order(Fn_decl* fn, std::unordered_set<Fn_decl*>& seen);
+  /// Appends `fn` to the processing order after its callees.
+
+  Inline_body const* get_body(Call_expr const* e);
+  /// Returns the body to substitute for `e`, or null if the callee
+  /// cannot be inlined into the current function.
+
+  Expr* substitute(Call_expr* e);
+  /// Returns the callee's returned expression with the arguments of `e`
+  /// substituted for its parameters, or null if that is not possible.
+
+  Expr* expand(Call_expr* e, std::vector<Stmt*>& out);
+  /// Appends the statements that bind the parameters and run the body of
+  /// the callee of `e` to `out`, and returns the expression computing the
+  /// result. Returns null if the callee cannot be inlined.
+
+  bool expand(Expr*& e, std::vector<Stmt*>& out);
+  /// Expands the call computing the value of `e`, if there is one.
+
+  Expr* expr(Expr* e);
+  /// Inlines calls in `e`, in place.
+
+  Stmt* stmt(Stmt* s);
+  /// Inlines calls in `s`. Returns `s` or its replacement.
+
+  void stmt(Stmt* s, std::vector<Stmt*>& out);
+  /// Inlines calls in `s`, appending its replacement to `out`.
+
+  Builder& m_b;
+  /// The builder that lays out the changed functions.
+
+  Inline_options m_opts;
+  /// The thresholds.
+
+  std::vector<Fn_decl*> m_fns;
+  /// The defined functions, callees first.
+
+  std::unordered_map<Fn_decl const*, std::unordered_set<Fn_decl*>> m_callees;
+  /// The functions named in the calls of each function.
+
+  std::unordered_set<Fn_decl const*> m_recursive;
+  /// The recursive functions.
+
+  std::unordered_map<Fn_decl const*, std::size_t> m_sizes;
+  /// The size of each function processed so far.
+
+  std::unordered_map<Fn_decl const*, Inline_body> m_bodies;
+  /// The inlinable parts of each function processed so far.
+
+  Fn_decl* m_caller;
+  /// The function whose calls are being inlined.
+
+  std::size_t m_size;
+  /// The size of the caller, including the bodies inlined so far.
+
+  std::size_t m_count;
+  /// The number of calls inlined.
+};
+
+Inliner::Inliner(Builder& b, Inline_options const& opts)
+  : m_b(b), m_opts(opts), m_fns(), m_callees(), m_recursive(), m_sizes(),
+    m_bodies(), m_caller(), m_size(), m_count()
+{ }
+
+std::size_t
+Inliner::run(Prog_decl* p)
+{
+  std::vector<Fn_decl*> fns;
+  for (Decl* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl* fn = static_cast<Fn_decl*>(d);
+    if (!fn->get_body())
+      continue;
+    fns.push_back(fn);
+    auto& callees = m_callees[fn];
+    for_each_stmt(fn->get_body(), [&callees](Stmt* s) {
+      if (Expr* e = get_expression(s)) {
+        for_each_expr(e, [&callees](Expr* x) {
+          if (x->get_kind() == Expr::call_expr) {
+            if (Fn_decl* g = get_callee(static_cast<Call_expr*>(x)))
+              callees.insert(g);
+          }
+        });
+      }
+    });
+  }
+  find_recursive();
+  std::unordered_set<Fn_decl*> seen;
+  for (Fn_decl* fn : fns)
+    order(fn, seen);
+
+  for (Fn_decl* fn : m_fns) {
+    m_caller = fn;
+    m_size = measure(fn->get_body());
+    std::size_t count = m_count;
+    Stmt* body = stmt(fn->get_body());
+    if (m_count != count) {
+      fn->replace_body(body);
+      m_b.layout_function(fn);
+      m_size = measure(body);
+    }
+    m_sizes[fn] = m_size;
+    m_bodies[fn] = get_inline_body(fn);
+  }
+  return m_count;
+}
+
+void
+Inliner::find_recursive()
+{
+  for (auto const& [fn, callees] : m_callees) {
+    std::unordered_set<Fn_decl const*> seen;
+    std::vector<Fn_decl const*> work(callees.begin(), callees.end());
+    while (!work.empty()) {
+      Fn_decl const* g = work.back();
+      work.pop_back();
+      if (g == fn) {
+        m_recursive.insert(fn);
+        break;
+      }
+      if (!seen.insert(g).second)
+        continue;
+      auto iter = m_callees.find(g);
+      if (iter != m_callees.end())
+        work.insert(work.end(), iter->second.begin(), iter->second.end());
+    }
+  }
+}
+
+void
+Inliner::order(Fn_decl* fn, std::unordered_set<Fn_decl*>& seen)
+{
+  if (!seen.insert(fn).second)
+    return;
+  auto iter = m_callees.find(fn);
+  if (iter == m_callees.end())
+    return;
+  for (Fn_decl* g : iter->second)
+    order(g, seen);
+  m_fns.push_back(fn);
+}
+
+Inline_body const*
+Inliner::get_body(Call_expr const* e)
+{
+  Fn_decl* g = get_callee(e);
+  if (!g || g == m_caller || m_recursive.count(g))
+    return nullptr;
+  auto size = m_sizes.find(g);
+  if (size == m_sizes.end())
+    return nullptr;
+  std::size_t limit = m_opts.max_size;
+  if (g->get_call_count() >= m_opts.hot_calls)
+    limit = m_opts.max_hot_size;
+  if (size->second > limit || m_size > m_opts.max_caller_size)
+    return nullptr;
+  Inline_body const& body = m_bodies[g];
+  if (!body.result)
+    return nullptr;
+  return &body;
+}
+
+Expr*
+Inliner::substitute(Call_expr* e)
+{
+  Inline_body const* body = get_body(e);
+  if (!body || !body->stmts.empty() || !is_pure(body->result))
+    return nullptr;
+
+  std::unordered_map<Decl const*, int> uses;
+  for_each_expr(body->result, [&uses](Expr* x) {
+    if (x->get_kind() == Expr::id_expr)
+      ++uses[static_cast<Id_expr*>(x)->get_declaration()];
+  });
+
+  // Bind names of variables as locations, and other values where they
+  // are read.
+  Copier c;
+  Fn_decl* g = get_callee(e);
+  Expr* const* ai = e->get_arguments().begin();
+  for (Decl* p : g->get_parameters()) {
+    Expr* a = *ai++;
+    if (p->is_reference()) {
+      if (a->get_kind() != Expr::id_expr)
+        return nullptr;
+      c.locs[p] = a;
+    }
+    else if (a->get_kind() == Expr::value_conv &&
+             static_cast<Value_conv*>(a)->get_source()->get_kind() == Expr::id_expr) {
+      c.locs[p] = static_cast<Value_conv*>(a)->get_source();
+    }
+    else if (is_literal(a) || (uses[p] <= 1 && is_pure(a) && !can_trap(a))) {
+      c.vals[p] = a;
+    }
+    else {
+      return nullptr;
+    }
+  }
+  Expr* r = c.copy(body->result);
+  if (c.failed)
+    return nullptr;
+  m_size += m_sizes[g];
+  ++m_count;
+  return r;
+}
+
+Expr*
+Inliner::expand(Call_expr* e, std::vector<Stmt*>& out)
+{
+  Inline_body const* body = get_body(e);
+  if (!body)
+    return nullptr;
+
+  // The arguments become the initializers of the parameters, so they
+  // are evaluated in order before the body.
+  Copier c;
+  Fn_decl* g = get_callee(e);
+  Expr* const* ai = e->get_arguments().begin();
+  for (Decl* p : g->get_parameters()) {
+    Var_decl* parm = static_cast<Var_decl*>(p);
+    Var_decl* var = new Var_decl(parm->get_name(), parm->get_type());
+    var->set_initializer(*ai++);
+    c.decls[parm] = var;
+    out.push_back(new Decl_stmt(var));
+  }
+  for (Stmt* s : body->stmts)
+    out.push_back(c.copy(s));
+  m_size += m_sizes[g];
+  ++m_count;
+  return c.copy(body->result);
+}
+
+bool
+Inliner::expand(Expr*& e, std::vector<Stmt*>& out)
+{
+  // The call may be converted to a value, as when a function returning
+  // a reference initializes an object.
+  Expr** call = &e;
+  if (e->get_kind() == Expr::value_conv)
+    call = e->get_children().begin();
+  if ((*call)->get_kind() != Expr::call_expr)
+    return false;
+  if (Expr* r = expand(static_cast<Call_expr*>(*call), out)) {
+    *call = r;
+    return true;
+  }
+  return false;
+}
+
+Expr*
+Inliner::expr(Expr* e)
+{
+  for (Expr*& sub : e->get_children())
+    sub = expr(sub);
+  if (e->get_kind() == Expr::call_expr) {
+    if (Expr* r = substitute(static_cast<Call_expr*>(e)))
+      return r;
+  }
+  return e;
+}
+
+Stmt*
+Inliner::stmt(Stmt* s)
+{
+  std::vector<Stmt*> ss;
+  stmt(s, ss);
+  if (ss.size() == 1)
+    return ss.front();
+  return new Block_stmt(std::move(ss));
+}
+
+void
+Inliner::stmt(Stmt* s, std::vector<Stmt*>& out)
+{
+  switch (s->get_kind()) {
+  case Stmt::block_stmt: {
+    // Statements of expanded calls are added to the block, so the scope
+    // of a variable initialized by a call is unchanged.
+    std::vector<Stmt*> ss;
+    for (Stmt* sub : s->get_children())
+      stmt(sub, ss);
+    out.push_back(new Block_stmt(std::move(ss)));
+    return;
+  }
+  case Stmt::if_stmt: {
+    If_stmt* s1 = static_cast<If_stmt*>(s);
+    Expr* e = expr(s1->get_condition());
+    Stmt* t = stmt(s1->get_true_statement());
+    Stmt* f = s1->get_false_statement() ? stmt(s1->get_false_statement()) : nullptr;
+    out.push_back(new If_stmt(e, t, f));
+    return;
+  }
+  case Stmt::while_stmt: {
+    While_stmt* s1 = static_cast<While_stmt*>(s);
+    Expr* e = expr(s1->get_condition());
+    out.push_back(new While_stmt(e, stmt(s1->get_body())));
+    return;
+  }
+  case Stmt::ret_stmt: {
+    Expr* e = expr(static_cast<Ret_stmt*>(s)->get_return_value());
+    expand(e, out);
+    out.push_back(new Ret_stmt(e));
+    return;
+  }
+  case Stmt::expr_stmt: {
+    // The target of an assignment is found before the value is computed,
+    // so only calls assigned to variables can be expanded.
+    Expr* e = expr(static_cast<Expr_stmt*>(s)->get_expression());
+    if (e->get_kind() == Expr::assign_expr) {
+      Node_range<Expr> ops = e->get_children();
+      if (ops.front()->get_kind() == Expr::id_expr)
+        expand(*(ops.begin() + 1), out);
+    }
+    else {
+      expand(e, out);
+    }
+    out.push_back(new Expr_stmt(e));
+    return;
+  }
+  case Stmt::decl_stmt: {
+    Decl* d = static_cast<Decl_stmt*>(s)->get_declaration();
+    if (d->is_variable()) {
+      Var_decl* var = static_cast<Var_decl*>(d);
+      if (Expr* init = var->get_initializer()) {
+        init = expr(init);
+        expand(init, out);
+        var->replace_initializer(init);
+      }
+    }
+    out.push_back(s);
+    return;
+  }
+  default:
+    out.push_back(s);
+    return;
+  }
+}
+
+} // namespace
+
+
+std::size_t
+inline_calls(Builder& b, Prog_decl* p, Inline_options const& opts)
+{
+  return Inliner(b, opts).run(p);
+}
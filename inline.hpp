@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+class Builder;
+class Prog_decl;
+
+
+/// The thresholds of the inliner. Sizes count the statement and
+/// expression nodes of a function body.
+struct Inline_options
+{
+  std::size_t max_size = 16;
+  /// The greatest size of a callee that is always inlined.
+
+  std::size_t max_hot_size = 64;
+  /// The greatest size of a callee that is inlined when it is hot.
+
+  unsigned hot_calls = 1000;
+  /// The number of calls counted by Fn_decl::count_call at which a
+  /// callee is hot.
+
+  std::size_t max_caller_size = 2000;
+  /// Calls are not inlined into functions that have grown beyond this
+  /// size.
+};
+
+
+std::size_t inline_calls(Builder& b, Prog_decl* p, Inline_options const& opts = {});
+/// Replaces direct calls to small functions in `p` with the bodies of
+/// those functions, and lays out the functions that changed. Returns the
+/// number of calls replaced. This must be done before the program is
+/// translated by a backend.
+///
+/// Functions are processed callees first, so a callee's own calls are
+/// inlined before its body is copied. Recursive functions, functions
+/// without definitions, and indirect calls are left alone. A callee can
+/// be inlined when it ends with its only return statement.
+///
+/// A call that is a statement's expression, initializer, return value,
+/// or the right operand of an assignment to a variable becomes a
+/// sequence of statements. Each parameter becomes a local variable that
+/// is copy initialized or, for reference parameters, bound to its
+/// argument, so arguments are evaluated once and in order. Other calls
+/// are replaced by the returned expression when the callee has no other
+/// statements and the substitution cannot change the result: the
+/// returned expression must be pure, reference arguments must name
+/// variables, and value arguments must be literals, variable reads, or
+/// pure expressions that cannot trap and are used at most once.
@@ -0,0 +1,962 @@
+#include "ir.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+#include "visitor.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <unordered_set>
+
+/// Returns the SSA type of values of type `t`.
+static Ir_type
+get_ir_type(Type const* t)
+{
+  switch (t->get_kind()) {
+  case Type::bool_type:
+    return bool_ty;
+  case Type::int_type:
+    return int_ty;
+  case Type::float_type:
+    return float_ty;
+  case Type::ref_type:
+    return ptr_ty;
+  case Type::fn_type:
+    return fn_ty;
+  default:
+    break;
+  }
+  throw std::logic_error("translating invalid type");
+}
+
+
+namespace
+{
+
+/// Finds the local variables whose addresses are taken.
+///
+/// An address is taken when a reference expression is bound to a
+/// reference, returned by reference, or selected by a conditional
+/// expression. The variables the expression may designate are those
+/// named by it, by the left operand of an assignment, or by either arm
+/// of a conditional.
+struct Find_addressed : Const_expr_visitor<Find_addressed>
+{
+  Find_addressed(std::unordered_set<Var_decl const*>& vars) : vars(vars) { }
+
+  void visit_bool_lit(Bool_expr const* e) { }
+  void visit_int_lit(Int_expr const* e) { }
+  void visit_float_lit(Float_expr const* e) { }
+  void visit_id_expr(Id_expr const* e) { }
+  void visit_unary_expr(Unary_expr const* e) { visit(e->get_child()); }
+  void visit_binary_expr(Binary_expr const* e) { visit(e->get_child(0)); visit(e->get_child(1)); }
+  void visit_add_expr(Add_expr const* e) { visit_binary_expr(e); }
+  void visit_sub_expr(Sub_expr const* e) { visit_binary_expr(e); }
+  void visit_mul_expr(Mul_expr const* e) { visit_binary_expr(e); }
+  void visit_div_expr(Div_expr const* e) { visit_binary_expr(e); }
+  void visit_rem_expr(Rem_expr const* e) { visit_binary_expr(e); }
+  void visit_neg_expr(Neg_expr const* e) { visit_unary_expr(e); }
+  void visit_rec_expr(Rec_expr const* e) { visit_unary_expr(e); }
+  void visit_eq_expr(Eq_expr const* e) { visit_binary_expr(e); }
+  void visit_ne_expr(Ne_expr const* e) { visit_binary_expr(e); }
+  void visit_lt_expr(Lt_expr const* e) { visit_binary_expr(e); }
+  void visit_gt_expr(Gt_expr const* e) { visit_binary_expr(e); }
+  void visit_le_expr(Le_expr const* e) { visit_binary_expr(e); }
+  void visit_ge_expr(Ge_expr const* e) { visit_binary_expr(e); }
+  void visit_and_expr(And_expr const* e) { visit_binary_expr(e); }
+  void visit_or_expr(Or_expr const* e) { visit_binary_expr(e); }
+  void visit_not_expr(Not_expr const* e) { visit_unary_expr(e); }
+  void visit_assign_expr(Assign_expr const* e) { visit_binary_expr(e); }
+  void visit_value_conv(Value_conv const* e) { visit(e->get_source()); }
+  void visit_error_expr(Error_expr const* e) { }
+  void visit_cond_expr(Cond_expr const* e) { find_cond(e); }
+  void visit_call_expr(Call_expr const* e) { find_call(e); }
+
+  void find_cond(Cond_expr const* e)
+  {
+    visit(e->get_condition());
+    visit(e->get_true_value());
+    visit(e->get_false_value());
+    if (e->get_type()->is_reference()) {
+      escape(e->get_true_value());
+      escape(e->get_false_value());
+    }
+  }
+
+  void find_call(Call_expr const* e)
+  {
+    visit(e->get_function());
+    for (Expr const* a : e->get_arguments()) {
+      visit(a);
+      if (a->get_type()->is_reference())
+        escape(a);
+    }
+  }
+
+  /// Marks the variables that `e` may designate.
+  void escape(Expr const* e)
+  {
+    switch (e->get_kind()) {
+    case Expr::id_expr: {
+      // References are held as addresses, and globals are in memory.
+      Decl const* d = static_cast<Id_expr const*>(e)->get_declaration();
+      if (!d->is_variable() || d->is_reference())
+        break;
+      Var_decl const* var = static_cast<Var_decl const*>(d);
+      if (!var->has_static_storage())
+        vars.insert(var);
+      break;
+    }
+    case Expr::assign_expr:
+      escape(static_cast<Assign_expr const*>(e)->get_child(0));
+      break;
+    case Expr::cond_expr:
+      escape(static_cast<Cond_expr const*>(e)->get_true_value());
+      escape(static_cast<Cond_expr const*>(e)->get_false_value());
+      break;
+    default:
+      break;
+    }
+  }
+
+  std::unordered_set<Var_decl const*>& vars;
+};
+
+
+/// Applies Find_addressed to the expressions of statements.
+struct Find_addressed_stmt : Const_stmt_visitor<Find_addressed_stmt>
+{
+  Find_addressed_stmt(std::unordered_set<Var_decl const*>& vars) : find(vars) { }
+
+  void visit_skip_stmt(Skip_stmt const* s) { }
+  void visit_block_stmt(Block_stmt const* s) { for (Stmt const* sub : *s) visit(sub); }
+  void visit_if_stmt(If_stmt const* s) { find_if(s); }
+  void visit_while_stmt(While_stmt const* s) { find.visit(s->get_condition()); visit(s->get_body()); }
+  void visit_break_stmt(Break_stmt const* s) { }
+  void visit_cont_stmt(Cont_stmt const* s) { }
+  void visit_ret_stmt(Ret_stmt const* s) { find_ret(s); }
+  void visit_expr_stmt(Expr_stmt const* s) { find.visit(s->get_expression()); }
+  void visit_decl_stmt(Decl_stmt const* s) { find_decl(s->get_declaration()); }
+
+  void find_if(If_stmt const* s)
+  {
+    find.visit(s->get_condition());
+    visit(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement())
+      visit(f);
+  }
+
+  void find_ret(Ret_stmt const* s)
+  {
+    Expr const* e = s->get_return_value();
+    find.visit(e);
+    if (e->get_type()->is_reference())
+      find.escape(e);
+  }
+
+  void find_decl(Decl const* d)
+  {
+    if (!d->is_variable())
+      return;
+    if (Expr const* e = static_cast<Var_decl const*>(d)->get_initializer()) {
+      find.visit(e);
+      if (d->is_reference())
+        find.escape(e);
+    }
+  }
+
+  Find_addressed find;
+};
+
+} // namespace
+
+
+/// Translates a function body to SSA form.
+///
+/// Blocks are sealed once all of their predecessors are known. Reading a
+/// variable in an unsealed block creates an incomplete phi that receives
+/// its operands when the block is sealed. Phis found to be trivial are
+/// replaced by their single operand.
+class Ir_builder
+{
+public:
+  Ir_builder(Ir_function& fn);
+
+  void build_function(Fn_decl const* fn);
+  /// Translates the body of `fn`.
+
+  void build_globals(Prog_decl const* p);
+  /// Translates the initializers of the global variables of `p`.
+
+private:
+  /// The location of an object. Either `var` is a variable held in SSA
+  /// values, or `ptr` is its address.
+  struct Loc
+  {
+    Var_decl const* var;
+    Ir_inst* ptr;
+  };
+
+  /// A loop being translated.
+  struct Loop
+  {
+    Ir_block* head;
+    /// The block evaluating the condition.
+
+    Ir_block* exit;
+    /// The block following the loop.
+  };
+
+  struct Build_value;
+  struct Build_location;
+  struct Build_stmt;
+
+  // Variables
+
+  void write(Var_decl const* var, Ir_block* b, Ir_inst* v);
+  /// Records `v` as the value of `var` at the end of `b`.
+
+  Ir_inst* read(Var_decl const* var, Ir_block* b);
+  /// Returns the value of `var` at the end of `b`.
+
+  Ir_inst* read_recursive(Var_decl const* var, Ir_block* b);
+  /// Returns the value of `var` on entry to `b`.
+
+  Ir_inst* add_phi_operands(Var_decl const* var, Ir_inst* phi);
+  /// Fills `phi` with the values of `var` in each predecessor.
+
+  Ir_inst* remove_trivial_phi(Ir_inst* phi);
+  /// Replaces `phi` if its operands are all the same value or the phi
+  /// itself. Returns the value that replaces it.
+
+  Ir_inst* resolve(Ir_inst* v);
+  /// Returns the value that replaced `v`, if any.
+
+  void seal(Ir_block* b);
+  /// Completes the phis of `b`, all of whose predecessors are known.
+
+  // Blocks
+
+  Ir_block* block();
+  /// Returns a new block.
+
+  void enter(Ir_block* b) { m_block = b; }
+  /// Makes `b` the current block.
+
+  void jump(Ir_block* target);
+  /// Ends the current block with a branch to `target`.
+
+  void branch(Ir_inst* c, Ir_block* t, Ir_block* f);
+  /// Ends the current block with a conditional branch.
+
+  void terminate(Ir_inst* t);
+  /// Ends the current block with `t`. Code that follows is unreachable
+  /// and goes in a new block.
+
+  // Instructions
+
+  Ir_inst* emit(Ir_inst* i) { m_block->append(i); return i; }
+  /// Appends `i` to the current block.
+
+  Ir_inst* emit(Ir_opcode op, Ir_type t, std::initializer_list<Ir_inst*> ops = {});
+  /// Appends a new instruction to the current block.
+
+  Ir_inst* undef(Ir_type t);
+  /// Returns an indeterminate value of type `t`.
+
+  Ir_inst* boolean(bool b);
+  /// Returns the constant `b`.
+
+  Ir_inst* value(Expr const* e);
+  /// Translates `e`, which has object type.
+
+  Loc location(Expr const* e);
+  /// Translates `e`, which has reference type.
+
+  Ir_inst* address(Loc loc);
+  /// Returns the address of the object at `loc`, which must be in memory.
+
+  Ir_inst* operand(Expr const* e);
+  /// Translates `e` as a value or an address, depending on its type.
+
+  Ir_inst* call(Call_expr const* e);
+  /// Translates the call `e`.
+
+  void bind(Var_decl const* var, Ir_inst* init);
+  /// Initializes the local variable `var` with `init`.
+
+  void statement(Stmt const* s);
+  /// Translates `s`.
+
+  void finish();
+  /// Removes unreachable blocks, the phis that only joined values from
+  /// them, and unused values created in the entry.
+
+  Ir_function& m_fn;
+  /// The function being built.
+
+  Ir_block* m_block;
+  /// The current block.
+
+  std::unordered_set<Var_decl const*> m_addressed;
+  /// The local variables that live in memory.
+
+  std::unordered_map<Var_decl const*, Ir_inst*> m_slots;
+  /// The frame slots of local variables in memory.
+
+  std::unordered_map<Ir_block*, std::unordered_map<Var_decl const*, Ir_inst*>> m_defs;
+  /// The value of each variable at the end of each block.
+
+  std::unordered_map<Ir_block*, std::vector<std::pair<Var_decl const*, Ir_inst*>>> m_incomplete;
+  /// The incomplete phis of unsealed blocks.
+
+  std::unordered_set<Ir_block*> m_sealed;
+  /// The sealed blocks.
+
+  std::unordered_map<Ir_inst*, Ir_inst*> m_replaced;
+  /// The values replacing removed phis.
+
+  std::vector<Loop> m_loops;
+  /// The enclosing loops.
+};
+
+
+/// Translates expressions with object type.
+struct Ir_builder::Build_value : Const_expr_visitor<Build_value, Ir_inst*>
+{
+  Build_value(Ir_builder& b) : b(b) { }
+
+  Ir_inst* visit_bool_lit(Bool_expr const* e) { return b.boolean(e->get_bool_value()); }
+  Ir_inst* visit_int_lit(Int_expr const* e) { return build_int(e); }
+  Ir_inst* visit_float_lit(Float_expr const* e) { return build_float(e); }
+  Ir_inst* visit_id_expr(Id_expr const* e) { return build_id(e); }
+  Ir_inst* visit_add_expr(Add_expr const* e) { return arithmetic(e, add_i_ir, add_f_ir); }
+  Ir_inst* visit_sub_expr(Sub_expr const* e) { return arithmetic(e, sub_i_ir, sub_f_ir); }
+  Ir_inst* visit_mul_expr(Mul_expr const* e) { return arithmetic(e, mul_i_ir, mul_f_ir); }
+  Ir_inst* visit_div_expr(Div_expr const* e) { return arithmetic(e, div_i_ir, div_f_ir); }
+  Ir_inst* visit_rem_expr(Rem_expr const* e) { return binary(e, rem_i_ir, int_ty); }
+  Ir_inst* visit_neg_expr(Neg_expr const* e) { return unary(e, is_float(e) ? neg_f_ir : neg_i_ir); }
+  Ir_inst* visit_rec_expr(Rec_expr const* e) { return unary(e, is_float(e) ? rec_f_ir : rec_i_ir); }
+  Ir_inst* visit_eq_expr(Eq_expr const* e) { return equality(e, eq_i_ir, eq_f_ir, eq_p_ir); }
+  Ir_inst* visit_ne_expr(Ne_expr const* e) { return equality(e, ne_i_ir, ne_f_ir, ne_p_ir); }
+  Ir_inst* visit_lt_expr(Lt_expr const* e) { return relational(e, lt_i_ir, lt_f_ir); }
+  Ir_inst* visit_gt_expr(Gt_expr const* e) { return relational(e, gt_i_ir, gt_f_ir); }
+  Ir_inst* visit_le_expr(Le_expr const* e) { return relational(e, le_i_ir, le_f_ir); }
+  Ir_inst* visit_ge_expr(Ge_expr const* e) { return relational(e, ge_i_ir, ge_f_ir); }
+  Ir_inst* visit_cond_expr(Cond_expr const* e) { return build_cond(e); }
+  Ir_inst* visit_and_expr(And_expr const* e) { return logical(e, false); }
+  Ir_inst* visit_or_expr(Or_expr const* e) { return logical(e, true); }
+  Ir_inst* visit_not_expr(Not_expr const* e) { return unary(e, not_b_ir); }
+  Ir_inst* visit_assign_expr(Assign_expr const* e) { throw std::logic_error("invalid value expression"); }
+  Ir_inst* visit_call_expr(Call_expr const* e) { return b.call(e); }
+  Ir_inst* visit_value_conv(Value_conv const* e) { return build_load(e); }
+  Ir_inst* visit_error_expr(Error_expr const* e) { throw std::logic_error("translating invalid expression"); }
+
+  static bool is_float(Expr const* e) { return e->get_type()->is_float(); }
+
+  Ir_inst* build_int(Int_expr const* e)
+  {
+    Ir_inst* i = b.emit(const_i_ir, int_ty);
+    i->set_int(e->get_int_value());
+    return i;
+  }
+
+  Ir_inst* build_float(Float_expr const* e)
+  {
+    Ir_inst* i = b.emit(const_f_ir, float_ty);
+    i->set_float(e->get_float_value());
+    return i;
+  }
+
+  Ir_inst* build_id(Id_expr const* e)
+  {
+    Decl const* d = e->get_declaration();
+    if (!d->is_function())
+      throw std::logic_error("invalid value expression");
+    Ir_inst* i = b.emit(const_fn_ir, fn_ty);
+    i->set_function(static_cast<Fn_decl const*>(d));
+    return i;
+  }
+
+  Ir_inst* unary(Unary_expr const* e, Ir_opcode op)
+  {
+    Ir_inst* x = b.value(e->get_child());
+    return b.emit(op, get_ir_type(e->get_type()), {x});
+  }
+
+  Ir_inst* binary(Binary_expr const* e, Ir_opcode op, Ir_type t)
+  {
+    Ir_inst* x = b.value(e->get_child(0));
+    Ir_inst* y = b.value(e->get_child(1));
+    return b.emit(op, t, {x, y});
+  }
+
+  Ir_inst* arithmetic(Binary_expr const* e, Ir_opcode i, Ir_opcode f)
+  {
+    return binary(e, is_float(e) ? f : i, is_float(e) ? float_ty : int_ty);
+  }
+
+  Ir_inst* equality(Binary_expr const* e, Ir_opcode i, Ir_opcode f, Ir_opcode p)
+  {
+    Type const* t = e->get_child(0)->get_type();
+    return binary(e, t->is_int() ? i : t->is_float() ? f : p, bool_ty);
+  }
+
+  Ir_inst* relational(Binary_expr const* e, Ir_opcode i, Ir_opcode f)
+  {
+    return binary(e, is_float(e->get_child(0)) ? f : i, bool_ty);
+  }
+
+  /// Joins the values `t` and `f` computed in the predecessors of the
+  /// current block, which are `tb` and `fb` in order.
+  Ir_inst* join(Ir_inst* t, Ir_inst* f)
+  {
+    Ir_inst* phi = b.m_fn.make(phi_ir, t->get_type(), {t, f});
+    b.m_block->insert(0, phi);
+    return phi;
+  }
+
+  Ir_inst* build_cond(Cond_expr const* e)
+  {
+    Ir_inst* c = b.value(e->get_condition());
+    Ir_block* tb = b.block();
+    Ir_block* fb = b.block();
+    Ir_block* done = b.block();
+    b.branch(c, tb, fb);
+    b.seal(tb);
+    b.seal(fb);
+    b.enter(tb);
+    Ir_inst* t = b.value(e->get_true_value());
+    b.jump(done);
+    b.enter(fb);
+    Ir_inst* f = b.value(e->get_false_value());
+    b.jump(done);
+    b.seal(done);
+    b.enter(done);
+    return join(t, f);
+  }
+
+  /// Translates a short-circuit operator, which produces `skip` if the
+  /// first operand is `skip`.
+  Ir_inst* logical(Binary_expr const* e, bool skip)
+  {
+    Ir_inst* x = b.value(e->get_child(0));
+    Ir_block* rhs = b.block();
+    Ir_block* done = b.block();
+    if (skip)
+      b.branch(x, done, rhs);
+    else
+      b.branch(x, rhs, done);
+    b.seal(rhs);
+    b.enter(rhs);
+    Ir_inst* y = b.value(e->get_child(1));
+    b.jump(done);
+    b.seal(done);
+    b.enter(done);
+    return join(b.boolean(skip), y);
+  }
+
+  Ir_inst* build_load(Value_conv const* e)
+  {
+    Loc loc = b.location(e->get_source());
+    if (loc.var)
+      return b.read(loc.var, b.m_block);
+    return b.emit(load_ir, get_ir_type(e->get_type()), {loc.ptr});
+  }
+
+  Ir_builder& b;
+};
+
+
+/// Translates expressions with reference type.
+struct Ir_builder::Build_location : Const_expr_visitor<Build_location, Ir_builder::Loc>
+{
+  Build_location(Ir_builder& b) : b(b) { }
+
+  Loc visit_id_expr(Id_expr const* e) { return build_id(e); }
+  Loc visit_cond_expr(Cond_expr const* e) { return build_cond(e); }
+  Loc visit_assign_expr(Assign_expr const* e) { return build_assign(e); }
+  Loc visit_call_expr(Call_expr const* e) { return Loc{nullptr, b.call(e)}; }
+  Loc visit_error_expr(Error_expr const* e) { throw std::logic_error("translating invalid expression"); }
+  Loc visit_expr(Expr const* e) { throw std::logic_error("invalid reference expression"); }
+
+  Loc build_id(Id_expr const* e)
+  {
+    Decl const* d = e->get_declaration();
+    assert(d->is_variable());
+    Var_decl const* var = static_cast<Var_decl const*>(d);
+    if (var->has_static_storage()) {
+      Ir_inst* g = b.emit(global_ir, ptr_ty);
+      g->set_variable(var);
+      if (var->is_reference())
+        return Loc{nullptr, b.emit(load_ir, ptr_ty, {g})};
+      return Loc{nullptr, g};
+    }
+    // A reference variable holds the address it is bound to.
+    if (var->is_reference())
+      return Loc{nullptr, b.read(var, b.m_block)};
+    auto iter = b.m_slots.find(var);
+    if (iter != b.m_slots.end())
+      return Loc{nullptr, iter->second};
+    return Loc{var, nullptr};
+  }
+
+  Loc build_cond(Cond_expr const* e)
+  {
+    Ir_inst* c = b.value(e->get_condition());
+    Ir_block* tb = b.block();
+    Ir_block* fb = b.block();
+    Ir_block* done = b.block();
+    b.branch(c, tb, fb);
+    b.seal(tb);
+    b.seal(fb);
+    b.enter(tb);
+    Ir_inst* t = b.address(b.location(e->get_true_value()));
+    b.jump(done);
+    b.enter(fb);
+    Ir_inst* f = b.address(b.location(e->get_false_value()));
+    b.jump(done);
+    b.seal(done);
+    b.enter(done);
+    Ir_inst* phi = b.m_fn.make(phi_ir, ptr_ty, {t, f});
+    done->insert(0, phi);
+    return Loc{nullptr, phi};
+  }
+
+  Loc build_assign(Assign_expr const* e)
+  {
+    Loc loc = b.location(e->get_child(0));
+    Ir_inst* v = b.value(e->get_child(1));
+    if (loc.var)
+      b.write(loc.var, b.m_block, v);
+    else
+      b.emit(store_ir, no_ty, {loc.ptr, v});
+    return loc;
+  }
+
+  Ir_builder& b;
+};
+
+
+/// Translates statements.
+struct Ir_builder::Build_stmt : Const_stmt_visitor<Build_stmt>
+{
+  Build_stmt(Ir_builder& b) : b(b) { }
+
+  void visit_skip_stmt(Skip_stmt const* s) { }
+  void visit_block_stmt(Block_stmt const* s) { for (Stmt const* sub : *s) b.statement(sub); }
+  void visit_if_stmt(If_stmt const* s) { build_if(s); }
+  void visit_while_stmt(While_stmt const* s) { build_while(s); }
+  void visit_break_stmt(Break_stmt const* s) { b.jump(b.m_loops.back().exit); }
+  void visit_cont_stmt(Cont_stmt const* s) { b.jump(b.m_loops.back().head); }
+  void visit_ret_stmt(Ret_stmt const* s) { b.terminate(b.m_fn.make(ret_ir, no_ty, {b.operand(s->get_return_value())})); }
+  void visit_expr_stmt(Expr_stmt const* s) { build_expr(s->get_expression()); }
+  void visit_decl_stmt(Decl_stmt const* s) { build_decl(s); }
+
+  void build_if(If_stmt const* s)
+  {
+    Ir_inst* c = b.value(s->get_condition());
+    Stmt const* f = s->get_false_statement();
+    Ir_block* tb = b.block();
+    Ir_block* fb = f ? b.block() : nullptr;
+    Ir_block* done = b.block();
+    b.branch(c, tb, f ? fb : done);
+    b.seal(tb);
+    b.enter(tb);
+    b.statement(s->get_true_statement());
+    b.jump(done);
+    if (f) {
+      b.seal(fb);
+      b.enter(fb);
+      b.statement(f);
+      b.jump(done);
+    }
+    b.seal(done);
+    b.enter(done);
+  }
+
+  void build_while(While_stmt const* s)
+  {
+    // The head is sealed once the body's back edges are known.
+    Ir_block* head = b.block();
+    Ir_block* body = b.block();
+    Ir_block* exit = b.block();
+    b.jump(head);
+    b.enter(head);
+    Ir_inst* c = b.value(s->get_condition());
+    b.branch(c, body, exit);
+    b.seal(body);
+    b.m_loops.push_back(Loop{head, exit});
+    b.enter(body);
+    b.statement(s->get_body());
+    b.jump(head);
+    b.m_loops.pop_back();
+    b.seal(head);
+    b.seal(exit);
+    b.enter(exit);
+  }
+
+  void build_expr(Expr const* e)
+  {
+    // The result is discarded, so the object need not be in memory.
+    if (e->get_type()->is_reference())
+      b.location(e);
+    else
+      b.value(e);
+  }
+
+  void build_decl(Decl_stmt const* s)
+  {
+    Decl const* d = s->get_declaration();
+    if (!d->is_variable())
+      return;
+    Var_decl const* var = static_cast<Var_decl const*>(d);
+    Ir_inst* init;
+    if (Expr const* e = var->get_initializer())
+      init = b.operand(e);
+    else
+      init = b.undef(get_ir_type(var->get_type()));
+    b.bind(var, init);
+  }
+
+  Ir_builder& b;
+};
+
+
+Ir_builder::Ir_builder(Ir_function& fn)
+  : m_fn(fn), m_block(), m_addressed(), m_slots(), m_defs(), m_incomplete(),
+    m_sealed(), m_replaced(), m_loops()
+{ }
+
+void
+Ir_builder::write(Var_decl const* var, Ir_block* b, Ir_inst* v)
+{
+  m_defs[b][var] = v;
+}
+
+Ir_inst*
+Ir_builder::read(Var_decl const* var, Ir_block* b)
+{
+  auto& defs = m_defs[b];
+  auto iter = defs.find(var);
+  if (iter != defs.end())
+    return iter->second = resolve(iter->second);
+  return read_recursive(var, b);
+}
+
+Ir_inst*
+Ir_builder::read_recursive(Var_decl const* var, Ir_block* b)
+{
+  Ir_inst* v;
+  Ir_type t = get_ir_type(var->get_type());
+  if (!m_sealed.count(b)) {
+    v = m_fn.make(phi_ir, t);
+    b->insert(0, v);
+    m_incomplete[b].emplace_back(var, v);
+  }
+  else if (b->get_predecessors().size() == 1) {
+    v = read(var, b->get_predecessors().front());
+  }
+  else if (b->get_predecessors().empty()) {
+    // Only unreachable blocks and the entry have no predecessors.
+    v = undef(t);
+  }
+  else {
+    // Break cycles by recording the phi before reading the operands.
+    v = m_fn.make(phi_ir, t);
+    b->insert(0, v);
+    write(var, b, v);
+    v = add_phi_operands(var, v);
+  }
+  write(var, b, v);
+  return v;
+}
+
+Ir_inst*
+Ir_builder::add_phi_operands(Var_decl const* var, Ir_inst* phi)
+{
+  for (Ir_block* p : phi->get_block()->get_predecessors())
+    phi->add_operand(read(var, p));
+  return remove_trivial_phi(phi);
+}
+
+Ir_inst*
+Ir_builder::remove_trivial_phi(Ir_inst* phi)
+{
+  Ir_inst* same = nullptr;
+  for (Ir_inst* op : phi->get_operands()) {
+    if (op == same || op == phi)
+      continue;
+    if (same)
+      return phi;
+    same = op;
+  }
+  if (!same)
+    same = undef(phi->get_type());
+
+  // Replacing the phi may make phis using it trivial. Phis still being
+  // filled are checked when they are complete.
+  std::vector<Ir_inst*> users;
+  for (Ir_inst* u : phi->get_users()) {
+    if (u == phi || !u->is_phi())
+      continue;
+    if (u->get_num_operands() == u->get_block()->get_predecessors().size())
+      users.push_back(u);
+  }
+  phi->replace_uses(same);
+  phi->drop_operands();
+  phi->get_block()->remove(phi);
+  m_replaced[phi] = same;
+  for (Ir_inst* u : users) {
+    if (u->get_block())
+      remove_trivial_phi(u);
+  }
+  return same;
+}
+
+Ir_inst*
+Ir_builder::resolve(Ir_inst* v)
+{
+  for (auto iter = m_replaced.find(v); iter != m_replaced.end(); iter = m_replaced.find(v))
+    v = iter->second;
+  return v;
+}
+
+void
+Ir_builder::seal(Ir_block* b)
+{
+  auto iter = m_incomplete.find(b);
+  if (iter != m_incomplete.end()) {
+    auto phis = std::move(iter->second);
+    m_incomplete.erase(iter);
+    for (auto [var, phi] : phis)
+      add_phi_operands(var, phi);
+  }
+  m_sealed.insert(b);
+}
+
+Ir_block*
+Ir_builder::block()
+{
+  return m_fn.make_block();
+}
+
+void
+Ir_builder::jump(Ir_block* target)
+{
+  Ir_inst* t = m_fn.make(br_ir, no_ty);
+  t->set_target(0, target);
+  target->add_predecessor(m_block);
+  terminate(t);
+}
+
+void
+Ir_builder::branch(Ir_inst* c, Ir_block* t, Ir_block* f)
+{
+  Ir_inst* i = m_fn.make(cbr_ir, no_ty, {c});
+  i->set_target(0, t);
+  i->set_target(1, f);
+  t->add_predecessor(m_block);
+  f->add_predecessor(m_block);
+  terminate(i);
+}
+
+void
+Ir_builder::terminate(Ir_inst* t)
+{
+  emit(t);
+  Ir_block* next = block();
+  seal(next);
+  enter(next);
+}
+
+Ir_inst*
+Ir_builder::emit(Ir_opcode op, Ir_type t, std::initializer_list<Ir_inst*> ops)
+{
+  return emit(m_fn.make(op, t, ops));
+}
+
+Ir_inst*
+Ir_builder::undef(Ir_type t)
+{
+  // Indeterminate values are created in the entry so that they dominate
+  // every use.
+  Ir_inst* u = m_fn.make(undef_ir, t);
+  m_fn.get_entry()->insert(0, u);
+  return u;
+}
+
+Ir_inst*
+Ir_builder::boolean(bool b)
+{
+  // Like undef, these may be phi operands of any predecessor.
+  Ir_inst* k = m_fn.make(const_b_ir, bool_ty);
+  k->set_int(b);
+  m_fn.get_entry()->insert(0, k);
+  return k;
+}
+
+Ir_inst*
+Ir_builder::value(Expr const* e)
+{
+  return Build_value(*this).visit(e);
+}
+
+Ir_builder::Loc
+Ir_builder::location(Expr const* e)
+{
+  return Build_location(*this).visit(e);
+}
+
+Ir_inst*
+Ir_builder::address(Loc loc)
+{
+  if (loc.var)
+    throw std::logic_error("address of a variable held in registers");
+  return loc.ptr;
+}
+
+Ir_inst*
+Ir_builder::operand(Expr const* e)
+{
+  if (e->get_type()->is_reference())
+    return address(location(e));
+  return value(e);
+}
+
+Ir_inst*
+Ir_builder::call(Call_expr const* e)
+{
+  // Resolve the callee before evaluating arguments, as the evaluator does.
+  Ir_type t = get_ir_type(e->get_type());
+  Expr const* f = e->get_function();
+  Decl const* d = nullptr;
+  if (f->get_kind() == Expr::id_expr)
+    d = static_cast<Id_expr const*>(f)->get_declaration();
+  Ir_inst* i;
+  if (d && d->is_function()) {
+    i = m_fn.make(call_ir, t);
+    i->set_function(static_cast<Fn_decl const*>(d));
+  }
+  else {
+    i = m_fn.make(calli_ir, t, {value(f)});
+  }
+  for (Expr const* a : e->get_arguments())
+    i->add_operand(operand(a));
+  return emit(i);
+}
+
+void
+Ir_builder::bind(Var_decl const* var, Ir_inst* init)
+{
+  if (m_addressed.count(var)) {
+    // Slots are allocated in the entry so that they dominate every use.
+    Ir_inst* s = m_fn.make(slot_ir, ptr_ty);
+    s->set_variable(var);
+    m_fn.get_entry()->insert(0, s);
+    m_slots[var] = s;
+    emit(store_ir, no_ty, {s, init});
+  }
+  else {
+    write(var, m_block, init);
+  }
+}
+
+void
+Ir_builder::statement(Stmt const* s)
+{
+  Build_stmt(*this).visit(s);
+}
+
+void
+Ir_builder::finish()
+{
+  m_fn.remove_unreachable();
+  std::vector<Ir_inst*> phis;
+  for (std::size_t n = 0; n < m_fn.get_num_blocks(); ++n) {
+    for (Ir_inst* i : *m_fn.get_block(n)) {
+      if (!i->is_phi())
+        break;
+      phis.push_back(i);
+    }
+  }
+  for (Ir_inst* phi : phis) {
+    if (phi->get_block())
+      remove_trivial_phi(phi);
+  }
+
+  std::vector<Ir_inst*> unused;
+  for (Ir_inst* i : *m_fn.get_entry()) {
+    if ((i->get_opcode() == undef_ir || i->is_constant()) && i->get_users().empty())
+      unused.push_back(i);
+  }
+  for (Ir_inst* i : unused)
+    m_fn.get_entry()->erase(i);
+}
+
+void
+Ir_builder::build_function(Fn_decl const* fn)
+{
+  Find_addressed_stmt find(m_addressed);
+  find.visit(fn->get_body());
+
+  Ir_block* entry = block();
+  seal(entry);
+  enter(entry);
+  int n = 0;
+  for (Decl const* d : fn->get_parameters()) {
+    Ir_inst* p = emit(param_ir, get_ir_type(d->get_type()));
+    p->set_int(n++);
+    bind(static_cast<Var_decl const*>(d), p);
+  }
+  statement(fn->get_body());
+
+  // Falling off the end returns an indeterminate value.
+  Ir_inst* r = undef(get_ir_type(fn->get_return()->get_type()));
+  emit(ret_ir, no_ty, {r});
+  finish();
+}
+
+void
+Ir_builder::build_globals(Prog_decl const* p)
+{
+  Ir_block* entry = block();
+  seal(entry);
+  enter(entry);
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_variable())
+      continue;
+    Var_decl const* var = static_cast<Var_decl const*>(d);
+    Ir_type t = get_ir_type(var->get_type());
+    Ir_inst* init;
+    if (Expr const* e = var->get_initializer())
+      init = operand(e);
+    else
+      init = undef(t);
+    Ir_inst* g = emit(global_ir, ptr_ty);
+    g->set_variable(var);
+    emit(store_ir, no_ty, {g, init});
+  }
+  Ir_inst* z = emit(const_i_ir, int_ty);
+  z->set_int(0);
+  emit(ret_ir, no_ty, {z});
+  finish();
+}
+
+
+Ir_program::Ir_program(Prog_decl const* p)
+  : m_prog(p), m_init(new Ir_function(nullptr)), m_fns(), m_index()
+{
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    if (!fn->get_body())
+      continue;
+    m_fns.emplace_back(new Ir_function(fn));
+    m_index.emplace(fn, m_fns.back().get());
+    Ir_builder(*m_fns.back()).build_function(fn);
+  }
+  Ir_builder(*m_init).build_globals(p);
+}
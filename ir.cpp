@@ -0,0 +1,421 @@
+#include "ir.hpp"
+#include "decl.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cassert>
+#include <iostream>
+
+char const*
+get_opcode_name(Ir_opcode op)
+{
+  switch (op) {
+#define def_inst(K) case K##_ir: return #K;
+#include "ir.def"
+  }
+  assert(false && "invalid opcode");
+  return nullptr;
+}
+
+char const*
+get_type_name(Ir_type t)
+{
+  switch (t) {
+  case no_ty: return "void";
+  case bool_ty: return "bool";
+  case int_ty: return "int";
+  case float_ty: return "float";
+  case fn_ty: return "fn";
+  case ptr_ty: return "ptr";
+  }
+  assert(false && "invalid type");
+  return nullptr;
+}
+
+
+// Instructions
+
+Ir_inst::Ir_inst(Ir_opcode op, Ir_type t)
+  : m_op(op), m_type(t), m_block(), m_id(-1), m_ops(), m_users(), m_imm(), m_targets()
+{ }
+
+bool
+Ir_inst::is_pure() const
+{
+  switch (m_op) {
+  case div_i_ir:
+  case rem_i_ir:
+  case rec_i_ir:
+  case store_ir:
+  case call_ir:
+  case calli_ir:
+  case br_ir:
+  case cbr_ir:
+  case ret_ir:
+    return false;
+  default:
+    return true;
+  }
+}
+
+void
+Ir_inst::add_operand(Ir_inst* v)
+{
+  m_ops.push_back(v);
+  v->m_users.push_back(this);
+}
+
+void
+Ir_inst::set_operand(std::size_t n, Ir_inst* v)
+{
+  m_ops[n]->remove_user(this);
+  m_ops[n] = v;
+  v->m_users.push_back(this);
+}
+
+void
+Ir_inst::remove_operand(std::size_t n)
+{
+  m_ops[n]->remove_user(this);
+  m_ops.erase(m_ops.begin() + n);
+}
+
+void
+Ir_inst::drop_operands()
+{
+  for (Ir_inst* v : m_ops)
+    v->remove_user(this);
+  m_ops.clear();
+}
+
+void
+Ir_inst::replace_uses(Ir_inst* v)
+{
+  assert(v != this);
+  // Each user appears once per use, and each replacement removes one.
+  while (!m_users.empty()) {
+    Ir_inst* u = m_users.back();
+    auto iter = std::find(u->m_ops.begin(), u->m_ops.end(), this);
+    assert(iter != u->m_ops.end());
+    u->set_operand(iter - u->m_ops.begin(), v);
+  }
+}
+
+void
+Ir_inst::remove_user(Ir_inst* u)
+{
+  auto iter = std::find(m_users.begin(), m_users.end(), u);
+  assert(iter != m_users.end());
+  m_users.erase(iter);
+}
+
+
+// Blocks
+
+Ir_block::Ir_block(Ir_function* fn, int id)
+  : m_fn(fn), m_id(id), m_insts(), m_preds()
+{ }
+
+Ir_inst*
+Ir_block::get_terminator() const
+{
+  if (m_insts.empty() || !m_insts.back()->is_terminator())
+    return nullptr;
+  return m_insts.back();
+}
+
+void
+Ir_block::append(Ir_inst* i)
+{
+  assert(!i->m_block);
+  i->m_block = this;
+  m_insts.push_back(i);
+}
+
+void
+Ir_block::insert(std::size_t pos, Ir_inst* i)
+{
+  assert(!i->m_block);
+  i->m_block = this;
+  m_insts.insert(m_insts.begin() + pos, i);
+}
+
+void
+Ir_block::remove(Ir_inst* i)
+{
+  assert(i->m_block == this);
+  m_insts.erase(std::find(m_insts.begin(), m_insts.end(), i));
+  i->m_block = nullptr;
+}
+
+void
+Ir_block::erase(Ir_inst* i)
+{
+  assert(i->get_users().empty());
+  remove(i);
+  i->drop_operands();
+}
+
+std::vector<Ir_block*>
+Ir_block::get_successors() const
+{
+  Ir_inst* t = get_terminator();
+  if (!t)
+    return {};
+  switch (t->get_opcode()) {
+  case br_ir:
+    return {t->get_target(0)};
+  case cbr_ir:
+    return {t->get_target(0), t->get_target(1)};
+  default:
+    return {};
+  }
+}
+
+void
+Ir_block::add_predecessor(Ir_block* b)
+{
+  m_preds.push_back(b);
+}
+
+void
+Ir_block::remove_predecessor(Ir_block* b)
+{
+  auto iter = std::find(m_preds.begin(), m_preds.end(), b);
+  assert(iter != m_preds.end());
+  std::size_t n = iter - m_preds.begin();
+  m_preds.erase(iter);
+  for (Ir_inst* i : m_insts) {
+    if (!i->is_phi())
+      break;
+    i->remove_operand(n);
+  }
+}
+
+
+// Functions
+
+Ir_function::Ir_function(Fn_decl const* fn)
+  : m_fn(fn), m_blocks(), m_insts()
+{ }
+
+Ir_block*
+Ir_function::make_block()
+{
+  m_blocks.emplace_back(new Ir_block(this, m_blocks.size()));
+  return m_blocks.back().get();
+}
+
+void
+Ir_function::remove_block(Ir_block* b)
+{
+  assert(b->get_predecessors().empty());
+  for (Ir_block* s : b->get_successors())
+    s->remove_predecessor(b);
+
+  // Values of the block can only be used within it, or by other blocks
+  // that are being removed, so uses are dropped first.
+  for (Ir_inst* i : b->get_instructions())
+    i->drop_operands();
+  while (!b->get_instructions().empty()) {
+    Ir_inst* i = b->get_instructions().back();
+    if (!i->get_users().empty())
+      i->replace_uses(make(undef_ir, i->get_type()));
+    b->remove(i);
+  }
+  auto iter = std::find_if(m_blocks.begin(), m_blocks.end(), [b](auto const& p) {
+    return p.get() == b;
+  });
+  m_blocks.erase(iter);
+}
+
+Ir_inst*
+Ir_function::make(Ir_opcode op, Ir_type t)
+{
+  m_insts.emplace_back(new Ir_inst(op, t));
+  return m_insts.back().get();
+}
+
+Ir_inst*
+Ir_function::make(Ir_opcode op, Ir_type t, std::initializer_list<Ir_inst*> ops)
+{
+  Ir_inst* i = make(op, t);
+  for (Ir_inst* v : ops)
+    i->add_operand(v);
+  return i;
+}
+
+void
+Ir_function::remove_unreachable()
+{
+  std::vector<bool> reached(m_blocks.size());
+  std::vector<Ir_block*> work{get_entry()};
+  renumber();
+  reached[get_entry()->get_id()] = true;
+  while (!work.empty()) {
+    Ir_block* b = work.back();
+    work.pop_back();
+    for (Ir_block* s : b->get_successors()) {
+      if (!reached[s->get_id()]) {
+        reached[s->get_id()] = true;
+        work.push_back(s);
+      }
+    }
+  }
+
+  // Unreachable blocks may be each other's predecessors, so detach them
+  // all before removing any.
+  std::vector<Ir_block*> dead;
+  for (auto const& b : m_blocks) {
+    if (!reached[b->get_id()])
+      dead.push_back(b.get());
+  }
+  for (Ir_block* b : dead) {
+    for (Ir_block* s : b->get_successors())
+      s->remove_predecessor(b);
+    if (Ir_inst* t = b->get_terminator())
+      b->erase(t);
+  }
+  for (Ir_block* b : dead) {
+    while (!b->get_predecessors().empty())
+      b->remove_predecessor(b->get_predecessors().back());
+    remove_block(b);
+  }
+  renumber();
+}
+
+void
+Ir_function::renumber()
+{
+  int n = 0;
+  for (std::size_t i = 0; i < m_blocks.size(); ++i) {
+    m_blocks[i]->set_id(i);
+    for (Ir_inst* inst : *m_blocks[i])
+      inst->m_id = inst->get_type() == no_ty ? -1 : n++;
+  }
+}
+
+std::size_t
+Ir_function::count_instructions() const
+{
+  std::size_t n = 0;
+  for (auto const& b : m_blocks)
+    n += b->size();
+  return n;
+}
+
+
+// Dominators
+
+Ir_dominators::Ir_dominators(Ir_function const& fn)
+  : m_order(), m_nodes()
+{
+  // Find the postorder with an explicit stack of successor positions.
+  Ir_block* entry = fn.get_entry();
+  std::unordered_map<Ir_block const*, bool> seen{{entry, true}};
+  std::vector<std::pair<Ir_block*, std::vector<Ir_block*>>> stack;
+  stack.emplace_back(entry, entry->get_successors());
+  while (!stack.empty()) {
+    auto& [b, succs] = stack.back();
+    if (!succs.empty()) {
+      Ir_block* s = succs.back();
+      succs.pop_back();
+      if (!seen[s]) {
+        seen[s] = true;
+        stack.emplace_back(s, s->get_successors());
+      }
+      continue;
+    }
+    m_order.push_back(b);
+    stack.pop_back();
+  }
+  std::reverse(m_order.begin(), m_order.end());
+  for (std::size_t n = 0; n < m_order.size(); ++n)
+    m_nodes[m_order[n]] = Node{n, nullptr, {}};
+
+  auto intersect = [this](Ir_block* a, Ir_block* b) {
+    while (a != b) {
+      while (m_nodes[a].rpo > m_nodes[b].rpo)
+        a = m_nodes[a].idom;
+      while (m_nodes[b].rpo > m_nodes[a].rpo)
+        b = m_nodes[b].idom;
+    }
+    return a;
+  };
+  m_nodes[entry].idom = entry;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (Ir_block* b : m_order) {
+      if (b == entry)
+        continue;
+      Ir_block* d = nullptr;
+      for (Ir_block* p : b->get_predecessors()) {
+        auto iter = m_nodes.find(p);
+        if (iter == m_nodes.end() || !iter->second.idom)
+          continue;
+        d = d ? intersect(d, p) : p;
+      }
+      if (m_nodes[b].idom != d) {
+        m_nodes[b].idom = d;
+        changed = true;
+      }
+    }
+  }
+
+  m_nodes[entry].idom = nullptr;
+  for (Ir_block* b : m_order) {
+    if (Ir_block* d = m_nodes[b].idom)
+      m_nodes[d].children.push_back(b);
+  }
+}
+
+Ir_block*
+Ir_dominators::get_idom(Ir_block const* b) const
+{
+  auto iter = m_nodes.find(b);
+  if (iter == m_nodes.end())
+    return nullptr;
+  return iter->second.idom;
+}
+
+std::vector<Ir_block*> const&
+Ir_dominators::get_children(Ir_block const* b) const
+{
+  static std::vector<Ir_block*> const none;
+  auto iter = m_nodes.find(b);
+  if (iter == m_nodes.end())
+    return none;
+  return iter->second.children;
+}
+
+bool
+Ir_dominators::dominates(Ir_block const* a, Ir_block const* b) const
+{
+  if (!is_reachable(a) || !is_reachable(b))
+    return false;
+  // Dominators precede the blocks they dominate in reverse postorder.
+  std::size_t n = m_nodes.find(a)->second.rpo;
+  while (b && b != a && m_nodes.find(b)->second.rpo > n)
+    b = get_idom(b);
+  return b == a;
+}
+
+
+// Programs
+
+bool
+Ir_program::verify(std::ostream& os) const
+{
+  bool ok = m_init->verify(os);
+  for (auto const& fn : m_fns)
+    ok = fn->verify(os) && ok;
+  return ok;
+}
+
+void
+Ir_program::dump(std::ostream& os)
+{
+  m_init->dump(os);
+  for (auto const& fn : m_fns)
+    fn->dump(os);
+}
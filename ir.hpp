@@ -0,0 +1,444 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+#include <initializer_list>
+#include <iosfwd>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Fn_decl;
+class Var_decl;
+class Prog_decl;
+class Ir_block;
+class Ir_function;
+
+
+/// The operations of the SSA form.
+enum Ir_opcode : std::uint8_t
+{
+#define def_inst(K) K##_ir,
+#include "ir.def"
+};
+
+char const* get_opcode_name(Ir_opcode op);
+/// Returns the mnemonic of `op`.
+
+
+/// The types of SSA values. Booleans, integers, and floats are the values
+/// of the corresponding object types. Functions are function values, and
+/// pointers are the addresses of objects, which are the values of
+/// references.
+enum Ir_type : std::uint8_t
+{
+  no_ty,
+  bool_ty,
+  int_ty,
+  float_ty,
+  fn_ty,
+  ptr_ty,
+};
+
+char const* get_type_name(Ir_type t);
+/// Returns the name of `t`.
+
+
+/// An instruction, which is also the value it computes.
+///
+/// Each instruction records its users, so uses can be replaced without
+/// searching the function. An instruction that uses a value more than
+/// once appears once for each use in that value's users.
+class Ir_inst
+{
+public:
+  Ir_inst(Ir_opcode op, Ir_type t);
+  /// Constructs an unattached instruction with no operands.
+
+  Ir_opcode get_opcode() const { return m_op; }
+  /// Returns the operation.
+
+  char const* get_opcode_name() const { return ::get_opcode_name(m_op); }
+  /// Returns the mnemonic of the operation.
+
+  Ir_type get_type() const { return m_type; }
+  /// Returns the type of the value, or no_ty if there is none.
+
+  Ir_block* get_block() const { return m_block; }
+  /// Returns the enclosing block, or null if the instruction is detached.
+
+  int get_id() const { return m_id; }
+  /// Returns the number assigned by Ir_function::renumber.
+
+  bool is_phi() const { return m_op == phi_ir; }
+  /// Returns true if this is a phi.
+
+  bool is_constant() const { return const_b_ir <= m_op && m_op <= const_fn_ir; }
+  /// Returns true if this is a constant.
+
+  bool is_terminator() const { return m_op >= br_ir; }
+  /// Returns true if this ends a block.
+
+  bool is_pure() const;
+  /// Returns true if the instruction has no effect other than computing
+  /// its value, so that it can be removed or moved when the value is not
+  /// needed. Division can trap, so it is not pure.
+
+  // Operands
+
+  std::size_t get_num_operands() const { return m_ops.size(); }
+  /// Returns the number of operands.
+
+  Ir_inst* get_operand(std::size_t n) const { return m_ops[n]; }
+  /// Returns the nth operand.
+
+  std::vector<Ir_inst*> const& get_operands() const { return m_ops; }
+  /// Returns the operands.
+
+  void add_operand(Ir_inst* v);
+  /// Appends the operand `v`.
+
+  void set_operand(std::size_t n, Ir_inst* v);
+  /// Replaces the nth operand with `v`.
+
+  void remove_operand(std::size_t n);
+  /// Removes the nth operand.
+
+  void drop_operands();
+  /// Removes all operands.
+
+  std::vector<Ir_inst*> const& get_users() const { return m_users; }
+  /// Returns the instructions using this value.
+
+  void replace_uses(Ir_inst* v);
+  /// Replaces every use of this value with `v`.
+
+  // Immediates
+
+  Int_value get_int() const { return m_imm.num; }
+  /// Returns the value of a const_b or const_i.
+
+  Float_value get_float() const { return m_imm.fp; }
+  /// Returns the value of a const_f.
+
+  Fn_decl const* get_function() const { return m_imm.fn; }
+  /// Returns the function of a const_fn or call.
+
+  Var_decl const* get_variable() const { return m_imm.var; }
+  /// Returns the variable of a slot or global.
+
+  int get_index() const { return m_imm.num; }
+  /// Returns the index of a param.
+
+  void set_int(Int_value n) { m_imm.num = n; }
+  void set_float(Float_value n) { m_imm.fp = n; }
+  void set_function(Fn_decl const* fn) { m_imm.fn = fn; }
+  void set_variable(Var_decl const* var) { m_imm.var = var; }
+  /// Sets the immediate.
+
+  // Targets
+
+  Ir_block* get_target(int n) const { return m_targets[n]; }
+  /// Returns the nth target of a branch.
+
+  void set_target(int n, Ir_block* b) { m_targets[n] = b; }
+  /// Sets the nth target of a branch. The predecessors of the target are
+  /// not updated.
+
+private:
+  friend class Ir_block;
+  friend class Ir_function;
+
+  void remove_user(Ir_inst* u);
+  /// Removes one occurrence of `u` from the users.
+
+  Ir_opcode m_op;
+  /// The operation.
+
+  Ir_type m_type;
+  /// The type of the value.
+
+  Ir_block* m_block;
+  /// The enclosing block.
+
+  int m_id;
+  /// The number of the value.
+
+  std::vector<Ir_inst*> m_ops;
+  /// The operands.
+
+  std::vector<Ir_inst*> m_users;
+  /// The users.
+
+  union Imm {
+    Int_value num;
+    Float_value fp;
+    Fn_decl const* fn;
+    Var_decl const* var;
+  };
+
+  Imm m_imm;
+  /// The immediate.
+
+  Ir_block* m_targets[2];
+  /// The targets of a branch.
+};
+
+
+/// A basic block.
+///
+/// Phis come first, and the last instruction is the only terminator. The
+/// operands of a phi correspond to the predecessors of its block, in
+/// order.
+class Ir_block
+{
+public:
+  Ir_block(Ir_function* fn, int id);
+  /// Constructs an empty block of `fn`.
+
+  Ir_function* get_function() const { return m_fn; }
+  /// Returns the enclosing function.
+
+  int get_id() const { return m_id; }
+  /// Returns the number of the block.
+
+  void set_id(int id) { m_id = id; }
+  /// Sets the number of the block.
+
+  // Instructions
+
+  std::vector<Ir_inst*> const& get_instructions() const { return m_insts; }
+  /// Returns the instructions.
+
+  std::vector<Ir_inst*>::const_iterator begin() const { return m_insts.begin(); }
+  std::vector<Ir_inst*>::const_iterator end() const { return m_insts.end(); }
+
+  std::size_t size() const { return m_insts.size(); }
+  /// Returns the number of instructions.
+
+  Ir_inst* get_terminator() const;
+  /// Returns the terminator, or null if the block is incomplete.
+
+  void append(Ir_inst* i);
+  /// Appends `i`, which must be detached.
+
+  void insert(std::size_t pos, Ir_inst* i);
+  /// Inserts `i`, which must be detached, before the instruction at `pos`.
+
+  void remove(Ir_inst* i);
+  /// Detaches `i` from the block. Its operands and users are unchanged.
+
+  void erase(Ir_inst* i);
+  /// Detaches `i`, which must have no users, and drops its operands.
+
+  // Control flow
+
+  std::vector<Ir_block*> const& get_predecessors() const { return m_preds; }
+  /// Returns the predecessors.
+
+  std::vector<Ir_block*> get_successors() const;
+  /// Returns the targets of the terminator.
+
+  void add_predecessor(Ir_block* b);
+  /// Appends `b` to the predecessors. Phis must be given an operand for
+  /// it.
+
+  void remove_predecessor(Ir_block* b);
+  /// Removes `b` from the predecessors, and the corresponding operand of
+  /// each phi.
+
+private:
+  Ir_function* m_fn;
+  /// The enclosing function.
+
+  int m_id;
+  /// The number of the block.
+
+  std::vector<Ir_inst*> m_insts;
+  /// The instructions.
+
+  std::vector<Ir_block*> m_preds;
+  /// The predecessors.
+};
+
+
+/// A function in SSA form.
+///
+/// The function owns its blocks and instructions. The first block is the
+/// entry. Instructions removed from blocks remain allocated until the
+/// function is destroyed.
+class Ir_function
+{
+public:
+  Ir_function(Fn_decl const* fn);
+  /// Constructs an empty function for `fn`, which is null for the
+  /// initializers of global variables.
+
+  Ir_function(Ir_function const&) = delete;
+  Ir_function& operator=(Ir_function const&) = delete;
+
+  Fn_decl const* get_decl() const { return m_fn; }
+  /// Returns the declaration.
+
+  Ir_block* get_entry() const { return m_blocks.front().get(); }
+  /// Returns the entry block.
+
+  std::size_t get_num_blocks() const { return m_blocks.size(); }
+  /// Returns the number of blocks.
+
+  Ir_block* get_block(std::size_t n) const { return m_blocks[n].get(); }
+  /// Returns the nth block.
+
+  Ir_block* make_block();
+  /// Appends a new empty block.
+
+  void remove_block(Ir_block* b);
+  /// Destroys `b`, which must have no predecessors. It is removed from
+  /// the predecessors of its successors, and its instructions are erased.
+
+  Ir_inst* make(Ir_opcode op, Ir_type t);
+  /// Creates a detached instruction.
+
+  Ir_inst* make(Ir_opcode op, Ir_type t, std::initializer_list<Ir_inst*> ops);
+  /// Creates a detached instruction with operands `ops`.
+
+  void remove_unreachable();
+  /// Removes the blocks that cannot be reached from the entry.
+
+  void renumber();
+  /// Numbers the blocks in order and the values in order of appearance.
+
+  std::size_t count_instructions() const;
+  /// Returns the number of instructions in all blocks.
+
+  bool verify(std::ostream& os) const;
+  /// Checks the structure of the function and writes a message to `os`
+  /// for each problem found. Returns true if there were none.
+
+  void dump(std::ostream& os);
+  /// Renumbers the function and writes a listing of it.
+
+private:
+  Fn_decl const* m_fn;
+  /// The declaration.
+
+  std::vector<std::unique_ptr<Ir_block>> m_blocks;
+  /// The blocks.
+
+  std::vector<std::unique_ptr<Ir_inst>> m_insts;
+  /// All instructions created.
+};
+
+
+/// The dominator tree of a function.
+///
+/// Dominators are computed with the iterative algorithm of Cooper,
+/// Harvey, and Kennedy over reverse postorder. Blocks that cannot be
+/// reached from the entry are not in the tree. The analysis must be
+/// recomputed when the control flow graph changes.
+class Ir_dominators
+{
+public:
+  Ir_dominators(Ir_function const& fn);
+  /// Computes the dominators of `fn`.
+
+  std::vector<Ir_block*> const& get_order() const { return m_order; }
+  /// Returns the reachable blocks in reverse postorder. This is also a
+  /// preorder of the dominator tree.
+
+  bool is_reachable(Ir_block const* b) const { return m_nodes.count(b); }
+  /// Returns true if `b` can be reached from the entry.
+
+  Ir_block* get_idom(Ir_block const* b) const;
+  /// Returns the immediate dominator of `b`, or null for the entry and
+  /// unreachable blocks.
+
+  std::vector<Ir_block*> const& get_children(Ir_block const* b) const;
+  /// Returns the blocks immediately dominated by `b`.
+
+  bool dominates(Ir_block const* a, Ir_block const* b) const;
+  /// Returns true if `a` dominates `b`. Every block dominates itself.
+
+private:
+  /// The dominator tree node of a block.
+  struct Node
+  {
+    std::size_t rpo;
+    /// The position in reverse postorder.
+
+    Ir_block* idom;
+    /// The immediate dominator.
+
+    std::vector<Ir_block*> children;
+    /// The immediately dominated blocks.
+  };
+
+  std::vector<Ir_block*> m_order;
+  /// The reachable blocks in reverse postorder.
+
+  std::unordered_map<Ir_block const*, Node> m_nodes;
+  /// The tree node of each reachable block.
+};
+
+
+/// A program in SSA form.
+///
+/// The program must have been checked. Each defined function is
+/// translated to an Ir_function, and the initializers of the global
+/// variables to a function without a declaration.
+///
+/// Construction follows Braun et al., "Simple and Efficient Construction
+/// of Static Single Assignment Form". Local variables whose address is
+/// never taken become SSA values, with phis inserted on demand as blocks
+/// are completed. The others, and all globals, are accessed through
+/// loads and stores.
+class Ir_program
+{
+public:
+  Ir_program(Prog_decl const* p);
+  /// Translates `p`.
+
+  Ir_program(Ir_program const&) = delete;
+  Ir_program& operator=(Ir_program const&) = delete;
+
+  Prog_decl const* get_decl() const { return m_prog; }
+  /// Returns the program.
+
+  Ir_function* get_init() const { return m_init.get(); }
+  /// Returns the initializers of global variables.
+
+  std::vector<std::unique_ptr<Ir_function>> const& get_functions() const { return m_fns; }
+  /// Returns the defined functions, in declaration order.
+
+  Ir_function* get_function(Fn_decl const* fn) const;
+  /// Returns the translation of `fn`, or null if `fn` has no definition.
+
+  bool verify(std::ostream& os) const;
+  /// Verifies every function.
+
+  void dump(std::ostream& os);
+  /// Writes a listing of every function.
+
+private:
+  Prog_decl const* m_prog;
+  /// The program.
+
+  std::unique_ptr<Ir_function> m_init;
+  /// The initializers of global variables.
+
+  std::vector<std::unique_ptr<Ir_function>> m_fns;
+  /// The defined functions.
+
+  std::unordered_map<Fn_decl const*, Ir_function*> m_index;
+  /// Maps declarations to their translations.
+};
+
+inline Ir_function*
+Ir_program::get_function(Fn_decl const* fn) const
+{
+  auto iter = m_index.find(fn);
+  if (iter == m_index.end())
+    return nullptr;
+  return iter->second;
+}
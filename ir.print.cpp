@@ -0,0 +1,88 @@
+#include "ir.hpp"
+#include "decl.hpp"
+#include "name.hpp"
+
+#include <iostream>
+
+/// Writes the operand `v`.
+static void
+print_value(std::ostream& os, Ir_inst const* v)
+{
+  os << '%' << v->get_id();
+}
+
+/// Writes the immediate of `i`, if it has one.
+static void
+print_immediate(std::ostream& os, Ir_inst const* i)
+{
+  switch (i->get_opcode()) {
+  case param_ir:
+    os << ' ' << i->get_index();
+    break;
+  case const_b_ir:
+    os << ' ' << (i->get_int() ? "true" : "false");
+    break;
+  case const_i_ir:
+    os << ' ' << i->get_int();
+    break;
+  case const_f_ir:
+    os << ' ' << i->get_float();
+    break;
+  case const_fn_ir:
+  case call_ir:
+    os << ' ' << *i->get_function()->get_name();
+    break;
+  case slot_ir:
+  case global_ir:
+    os << ' ' << *i->get_variable()->get_name();
+    break;
+  default:
+    break;
+  }
+}
+
+/// Writes `i` on a line.
+static void
+print_instruction(std::ostream& os, Ir_inst const* i)
+{
+  os << "  ";
+  if (i->get_type() != no_ty) {
+    print_value(os, i);
+    os << " = ";
+  }
+  os << i->get_opcode_name();
+  print_immediate(os, i);
+  for (std::size_t n = 0; n < i->get_num_operands(); ++n) {
+    os << (n ? ", " : " ");
+    print_value(os, i->get_operand(n));
+  }
+  if (i->is_terminator()) {
+    for (Ir_block const* s : i->get_block()->get_successors())
+      os << " b" << s->get_id();
+  }
+  if (i->get_type() != no_ty)
+    os << " : " << get_type_name(i->get_type());
+  os << '\n';
+}
+
+void
+Ir_function::dump(std::ostream& os)
+{
+  renumber();
+  if (m_fn)
+    os << "function " << *m_fn->get_name() << '\n';
+  else
+    os << "globals\n";
+  for (auto const& b : m_blocks) {
+    os << 'b' << b->get_id() << ':';
+    if (!b->get_predecessors().empty()) {
+      os << "  // preds:";
+      for (Ir_block const* p : b->get_predecessors())
+        os << " b" << p->get_id();
+    }
+    os << '\n';
+    for (Ir_inst const* i : *b)
+      print_instruction(os, i);
+  }
+  os << '\n';
+}
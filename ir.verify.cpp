@@ -0,0 +1,158 @@
+#include "ir.hpp"
+#include "decl.hpp"
+#include "name.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+
+/// Checks a function, reporting problems to a stream.
+struct Verifier
+{
+  Verifier(Ir_function const& fn, std::ostream& os) : fn(fn), os(os), ok(true) { }
+
+  /// Reports a problem with `i` in `b`.
+  std::ostream& error(Ir_block const* b, Ir_inst const* i = nullptr)
+  {
+    ok = false;
+    os << "error: ";
+    if (Fn_decl const* d = fn.get_decl())
+      os << "function " << *d->get_name() << ", ";
+    os << "b" << b->get_id();
+    if (i)
+      os << ", " << i->get_opcode_name();
+    return os << ": ";
+  }
+
+  /// Returns the index of `b`, or -1 if it is not a block of the function.
+  int index(Ir_block const* b) const
+  {
+    auto iter = blocks.find(b);
+    return iter == blocks.end() ? -1 : iter->second;
+  }
+
+  void check_structure(Ir_block const* b)
+  {
+    if (!b->get_terminator())
+      error(b) << "missing terminator\n";
+    bool phis = true;
+    for (std::size_t n = 0; n < b->size(); ++n) {
+      Ir_inst const* i = b->get_instructions()[n];
+      if (i->get_block() != b)
+        error(b, i) << "wrong enclosing block\n";
+      if (i->is_terminator() && n + 1 != b->size())
+        error(b, i) << "terminator before the end of the block\n";
+      if (i->is_phi()) {
+        if (!phis)
+          error(b, i) << "phi after other instructions\n";
+        if (i->get_num_operands() != b->get_predecessors().size())
+          error(b, i) << "phi operands do not match predecessors\n";
+      }
+      else {
+        phis = false;
+      }
+      for (Ir_inst const* v : i->get_operands()) {
+        if (!v->get_block() || index(v->get_block()) < 0)
+          error(b, i) << "operand " << v->get_opcode_name() << " is not in the function\n";
+        else if (std::count(v->get_users().begin(), v->get_users().end(), i) !=
+                 std::count(i->get_operands().begin(), i->get_operands().end(), v))
+          error(b, i) << "users of operand " << v->get_opcode_name() << " are inconsistent\n";
+      }
+      for (Ir_inst const* u : i->get_users()) {
+        if (!u->get_block())
+          error(b, i) << "detached user " << u->get_opcode_name() << '\n';
+      }
+    }
+  }
+
+  void check_edges(Ir_block const* b)
+  {
+    if (b == fn.get_entry() && !b->get_predecessors().empty())
+      error(b) << "entry has predecessors\n";
+    for (Ir_block const* s : b->get_successors()) {
+      if (index(s) < 0)
+        error(b) << "target is not in the function\n";
+      else if (std::count(s->get_predecessors().begin(), s->get_predecessors().end(), b) !=
+               std::count(succs[b].begin(), succs[b].end(), s))
+        error(b) << "not a predecessor of block " << s->get_id() << '\n';
+    }
+    for (Ir_block const* p : b->get_predecessors()) {
+      if (index(p) < 0 || std::find(succs[p].begin(), succs[p].end(), b) == succs[p].end())
+        error(b) << "predecessor is not a successor\n";
+    }
+  }
+
+  void check_dominance(Ir_dominators const& dom, Ir_block const* b)
+  {
+    if (!dom.is_reachable(b))
+      return;
+    for (Ir_inst const* i : *b) {
+      for (std::size_t n = 0; n < i->get_num_operands(); ++n) {
+        Ir_inst const* v = i->get_operand(n);
+        Ir_block const* d = v->get_block();
+        if (!d || index(d) < 0)
+          continue;
+        if (i->is_phi()) {
+          // The operand is used at the end of the predecessor.
+          Ir_block const* p = b->get_predecessors()[n];
+          if (dom.is_reachable(p) && !dom.dominates(d, p))
+            error(b, i) << "operand %" << v->get_id() << " does not dominate its predecessor\n";
+        }
+        else if (d == b ? pos[v] >= pos[i] : !dom.dominates(d, b)) {
+          error(b, i) << "operand %" << v->get_id() << " does not dominate its use\n";
+        }
+      }
+    }
+  }
+
+  bool check()
+  {
+    if (fn.get_num_blocks() == 0) {
+      ok = false;
+      os << "error: function has no blocks\n";
+      return ok;
+    }
+    for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+      Ir_block const* b = fn.get_block(n);
+      blocks.emplace(b, n);
+      succs.emplace(b, b->get_successors());
+      for (std::size_t k = 0; k < b->size(); ++k)
+        pos.emplace(b->get_instructions()[k], k);
+    }
+    for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+      check_structure(fn.get_block(n));
+      check_edges(fn.get_block(n));
+    }
+    if (!ok)
+      return ok;
+    Ir_dominators dom(fn);
+    for (std::size_t n = 0; n < fn.get_num_blocks(); ++n)
+      check_dominance(dom, fn.get_block(n));
+    return ok;
+  }
+
+  Ir_function const& fn;
+  std::ostream& os;
+  bool ok;
+
+  std::unordered_map<Ir_block const*, int> blocks;
+  /// The index of each block.
+
+  std::unordered_map<Ir_block const*, std::vector<Ir_block*>> succs;
+  /// The successors of each block.
+
+  std::unordered_map<Ir_inst const*, std::size_t> pos;
+  /// The position of each instruction in its block.
+};
+
+} // namespace
+
+
+bool
+Ir_function::verify(std::ostream& os) const
+{
+  return Verifier(*this, os).check();
+}
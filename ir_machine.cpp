@@ -0,0 +1,508 @@
+#include "ir_machine.hpp"
+#include "decl.hpp"
+#include "opt.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+/// The operations of lowered code. The first are those of the SSA form,
+/// in the same order. Constants of every type are const_i operations on
+/// their encodings, and br is a jump that may be omitted when its target
+/// follows.
+enum Op_kind : std::uint8_t
+{
+#define def_inst(K) K##_op,
+#include "ir.def"
+  mov_op,        // copy x
+  tail_call_op,  // call n with the caller's frame
+  tail_calli_op, // call through a value with the caller's frame
+};
+
+inline Float_value
+get_float(std::uint64_t b)
+{
+  Float_value f;
+  std::memcpy(&f, &b, sizeof f);
+  return f;
+}
+
+inline std::uint64_t
+get_bits(Float_value f)
+{
+  std::uint64_t b;
+  std::memcpy(&b, &f, sizeof b);
+  return b;
+}
+
+// Integer arithmetic wraps on overflow, as it does in the evaluator.
+
+std::uint64_t
+div_int(Int_value a, Int_value b)
+{
+  if (b == 0)
+    throw std::runtime_error("division by zero");
+  if (b == -1)
+    return -std::uint64_t(a);
+  return a / b;
+}
+
+std::uint64_t
+rem_int(Int_value a, Int_value b)
+{
+  if (b == 0)
+    throw std::runtime_error("division by zero");
+  if (b == -1)
+    return 0;
+  return a % b;
+}
+
+} // namespace
+
+
+/// An operation of lowered code.
+struct Ir_machine::Op
+{
+  Op_kind kind;
+  /// The operation.
+
+  int dst;
+  /// The register of the result, or -1 if there is none.
+
+  int x;
+  int y;
+  /// The registers of the operands. For calls, `x` is the position of
+  /// the first argument register in Code::args and `y` the number of
+  /// arguments. The callee of calli is the first argument.
+
+  union
+  {
+    std::uint64_t bits;
+    int slot;
+    Code const* code;
+  } imm;
+  /// The encoding of a constant, the index of a slot, or the callee of a
+  /// call (null if it is not defined).
+
+  int target[2];
+  /// The destinations of jumps and branches.
+};
+
+
+/// A lowered function.
+struct Ir_machine::Code
+{
+  Fn_decl const* fn;
+  /// The function, or null for the initializers of globals.
+
+  std::vector<Op> ops;
+  /// The operations.
+
+  std::vector<int> args;
+  /// The argument registers of calls.
+
+  std::vector<int> params;
+  /// The register of each parameter, or -1 if the parameter is unused.
+
+  int regs = 0;
+  /// The number of registers.
+
+  int slots = 0;
+  /// The number of slots.
+};
+
+
+Ir_machine::Ir_machine(Prog_decl const* p, int level)
+  : m_ir(p), m_code(), m_index(), m_globals(), m_statics(),
+    m_regs(), m_cells(), m_acts(), m_args()
+{
+  Pass_manager(level).run(m_ir);
+
+  // All functions are created first, so that calls can refer to them.
+  std::vector<Ir_function*> fns;
+  for (auto const& fn : m_ir.get_functions())
+    fns.push_back(fn.get());
+  fns.push_back(m_ir.get_init());
+  for (Ir_function* fn : fns) {
+    m_code.emplace_back(new Code());
+    m_code.back()->fn = fn->get_decl();
+    if (fn->get_decl())
+      m_index.emplace(fn->get_decl(), m_code.back().get());
+  }
+  for (std::size_t i = 0; i < fns.size(); ++i)
+    lower(*fns[i], *m_code[i]);
+
+  Code const* init = m_code.back().get();
+  push_frame(init, nullptr);
+  run(init);
+}
+
+Ir_machine::~Ir_machine() = default;
+
+Value
+Ir_machine::call(Fn_decl const* fn, std::vector<Value> const& args)
+{
+  auto iter = m_index.find(fn);
+  if (iter == m_index.end())
+    throw std::runtime_error("call to undefined function");
+  assert(args.size() == fn->get_num_parameters());
+  for (Decl const* p : fn->get_parameters()) {
+    if (p->is_reference())
+      throw std::logic_error("cannot bind reference parameter to a value");
+  }
+
+  // Discard the state of a call that was abandoned by an exception.
+  m_acts.clear();
+  m_regs.clear();
+  m_cells.clear();
+
+  std::vector<std::uint64_t> bits;
+  for (Value const& v : args) {
+    if (v.is_float())
+      bits.push_back(get_bits(v.get_float()));
+    else if (v.is_function())
+      bits.push_back(reinterpret_cast<std::uintptr_t>(v.get_function()));
+    else
+      bits.push_back(v.get_int());
+  }
+  push_frame(iter->second, bits.data());
+  std::uint64_t r = run(iter->second);
+
+  Type const* t = fn->get_return()->get_type();
+  if (t->is_float())
+    return Value(get_float(r));
+  if (t->is_bool())
+    return Value(r != 0);
+  if (t->is_function())
+    return Value(reinterpret_cast<Fn_value>(r));
+  if (t->is_reference())
+    throw std::logic_error("cannot return a reference to the host");
+  return Value(Int_value(r));
+}
+
+std::uint64_t*
+Ir_machine::get_static(Var_decl const* var)
+{
+  std::uint64_t*& cell = m_globals[var];
+  if (!cell) {
+    m_statics.push_back(0);
+    cell = &m_statics.back();
+  }
+  return cell;
+}
+
+void
+Ir_machine::lower(Ir_function& fn, Code& code)
+{
+  fn.renumber();
+
+  // Phis are copied through scratch registers that follow the values
+  // when one copy on an edge would overwrite the source of another.
+  int values = 0;
+  int phis = 0;
+  for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+    int k = 0;
+    for (Ir_inst* i : *fn.get_block(n)) {
+      values = std::max(values, i->get_id() + 1);
+      k += i->is_phi();
+    }
+    phis = std::max(phis, k);
+  }
+  code.regs = values + phis;
+  if (code.fn)
+    code.params.assign(code.fn->get_num_parameters(), -1);
+
+  std::vector<Op>& ops = code.ops;
+  auto emit = [&](Op_kind k, int dst, int x = -1, int y = -1) -> Op& {
+    Op op{};
+    op.kind = k;
+    op.dst = dst;
+    op.x = x;
+    op.y = y;
+    ops.push_back(op);
+    return ops.back();
+  };
+  auto reg = [](Ir_inst const* i) { return i->get_id(); };
+
+  // Jumps to blocks are resolved when every block has been placed.
+  struct Fixup
+  {
+    std::size_t op;
+    int n;
+    Ir_block* block;
+  };
+  std::vector<Fixup> fixups;
+  std::vector<int> starts(fn.get_num_blocks());
+
+  // Emits the copies for the phis of `to` on the edge from `from`.
+  auto copy = [&](Ir_block* from, Ir_block* to) {
+    auto const& preds = to->get_predecessors();
+    std::size_t k = std::find(preds.begin(), preds.end(), from) - preds.begin();
+    std::vector<std::pair<int, int>> moves;
+    for (Ir_inst* i : *to) {
+      if (!i->is_phi())
+        break;
+      int src = reg(i->get_operand(k));
+      if (src != reg(i))
+        moves.emplace_back(reg(i), src);
+    }
+    bool overlap = false;
+    for (std::size_t a = 0; a < moves.size(); ++a) {
+      for (std::size_t b = a + 1; b < moves.size(); ++b)
+        overlap |= moves[b].second == moves[a].first;
+    }
+    if (!overlap) {
+      for (auto const& m : moves)
+        emit(mov_op, m.first, m.second);
+      return;
+    }
+    for (std::size_t a = 0; a < moves.size(); ++a)
+      emit(mov_op, values + a, moves[a].second);
+    for (std::size_t a = 0; a < moves.size(); ++a)
+      emit(mov_op, moves[a].first, values + a);
+  };
+  auto has_phis = [](Ir_block const* b) {
+    return b->size() && (*b->begin())->is_phi();
+  };
+
+  // Branches along edges with copies go to stubs placed after the
+  // blocks.
+  struct Stub
+  {
+    std::size_t op;
+    int n;
+    Ir_block* from;
+    Ir_block* to;
+  };
+  std::vector<Stub> stubs;
+
+  for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+    Ir_block* b = fn.get_block(n);
+    starts[n] = ops.size();
+    Ir_inst const* prev = nullptr;
+    for (Ir_inst* i : *b) {
+      Ir_opcode op = i->get_opcode();
+      switch (op) {
+      case param_ir:
+        code.params[i->get_index()] = reg(i);
+        break;
+      case const_b_ir:
+      case const_i_ir:
+        emit(const_i_op, reg(i)).imm.bits = i->get_int();
+        break;
+      case const_f_ir:
+        emit(const_i_op, reg(i)).imm.bits = get_bits(i->get_float());
+        break;
+      case const_fn_ir:
+        emit(const_i_op, reg(i)).imm.bits = reinterpret_cast<std::uintptr_t>(i->get_function());
+        break;
+      case undef_ir:
+        emit(const_i_op, reg(i)).imm.bits = 0;
+        break;
+      case global_ir:
+        emit(const_i_op, reg(i)).imm.bits = reinterpret_cast<std::uintptr_t>(get_static(i->get_variable()));
+        break;
+      case slot_ir:
+        emit(slot_op, reg(i)).imm.slot = code.slots++;
+        break;
+      case phi_ir:
+        break;
+      case store_ir:
+        emit(store_op, -1, reg(i->get_operand(0)), reg(i->get_operand(1)));
+        break;
+      case call_ir:
+      case calli_ir: {
+        Op& c = emit(Op_kind(op), reg(i), code.args.size(), i->get_num_operands());
+        if (op == call_ir) {
+          auto iter = m_index.find(i->get_function());
+          c.imm.code = iter == m_index.end() ? nullptr : iter->second;
+        }
+        for (Ir_inst* a : i->get_operands())
+          code.args.push_back(reg(a));
+        break;
+      }
+      case br_ir:
+        copy(b, i->get_target(0));
+        if (n + 1 == fn.get_num_blocks() || fn.get_block(n + 1) != i->get_target(0)) {
+          fixups.push_back({ops.size(), 0, i->get_target(0)});
+          emit(br_op, -1);
+        }
+        break;
+      case cbr_ir: {
+        std::size_t at = ops.size();
+        emit(cbr_op, -1, reg(i->get_operand(0)));
+        for (int k = 0; k < 2; ++k) {
+          if (has_phis(i->get_target(k)))
+            stubs.push_back({at, k, b, i->get_target(k)});
+          else
+            fixups.push_back({at, k, i->get_target(k)});
+        }
+        break;
+      }
+      case ret_ir: {
+        // Return the result of a call made just before as a tail call.
+        // A pointer argument could designate a slot of this frame, which
+        // the callee must not replace.
+        Ir_inst const* v = i->get_operand(0);
+        if (prev == v && (v->get_opcode() == call_ir || v->get_opcode() == calli_ir)
+            && v->get_users().size() == 1) {
+          bool safe = true;
+          for (Ir_inst const* a : v->get_operands())
+            safe &= code.slots == 0 || a->get_type() != ptr_ty;
+          if (safe) {
+            Op& c = ops.back();
+            c.kind = v->get_opcode() == call_ir ? tail_call_op : tail_calli_op;
+            break;
+          }
+        }
+        emit(ret_op, -1, reg(v));
+        break;
+      }
+      default:
+        emit(Op_kind(op), reg(i), reg(i->get_operand(0)),
+             i->get_num_operands() > 1 ? reg(i->get_operand(1)) : -1);
+        break;
+      }
+      prev = i;
+    }
+  }
+
+  for (Stub const& s : stubs) {
+    ops[s.op].target[s.n] = ops.size();
+    copy(s.from, s.to);
+    fixups.push_back({ops.size(), 0, s.to});
+    emit(br_op, -1);
+  }
+  for (Fixup const& f : fixups)
+    ops[f.op].target[f.n] = starts[f.block->get_id()];
+}
+
+void
+Ir_machine::push_frame(Code const* code, std::uint64_t const* args)
+{
+  std::size_t regs = m_regs.size();
+  m_regs.resize(regs + code->regs);
+  m_cells.resize(m_cells.size() + code->slots);
+  for (std::size_t i = 0; i < code->params.size(); ++i) {
+    if (code->params[i] >= 0)
+      m_regs[regs + code->params[i]] = args[i];
+  }
+}
+
+std::uint64_t
+Ir_machine::run(Code const* code)
+{
+  std::size_t depth = m_acts.size();
+  std::size_t regs = m_regs.size() - code->regs;
+  std::size_t cells = m_cells.size() - code->slots;
+  int pc = 0;
+  for (;;) {
+    Op const& op = code->ops[pc++];
+    std::uint64_t* r = m_regs.data() + regs;
+    auto x = [&] { return r[op.x]; };
+    auto y = [&] { return r[op.y]; };
+    auto ix = [&] { return Int_value(r[op.x]); };
+    auto iy = [&] { return Int_value(r[op.y]); };
+    auto fx = [&] { return get_float(r[op.x]); };
+    auto fy = [&] { return get_float(r[op.y]); };
+    switch (op.kind) {
+    case const_i_op: r[op.dst] = op.imm.bits; break;
+    case mov_op: r[op.dst] = x(); break;
+
+    case add_i_op: r[op.dst] = x() + y(); break;
+    case sub_i_op: r[op.dst] = x() - y(); break;
+    case mul_i_op: r[op.dst] = x() * y(); break;
+    case div_i_op: r[op.dst] = div_int(ix(), iy()); break;
+    case rem_i_op: r[op.dst] = rem_int(ix(), iy()); break;
+    case neg_i_op: r[op.dst] = -x(); break;
+    case rec_i_op: r[op.dst] = div_int(1, ix()); break;
+
+    case add_f_op: r[op.dst] = get_bits(fx() + fy()); break;
+    case sub_f_op: r[op.dst] = get_bits(fx() - fy()); break;
+    case mul_f_op: r[op.dst] = get_bits(fx() * fy()); break;
+    case div_f_op: r[op.dst] = get_bits(fx() / fy()); break;
+    case neg_f_op: r[op.dst] = get_bits(-fx()); break;
+    case rec_f_op: r[op.dst] = get_bits(1.0 / fx()); break;
+
+    case eq_i_op: r[op.dst] = ix() == iy(); break;
+    case ne_i_op: r[op.dst] = ix() != iy(); break;
+    case lt_i_op: r[op.dst] = ix() < iy(); break;
+    case gt_i_op: r[op.dst] = ix() > iy(); break;
+    case le_i_op: r[op.dst] = ix() <= iy(); break;
+    case ge_i_op: r[op.dst] = ix() >= iy(); break;
+
+    case eq_f_op: r[op.dst] = fx() == fy(); break;
+    case ne_f_op: r[op.dst] = fx() != fy(); break;
+    case lt_f_op: r[op.dst] = fx() < fy(); break;
+    case gt_f_op: r[op.dst] = fx() > fy(); break;
+    case le_f_op: r[op.dst] = fx() <= fy(); break;
+    case ge_f_op: r[op.dst] = fx() >= fy(); break;
+
+    case eq_p_op: r[op.dst] = x() == y(); break;
+    case ne_p_op: r[op.dst] = x() != y(); break;
+    case not_b_op: r[op.dst] = !x(); break;
+
+    case slot_op: r[op.dst] = reinterpret_cast<std::uintptr_t>(&m_cells[cells + op.imm.slot]); break;
+    case load_op: r[op.dst] = *reinterpret_cast<std::uint64_t*>(x()); break;
+    case store_op: *reinterpret_cast<std::uint64_t*>(x()) = y(); break;
+
+    case br_op: pc = op.target[0]; break;
+    case cbr_op: pc = op.target[x() ? 0 : 1]; break;
+
+    case call_op:
+    case calli_op:
+    case tail_call_op:
+    case tail_calli_op: {
+      int first = op.x;
+      Code const* callee = op.imm.code;
+      if (op.kind == calli_op || op.kind == tail_calli_op) {
+        auto iter = m_index.find(reinterpret_cast<Fn_decl const*>(r[code->args[first++]]));
+        callee = iter == m_index.end() ? nullptr : iter->second;
+      }
+      if (!callee)
+        throw std::runtime_error("call to undefined function");
+      m_args.clear();
+      for (int i = first; i < op.x + op.y; ++i)
+        m_args.push_back(r[code->args[i]]);
+      if (op.kind == tail_call_op || op.kind == tail_calli_op) {
+        m_regs.resize(regs);
+        m_cells.resize(cells);
+      }
+      else {
+        m_acts.push_back({code, pc, regs, cells, op.dst});
+        regs = m_regs.size();
+        cells = m_cells.size();
+      }
+      push_frame(callee, m_args.data());
+      code = callee;
+      pc = 0;
+      break;
+    }
+
+    case ret_op: {
+      std::uint64_t v = x();
+      m_regs.resize(regs);
+      m_cells.resize(cells);
+      if (m_acts.size() == depth)
+        return v;
+      Activation const& a = m_acts.back();
+      code = a.code;
+      pc = a.pc;
+      regs = a.regs;
+      cells = a.cells;
+      if (a.dst >= 0)
+        m_regs[regs + a.dst] = v;
+      m_acts.pop_back();
+      break;
+    }
+
+    default:
+      throw std::logic_error("invalid operation");
+    }
+  }
+}
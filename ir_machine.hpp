@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ir.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+/// Executes the SSA form of a program.
+///
+/// Each function is lowered to a sequence of operations over a frame of
+/// registers, one for each value of the function, and phis become copies
+/// on the edges into their blocks. Since the machine runs the program as
+/// translated, it checks the translation to SSA form, and the passes that
+/// transform it, against the other engines.
+///
+/// The SSA form may first be optimized by the passes of an optimization
+/// level (see Pass_manager).
+///
+/// Values are held in the 64-bit encodings of Native_module. Addresses
+/// are pointers to cells that hold such encodings. Calls do not recurse
+/// on the native stack, and a call whose result is returned at once runs
+/// in the caller's frame, so tail recursion runs in constant space. A
+/// call passing a pointer cannot do so if the caller has slots, since
+/// the pointer could designate one of them.
+class Ir_machine
+{
+public:
+  Ir_machine(Prog_decl const* p, int level = 0);
+  /// Translates `p`, which must have been checked, to SSA form, optimizes
+  /// it at the optimization level `level`, lowers it, and initializes
+  /// the global variables.
+
+  Ir_machine(Ir_machine const&) = delete;
+  Ir_machine& operator=(Ir_machine const&) = delete;
+
+  ~Ir_machine();
+
+  Value call(Fn_decl const* fn, std::vector<Value> const& args);
+  /// Calls `fn` with `args`, which must be values of its parameter types,
+  /// and returns the result.
+
+  Ir_program const& get_program() const { return m_ir; }
+  /// Returns the SSA form being executed.
+
+private:
+  struct Op;
+  struct Code;
+
+  /// A suspended caller.
+  struct Activation
+  {
+    Code const* code;
+    /// The calling code.
+
+    int pc;
+    /// The operation after the call.
+
+    std::size_t regs;
+    /// The first register of the caller's frame.
+
+    std::size_t cells;
+    /// The first slot of the caller's frame.
+
+    int dst;
+    /// The register receiving the result.
+  };
+
+  void lower(Ir_function& fn, Code& code);
+  /// Lowers `fn` to `code`.
+
+  std::uint64_t* get_static(Var_decl const* var);
+  /// Returns the cell of the global variable `var`.
+
+  std::uint64_t run(Code const* code);
+  /// Runs `code` in the frame on top of the stack until it returns, and
+  /// returns its result. The frame is popped.
+
+  void push_frame(Code const* code, std::uint64_t const* args);
+  /// Pushes a frame for `code` whose parameters are copied from `args`.
+
+  Ir_program m_ir;
+  /// The program.
+
+  std::vector<std::unique_ptr<Code>> m_code;
+  /// The lowered functions. The last is the initializer of globals.
+
+  std::unordered_map<Fn_decl const*, Code const*> m_index;
+  /// Maps declarations to their lowered functions.
+
+  std::unordered_map<Var_decl const*, std::uint64_t*> m_globals;
+  /// Maps global variables to their cells.
+
+  std::deque<std::uint64_t> m_statics;
+  /// The cells of global variables.
+
+  std::vector<std::uint64_t> m_regs;
+  /// The registers of active frames.
+
+  std::deque<std::uint64_t> m_cells;
+  /// The slots of active frames. Slots do not move while their frame is
+  /// active, so pointers to them remain valid.
+
+  std::vector<Activation> m_acts;
+  /// The suspended callers.
+
+  std::vector<std::uint64_t> m_args;
+  /// The arguments of a call being made.
+};
@@ -0,0 +1,469 @@
+#include "jit.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  define JIT_SUPPORTED 1
+#else
+#  define JIT_SUPPORTED 0
+#endif
+
+namespace
+{
+
+// Register assignments in compiled code:
+//
+//   rbx  the frame
+//   r12  the machine
+//   r13  the code being executed
+//
+// These are callee-saved, so they survive calls to the step helper.
+// rax, rcx, and rdx are scratch registers.
+
+/// The encoding of unboxed integers in the high 16 bits.
+constexpr std::uint64_t int_bits = std::uint64_t(Packed_value::int_tag) << Packed_value::payload_bits;
+
+/// The encoding of false.
+constexpr std::uint64_t false_bits = int_bits;
+
+/// Condition codes, as used in the second byte of jcc and setcc.
+enum Cond : std::uint8_t
+{
+  o_cond = 0x0,
+  e_cond = 0x4,
+  ne_cond = 0x5,
+  s_cond = 0x8,
+  l_cond = 0xc,
+  ge_cond = 0xd,
+  le_cond = 0xe,
+  g_cond = 0xf,
+};
+
+
+/// Appends machine code to a buffer. Each function emits one fixed
+/// instruction sequence; register operands are implied by the name.
+class Assembler
+{
+public:
+  std::size_t size() const { return m_buf.size(); }
+  unsigned char const* data() const { return m_buf.data(); }
+
+  void bytes(std::initializer_list<std::uint8_t> bs) { m_buf.insert(m_buf.end(), bs); }
+  void imm32(std::uint32_t n) { put(&n, 4); }
+  void imm64(std::uint64_t n) { put(&n, 8); }
+
+  /// Emits a rel32 jump or jcc with an unresolved target and returns the
+  /// position of its displacement.
+  std::size_t jmp() { bytes({0xe9}); return hole(); }
+  std::size_t jcc(Cond c) { bytes({0x0f, std::uint8_t(0x80 | c)}); return hole(); }
+
+  /// Resolves the displacement at `pos` to `target`.
+  void patch(std::size_t pos, std::size_t target)
+  {
+    std::int32_t rel = std::int32_t(target - (pos + 4));
+    std::memcpy(&m_buf[pos], &rel, 4);
+  }
+
+  // Frame access. The displacement of register n is 8n.
+
+  void load_rax(int n) { bytes({0x48, 0x8b, 0x83}); imm32(8 * n); }   // mov rax, [rbx + 8n]
+  void load_rcx(int n) { bytes({0x48, 0x8b, 0x8b}); imm32(8 * n); }   // mov rcx, [rbx + 8n]
+  void load_rdx(int n) { bytes({0x48, 0x8b, 0x93}); imm32(8 * n); }   // mov rdx, [rbx + 8n]
+  void store_rax(int n) { bytes({0x48, 0x89, 0x83}); imm32(8 * n); }  // mov [rbx + 8n], rax
+
+  // Tags
+
+  /// Jumps to the returned hole if the tag of rax (or rcx, or rdx) is
+  /// not `tag`. Clobbers rdx.
+  std::size_t tag_ne_rax(std::uint32_t tag) { bytes({0x48, 0x89, 0xc2}); return tag_ne_rdx(tag); }
+  std::size_t tag_ne_rcx(std::uint32_t tag) { bytes({0x48, 0x89, 0xca}); return tag_ne_rdx(tag); }
+  std::size_t tag_ne_rdx(std::uint32_t tag)
+  {
+    bytes({0x48, 0xc1, 0xea, 0x30});   // shr rdx, 48
+    bytes({0x81, 0xfa}); imm32(tag);   // cmp edx, tag
+    return jcc(ne_cond);
+  }
+
+  /// Jumps to the returned hole if the tag of rax or register n is box_tag.
+  /// Clobbers rdx.
+  std::size_t boxed_rax() { bytes({0x48, 0x89, 0xc2}); return boxed_rdx(); }
+  std::size_t boxed(int n) { load_rdx(n); return boxed_rdx(); }
+  std::size_t boxed_rdx()
+  {
+    bytes({0x48, 0xc1, 0xea, 0x30});
+    bytes({0x81, 0xfa}); imm32(Packed_value::box_tag);
+    return jcc(e_cond);
+  }
+
+  // Arithmetic on payloads shifted into the high 48 bits, so that the
+  // overflow flag reports 48-bit overflow.
+
+  void shl16_rax_rcx() { bytes({0x48, 0xc1, 0xe0, 0x10, 0x48, 0xc1, 0xe1, 0x10}); }
+  void add_rax_rcx() { bytes({0x48, 0x01, 0xc8}); }
+  void sub_rax_rcx() { bytes({0x48, 0x29, 0xc8}); }
+  void cmp_rax_rcx() { bytes({0x48, 0x39, 0xc8}); }
+
+  /// Re-tags the shifted payload in rax as an unboxed integer.
+  void retag_rax()
+  {
+    bytes({0x48, 0xc1, 0xe8, 0x10});           // shr rax, 16
+    bytes({0x48, 0xba}); imm64(int_bits);      // mov rdx, int_bits
+    bytes({0x48, 0x09, 0xd0});                 // or rax, rdx
+  }
+
+  /// Materializes the flag `c` in rax as an unboxed boolean.
+  void set_rax(Cond c)
+  {
+    bytes({0x0f, std::uint8_t(0x90 | c), 0xc0});  // setcc al
+    bytes({0x0f, 0xb6, 0xc0});                     // movzx eax, al
+    bytes({0x48, 0xba}); imm64(int_bits);          // mov rdx, int_bits
+    bytes({0x48, 0x09, 0xd0});                     // or rax, rdx
+  }
+
+  void mov_rax(std::uint64_t n) { bytes({0x48, 0xb8}); imm64(n); }
+  void mov_rdx(std::uint64_t n) { bytes({0x48, 0xba}); imm64(n); }
+  void cmp_rax_rdx() { bytes({0x48, 0x39, 0xd0}); }
+  void mov_eax(std::uint32_t n) { bytes({0xb8}); imm32(n); }
+
+  // Linkage
+
+  void prologue(Code const* code)
+  {
+    bytes({0x53, 0x41, 0x54, 0x41, 0x55});       // push rbx; push r12; push r13
+    bytes({0x48, 0x89, 0xfb});                   // mov rbx, rdi
+    bytes({0x49, 0x89, 0xf4});                   // mov r12, rsi
+    bytes({0x49, 0xbd}); imm64(std::uint64_t(code));  // mov r13, code
+  }
+
+  /// Jumps to the entry for the instruction index in edx, using the table
+  /// of 32-bit offsets whose position is later patched into the returned
+  /// hole. Each offset is relative to the table.
+  std::size_t dispatch()
+  {
+    bytes({0x48, 0x63, 0xc2});                   // movsxd rax, edx
+    bytes({0x48, 0x8d, 0x0d});                   // lea rcx, [rip + table]
+    std::size_t pos = hole();
+    bytes({0x48, 0x63, 0x04, 0x81});             // movsxd rax, [rcx + 4 * rax]
+    bytes({0x48, 0x01, 0xc8});                   // add rax, rcx
+    bytes({0xff, 0xe0});                         // jmp rax
+    return pos;
+  }
+
+  /// Pads the code to a multiple of four bytes.
+  void align4() { while (size() % 4) bytes({0xcc}); }
+
+  void epilogue()
+  {
+    bytes({0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3}); // pop r13; pop r12; pop rbx; ret
+  }
+
+  /// Calls `step(m, fp, pc, code)` and returns the hole of the jump taken
+  /// when it reports an exception.
+  std::size_t call_step(Step_fn step, Instr const* pc)
+  {
+    bytes({0x4c, 0x89, 0xe7});                   // mov rdi, r12
+    bytes({0x48, 0x89, 0xde});                   // mov rsi, rbx
+    bytes({0x48, 0xba}); imm64(std::uint64_t(pc));   // mov rdx, pc
+    bytes({0x4c, 0x89, 0xe9});                   // mov rcx, r13
+    bytes({0x48, 0xb8}); imm64(std::uint64_t(step)); // mov rax, step
+    bytes({0xff, 0xd0});                         // call rax
+    bytes({0x85, 0xc0});                         // test eax, eax
+    return jcc(s_cond);
+  }
+
+private:
+  std::size_t hole() { std::size_t p = size(); imm32(0); return p; }
+  void put(void const* p, std::size_t n)
+  {
+    unsigned char const* b = static_cast<unsigned char const*>(p);
+    m_buf.insert(m_buf.end(), b, b + n);
+  }
+
+  std::vector<unsigned char> m_buf;
+};
+
+
+/// Translates the instructions of one function.
+struct Translator
+{
+  Translator(Code const& code, Step_fn step)
+    : as(), code(code), step(step), labels(code.size() + 1), jumps(), slow(), exits()
+  { }
+
+  /// A jump to the instruction with the given index.
+  struct Jump
+  {
+    std::size_t pos;
+    int target;
+  };
+
+  void translate();
+  void translate(int i, Instr const& in);
+  void translate_step(int i);
+  void translate_move(int i, Instr const& in);
+  void translate_ldi(int i, Instr const& in);
+  void translate_arith(int i, Instr const& in);
+  void translate_compare(int i, Instr const& in, Cond c);
+  void translate_branch(Instr const& in, int target, Cond c);
+  void translate_tail_call(int i, Instr const& in);
+
+  /// Sends the jump at `pos` to the out-of-line step of instruction i.
+  void to_slow(std::size_t pos, int i) { slow.push_back(Jump{pos, i}); }
+
+  Assembler as;
+  /// The generated code.
+
+  Code const& code;
+  Step_fn step;
+
+  std::vector<std::size_t> labels;
+  /// The position of each instruction.
+
+  std::vector<Jump> jumps;
+  /// Jumps to instructions.
+
+  std::vector<Jump> slow;
+  /// Jumps to out-of-line steps.
+
+  std::vector<std::size_t> exits;
+  /// Jumps to the epilogue.
+};
+
+void
+Translator::translate()
+{
+  as.prologue(&code);
+  std::size_t table = as.dispatch();
+  Instr const* instrs = code.get_instructions();
+  for (std::size_t i = 0; i < code.size(); ++i) {
+    labels[i] = as.size();
+    translate(i, instrs[i]);
+  }
+  labels[code.size()] = as.size();
+
+  // The epilogue. eax holds the returned register or a negative number.
+  std::size_t exit = as.size();
+  as.epilogue();
+
+  // Each slow path steps its instruction and resumes after it. An
+  // instruction may have several jumps to its slow path, so stubs are
+  // shared.
+  std::vector<std::size_t> stubs(code.size(), 0);
+  for (Jump const& j : slow) {
+    if (!stubs[j.target]) {
+      stubs[j.target] = as.size();
+      exits.push_back(as.call_step(step, &instrs[j.target]));
+      jumps.push_back(Jump{as.jmp(), j.target + 1});
+    }
+    as.patch(j.pos, stubs[j.target]);
+  }
+
+  for (Jump const& j : jumps)
+    as.patch(j.pos, labels[j.target]);
+  for (std::size_t pos : exits)
+    as.patch(pos, exit);
+
+  // The entry table has an offset for each instruction.
+  as.align4();
+  as.patch(table, as.size());
+  std::size_t base = as.size();
+  for (std::size_t pos : labels)
+    as.imm32(std::uint32_t(pos - base));
+}
+
+void
+Translator::translate(int i, Instr const& in)
+{
+  switch (in.op) {
+  case mov_op:
+    return translate_move(i, in);
+  case ldi_op:
+    return translate_ldi(i, in);
+  case add_i_op:
+  case sub_i_op:
+    return translate_arith(i, in);
+  case eq_i_op:
+    return translate_compare(i, in, e_cond);
+  case ne_i_op:
+    return translate_compare(i, in, ne_cond);
+  case lt_i_op:
+    return translate_compare(i, in, l_cond);
+  case gt_i_op:
+    return translate_compare(i, in, g_cond);
+  case le_i_op:
+    return translate_compare(i, in, le_cond);
+  case ge_i_op:
+    return translate_compare(i, in, ge_cond);
+  case jmp_op:
+    jumps.push_back(Jump{as.jmp(), in.a});
+    return;
+  case jt_op:
+    return translate_branch(in, in.b, ne_cond);
+  case jf_op:
+    return translate_branch(in, in.b, e_cond);
+  case ret_op:
+    as.mov_eax(in.a);
+    exits.push_back(as.jmp());
+    return;
+  case tcall_op:
+    if (code.get_callee(in.b) == &code)
+      return translate_tail_call(i, in);
+    as.mov_eax(std::uint32_t(-2 - i));
+    exits.push_back(as.jmp());
+    return;
+  case call_op:
+  case calli_op:
+  case tcalli_op:
+    as.mov_eax(std::uint32_t(-2 - i));
+    exits.push_back(as.jmp());
+    return;
+  default:
+    return translate_step(i);
+  }
+}
+
+void
+Translator::translate_step(int i)
+{
+  exits.push_back(as.call_step(step, code.get_instructions() + i));
+}
+
+// r[a] = r[b], unless either is boxed.
+void
+Translator::translate_move(int i, Instr const& in)
+{
+  as.load_rax(in.b);
+  to_slow(as.boxed_rax(), i);
+  to_slow(as.boxed(in.a), i);
+  as.store_rax(in.a);
+}
+
+// r[a] = b, unless r[a] is boxed.
+void
+Translator::translate_ldi(int i, Instr const& in)
+{
+  to_slow(as.boxed(in.a), i);
+  as.mov_rax(Packed_value(Int_value(in.b)).get_bits());
+  as.store_rax(in.a);
+}
+
+// r[a] = r[b] op r[c], if both operands and the result are unboxed and
+// r[a] is not boxed.
+void
+Translator::translate_arith(int i, Instr const& in)
+{
+  as.load_rax(in.b);
+  as.load_rcx(in.c);
+  to_slow(as.tag_ne_rax(Packed_value::int_tag), i);
+  to_slow(as.tag_ne_rcx(Packed_value::int_tag), i);
+  as.shl16_rax_rcx();
+  if (in.op == add_i_op)
+    as.add_rax_rcx();
+  else
+    as.sub_rax_rcx();
+  to_slow(as.jcc(o_cond), i);
+  as.retag_rax();
+  std::size_t j = as.boxed(in.a);
+  to_slow(j, i);
+  as.store_rax(in.a);
+}
+
+// r[a] = r[b] cmp r[c], if both operands are unboxed and r[a] is not
+// boxed.
+void
+Translator::translate_compare(int i, Instr const& in, Cond c)
+{
+  as.load_rax(in.b);
+  as.load_rcx(in.c);
+  to_slow(as.tag_ne_rax(Packed_value::int_tag), i);
+  to_slow(as.tag_ne_rcx(Packed_value::int_tag), i);
+  to_slow(as.boxed(in.a), i);
+  as.shl16_rax_rcx();
+  as.cmp_rax_rcx();
+  as.set_rax(c);
+  as.store_rax(in.a);
+}
+
+// Conditions are booleans, so they are compared with the encoding of
+// false.
+void
+Translator::translate_branch(Instr const& in, int target, Cond c)
+{
+  as.load_rax(in.a);
+  as.mov_rdx(false_bits);
+  as.cmp_rax_rdx();
+  jumps.push_back(Jump{as.jcc(c), target});
+}
+
+// A tail call of this code moves the arguments to the parameters and
+// jumps to the first instruction, unless an argument or parameter is
+// boxed. Then the machine makes the call.
+void
+Translator::translate_tail_call(int i, Instr const& in)
+{
+  std::vector<std::size_t> boxed;
+  for (int n = 0; n < code.get_num_parameters(); ++n) {
+    as.load_rax(in.c + n);
+    boxed.push_back(as.boxed_rax());
+    boxed.push_back(as.boxed(n));
+  }
+  for (int n = 0; n < code.get_num_parameters(); ++n) {
+    as.load_rax(in.c + n);
+    as.store_rax(n);
+  }
+  jumps.push_back(Jump{as.jmp(), 0});
+
+  for (std::size_t pos : boxed)
+    as.patch(pos, as.size());
+  as.mov_eax(std::uint32_t(-2 - i));
+  exits.push_back(as.jmp());
+}
+
+} // namespace
+
+
+Jit::Jit(Step_fn step)
+  : m_step(step), m_regions(), m_bytes()
+{ }
+
+Jit::~Jit()
+{
+#if JIT_SUPPORTED
+  for (Region const& r : m_regions)
+    munmap(r.ptr, r.size);
+#endif
+}
+
+bool
+Jit::is_supported()
+{
+  return JIT_SUPPORTED;
+}
+
+Native_fn
+Jit::compile(Code const& code)
+{
+#if JIT_SUPPORTED
+  Translator tr(code, m_step);
+  tr.translate();
+
+  std::size_t page = sysconf(_SC_PAGESIZE);
+  std::size_t size = (tr.as.size() + page - 1) & ~(page - 1);
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return nullptr;
+  std::memcpy(p, tr.as.data(), tr.as.size());
+  if (mprotect(p, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(p, size);
+    return nullptr;
+  }
+  m_regions.push_back(Region{p, size});
+  m_bytes += tr.as.size();
+  return reinterpret_cast<Native_fn>(p);
+#else
+  return nullptr;
+#endif
+}
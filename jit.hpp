@@ -0,0 +1,82 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <vector>
+
+class Machine;
+
+
+/// The entry point of a compiled function. It is called with the frame of
+/// the function, the machine executing it, and the index of the
+/// instruction at which to start. It returns the register holding the
+/// return value, -1 if an exception was raised by a helper, or `-2 - i`
+/// if it reached the call or tail call at instruction i, which the caller
+/// makes in its place. Compiled code may be entered at the first
+/// instruction or at any instruction following a call.
+using Native_fn = int (*)(Packed_value* fp, Machine* m, int start);
+
+
+/// Executes the instruction `pc` of `code` in the frame `fp` on behalf of
+/// compiled code. Returns a negative number if an exception was raised.
+using Step_fn = int (*)(Machine* m, Packed_value* fp, Instr const* pc, Code const* code);
+
+
+/// A baseline compiler from bytecode to x86-64 machine code.
+///
+/// Each instruction is translated by copying a fixed template. Moves,
+/// integer addition, subtraction, and comparison, and all jumps and
+/// returns are compiled inline. Their templates operate on packed values
+/// in the frame and fall back to an out-of-line call of the step helper
+/// when an operand is not an unboxed integer or a result would not fit
+/// in 48 bits. Calls and tail calls return to the machine, which makes
+/// the call on its own stack and then re-enters the caller after the
+/// call, so compiled code never nests on the native stack. All other
+/// instructions call the step helper. The compiled code therefore uses
+/// the same frames as the interpreter and can be mixed with it freely.
+///
+/// Code is written to anonymous mappings that are made executable once
+/// they are complete. The compiler requires x86-64 Linux; elsewhere,
+/// compile always fails and the interpreter is used.
+class Jit
+{
+public:
+  Jit(Step_fn step);
+  /// Constructs a compiler whose code calls `step` to execute
+  /// instructions that are not compiled inline.
+
+  ~Jit();
+
+  Jit(Jit const&) = delete;
+  Jit& operator=(Jit const&) = delete;
+
+  static bool is_supported();
+  /// Returns true if the host can run compiled code.
+
+  Native_fn compile(Code const& code);
+  /// Compiles `code`. Returns null if the host is not supported or
+  /// executable memory cannot be allocated.
+
+  std::size_t get_num_functions() const { return m_regions.size(); }
+  /// Returns the number of compiled functions.
+
+  std::size_t get_code_size() const { return m_bytes; }
+  /// Returns the total size of the compiled code.
+
+private:
+  /// A mapping holding the code of one function.
+  struct Region
+  {
+    void* ptr;
+    std::size_t size;
+  };
+
+  Step_fn m_step;
+  /// The helper for instructions that are not compiled inline.
+
+  std::vector<Region> m_regions;
+  /// The executable mappings.
+
+  std::size_t m_bytes;
+  /// The number of bytes of code generated.
+};
@@ -0,0 +1,137 @@
+#include "native.hpp"
+#include "type.hpp"
+#include "decl.hpp"
+
+#include <dlfcn.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+/// Returns `s` with each occurrence of `from` replaced by `to`.
+static std::string
+substitute(std::string s, std::string const& from, std::string const& to)
+{
+  for (std::size_t i = s.find(from); i != std::string::npos; i = s.find(from, i + to.size()))
+    s.replace(i, from.size(), to);
+  return s;
+}
+
+/// Returns true if `t` can be passed between the host and native code.
+static bool
+is_scalar(Type const* t)
+{
+  return t->is_bool() || t->is_int() || t->is_float();
+}
+
+Native_module::Native_module(Prog_decl const* p, std::string const& source,
+                             std::string const& ext, std::string const& build)
+  : m_lib(), m_entries()
+{
+  char tmpl[] = "/tmp/native.XXXXXX";
+  if (!mkdtemp(tmpl))
+    throw std::runtime_error("cannot create temporary directory");
+  fs::path dir = tmpl;
+  std::string src = (dir / ("prog" + ext)).string();
+  std::string lib = (dir / "prog.so").string();
+  std::ofstream(src) << source;
+  std::string cmd = substitute(substitute(build, "%i", src), "%o", lib);
+  int status = std::system(cmd.c_str());
+  if (status == 0)
+    m_lib = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+  // The mapping of a loaded library outlives its file.
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  if (status != 0)
+    throw std::runtime_error("build failed: " + cmd);
+  if (!m_lib)
+    throw std::runtime_error(std::string("cannot load native code: ") + dlerror());
+
+  int n = 0;
+  for (Decl const* d : p->get_children()) {
+    if (!d->is_function())
+      continue;
+    Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+    if (!fn->get_body())
+      continue;
+    if (has_entry(fn)) {
+      std::string sym = "rt_entry_" + std::to_string(n);
+      m_entries.emplace(fn, reinterpret_cast<Entry_fn>(dlsym(m_lib, sym.c_str())));
+    }
+    ++n;
+  }
+
+  auto start = reinterpret_cast<int (*)()>(dlsym(m_lib, "rt_start"));
+  check(start());
+}
+
+Native_module::~Native_module()
+{
+  dlclose(m_lib);
+}
+
+bool
+Native_module::has_entry(Fn_decl const* fn)
+{
+  if (!fn->get_body())
+    return false;
+  for (Decl const* p : fn->get_parameters()) {
+    if (!is_scalar(p->get_type()))
+      return false;
+  }
+  return is_scalar(fn->get_return()->get_type());
+}
+
+Value
+Native_module::call(Fn_decl const* fn, std::vector<Value> const& args)
+{
+  auto iter = m_entries.find(fn);
+  if (iter == m_entries.end())
+    throw std::logic_error("function cannot be called from the host");
+  assert(args.size() == fn->get_num_parameters());
+
+  std::vector<unsigned long long> bits;
+  for (Value const& v : args) {
+    unsigned long long b;
+    if (v.is_float()) {
+      Float_value f = v.get_float();
+      std::memcpy(&b, &f, sizeof b);
+    }
+    else {
+      b = v.get_int();
+    }
+    bits.push_back(b);
+  }
+
+  unsigned long long r;
+  check(iter->second(bits.data(), &r));
+  Type const* t = fn->get_return()->get_type();
+  if (t->is_float()) {
+    Float_value f;
+    std::memcpy(&f, &r, sizeof f);
+    return Value(f);
+  }
+  if (t->is_bool())
+    return Value(r != 0);
+  return Value(Int_value(r));
+}
+
+void
+Native_module::check(int status)
+{
+  switch (status) {
+  case 0:
+    return;
+  case 1:
+    throw std::runtime_error("division by zero");
+  case 2:
+    throw std::runtime_error("call to undefined function");
+  default:
+    throw std::runtime_error("native code failed");
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Fn_decl;
+class Prog_decl;
+
+
+/// A program compiled to a shared library by one of the native backends.
+///
+/// The library exports `rt_start`, which initializes the global variables,
+/// and `rt_entry_<n>` for the nth defined function of the program if that
+/// function has an entry point (see has_entry). An entry point has the C
+/// signature
+///
+///   int rt_entry_<n>(uint64_t const* args, uint64_t* ret);
+///
+/// Arguments and results are passed as 64-bit encodings: integers and
+/// booleans as two's complement, floats as IEEE bits. `rt_start` takes no
+/// arguments. Both return 0 on success, 1 if the program divided by zero,
+/// and 2 if it called an undefined function.
+class Native_module
+{
+public:
+  Native_module(Prog_decl const* p, std::string const& source,
+                std::string const& ext, std::string const& build);
+  /// Builds and loads the library for `p` from `source`. The source is
+  /// written to a temporary file with extension `ext`, and `build` is run
+  /// by the shell after replacing `%i` with the name of the source file
+  /// and `%o` with the name of the library. Throws a runtime error if the
+  /// build fails or the library cannot be loaded.
+
+  ~Native_module();
+
+  Native_module(Native_module const&) = delete;
+  Native_module& operator=(Native_module const&) = delete;
+
+  Value call(Fn_decl const* fn, std::vector<Value> const& args);
+  /// Calls `fn` with `args` and returns the result. Throws a logic error
+  /// if `fn` has no entry point.
+
+  static bool has_entry(Fn_decl const* fn);
+  /// Returns true if `fn` is defined and its parameters and result all
+  /// have type bool, int, or float.
+
+private:
+  using Entry_fn = int (*)(unsigned long long const* args, unsigned long long* ret);
+  /// The signature of an entry point.
+
+  static void check(int status);
+  /// Throws the exception corresponding to a nonzero status.
+
+  void* m_lib;
+  /// The loaded library.
+
+  std::unordered_map<Fn_decl const*, Entry_fn> m_entries;
+  /// The entry point of each callable function.
+};
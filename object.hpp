@@ -1,26 +1,31 @@
 #pragma once
 
-#include "value.hpp"
+#include "packed.hpp"
 
 #include <utility>
 
 class Type;
 
 
-/// An object occupies a region of storage and holds a value.
+/// An object occupies a region of storage and holds a value. Values are
+/// stored packed, so an object is two words.
 ///
 /// \todo If we support aggregate objects than an object is either a scalar
 /// or an aggregate with subobjects.
 class Object
 {
 public:
+  Object();
+  /// Constructs an untyped object with indeterminate value. This is the
+  /// state of a slot that has not been allocated.
+
   Object(Type* t);
   /// Constructs the object with indeterminate value.
 
-  Object(Type* t, Value const& val);
+  Object(Type* t, Packed_value const& val);
   /// Constructs the object.
 
-  Object(Type* t, Value&& val);
+  Object(Type* t, Packed_value&& val);
   /// Constructs the object.
 
   Type* get_type() const { return m_type; }
@@ -32,67 +37,72 @@ public:
   bool is_uninitialized() const { return m_value.is_indeterminate(); }
   /// Returns true if the object is uninitialized.
 
-  Value const& load() const { return m_value; }
+  Packed_value const& load() const { return m_value; }
   /// Returns the value of the object.
 
-  void initialize(Value const& val);
+  void initialize(Packed_value const& val);
   /// Performs the initial store of the object.
 
-  void initialize(Value&& val);
+  void initialize(Packed_value&& val);
   /// Performs the initial store of the object.
 
-  void store(Value const& val);
+  void store(Packed_value const& val);
   /// Sets the value of the initialized object.
 
-  void store(Value&& val);
+  void store(Packed_value&& val);
   /// Sets the value of the initialized object.
 
 private:
   Type* m_type;
   /// The type of object.
   
-  Value m_value;
+  Packed_value m_value;
   /// The value of the object.
 };
 
+inline
+Object::Object()
+  : m_type(), m_value()
+{ }
+
 inline
 Object::Object(Type* t)
   : m_type(t), m_value()
 { }
 
 inline
-Object::Object(Type* t, Value const& val)
+Object::Object(Type* t, Packed_value const& val)
   : m_type(t), m_value(val)
 { }
 
 inline
-Object::Object(Type* t, Value&& val)
+Object::Object(Type* t, Packed_value&& val)
   : m_type(t), m_value(std::move(val))
 { }
 
 inline void
-Object::initialize(Value const& val)
+Object::initialize(Packed_value const& val)
 {
   assert(is_uninitialized());
   m_value = val;
 }
 
 inline void
-Object::initialize(Value&& val)
+Object::initialize(Packed_value&& val)
 {
   assert(is_uninitialized());
   m_value = std::move(val);
 }
 
 inline void
-Object::store(Value const& val)
+Object::store(Packed_value const& val)
 {
   assert(is_initialized());
   m_value = val; 
 }
 
 inline void
-Object::store(Value&& val)
+Object::store(Packed_value&& val)
 {
   assert(is_initialized());
   m_value = std::move(val); 
@@ -0,0 +1,123 @@
+#include "opt.hpp"
+#include "ir.hpp"
+
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+char const*
+get_pass_name(Pass_kind k)
+{
+  switch (k) {
+#define def_pass(K, F) case K##_pass: return #K;
+#include "opt.def"
+  default:
+    break;
+  }
+  assert(false && "invalid pass");
+  return nullptr;
+}
+
+bool
+run_pass(Pass_kind k, Ir_function& fn)
+{
+  switch (k) {
+#define def_pass(K, F) case K##_pass: return F(fn);
+#include "opt.def"
+  default:
+    break;
+  }
+  assert(false && "invalid pass");
+  return false;
+}
+
+
+Pass_manager::Pass_manager()
+  : m_passes(), m_verify(false), m_stats()
+{ }
+
+Pass_manager::Pass_manager(int level)
+  : Pass_manager()
+{
+  if (level <= 0)
+    return;
+  if (level == 1) {
+    m_passes = {sccp_pass, dce_pass};
+    return;
+  }
+  m_passes = {sccp_pass, gvn_pass, licm_pass, dce_pass};
+  if (level >= 3)
+    m_passes.insert(m_passes.end(), {sccp_pass, gvn_pass, dce_pass});
+}
+
+void
+Pass_manager::run(Ir_function& fn)
+{
+  for (Pass_kind k : m_passes) {
+    Pass_stats& stats = m_stats[k];
+    std::size_t before = fn.count_instructions();
+    Clock::time_point start = Clock::now();
+    bool changed = run_pass(k, fn);
+    stats.time += Clock::now() - start;
+    stats.removed += std::ptrdiff_t(before) - std::ptrdiff_t(fn.count_instructions());
+    stats.changes += changed;
+    ++stats.runs;
+    if (m_verify) {
+      std::stringstream ss;
+      if (!fn.verify(ss))
+        throw std::logic_error(std::string("invalid function after ") + get_pass_name(k) + "\n" + ss.str());
+    }
+  }
+}
+
+void
+Pass_manager::run(Ir_program& p)
+{
+  run(*p.get_init());
+  for (auto const& fn : p.get_functions())
+    run(*fn);
+}
+
+void
+Pass_manager::reset_stats()
+{
+  for (Pass_stats& stats : m_stats)
+    stats = Pass_stats();
+}
+
+void
+Pass_manager::report(std::ostream& os) const
+{
+  using Ms = std::chrono::duration<double, std::milli>;
+  std::ios::fmtflags flags = os.flags();
+  std::streamsize prec = os.precision();
+  os << std::left << std::setw(8) << "pass"
+     << std::right << std::setw(8) << "runs"
+     << std::setw(10) << "changed"
+     << std::setw(10) << "removed"
+     << std::setw(12) << "time (ms)" << '\n';
+  Pass_stats total;
+  for (int k = 0; k < num_passes; ++k) {
+    Pass_stats const& stats = m_stats[k];
+    if (!stats.runs)
+      continue;
+    os << std::left << std::setw(8) << get_pass_name(Pass_kind(k))
+       << std::right << std::setw(8) << stats.runs
+       << std::setw(10) << stats.changes
+       << std::setw(10) << stats.removed
+       << std::setw(12) << std::fixed << std::setprecision(3) << Ms(stats.time).count() << '\n';
+    total.runs += stats.runs;
+    total.changes += stats.changes;
+    total.removed += stats.removed;
+    total.time += stats.time;
+  }
+  os << std::left << std::setw(8) << "total"
+     << std::right << std::setw(8) << total.runs
+     << std::setw(10) << total.changes
+     << std::setw(10) << total.removed
+     << std::setw(12) << std::fixed << std::setprecision(3) << Ms(total.time).count() << '\n';
+  os.flags(flags);
+  os.precision(prec);
+}
@@ -0,0 +1,65 @@
+#include "opt.hpp"
+#include "ir.hpp"
+
+#include <unordered_set>
+
+/// Returns true if `i` must be kept even when its value is unused.
+static bool
+is_essential(Ir_inst const* i)
+{
+  // Impure instructions store, call, trap, or transfer control.
+  return !i->is_pure();
+}
+
+bool
+eliminate_dead_code(Ir_function& fn)
+{
+  // Mark the essential instructions and, transitively, their operands.
+  std::unordered_set<Ir_inst*> live;
+  std::vector<Ir_inst*> work;
+  for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+    for (Ir_inst* i : *fn.get_block(n)) {
+      if (is_essential(i) && live.insert(i).second)
+        work.push_back(i);
+    }
+  }
+  while (!work.empty()) {
+    Ir_inst* i = work.back();
+    work.pop_back();
+    for (Ir_inst* v : i->get_operands()) {
+      if (live.insert(v).second)
+        work.push_back(v);
+    }
+  }
+
+  // Drop the operands of dead instructions before removing them, since
+  // dead instructions may use each other in cycles.
+  std::vector<Ir_inst*> dead;
+  for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+    for (Ir_inst* i : *fn.get_block(n)) {
+      if (!live.count(i))
+        dead.push_back(i);
+    }
+  }
+  for (Ir_inst* i : dead)
+    i->drop_operands();
+  for (Ir_inst* i : dead)
+    i->get_block()->erase(i);
+
+  // A conditional branch whose targets are the same is a jump.
+  bool changed = !dead.empty();
+  for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+    Ir_block* b = fn.get_block(n);
+    Ir_inst* t = b->get_terminator();
+    if (!t || t->get_opcode() != cbr_ir || t->get_target(0) != t->get_target(1))
+      continue;
+    Ir_block* target = t->get_target(0);
+    b->erase(t);
+    Ir_inst* br = fn.make(br_ir, no_ty);
+    br->set_target(0, target);
+    b->append(br);
+    target->remove_predecessor(b);
+    changed = true;
+  }
+  return changed;
+}
@@ -0,0 +1,131 @@
+#include "opt.hpp"
+#include "ir.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace
+{
+
+/// Returns true if `i` computes a value from its operands and immediate
+/// alone, so that two such instructions with the same operands are
+/// equal. Integer division is included: an instruction dominated by an
+/// equal one is only reached if the first did not trap.
+bool
+is_numbered(Ir_inst const* i)
+{
+  Ir_opcode op = i->get_opcode();
+  if (i->is_constant())
+    return true;
+  if (add_i_ir <= op && op <= not_b_ir)
+    return true;
+  // The address of a global never changes.
+  return op == global_ir;
+}
+
+/// Returns true if the operands of `op` can be swapped.
+bool
+is_commutative(Ir_opcode op)
+{
+  switch (op) {
+  case add_i_ir:
+  case mul_i_ir:
+  case add_f_ir:
+  case mul_f_ir:
+  case eq_i_ir:
+  case ne_i_ir:
+  case eq_f_ir:
+  case ne_f_ir:
+  case eq_p_ir:
+  case ne_p_ir:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Returns the immediate of `i` as bits.
+std::uint64_t
+get_immediate(Ir_inst const* i)
+{
+  switch (i->get_opcode()) {
+  case const_b_ir:
+  case const_i_ir:
+    return std::uint64_t(i->get_int());
+  case const_f_ir: {
+    Float_value n = i->get_float();
+    std::uint64_t bits;
+    std::memcpy(&bits, &n, sizeof bits);
+    return bits;
+  }
+  case const_fn_ir:
+    return std::uint64_t(std::uintptr_t(i->get_function()));
+  case global_ir:
+    return std::uint64_t(std::uintptr_t(i->get_variable()));
+  default:
+    return 0;
+  }
+}
+
+/// The expression computed by an instruction.
+using Key = std::tuple<Ir_opcode, Ir_type, std::uint64_t, Ir_inst*, Ir_inst*>;
+
+Key
+get_key(Ir_inst const* i)
+{
+  Ir_inst* x = i->get_num_operands() > 0 ? i->get_operand(0) : nullptr;
+  Ir_inst* y = i->get_num_operands() > 1 ? i->get_operand(1) : nullptr;
+  if (is_commutative(i->get_opcode()) && y < x)
+    std::swap(x, y);
+  return Key(i->get_opcode(), i->get_type(), get_immediate(i), x, y);
+}
+
+
+/// Numbers values in a preorder walk of the dominator tree, so that the
+/// expressions available at a block are those computed by its
+/// dominators.
+struct Numbering
+{
+  Numbering(Ir_function& fn) : dom(fn), changed(false) { }
+
+  void number(Ir_block* b)
+  {
+    std::vector<Key> scope;
+    std::vector<Ir_inst*> insts = b->get_instructions();
+    for (Ir_inst* i : insts) {
+      if (!is_numbered(i))
+        continue;
+      Key k = get_key(i);
+      auto iter = available.find(k);
+      if (iter != available.end()) {
+        i->replace_uses(iter->second);
+        b->erase(i);
+        changed = true;
+        continue;
+      }
+      available.emplace(k, i);
+      scope.push_back(k);
+    }
+    for (Ir_block* c : dom.get_children(b))
+      number(c);
+    for (Key const& k : scope)
+      available.erase(k);
+  }
+
+  Ir_dominators dom;
+  std::map<Key, Ir_inst*> available;
+  bool changed;
+};
+
+} // namespace
+
+
+bool
+number_values(Ir_function& fn)
+{
+  Numbering num(fn);
+  num.number(fn.get_entry());
+  return num.changed;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+class Ir_function;
+class Ir_program;
+
+
+/// The optimization passes.
+enum Pass_kind
+{
+#define def_pass(K, F) K##_pass,
+#include "opt.def"
+  num_passes
+};
+
+char const* get_pass_name(Pass_kind k);
+/// Returns the name of `k`.
+
+
+// Passes
+//
+// Each pass transforms a function in place and returns true if it changed
+// anything. Passes preserve the invariants checked by Ir_function::verify.
+
+bool propagate_constants(Ir_function& fn);
+/// Replaces values that are constant on every executable path with
+/// constants, and conditional branches on constants with jumps. Blocks
+/// that become unreachable are removed. This is the sparse conditional
+/// constant propagation of Wegman and Zadeck.
+
+bool eliminate_dead_code(Ir_function& fn);
+/// Removes instructions whose values are not needed by any store, call,
+/// trap, or terminator. Cycles of phis that only feed each other are
+/// removed as well.
+
+bool number_values(Ir_function& fn);
+/// Replaces each arithmetic, relational, logical, or constant
+/// instruction that recomputes the value of a dominating instruction
+/// with that instruction.
+
+bool hoist_invariants(Ir_function& fn);
+/// Moves pure instructions whose operands are defined outside a loop to
+/// the block that precedes the loop. The loops are those of while
+/// statements. Division is not moved, since it could trap in a loop that
+/// never runs its body.
+
+bool run_pass(Pass_kind k, Ir_function& fn);
+/// Runs the pass `k` on `fn`.
+
+
+/// The work done by one pass over all the functions it was run on.
+struct Pass_stats
+{
+  std::size_t runs = 0;
+  /// The number of functions processed.
+
+  std::size_t changes = 0;
+  /// The number of functions changed.
+
+  std::ptrdiff_t removed = 0;
+  /// The net number of instructions removed.
+
+  std::chrono::steady_clock::duration time = {};
+  /// The time spent in the pass.
+};
+
+
+/// Runs a sequence of passes over functions and records what each did.
+///
+/// The optimization levels select these sequences:
+///
+/// - 0: no passes
+/// - 1: sccp, dce
+/// - 2: sccp, gvn, licm, dce
+/// - 3: the level 2 sequence, then sccp, gvn, and dce once more to clean
+///   up after code motion
+class Pass_manager
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  Pass_manager();
+  /// Constructs a manager with no passes.
+
+  Pass_manager(int level);
+  /// Constructs a manager for the optimization level `level`. Levels
+  /// above 3 are treated as 3.
+
+  std::vector<Pass_kind> const& get_passes() const { return m_passes; }
+  /// Returns the sequence of passes.
+
+  void add(Pass_kind k) { m_passes.push_back(k); }
+  /// Appends `k` to the sequence.
+
+  void set_verify(bool b) { m_verify = b; }
+  /// When `b` is true, functions are verified after each pass, and a
+  /// failure throws std::logic_error naming the pass.
+
+  void run(Ir_function& fn);
+  /// Runs the sequence on `fn`.
+
+  void run(Ir_program& p);
+  /// Runs the sequence on every function of `p`.
+
+  // Statistics
+
+  Pass_stats const& get_stats(Pass_kind k) const { return m_stats[k]; }
+  /// Returns the statistics for `k`.
+
+  void reset_stats();
+  /// Discards all statistics.
+
+  void report(std::ostream& os) const;
+  /// Writes a table of the time spent and instructions removed by each
+  /// pass.
+
+private:
+  std::vector<Pass_kind> m_passes;
+  /// The sequence of passes.
+
+  bool m_verify;
+  /// True if functions are verified after each pass.
+
+  Pass_stats m_stats[num_passes];
+  /// The statistics of each pass.
+};
@@ -0,0 +1,131 @@
+#include "opt.hpp"
+#include "ir.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace
+{
+
+/// A natural loop.
+struct Loop
+{
+  Ir_block* header;
+  /// The block that dominates the loop. For a while statement, this
+  /// evaluates the condition.
+
+  std::unordered_set<Ir_block*> blocks;
+  /// The blocks of the loop, including the header.
+};
+
+/// Returns the natural loops, innermost first. Back edges to the
+/// same header form one loop.
+std::vector<Loop>
+find_loops(Ir_dominators const& dom)
+{
+  std::vector<Loop> loops;
+  for (Ir_block* h : dom.get_order()) {
+    // A back edge comes from a block the header dominates.
+    Loop loop{h, {h}};
+    std::vector<Ir_block*> work;
+    bool back = false;
+    for (Ir_block* p : h->get_predecessors()) {
+      if (!dom.dominates(h, p))
+        continue;
+      back = true;
+      if (loop.blocks.insert(p).second)
+        work.push_back(p);
+    }
+    if (!back)
+      continue;
+    // The loop is the header and the blocks that reach a back edge
+    // without passing through the header.
+    while (!work.empty()) {
+      Ir_block* b = work.back();
+      work.pop_back();
+      for (Ir_block* p : b->get_predecessors()) {
+        if (dom.is_reachable(p) && loop.blocks.insert(p).second)
+          work.push_back(p);
+      }
+    }
+    loops.push_back(std::move(loop));
+  }
+  std::stable_sort(loops.begin(), loops.end(), [](Loop const& a, Loop const& b) {
+    return a.blocks.size() < b.blocks.size();
+  });
+  return loops;
+}
+
+/// Returns the block through which the loop is entered, or null if there
+/// is no single such block ending in a jump to the header.
+Ir_block*
+get_preheader(Loop const& loop)
+{
+  Ir_block* pre = nullptr;
+  for (Ir_block* p : loop.header->get_predecessors()) {
+    if (loop.blocks.count(p))
+      continue;
+    if (pre)
+      return nullptr;
+    pre = p;
+  }
+  if (!pre || pre->get_terminator()->get_opcode() != br_ir)
+    return nullptr;
+  return pre;
+}
+
+/// Returns true if `i` may be executed before the loop. Loads are not
+/// moved, since the loop may store to the same object, and neither are
+/// instructions that can trap.
+bool
+is_movable(Ir_inst const* i)
+{
+  return i->is_pure() && !i->is_phi() && i->get_opcode() != load_ir;
+}
+
+/// Moves the invariant instructions of `loop` to its preheader. Returns
+/// true if any were moved.
+bool
+hoist(Loop const& loop, Ir_dominators const& dom)
+{
+  Ir_block* pre = get_preheader(loop);
+  if (!pre)
+    return false;
+
+  // Visit blocks in dominator order, so that operands computed in the
+  // loop are hoisted before their users are considered.
+  bool changed = false;
+  for (Ir_block* b : dom.get_order()) {
+    if (!loop.blocks.count(b))
+      continue;
+    std::vector<Ir_inst*> insts = b->get_instructions();
+    for (Ir_inst* i : insts) {
+      if (!is_movable(i))
+        continue;
+      bool invariant = std::none_of(i->get_operands().begin(), i->get_operands().end(), [&](Ir_inst* v) {
+        return loop.blocks.count(v->get_block());
+      });
+      if (!invariant)
+        continue;
+      b->remove(i);
+      pre->insert(pre->size() - 1, i);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+} // namespace
+
+
+bool
+hoist_invariants(Ir_function& fn)
+{
+  // Hoisting moves instructions but not edges, so the loops found at the
+  // start remain valid.
+  Ir_dominators dom(fn);
+  bool changed = false;
+  for (Loop const& loop : find_loops(dom))
+    changed = hoist(loop, dom) || changed;
+  return changed;
+}
@@ -0,0 +1,427 @@
+#include "opt.hpp"
+#include "ir.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+
+/// A value in the constant propagation lattice. Values start unknown
+/// and can only move down, to a constant and then to overdefined.
+struct Cell
+{
+  enum State
+  {
+    unknown,
+    constant,
+    overdefined,
+  };
+
+  State state = unknown;
+  /// The position in the lattice.
+
+  std::uint64_t bits = 0;
+  /// The encoding of a constant. Booleans and integers are stored as
+  /// integers, floats as their representation, and functions as their
+  /// address.
+};
+
+inline bool
+operator==(Cell const& a, Cell const& b)
+{
+  return a.state == b.state && (a.state != Cell::constant || a.bits == b.bits);
+}
+
+inline bool
+operator!=(Cell const& a, Cell const& b)
+{
+  return !(a == b);
+}
+
+inline Cell
+make_constant(std::uint64_t bits)
+{
+  return Cell{Cell::constant, bits};
+}
+
+inline Cell
+make_int(Int_value n)
+{
+  return make_constant(std::uint64_t(n));
+}
+
+inline Cell
+make_float(Float_value n)
+{
+  std::uint64_t bits;
+  std::memcpy(&bits, &n, sizeof bits);
+  return make_constant(bits);
+}
+
+inline Cell
+make_overdefined()
+{
+  return Cell{Cell::overdefined, 0};
+}
+
+inline Int_value
+get_int(Cell const& c)
+{
+  return Int_value(c.bits);
+}
+
+inline Float_value
+get_float(Cell const& c)
+{
+  Float_value n;
+  std::memcpy(&n, &c.bits, sizeof n);
+  return n;
+}
+
+/// Returns the meet of `a` and `b`.
+Cell
+meet(Cell const& a, Cell const& b)
+{
+  if (a.state == Cell::unknown)
+    return b;
+  if (b.state == Cell::unknown)
+    return a;
+  if (a == b)
+    return a;
+  return make_overdefined();
+}
+
+/// Folds integer division. Division by zero is not folded, so that it
+/// still traps at run time.
+Cell
+fold_div(Int_value a, Int_value b, bool rem)
+{
+  if (b == 0)
+    return make_overdefined();
+  // Wrap like the machine does instead of overflowing.
+  if (b == -1)
+    return make_int(rem ? 0 : Int_value(-std::uint64_t(a)));
+  return make_int(rem ? a % b : a / b);
+}
+
+/// Returns the value of `i` given the values of its operands, none of
+/// which are unknown or overdefined.
+Cell
+fold(Ir_inst const* i, Cell const* x, Cell const* y)
+{
+  auto wrap = [](std::uint64_t n) { return make_int(Int_value(n)); };
+  switch (i->get_opcode()) {
+  case add_i_ir: return wrap(x->bits + y->bits);
+  case sub_i_ir: return wrap(x->bits - y->bits);
+  case mul_i_ir: return wrap(x->bits * y->bits);
+  case div_i_ir: return fold_div(get_int(*x), get_int(*y), false);
+  case rem_i_ir: return fold_div(get_int(*x), get_int(*y), true);
+  case neg_i_ir: return wrap(-x->bits);
+  case rec_i_ir: return fold_div(1, get_int(*x), false);
+  case add_f_ir: return make_float(get_float(*x) + get_float(*y));
+  case sub_f_ir: return make_float(get_float(*x) - get_float(*y));
+  case mul_f_ir: return make_float(get_float(*x) * get_float(*y));
+  case div_f_ir: return make_float(get_float(*x) / get_float(*y));
+  case neg_f_ir: return make_float(-get_float(*x));
+  case rec_f_ir: return make_float(1.0 / get_float(*x));
+  case eq_i_ir: return make_int(get_int(*x) == get_int(*y));
+  case ne_i_ir: return make_int(get_int(*x) != get_int(*y));
+  case lt_i_ir: return make_int(get_int(*x) < get_int(*y));
+  case gt_i_ir: return make_int(get_int(*x) > get_int(*y));
+  case le_i_ir: return make_int(get_int(*x) <= get_int(*y));
+  case ge_i_ir: return make_int(get_int(*x) >= get_int(*y));
+  case eq_f_ir: return make_int(get_float(*x) == get_float(*y));
+  case ne_f_ir: return make_int(get_float(*x) != get_float(*y));
+  case lt_f_ir: return make_int(get_float(*x) < get_float(*y));
+  case gt_f_ir: return make_int(get_float(*x) > get_float(*y));
+  case le_f_ir: return make_int(get_float(*x) <= get_float(*y));
+  case ge_f_ir: return make_int(get_float(*x) >= get_float(*y));
+  case eq_p_ir: return make_int(x->bits == y->bits);
+  case ne_p_ir: return make_int(x->bits != y->bits);
+  case not_b_ir: return make_int(x->bits == 0);
+  default:
+    break;
+  }
+  return make_overdefined();
+}
+
+
+/// Sparse conditional constant propagation over one function.
+///
+/// Values are evaluated only in blocks reached by executable edges, and
+/// the operands of a phi only over executable incoming edges. The
+/// targets of a conditional branch become executable as the condition
+/// does.
+struct Propagator
+{
+  using Edge = std::pair<Ir_block*, Ir_block*>;
+
+  Propagator(Ir_function& fn) : fn(fn) { }
+
+  Cell const& get(Ir_inst* i) { return cells[i]; }
+
+  /// Lowers the value of `i` to `c`, queueing its users if it changed.
+  void set(Ir_inst* i, Cell const& c)
+  {
+    Cell& old = cells[i];
+    if (old == c)
+      return;
+    old = c;
+    for (Ir_inst* u : i->get_users())
+      values.push_back(u);
+  }
+
+  void reach(Ir_block* from, Ir_block* to)
+  {
+    edges.emplace_back(from, to);
+  }
+
+  /// Evaluates an instruction of an executable block.
+  void evaluate(Ir_inst* i)
+  {
+    switch (i->get_opcode()) {
+    case br_ir:
+      reach(i->get_block(), i->get_target(0));
+      return;
+    case cbr_ir: {
+      Cell const& c = get(i->get_operand(0));
+      if (c.state == Cell::unknown)
+        return;
+      if (c.state == Cell::overdefined || c.bits)
+        reach(i->get_block(), i->get_target(0));
+      if (c.state == Cell::overdefined || !c.bits)
+        reach(i->get_block(), i->get_target(1));
+      return;
+    }
+    case ret_ir:
+    case store_ir:
+      return;
+    case const_b_ir:
+    case const_i_ir:
+      set(i, make_int(i->get_int()));
+      return;
+    case const_f_ir:
+      set(i, make_float(i->get_float()));
+      return;
+    case const_fn_ir:
+      set(i, make_constant(std::uint64_t(std::uintptr_t(i->get_function()))));
+      return;
+    case phi_ir:
+      evaluate_phi(i);
+      return;
+    default:
+      break;
+    }
+
+    if (i->get_num_operands() == 0 || i->get_num_operands() > 2) {
+      set(i, make_overdefined());
+      return;
+    }
+    Cell const* ops[2] = {};
+    for (std::size_t n = 0; n < i->get_num_operands(); ++n) {
+      ops[n] = &get(i->get_operand(n));
+      if (ops[n]->state == Cell::overdefined) {
+        set(i, make_overdefined());
+        return;
+      }
+    }
+    for (std::size_t n = 0; n < i->get_num_operands(); ++n) {
+      if (ops[n]->state == Cell::unknown)
+        return;
+    }
+    Cell c = fold(i, ops[0], ops[1]);
+    set(i, meet(get(i), c));
+  }
+
+  void evaluate_phi(Ir_inst* phi)
+  {
+    Ir_block* b = phi->get_block();
+    Cell c;
+    for (std::size_t n = 0; n < phi->get_num_operands(); ++n) {
+      if (executable.count(Edge(b->get_predecessors()[n], b)))
+        c = meet(c, get(phi->get_operand(n)));
+    }
+    set(phi, c);
+  }
+
+  void solve()
+  {
+    edges.emplace_back(nullptr, fn.get_entry());
+    while (!edges.empty() || !values.empty()) {
+      while (!edges.empty()) {
+        Edge e = edges.back();
+        edges.pop_back();
+        if (!executable.insert(e).second)
+          continue;
+        Ir_block* b = e.second;
+        if (reached.insert(b).second) {
+          for (Ir_inst* i : *b)
+            evaluate(i);
+        }
+        else {
+          for (Ir_inst* i : *b) {
+            if (!i->is_phi())
+              break;
+            evaluate(i);
+          }
+        }
+      }
+      while (!values.empty()) {
+        Ir_inst* i = values.back();
+        values.pop_back();
+        if (i->get_block() && reached.count(i->get_block()))
+          evaluate(i);
+      }
+    }
+  }
+
+  /// Creates the constant `c` of type `t`.
+  Ir_inst* materialize(Cell const& c, Ir_type t)
+  {
+    Ir_inst* k;
+    switch (t) {
+    case bool_ty:
+      k = fn.make(const_b_ir, t);
+      k->set_int(get_int(c));
+      break;
+    case int_ty:
+      k = fn.make(const_i_ir, t);
+      k->set_int(get_int(c));
+      break;
+    case float_ty:
+      k = fn.make(const_f_ir, t);
+      k->set_float(get_float(c));
+      break;
+    case fn_ty:
+      k = fn.make(const_fn_ir, t);
+      k->set_function(reinterpret_cast<Fn_decl const*>(std::uintptr_t(c.bits)));
+      break;
+    default:
+      return nullptr;
+    }
+    return k;
+  }
+
+  /// Replaces constant values and folds constant branches. Returns true
+  /// if anything changed.
+  bool rewrite()
+  {
+    bool changed = false;
+    for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+      Ir_block* b = fn.get_block(n);
+      if (!reached.count(b))
+        continue;
+      // Decide the branch before its condition is replaced.
+      Ir_inst* t = b->get_terminator();
+      Cell cond;
+      if (t && t->get_opcode() == cbr_ir)
+        cond = get(t->get_operand(0));
+
+      std::vector<Ir_inst*> insts = b->get_instructions();
+      std::size_t phis = 0;
+      while (phis < insts.size() && insts[phis]->is_phi())
+        ++phis;
+      for (Ir_inst* i : insts) {
+        Cell const& c = get(i);
+        if (c.state != Cell::constant || i->is_constant())
+          continue;
+        Ir_inst* k = materialize(c, i->get_type());
+        if (!k)
+          continue;
+        // Constants replacing phis go after the last phi.
+        auto const& cur = b->get_instructions();
+        std::size_t pos = i->is_phi() ? phis : std::find(cur.begin(), cur.end(), i) - cur.begin();
+        b->insert(pos, k);
+        i->replace_uses(k);
+        b->erase(i);
+        if (i->is_phi())
+          --phis;
+        changed = true;
+      }
+
+      if (cond.state == Cell::constant) {
+        Ir_block* taken = t->get_target(cond.bits ? 0 : 1);
+        Ir_block* other = t->get_target(cond.bits ? 1 : 0);
+        Ir_inst* br = fn.make(br_ir, no_ty);
+        br->set_target(0, taken);
+        b->erase(t);
+        b->append(br);
+        other->remove_predecessor(b);
+        changed = true;
+      }
+    }
+    if (changed)
+      fn.remove_unreachable();
+    return changed;
+  }
+
+  Ir_function& fn;
+
+  std::unordered_map<Ir_inst*, Cell> cells;
+  /// The value of each instruction.
+
+  std::set<Edge> executable;
+  /// The edges found to be executable. The entry is reached by an edge
+  /// from null.
+
+  std::unordered_set<Ir_block*> reached;
+  /// The blocks with an executable incoming edge.
+
+  std::vector<Edge> edges;
+  /// The edges to be marked executable.
+
+  std::vector<Ir_inst*> values;
+  /// The instructions to be evaluated again.
+};
+
+
+/// Replaces phis whose operands are all the same value, or the phi
+/// itself, with that value. Removing blocks can leave such phis behind.
+bool
+remove_trivial_phis(Ir_function& fn)
+{
+  bool changed = false;
+  for (bool again = true; again; ) {
+    again = false;
+    for (std::size_t n = 0; n < fn.get_num_blocks(); ++n) {
+      Ir_block* b = fn.get_block(n);
+      std::vector<Ir_inst*> insts = b->get_instructions();
+      for (Ir_inst* phi : insts) {
+        if (!phi->is_phi())
+          break;
+        Ir_inst* same = nullptr;
+        bool trivial = true;
+        for (Ir_inst* op : phi->get_operands()) {
+          if (op == phi || op == same)
+            continue;
+          if (same)
+            trivial = false;
+          same = op;
+        }
+        if (!trivial || !same)
+          continue;
+        phi->replace_uses(same);
+        b->erase(phi);
+        changed = again = true;
+      }
+    }
+  }
+  return changed;
+}
+
+} // namespace
+
+
+bool
+propagate_constants(Ir_function& fn)
+{
+  Propagator prop(fn);
+  prop.solve();
+  bool changed = prop.rewrite();
+  return remove_trivial_phis(fn) || changed;
+}
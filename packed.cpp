@@ -0,0 +1,81 @@
+#include "packed.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+std::uint64_t
+Packed_value::box(Int_value n)
+{
+  return make(box_tag, new Int_value(n));
+}
+
+void
+Packed_value::copy_box(Packed_value const& x)
+{
+  m_bits = box(*static_cast<Int_value*>(x.get_pointer()));
+}
+
+void
+Packed_value::free_box(std::uint64_t bits)
+{
+  delete reinterpret_cast<Int_value*>(bits & payload_mask);
+}
+
+void
+Packed_value::assign(Packed_value const& x)
+{
+  if (this == &x)
+    return;
+  if (is_boxed())
+    free_box(m_bits);
+  m_bits = x.m_bits;
+  if (is_boxed())
+    copy_box(x);
+}
+
+Packed_value::Packed_value(Value const& val)
+  : Packed_value()
+{
+  switch (val.get_kind()) {
+  case Value::non_val:
+    break;
+  case Value::int_val:
+    *this = Packed_value(val.get_int());
+    break;
+  case Value::float_val:
+    *this = Packed_value(val.get_float());
+    break;
+  case Value::fn_val:
+    *this = Packed_value(val.get_function());
+    break;
+  default:
+    throw std::logic_error("cannot pack value");
+  }
+}
+
+Value
+Packed_value::to_value() const
+{
+  if (is_float())
+    return Value(get_float());
+  switch (get_tag()) {
+  case non_tag:
+    return Value();
+  case int_tag:
+  case box_tag:
+    return Value(get_int());
+  case fn_tag:
+    return Value(get_function());
+  default:
+    break;
+  }
+  throw std::logic_error("cannot unpack address");
+}
+
+std::ostream&
+operator<<(std::ostream& os, Packed_value const& val)
+{
+  if (val.is_address())
+    return os << '<' << "object" << ' ' << val.get_address() << '>';
+  return os << val.to_value();
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+class Object;
+
+
+/// An 8-byte encoding of a runtime value, used for the storage of objects
+/// and for the operands of the evaluator.
+///
+/// Floating point values are stored as their IEEE 754 bit patterns. All
+/// other values are stored in the space of negative quiet NaNs: the high
+/// 16 bits hold a tag and the low 48 bits hold a payload. Arithmetic does
+/// produce negative quiet NaNs; on x86-64, an invalid operation such as
+/// 0.0 / 0.0 yields the default NaN 0xfff8000000000000. That NaN is
+/// harmless only because its high 16 bits are below non_tag; a NaN with
+/// other payload bits, from memory or from another operation, may read
+/// as a tag. The encoding is sound because the float constructor replaces
+/// every NaN with the positive quiet NaN 0x7ff8000000000000. Raw double
+/// bits must never be stored except through that constructor.
+///
+/// Integers that fit in 48 bits are stored in the payload. Larger integers
+/// are boxed: the payload points to a heap-allocated Int_value owned by
+/// the packed value. Functions and addresses are stored as pointers, which
+/// requires user-space addresses to fit in 48 bits, as they do on x86-64
+/// and AArch64. An address is the Object it designates, or for the
+/// virtual machine, the register or static cell it designates.
+class Packed_value
+{
+public:
+  Packed_value();
+  /// Constructs an indeterminate value.
+
+  explicit Packed_value(bool b);
+  /// Constructs an integer value.
+
+  explicit Packed_value(Int_value n);
+  /// Constructs an integer value, boxing it if it does not fit in 48 bits.
+
+  explicit Packed_value(Float_value n);
+  /// Constructs a floating point value.
+
+  explicit Packed_value(Fn_value f);
+  /// Constructs a function value.
+
+  explicit Packed_value(Object* obj);
+  /// Constructs the address of `obj`.
+
+  explicit Packed_value(Packed_value* cell);
+  /// Constructs the address of the virtual machine cell `cell`.
+
+  explicit Packed_value(Value const& val);
+  /// Packs `val`, which must not be an address.
+
+  Packed_value(Packed_value const& x);
+  Packed_value(Packed_value&& x);
+  ~Packed_value();
+
+  Packed_value& operator=(Packed_value const& x);
+  Packed_value& operator=(Packed_value&& x);
+
+  // Kind
+
+  bool is_indeterminate() const { return get_tag() == non_tag; }
+  /// Returns true if the value is indeterminate.
+
+  bool is_int() const { return get_tag() - int_tag <= box_tag - int_tag; }
+  /// Returns true if this is an integer value, boxed or not.
+
+  bool is_boxed() const { return get_tag() == box_tag; }
+  /// Returns true if this is an integer that does not fit in 48 bits.
+
+  bool is_float() const { return get_tag() < non_tag; }
+  /// Returns true if this is a floating point value.
+
+  bool is_function() const { return get_tag() == fn_tag; }
+  /// Returns true if this is a function value.
+
+  bool is_address() const { return get_tag() == addr_tag; }
+  /// Returns true if this is an address.
+
+  // Accessors
+
+  Int_value get_int() const;
+  /// Returns the integer value.
+
+  Float_value get_float() const;
+  /// Returns the floating point value.
+
+  Fn_value get_function() const;
+  /// Returns the function value.
+
+  Object* get_address() const;
+  /// Returns the designated object.
+
+  Packed_value* get_cell() const;
+  /// Returns the designated virtual machine cell.
+
+  std::uint64_t get_bits() const { return m_bits; }
+  /// Returns the encoding of the value.
+
+  Value to_value() const;
+  /// Returns the value as a Value. The value must not be an address.
+
+  /// The high 16 bits of a packed value that is not a float. Tags are
+  /// ordered so that integers are a contiguous range and every float tag
+  /// is below non_tag. They are public so that code generators can test
+  /// encodings directly.
+  enum Tag : std::uint64_t
+  {
+    non_tag = 0xfff9,
+    int_tag = 0xfffa,
+    box_tag = 0xfffb,
+    fn_tag = 0xfffc,
+    addr_tag = 0xfffd,
+  };
+
+  static constexpr int payload_bits = 48;
+  /// The number of bits below the tag.
+
+private:
+  static constexpr std::uint64_t payload_mask = (std::uint64_t(1) << payload_bits) - 1;
+
+  static std::uint64_t make(Tag t, std::uint64_t p) { return (std::uint64_t(t) << payload_bits) | p; }
+  static std::uint64_t make(Tag t, void const* p);
+  static bool fits(Int_value n);
+
+  std::uint64_t get_tag() const { return m_bits >> payload_bits; }
+  void* get_pointer() const { return reinterpret_cast<void*>(m_bits & payload_mask); }
+
+  // Boxed integers are rare, so their handling is kept out of line. Boxes
+  // are freed by their bits so that no packed value's address escapes.
+  static std::uint64_t box(Int_value n);
+  void copy_box(Packed_value const& x);
+  static void free_box(std::uint64_t bits);
+  void assign(Packed_value const& x);
+
+  std::uint64_t m_bits;
+  /// The encoded value.
+};
+
+static_assert(sizeof(Packed_value) == 8, "packed values must be 8 bytes");
+
+inline std::uint64_t
+Packed_value::make(Tag t, void const* p)
+{
+  std::uintptr_t n = reinterpret_cast<std::uintptr_t>(p);
+  assert((n & ~payload_mask) == 0);
+  return make(t, std::uint64_t(n));
+}
+
+inline bool
+Packed_value::fits(Int_value n)
+{
+  // True when sign-extending the low 48 bits reproduces n.
+  return (Int_value(std::uint64_t(n) << (64 - payload_bits)) >> (64 - payload_bits)) == n;
+}
+
+inline
+Packed_value::Packed_value()
+  : m_bits(make(non_tag, std::uint64_t(0)))
+{ }
+
+inline
+Packed_value::Packed_value(bool b)
+  : m_bits(make(int_tag, std::uint64_t(b)))
+{ }
+
+inline
+Packed_value::Packed_value(Int_value n)
+{
+  if (fits(n))
+    m_bits = make(int_tag, std::uint64_t(n) & payload_mask);
+  else
+    m_bits = box(n);
+}
+
+inline
+Packed_value::Packed_value(Float_value n)
+{
+  if (n != n)
+    m_bits = 0x7ff8000000000000ull;
+  else
+    std::memcpy(&m_bits, &n, sizeof n);
+}
+
+inline
+Packed_value::Packed_value(Fn_value f)
+  : m_bits(make(fn_tag, f))
+{ }
+
+inline
+Packed_value::Packed_value(Object* obj)
+  : m_bits(make(addr_tag, obj))
+{ }
+
+inline
+Packed_value::Packed_value(Packed_value* cell)
+  : m_bits(make(addr_tag, cell))
+{ }
+
+inline
+Packed_value::Packed_value(Packed_value const& x)
+  : m_bits(x.m_bits)
+{
+  if (is_boxed())
+    copy_box(x);
+}
+
+inline
+Packed_value::Packed_value(Packed_value&& x)
+  : m_bits(x.m_bits)
+{
+  x.m_bits = make(non_tag, std::uint64_t(0));
+}
+
+inline
+Packed_value::~Packed_value()
+{
+  if (is_boxed())
+    free_box(m_bits);
+}
+
+inline Packed_value&
+Packed_value::operator=(Packed_value const& x)
+{
+  if (!is_boxed() && !x.is_boxed())
+    m_bits = x.m_bits;
+  else
+    assign(x);
+  return *this;
+}
+
+inline Packed_value&
+Packed_value::operator=(Packed_value&& x)
+{
+  // Taking the bits before freeing makes self-move safe without
+  // comparing addresses, so a moved temporary can stay in a register.
+  std::uint64_t bits = x.m_bits;
+  x.m_bits = make(non_tag, std::uint64_t(0));
+  if (is_boxed())
+    free_box(m_bits);
+  m_bits = bits;
+  return *this;
+}
+
+inline Int_value
+Packed_value::get_int() const
+{
+  assert(is_int());
+  if (get_tag() == int_tag)
+    return Int_value(m_bits << (64 - payload_bits)) >> (64 - payload_bits);
+  return *static_cast<Int_value*>(get_pointer());
+}
+
+inline Float_value
+Packed_value::get_float() const
+{
+  assert(is_float());
+  Float_value n;
+  std::memcpy(&n, &m_bits, sizeof n);
+  return n;
+}
+
+inline Fn_value
+Packed_value::get_function() const
+{
+  assert(is_function());
+  return static_cast<Fn_value>(get_pointer());
+}
+
+inline Object*
+Packed_value::get_address() const
+{
+  assert(is_address());
+  return static_cast<Object*>(get_pointer());
+}
+
+inline Packed_value*
+Packed_value::get_cell() const
+{
+  assert(is_address());
+  return static_cast<Packed_value*>(get_pointer());
+}
+
+
+// Operations
+
+std::ostream& operator<<(std::ostream& os, Packed_value const& val);
@@ -1,8 +1,9 @@
 #pragma once
+#include <cassert>
 #include <utility>
 #include <vector>
 #include <unordered_map>
-#include "parser.hpp"
+#include "symbol.hpp"
 #include "decl.hpp"
 
 
@@ -16,10 +17,10 @@ struct Scope : std::unordered_map<Symbol, Decl*>
     return iter->second;
   }
 
-  void declare(Decl* d)
+  void declare(Symbol sym, Decl* d)
   {
-    //assert(std::count(d) == 0);
-    //emplace(d->get_name(), d);
+    assert(count(sym) == 0);
+    emplace(sym, d);
   }
 };
 
@@ -34,9 +35,113 @@ struct Scope_stack : std::vector<Scope>
     }
     return nullptr;
   }
+};
+
+
+/// The innermost declaration of a symbol and the depth of the scope
+/// in which it was declared.
+struct Binding
+{
+  Decl* decl;
+  /// The declaration, or null if the symbol is not bound.
 
-  Scope back() 
+  int depth;
+  /// The scope depth of the declaration.
+};
+
+
+/// Resolves symbols to declarations using a single array indexed by
+/// symbol id. Each entry holds the innermost visible binding, so lookup
+/// is independent of the nesting depth. Declaring a symbol saves the
+/// binding it shadows in an undo log, and leaving a scope restores the
+/// bindings saved since the scope was entered. No storage is allocated
+/// per scope beyond a mark in the log.
+class Resolver
+{
+public:
+  Resolver();
+
+  void enter_scope();
+  /// Enters a new innermost scope.
+
+  void leave_scope();
+  /// Leaves the innermost scope, removing its declarations.
+
+  int get_depth() const { return m_marks.size(); }
+  /// Returns the number of enclosing scopes.
+
+  bool declare(Symbol sym, Decl* d);
+  /// Binds `sym` to `d` in the innermost scope. Returns false, leaving
+  /// the existing binding in place, if `sym` is already declared in that
+  /// scope.
+
+  Decl* lookup(Symbol sym) const;
+  /// Returns the innermost declaration of `sym`, or null if it is not
+  /// declared.
+
+private:
+  struct Saved
   {
-    return this->back(); 
-  }
+    int sym;
+    Binding prev;
+  };
+  /// A binding replaced by a declaration.
+
+  std::vector<Binding> m_bindings;
+  /// The innermost binding of each symbol, indexed by symbol id.
+
+  std::vector<Saved> m_undo;
+  /// The bindings shadowed by declarations in the current scopes.
+
+  std::vector<std::size_t> m_marks;
+  /// The size of the undo log when each scope was entered.
 };
+
+inline
+Resolver::Resolver()
+  : m_bindings(), m_undo(), m_marks()
+{ }
+
+inline void
+Resolver::enter_scope()
+{
+  m_marks.push_back(m_undo.size());
+}
+
+inline void
+Resolver::leave_scope()
+{
+  assert(!m_marks.empty());
+  std::size_t mark = m_marks.back();
+  m_marks.pop_back();
+  while (m_undo.size() > mark) {
+    Saved const& s = m_undo.back();
+    m_bindings[s.sym] = s.prev;
+    m_undo.pop_back();
+  }
+}
+
+inline bool
+Resolver::declare(Symbol sym, Decl* d)
+{
+  int n = sym.get_id();
+  assert(n >= 0);
+  if (std::size_t(n) >= m_bindings.size())
+    m_bindings.resize(n + 1, Binding{nullptr, 0});
+
+  Binding& b = m_bindings[n];
+  if (b.decl && b.depth == get_depth())
+    return false;
+  m_undo.push_back(Saved{n, b});
+  b = Binding{d, get_depth()};
+  return true;
+}
+
+inline Decl*
+Resolver::lookup(Symbol sym) const
+{
+  std::size_t n = sym.get_id();
+  if (n >= m_bindings.size())
+    return nullptr;
+  return m_bindings[n].decl;
+}
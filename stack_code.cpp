@@ -0,0 +1,138 @@
+#include "stack_code.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+Stack_code::Stack_code()
+  : m_bytes(), m_depth(0), m_max(0)
+{ }
+
+void
+Stack_code::emit_push(Int_value n)
+{
+  if (-128 <= n && n <= 127) {
+    m_bytes.push_back(push8_sop);
+    m_bytes.push_back(std::uint8_t(n));
+  }
+  else {
+    m_bytes.push_back(push64_sop);
+    std::uint64_t u = n;
+    for (int i = 0; i < 8; ++i)
+      m_bytes.push_back(std::uint8_t(u >> (8 * i)));
+  }
+  m_max = std::max(m_max, ++m_depth);
+}
+
+void
+Stack_code::emit(Stack_op op)
+{
+  assert(op != push8_sop && op != push64_sop);
+  assert(m_depth >= 2);
+  m_bytes.push_back(op);
+  --m_depth;
+}
+
+/// Returns the 8-byte immediate at `p`.
+static Int_value
+read_imm64(unsigned char const* p)
+{
+  std::uint64_t u = 0;
+  for (int i = 0; i < 8; ++i)
+    u |= std::uint64_t(p[i]) << (8 * i);
+  return Int_value(u);
+}
+
+void
+Stack_code::disassemble(std::ostream& os) const
+{
+  unsigned char const* p = data();
+  unsigned char const* last = p + size();
+  while (p != last) {
+    switch (*p++) {
+    case push8_sop:
+      os << "push " << Int_value(std::int8_t(*p)) << '\n';
+      p += 1;
+      break;
+    case push64_sop:
+      os << "push " << read_imm64(p) << '\n';
+      p += 8;
+      break;
+    case add_sop:
+      os << "add\n";
+      break;
+    case sub_sop:
+      os << "sub\n";
+      break;
+    case mul_sop:
+      os << "mul\n";
+      break;
+    case div_sop:
+      os << "div\n";
+      break;
+    case rem_sop:
+      os << "rem\n";
+      break;
+    default:
+      throw std::logic_error("invalid stack instruction");
+    }
+  }
+}
+
+Int_value
+execute(Stack_code const& code)
+{
+  // The operands are held in 64-bit words so arithmetic can wrap.
+  std::unique_ptr<std::uint64_t[]> stack(new std::uint64_t[code.get_max_depth() + 1]);
+  std::uint64_t* top = stack.get();
+
+  unsigned char const* p = code.data();
+  unsigned char const* last = p + code.size();
+  while (p != last) {
+    switch (*p++) {
+    case push8_sop:
+      *++top = std::uint64_t(Int_value(std::int8_t(*p)));
+      p += 1;
+      break;
+    case push64_sop:
+      *++top = read_imm64(p);
+      p += 8;
+      break;
+    case add_sop:
+      top[-1] += top[0];
+      --top;
+      break;
+    case sub_sop:
+      top[-1] -= top[0];
+      --top;
+      break;
+    case mul_sop:
+      top[-1] *= top[0];
+      --top;
+      break;
+    case div_sop: {
+      Int_value a = top[-1];
+      Int_value b = top[0];
+      if (b == 0)
+        throw std::runtime_error("division by zero");
+      top[-1] = (b == -1) ? -std::uint64_t(a) : std::uint64_t(a / b);
+      --top;
+      break;
+    }
+    case rem_sop: {
+      Int_value a = top[-1];
+      Int_value b = top[0];
+      if (b == 0)
+        throw std::runtime_error("division by zero");
+      top[-1] = (b == -1) ? 0 : std::uint64_t(a % b);
+      --top;
+      break;
+    }
+    default:
+      throw std::logic_error("invalid stack instruction");
+    }
+  }
+  assert(top == stack.get() + 1);
+  return Int_value(*top);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+
+/// The operations of the stack machine. Each opcode is one byte. The
+/// push instructions are followed by their immediate operand.
+enum Stack_op : std::uint8_t
+{
+  push8_sop,
+  /// Pushes the following signed byte.
+
+  push64_sop,
+  /// Pushes the following 8-byte little-endian integer.
+
+  add_sop,
+  sub_sop,
+  mul_sop,
+  div_sop,
+  rem_sop,
+  /// Pops the right and left operands and pushes the result.
+};
+
+
+/// An encoded stack machine program that evaluates an integer
+/// expression.
+///
+/// The emitter tracks the depth of the stack so the executor can allocate
+/// it once. The text form written by disassemble is the one previously
+/// written by the Generator: one `push n`, `add`, `sub`, `mul`, `div`,
+/// or `rem` per line.
+class Stack_code
+{
+public:
+  Stack_code();
+
+  void emit_push(Int_value n);
+  /// Appends an instruction that pushes `n`.
+
+  void emit(Stack_op op);
+  /// Appends the arithmetic instruction `op`.
+
+  unsigned char const* data() const { return m_bytes.data(); }
+  /// Returns the encoded instructions.
+
+  std::size_t size() const { return m_bytes.size(); }
+  /// Returns the number of bytes of code.
+
+  int get_max_depth() const { return m_max; }
+  /// Returns the greatest depth of the stack during execution.
+
+  void disassemble(std::ostream& os) const;
+  /// Writes the text form of the code.
+
+private:
+  std::vector<unsigned char> m_bytes;
+  /// The encoded instructions.
+
+  int m_depth;
+  /// The depth of the stack after the last instruction.
+
+  int m_max;
+  /// The greatest depth of the stack.
+};
+
+
+Int_value execute(Stack_code const& code);
+/// Executes `code`, which must leave exactly one value on the stack, and
+/// returns that value. Arithmetic wraps on overflow. Throws an exception
+/// on division by zero.
@@ -0,0 +1,229 @@
+#include "stats.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+bool node_stats_enabled = false;
+
+static constexpr int num_expr_kinds = 0
+#define def_expr(K, T) + 1
+#include "expr.def"
+  ;
+
+static constexpr int num_stmt_kinds = 0
+#define def_stmt(K, T) + 1
+#include "stmt.def"
+  ;
+
+static constexpr int num_decl_kinds = 0
+#define def_decl(K, T) + 1
+#include "decl.def"
+  ;
+
+static constexpr int num_type_kinds = 0
+#define def_type(K, T) + 1
+#include "type.def"
+  ;
+
+static Node_count expr_counts[num_expr_kinds];
+static Node_count stmt_counts[num_stmt_kinds];
+static Node_count decl_counts[num_decl_kinds];
+static Node_count type_counts[num_type_kinds];
+
+static std::size_t
+get_expr_size(Expr::Kind k)
+{
+  switch (k) {
+#define def_expr(K, T) case Expr::K: return sizeof(T);
+#include "expr.def"
+  }
+  return 0;
+}
+
+static std::size_t
+get_stmt_size(Stmt::Kind k)
+{
+  switch (k) {
+#define def_stmt(K, T) case Stmt::K: return sizeof(T);
+#include "stmt.def"
+  }
+  return 0;
+}
+
+static std::size_t
+get_decl_size(Decl::Kind k)
+{
+  switch (k) {
+#define def_decl(K, T) case Decl::K: return sizeof(T);
+#include "decl.def"
+  }
+  return 0;
+}
+
+static std::size_t
+get_type_size(Type::Kind k)
+{
+  switch (k) {
+#define def_type(K, T) case Type::K: return sizeof(T);
+#include "type.def"
+  }
+  return 0;
+}
+
+/// Returns the counts for category `c` and their number.
+static std::pair<Node_count*, int>
+get_counts(Node_category c)
+{
+  switch (c) {
+  case expr_node: return {expr_counts, num_expr_kinds};
+  case stmt_node: return {stmt_counts, num_stmt_kinds};
+  case decl_node: return {decl_counts, num_decl_kinds};
+  case type_node: return {type_counts, num_type_kinds};
+  }
+  return {nullptr, 0};
+}
+
+static char const*
+get_category_name(Node_category c)
+{
+  switch (c) {
+  case expr_node: return "expr";
+  case stmt_node: return "stmt";
+  case decl_node: return "decl";
+  case type_node: return "type";
+  }
+  return "<unknown>";
+}
+
+static char const*
+get_kind_name(Node_category c, int k)
+{
+  switch (c) {
+  case expr_node: return Expr::get_kind_name(Expr::Kind(k));
+  case stmt_node: return Stmt::get_kind_name(Stmt::Kind(k));
+  case decl_node: return Decl::get_kind_name(Decl::Kind(k));
+  case type_node: return Type::get_kind_name(Type::Kind(k));
+  }
+  return "<unknown>";
+}
+
+static std::size_t
+get_node_size(Node_category c, int k)
+{
+  switch (c) {
+  case expr_node: return get_expr_size(Expr::Kind(k));
+  case stmt_node: return get_stmt_size(Stmt::Kind(k));
+  case decl_node: return get_decl_size(Decl::Kind(k));
+  case type_node: return get_type_size(Type::Kind(k));
+  }
+  return 0;
+}
+
+static void
+report_at_exit()
+{
+  report_node_stats(std::cerr);
+}
+
+void
+enable_node_stats(bool report)
+{
+  static bool registered = false;
+  node_stats_enabled = true;
+  if (report && !registered) {
+    std::atexit(report_at_exit);
+    registered = true;
+  }
+}
+
+void
+disable_node_stats()
+{
+  node_stats_enabled = false;
+}
+
+void
+reset_node_stats()
+{
+  for (Node_category c : {expr_node, stmt_node, decl_node, type_node}) {
+    auto counts = get_counts(c);
+    for (int k = 0; k < counts.second; ++k)
+      counts.first[k] = Node_count {};
+  }
+}
+
+void
+record_node(Node_category c, int k)
+{
+  auto counts = get_counts(c);
+  assert(0 <= k && k < counts.second);
+  Node_count& n = counts.first[k];
+  ++n.constructed;
+  n.bytes += get_node_size(c, k);
+}
+
+void
+record_operands(Node_category c, int k, std::size_t n)
+{
+  auto counts = get_counts(c);
+  assert(0 <= k && k < counts.second);
+  counts.first[k].bytes += n * sizeof(void*);
+}
+
+Node_count
+get_node_count(Node_category c, int k)
+{
+  auto counts = get_counts(c);
+  assert(0 <= k && k < counts.second);
+  return counts.first[k];
+}
+
+Node_count
+get_node_total(Node_category c)
+{
+  Node_count total {};
+  auto counts = get_counts(c);
+  for (int k = 0; k < counts.second; ++k) {
+    total.constructed += counts.first[k].constructed;
+    total.bytes += counts.first[k].bytes;
+  }
+  return total;
+}
+
+void
+report_node_stats(std::ostream& os)
+{
+  os << std::left << std::setw(20) << "kind"
+     << std::right << std::setw(12) << "constructed"
+     << std::setw(14) << "bytes" << '\n';
+
+  Node_count all {};
+  for (Node_category c : {expr_node, stmt_node, decl_node, type_node}) {
+    auto counts = get_counts(c);
+    for (int k = 0; k < counts.second; ++k) {
+      Node_count n = counts.first[k];
+      if (n.constructed == 0)
+        continue;
+      os << std::left << std::setw(20) << get_kind_name(c, k)
+         << std::right << std::setw(12) << n.constructed
+         << std::setw(14) << n.bytes << '\n';
+    }
+    Node_count total = get_node_total(c);
+    os << std::left << std::setw(20) << std::string("total ") + get_category_name(c)
+       << std::right << std::setw(12) << total.constructed
+       << std::setw(14) << total.bytes << '\n';
+    all.constructed += total.constructed;
+    all.bytes += total.bytes;
+  }
+  os << std::left << std::setw(20) << "total"
+     << std::right << std::setw(12) << all.constructed
+     << std::setw(14) << all.bytes << '\n';
+}
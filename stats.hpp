@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+
+
+/// The categories of nodes whose constructions are counted.
+enum Node_category
+{
+  expr_node,
+  stmt_node,
+  decl_node,
+  type_node,
+};
+
+
+/// The number and total size of the nodes of a single kind constructed
+/// while counting is enabled.
+///
+/// Every construction is counted, wherever the node is stored. This
+/// includes temporaries and the base types that each Type_table builds,
+/// so the counts are an upper bound on the heap allocations of a phase
+/// that creates its builder before counting starts.
+struct Node_count
+{
+  std::size_t constructed;
+  /// The number of nodes constructed.
+
+  std::size_t bytes;
+  /// The number of bytes occupied by those nodes: the size of each node
+  /// plus one pointer for each operand of a k-ary node. Operand arrays
+  /// are allocated separately and may have unused capacity, which is not
+  /// counted.
+};
+
+
+extern bool node_stats_enabled;
+/// True when node constructions are being counted.
+
+
+// Operations
+
+void enable_node_stats(bool report_at_exit = true);
+/// Start counting node constructions. When `report_at_exit` is true, a
+/// summary table is written to `std::cerr` when the program exits.
+
+void disable_node_stats();
+/// Stop counting node constructions.
+
+void reset_node_stats();
+/// Discard all counts.
+
+void record_node(Node_category c, int k);
+/// Count the construction of a node of kind `k` in category `c`.
+
+void record_operands(Node_category c, int k, std::size_t n);
+/// Count `n` operands added to a node of kind `k` in category `c`.
+
+Node_count get_node_count(Node_category c, int k);
+/// Returns the count for nodes of kind `k` in category `c`.
+
+Node_count get_node_total(Node_category c);
+/// Returns the count for all nodes in category `c`.
+
+void report_node_stats(std::ostream& os);
+/// Write a summary table of all counts to `os`.
+
+
+inline void
+note_node(Node_category c, int k)
+{
+  if (node_stats_enabled)
+    record_node(c, k);
+}
+
+inline void
+note_operands(Node_category c, int k, std::size_t n)
+{
+  if (node_stats_enabled)
+    record_operands(c, k, n);
+}
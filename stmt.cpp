@@ -1,17 +1,59 @@
 #include "stmt.hpp"
+#include "type.hpp"
+#include "expr.hpp"
+#include "decl.hpp"
+
+#include <algorithm>
 
 char const*
 Stmt::get_kind_name() const
 {
-  switch (m_kind) {
-  case skip_stmt: return "skip_stmt";
-  case block_stmt: return "block_stmt";
-  case if_stmt: return "if_stmt";
-  case while_stmt: return "while_stmt";
-  case break_stmt: return "break_stmt";
-  case cont_stmt: return "cont_stmt";
-  case ret_stmt: return "ret_stmt";
-  case expr_stmt: return "expr_stmt";
-  case decl_stmt: return "decl_stmt";
+  return get_kind_name(m_kind);
+}
+
+char const*
+Stmt::get_kind_name(Kind k)
+{
+  switch (k) {
+#define def_stmt(K, T) case K: return #K;
+#include "stmt.def"
+  }
+  return "<unknown>";
+}
+
+/// Returns true if `e`, which has reference type, cannot designate a
+/// local variable of `fn`.
+static bool
+is_nonlocal(Fn_decl const* fn, Expr const* e)
+{
+  if (e->get_kind() == Expr::cond_expr) {
+    Cond_expr const* c = static_cast<Cond_expr const*>(e);
+    return is_nonlocal(fn, c->get_true_value()) && is_nonlocal(fn, c->get_false_value());
+  }
+  if (e->get_kind() != Expr::id_expr)
+    return false;
+  Decl* d = static_cast<Id_expr const*>(e)->get_declaration();
+  if (!d->is_variable())
+    return false;
+  if (static_cast<Var_decl*>(d)->has_static_storage())
+    return true;
+  // A reference parameter is bound to an object outside the frame.
+  if (!d->is_reference())
+    return false;
+  Node_range<Decl const> ps = fn->get_parameters();
+  return std::find(ps.begin(), ps.end(), d) != ps.end();
+}
+
+Call_expr const*
+get_tail_call(Fn_decl const* fn, Ret_stmt const* s)
+{
+  Expr const* e = s->get_return_value();
+  if (e->get_kind() != Expr::call_expr)
+    return nullptr;
+  Call_expr const* c = static_cast<Call_expr const*>(e);
+  for (Expr const* a : c->get_arguments()) {
+    if (a->get_type()->is_reference() && !is_nonlocal(fn, a))
+      return nullptr;
   }
-}
\ No newline at end of file
+  return c;
+}
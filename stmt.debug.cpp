@@ -2,6 +2,7 @@
 #include "expr.hpp"
 #include "decl.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -50,24 +51,30 @@ debug_decl(Printer& p, Decl_stmt const* s)
   // debug_decl(p, s->get_declaration());
 }
 
+namespace
+{
+
 // Some statements have non-statement "children".
+struct Debug_extra_kids : Const_stmt_visitor<Debug_extra_kids>
+{
+  Debug_extra_kids(Printer& p) : p(p) { }
+
+  void visit_if_stmt(If_stmt const* s) { debug_if(p, s); }
+  void visit_while_stmt(While_stmt const* s) { debug_while(p, s); }
+  void visit_ret_stmt(Ret_stmt const* s) { debug_ret(p, s); }
+  void visit_expr_stmt(Expr_stmt const* s) { debug_expr(p, s); }
+  void visit_decl_stmt(Decl_stmt const* s) { debug_decl(p, s); }
+  void visit_stmt(Stmt const* s) { }
+
+  Printer& p;
+};
+
+} // namespace
+
 static void
 debug_extra_kids(Printer& p, Stmt const* s)
 {
-  switch (s->get_kind()) {
-  default:
-    return;
-  case Stmt::if_stmt:
-    return debug_if(p, static_cast<If_stmt const*>(s));
-  case Stmt::while_stmt:
-    return debug_while(p, static_cast<While_stmt const*>(s));
-  case Stmt::ret_stmt:
-    return debug_ret(p, static_cast<Ret_stmt const*>(s));
-  case Stmt::expr_stmt:
-    return debug_expr(p, static_cast<Expr_stmt const*>(s));
-  case Stmt::decl_stmt:
-    return debug_decl(p, static_cast<Decl_stmt const*>(s));
-  }
+  Debug_extra_kids(p).visit(s);
 }
 
 static void
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "tree.hpp"
+#include "stats.hpp"
 #include "value.hpp"
 
 class Expr;
+class Call_expr;
 class Decl;
+class Fn_decl;
 class Printer;
 
 
@@ -14,15 +17,8 @@ class Stmt
 public:
   enum Kind
   {
-    skip_stmt,
-    block_stmt,
-    if_stmt,
-    while_stmt,
-    break_stmt,
-    cont_stmt,
-    ret_stmt,
-    expr_stmt,
-    decl_stmt,
+#define def_stmt(K, T) K,
+#include "stmt.def"
   };
 
 protected:
@@ -37,6 +33,9 @@ public:
   char const* get_kind_name() const;
   /// Returns the spelling of the kind.
 
+  static char const* get_kind_name(Kind k);
+  /// Returns the spelling of the kind `k`.
+
   // Children
 
   virtual Node_range<Stmt> get_children() = 0;
@@ -58,7 +57,9 @@ private:
 inline
 Stmt::Stmt(Kind k)
   : m_kind(k)
-{ }
+{
+  note_node(stmt_node, k);
+}
 
 // General purpose expression classes
 
@@ -152,17 +153,23 @@ public:
 inline
 Kary_stmt::Kary_stmt(Kind k, std::initializer_list<Stmt*> list)
   : Stmt(k), Base(list)
-{ }
+{
+  note_operands(stmt_node, k, get_arity());
+}
 
 inline
 Kary_stmt::Kary_stmt(Kind k, std::vector<Stmt*> const& vec)
   : Stmt(k), Base(vec)
-{ }
+{
+  note_operands(stmt_node, k, get_arity());
+}
 
 inline
 Kary_stmt::Kary_stmt(Kind k, std::vector<Stmt*>&& vec)
   : Stmt(k), Base(std::move(vec))
-{ }
+{
+  note_operands(stmt_node, k, get_arity());
+}
 
 
 
@@ -232,7 +239,7 @@ private:
 
 inline
 If_stmt::If_stmt(Expr* c, Stmt* s1, Stmt* s2)
-  : Binary_stmt(if_stmt, s1, s2)
+  : Binary_stmt(if_stmt, s1, s2), m_cond(c)
 { }
 
 
@@ -347,6 +354,13 @@ Decl_stmt::Decl_stmt(Decl* d)
 
 // Operations
 
+Call_expr const* get_tail_call(Fn_decl const* fn, Ret_stmt const* s);
+/// Returns the call whose result is returned by `s`, a return statement
+/// in the body of `fn`, if the callee can take over the frame of `fn`.
+/// That requires each reference argument to name a static variable or a
+/// reference parameter of `fn`, so that it cannot designate a local of
+/// `fn`. Otherwise returns null.
+
 void print_stmt(Printer& p, Stmt const* s);
 /// Print `s` using the given printer.
 
@@ -2,6 +2,7 @@
 #include "expr.hpp"
 #include "decl.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -36,29 +37,33 @@ print_ret(Printer& p, Ret_stmt const* s)
   print_expr(p, s->get_return_value());
 }
 
+namespace
+{
+
+/// Prints statements.
+///
+/// \todo Print conditional, loop, and declaration statements.
+struct Print_stmt : Const_stmt_visitor<Print_stmt>
+{
+  Print_stmt(Printer& p) : p(p) { }
+
+  void visit_skip_stmt(Skip_stmt const* s) { print_literal(p, "skip"); }
+  void visit_block_stmt(Block_stmt const* s) { print_block(p, s); }
+  void visit_break_stmt(Break_stmt const* s) { print_literal(p, "break"); }
+  void visit_cont_stmt(Cont_stmt const* s) { print_literal(p, "continue"); }
+  void visit_ret_stmt(Ret_stmt const* s) { print_ret(p, s); }
+  void visit_expr_stmt(Expr_stmt const* s) { print_expr(p, s); }
+  void visit_stmt(Stmt const* s) { assert(false); }
+
+  Printer& p;
+};
+
+} // namespace
+
 void
 print_stmt(Printer& p, Stmt const* s)
 {
-  switch (s->get_kind()) {
-  case Stmt::skip_stmt:
-    return print_literal(p, "skip");
-  case Stmt::block_stmt:
-    return print_block(p, static_cast<Block_stmt const*>(s));
-  case Stmt::if_stmt:
-  case Stmt::while_stmt:
-    break;
-  case Stmt::break_stmt:
-    return print_literal(p, "break");
-  case Stmt::cont_stmt:
-    return print_literal(p, "continue");
-  case Stmt::ret_stmt:
-    return print_ret(p, static_cast<Ret_stmt const*>(s));
-  case Stmt::expr_stmt:
-    return print_expr(p, static_cast<Expr_stmt const*>(s));
-  case Stmt::decl_stmt:
-    break;
-  }
-  assert(false);
+  Print_stmt(p).visit(s);
 }
 
 std::ostream&
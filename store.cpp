@@ -2,39 +2,48 @@
 #include "type.hpp"
 #include "decl.hpp"
 
-#include <algorithm>
 #include <iostream>
 
+Monotonic_store::Monotonic_store(int n)
+  : m_own_storage(new Object[n]), m_own_slots(new Object*[n]()), m_size(n),
+    m_storage(m_own_storage.get()), m_slots(m_own_slots.get())
+{ }
+
+Monotonic_store::Monotonic_store(int n, Object* objs, Object** slots)
+  : m_size(n), m_storage(objs), m_slots(slots)
+{ }
+
+/// Returns the slot index of `d`, which must be a variable.
+static int
+get_slot(Decl* d)
+{
+  assert(d->is_variable());
+  return static_cast<Var_decl*>(d)->get_slot();
+}
+
 Object*
 Monotonic_store::allocate(Decl* d)
 {
-  assert(m_lookup.count(d) == 0);
   assert(d->is_object());
-  m_storage.emplace_back(d->get_type());
-  m_lookup.emplace(d, m_storage.size() - 1);
-  return &m_storage.back();
+  int n = get_slot(d);
+  assert(0 <= n && n < m_size);
+  m_storage[n] = Object(d->get_type());
+  m_slots[n] = &m_storage[n];
+  return m_slots[n];
 }
 
 Object*
 Monotonic_store::locate(Decl* d)
 {
-  assert(m_lookup.count(d) != 0);
-  return &m_storage[m_lookup.find(d)->second];
-}
-
-static bool
-contains_object(std::vector<Object> const& store, Object* obj)
-{
-  auto iter = std::find_if(store.begin(), store.end(), [obj](Object const& x) {
-    return &x == obj;
-  });
-  return iter != store.end();
+  int n = get_slot(d);
+  assert(0 <= n && n < m_size && m_slots[n]);
+  return m_slots[n];
 }
 
 void
 Monotonic_store::alias(Decl* d, Object* obj)
 {
-  assert(m_lookup.count(d) == 0);
-  assert(contains_object(m_storage, obj));
-  m_lookup.emplace(d, obj - m_storage.data());
+  int n = get_slot(d);
+  assert(0 <= n && n < m_size);
+  m_slots[n] = obj;
 }
@@ -2,8 +2,7 @@
 
 #include "object.hpp"
 
-#include <unordered_map>
-#include <vector>
+#include <memory>
 
 class Decl;
 
@@ -11,24 +10,51 @@ class Decl;
 /// A store maintains a set of live objects. A monotonic store does not allow
 /// storage to be returned incrementally; all storage is released at the same
 /// time. This is used to implement the static store and automatic stores.
+///
+/// Objects are addressed by the slot index of their declaring variable
+/// (see Builder::layout_function), so the store is sized when it is
+/// created and lookup is an array index. The store never grows, so the
+/// address of an object is stable for the lifetime of the store and may
+/// be retained (e.g., by alias) without copying the object.
 class Monotonic_store
 {
 public:
+  explicit Monotonic_store(int n);
+  /// Constructs a store with `n` slots.
+
+  Monotonic_store(int n, Object* objs, Object** slots);
+  /// Constructs a store with `n` slots whose storage is provided by the
+  /// caller. Each of the `n` objects in `objs` must be constructed and
+  /// each of the `n` pointers in `slots` must be null. The storage must
+  /// outlive the store, and the caller destroys the objects after the
+  /// store. This is used to place automatic stores in the call stack.
+
+  Monotonic_store(Monotonic_store const&) = delete;
+  Monotonic_store& operator=(Monotonic_store const&) = delete;
+
   Object* allocate(Decl* d);
-  /// Allocate storage for an object.
+  /// Allocate storage for an object. If the slot of `d` already holds an
+  /// object (e.g., on a later iteration of a loop), it is replaced.
 
   Object* locate(Decl* d);
   /// Returns the object for the given declaration.
 
   void alias(Decl* d, Object* o);
   /// Make `d` an alias for the given object. This is used to support
-  /// reference binding.
+  /// reference binding. The object may reside in a different store.
 
 private:
-  std::vector<Object> m_storage;
-  /// The list of allocated objects.
-  
-  std::unordered_map<Decl*, int> m_lookup;
-  /// Associates a declaration with its corresponding object in
-  /// the store.
+  std::unique_ptr<Object[]> m_own_storage;
+  std::unique_ptr<Object*[]> m_own_slots;
+  /// The storage for the store, if it is owned.
+
+  int m_size;
+  /// The number of slots.
+
+  Object* m_storage;
+  /// The objects allocated in each slot.
+
+  Object** m_slots;
+  /// The object designated by each slot. This is either the slot's own
+  /// storage or, for references, an object bound by alias.
 };
@@ -1,57 +1,79 @@
 #pragma once
 
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 
 
 class Symbol
 {
   friend class Symbol_table;
-  
-  Symbol(std::string const* str) : m_str(str) { }
+
+  Symbol(std::string const* str, int id) : m_str(str), m_id(id) { }
   /// Constructs the symbol from `str`.
 
 public:
-  Symbol() : m_str() { }
+  Symbol() : m_str(), m_id(-1) { }
 
   std::string const& str() const { return *m_str; }
   /// Returns the spelling of the token.
 
-  friend bool operator==(Symbol a, Symbol b) 
+  int get_id() const { return m_id; }
+  /// Returns the dense id of the symbol. Symbols are numbered in the
+  /// order they are first entered in their table.
+
+  friend bool operator==(Symbol a, Symbol b)
   {
     return a.m_str == b.m_str;
   }
 
-  friend bool operator!=(Symbol a, Symbol b) 
+  friend bool operator!=(Symbol a, Symbol b)
   {
     return a.m_str != b.m_str;
   }
 
 private:
-  std::string const* m_str;  
+  std::string const* m_str;
+  int m_id;
 };
 
 
-class Symbol_table : std::unordered_set<std::string>
+class Symbol_table
 {
 public:
   Symbol get(std::string const& str);
   /// Returns the unique symbol for `str`.
-  
+
   Symbol get(char const* str);
   /// Returns the unique symbol for `str`.
+
+  Symbol get(int n) const { return m_syms[n]; }
+  /// Returns the symbol whose id is `n`.
+
+  std::size_t size() const { return m_syms.size(); }
+  /// Returns the number of symbols in the table.
+
+private:
+  std::unordered_map<std::string, int> m_ids;
+  /// Maps each spelling to its symbol id.
+
+  std::vector<Symbol> m_syms;
+  /// The symbols, indexed by id.
 };
 
 inline Symbol
 Symbol_table::get(std::string const& str)
 {
-  return &*emplace(str).first;
+  auto ins = m_ids.emplace(str, m_syms.size());
+  if (ins.second)
+    m_syms.push_back(Symbol(&ins.first->first, ins.first->second));
+  return m_syms[ins.first->second];
 }
 
 inline Symbol
 Symbol_table::get(char const* str)
 {
-  return &*emplace(str).first;
+  return get(std::string(str));
 }
 
 
@@ -66,4 +88,4 @@ namespace std
       return h(&sym.str());
     }
   };
-};
\ No newline at end of file
+};
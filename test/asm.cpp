@@ -0,0 +1,50 @@
+// Tests that the assembly backend computes what the evaluator computes,
+// including when more values are live across a call than there are
+// callee-saved registers, and when a local is passed by reference.
+
+#include "programs.hpp"
+
+#include "asmgen.hpp"
+#include "bytecode.hpp"
+#include "eval.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Evaluator ev(t.prog, t.statics);
+  Bytecode bc(t.prog, t.statics);
+  Asm_module am(t.prog, bc);
+
+  for (Test_call const& call : t.get_calls()) {
+    Value v1 = ev.call(call.fn, call.args);
+    Value v2 = am.call(call.fn, call.args);
+    assert(same_value(v1, v2));
+  }
+
+  // The fourteen locals of pressure and the result of its call are live
+  // at once, so some are spilled to stack slots.
+  for (Int_value n = 0; n < 12; ++n) {
+    Value v1 = ev.call(t.pressure, {Value(n)});
+    Value v2 = am.call(t.pressure, {Value(n)});
+    assert(same_value(v1, v2));
+  }
+
+  // twice passes its local to incr by reference.
+  for (Int_value n : {0, 1, -7, 1000}) {
+    Value v1 = ev.call(t.twice, {Value(n)});
+    Value v2 = am.call(t.twice, {Value(n)});
+    assert(same_value(v1, v2));
+  }
+
+  // Values wider than 48 bits pass through registers unboxed.
+  Int_value big = Int_value(1) << 50;
+  for (Int_value n : {big, -big, big - 1}) {
+    Value v1 = ev.call(t.boxed, {Value(n)});
+    Value v2 = am.call(t.boxed, {Value(n)});
+    assert(same_value(v1, v2));
+  }
+}
@@ -0,0 +1,62 @@
+// Tests that the builder diagnoses every ill-formed operand of a call or
+// an assignment once, and that an operand that is already an error is
+// not diagnosed again.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "type.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+
+  // fun f(a : int, b : int, c : int) -> int
+  Fn_decl* f = b.make_function(b.get_name("f"), b.get_function_type({i, i, i, i}));
+  Var_decl* x = b.make_variable(b.get_name("x"), i);
+
+  // A call with two ill-formed arguments reports both.
+  Expr* e = b.make_call({b.make_id(f), b.make_true(), b.make_int(1), new Float_expr(b.get_float_type(), Value(2.0))});
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 2);
+
+  // An argument that is already an error is not reported again.
+  b.clear_diagnostics();
+  Expr* bad = b.make_add(b.make_true(), b.make_int(1));
+  assert(b.get_diagnostics().size() == 1);
+  e = b.make_call({b.make_id(f), bad, b.make_int(1), b.make_false()});
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 2);
+
+  // A wrong number of arguments is reported once.
+  b.clear_diagnostics();
+  e = b.make_call({b.make_id(f), b.make_true()});
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 1);
+
+  // Both operands of an assignment are checked: the left operand is
+  // still diagnosed when the right one is ill-formed.
+  b.clear_diagnostics();
+  bad = b.make_add(b.make_true(), b.make_int(1));
+  e = b.make_assign(b.make_int(1), bad);
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 2);
+
+  b.clear_diagnostics();
+  bad = b.make_add(b.make_true(), b.make_int(1));
+  e = b.make_assign(b.make_id(x), bad);
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 1);
+
+  // A well-formed call and assignment report nothing.
+  b.clear_diagnostics();
+  e = b.make_call({b.make_id(f), b.make_int(1), b.make_id(x), b.make_int(3)});
+  assert(!b.is_error(e));
+  e = b.make_assign(b.make_id(x), e);
+  assert(!b.is_error(e));
+  assert(!b.has_errors());
+}
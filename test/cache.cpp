@@ -0,0 +1,217 @@
+// Tests that Body_cache rebuilds only edited functions and their
+// dependents, that reused bodies refer to declarations of the current
+// build, and that builds with fresh builders over the shared type table
+// can reuse them.
+
+#include "builder.hpp"
+#include "cache.hpp"
+#include "decl.hpp"
+#include "lexer.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// A global declaration of the test program. Each function returns the
+/// sum of the declarations it uses, calling functions with the argument
+/// 1 for each parameter.
+struct Source
+{
+  std::string name;
+  std::string sig;
+  /// The tokens of the declaration, excluding any function body.
+
+  std::string body;
+  /// The tokens of the function body, or empty for a variable.
+
+  int value;
+  /// The initializer of a variable, or the number of parameters of a
+  /// function.
+
+  std::vector<std::string> uses;
+};
+
+std::vector<Token>
+lex(Symbol_table& syms, std::string const& str)
+{
+  std::vector<Token> toks;
+  Lexer lex(syms, str);
+  while (Token tok = lex.get_next_token())
+    toks.push_back(tok);
+  return toks;
+}
+
+struct Build
+{
+  Build(Body_cache& cache, Builder& b, Symbol_table& syms)
+    : cache(cache), b(b), syms(syms)
+  { }
+
+  void run(std::vector<Source> const& srcs);
+
+  Stmt* make_body(Source const& src, Fn_decl* fn);
+
+  Body_cache& cache;
+  Builder& b;
+  Symbol_table& syms;
+
+  std::map<std::string, Decl*> decls;
+  /// The declarations of this build.
+
+  std::vector<std::string> rebuilt;
+  /// The functions whose bodies were built.
+};
+
+void
+Build::run(std::vector<Source> const& srcs)
+{
+  Type* i = b.get_int_type();
+  cache.begin_build(b);
+
+  Signature_map sigs;
+  for (Source const& src : srcs) {
+    std::vector<Token> toks = lex(syms, src.sig);
+    sigs[syms.get(src.name)] = fingerprint(toks.data(), toks.data() + toks.size());
+  }
+
+  for (Source const& src : srcs) {
+    Symbol sym = syms.get(src.name);
+    Fingerprint sig = sigs[sym];
+    if (src.body.empty()) {
+      decls[src.name] = cache.declare(sym, sig, [&] {
+        Var_decl* v = b.make_variable(b.get_name(src.name.c_str()), i);
+        b.copy_initialize(v, b.make_int(src.value));
+        return v;
+      });
+    }
+    else {
+      decls[src.name] = cache.declare(sym, sig, [&] {
+        std::vector<Type*> ts(src.value + 1, i);
+        Fn_decl* fn = b.make_function(b.get_name(src.name.c_str()), b.get_function_type(ts));
+        for (int n = 0; n < src.value; ++n)
+          fn->add_parameter(b.make_variable(b.get_name("p"), i));
+        fn->set_return(b.make_variable(b.get_name("ret"), i));
+        return fn;
+      });
+    }
+  }
+
+  for (Source const& src : srcs) {
+    if (src.body.empty())
+      continue;
+    std::vector<Token> toks = lex(syms, src.body);
+    Fingerprint body = fingerprint(toks.data(), toks.data() + toks.size(), sigs);
+    cache.define(syms.get(src.name), body, [&](Fn_decl* fn) {
+      return make_body(src, fn);
+    });
+  }
+
+  cache.end_build();
+}
+
+Stmt*
+Build::make_body(Source const& src, Fn_decl* fn)
+{
+  rebuilt.push_back(src.name);
+  Expr* e = b.make_int(0);
+  for (std::string const& name : src.uses) {
+    Decl* d = decls.at(name);
+    Expr* use;
+    if (d->is_function()) {
+      std::vector<Expr*> es{b.make_id(d)};
+      Fn_decl* callee = static_cast<Fn_decl*>(d);
+      for (std::size_t n = 0; n < callee->get_parameters().size(); ++n)
+        es.push_back(b.make_int(1));
+      use = b.make_call(es);
+    }
+    else {
+      use = b.make_id(d);
+    }
+    e = b.make_add(e, use);
+  }
+  return b.make_block({b.make_return(fn->get_return(), e)});
+}
+
+/// Builds `srcs` and returns the names of the rebuilt functions.
+std::vector<std::string>
+rebuild(Body_cache& cache, Builder& b, Symbol_table& syms,
+        std::vector<Source> const& srcs, std::map<std::string, Decl*>* decls = nullptr)
+{
+  Build build(cache, b, syms);
+  build.run(srcs);
+  if (decls)
+    *decls = build.decls;
+  return build.rebuilt;
+}
+
+using Names = std::vector<std::string>;
+
+} // namespace
+
+int
+main()
+{
+  Type_table types;
+  Builder b(types);
+  Symbol_table syms;
+  Body_cache cache(types);
+
+  std::vector<Source> srcs {
+    {"g", "var g : int = 1;", "", 1, {}},
+    {"a", "fun a(x : int) -> int", "{ return 0 + g; }", 1, {"g"}},
+    {"b", "fun b() -> int", "{ return 0 + a(1); }", 0, {"a"}},
+    {"c", "fun c() -> int", "{ return 0; }", 0, {}},
+  };
+  Source& g = srcs[0];
+  Source& a = srcs[1];
+  Source& c = srcs[3];
+
+  // Everything is built the first time.
+  std::map<std::string, Decl*> first;
+  assert((rebuild(cache, b, syms, srcs, &first) == Names{"a", "b", "c"}));
+  assert(cache.get_num_rebuilt() == 3 && cache.get_num_reused() == 0);
+
+  // Nothing is rebuilt when nothing changes, and the declarations that
+  // reused bodies refer to are those of the new build.
+  std::map<std::string, Decl*> second;
+  assert((rebuild(cache, b, syms, srcs, &second) == Names{}));
+  assert(cache.get_num_rebuilt() == 0 && cache.get_num_reused() == 3);
+  assert(first == second);
+
+  // Editing a body rebuilds only that function.
+  c.body = "{ return 2; }";
+  assert((rebuild(cache, b, syms, srcs) == Names{"c"}));
+
+  // Editing a signature rebuilds the function and its callers.
+  a.sig = "fun a(y : int) -> int";
+  assert((rebuild(cache, b, syms, srcs) == Names{"a", "b"}));
+
+  // Editing a global variable replaces its declaration and rebuilds the
+  // functions that use it.
+  g.sig = "var g : int = 2;";
+  g.value = 2;
+  std::map<std::string, Decl*> third;
+  assert((rebuild(cache, b, syms, srcs, &third) == Names{"a"}));
+  assert(third["g"] != second["g"]);
+  assert(third["b"] == second["b"] && third["c"] == second["c"]);
+
+  // Declarations dropped from the program are dropped from the cache.
+  srcs.pop_back();
+  rebuild(cache, b, syms, srcs);
+  srcs.push_back({"c", "fun c() -> int", "{ return 2; }", 0, {}});
+  assert((rebuild(cache, b, syms, srcs) == Names{"c"}));
+
+  // A fresh builder over the same table reuses every body, and the types
+  // it makes are those of the reused declarations.
+  std::map<std::string, Decl*> fourth;
+  Builder b2(types);
+  assert((rebuild(cache, b2, syms, srcs, &fourth) == Names{}));
+  assert(fourth["g"]->get_type() == b2.get_int_type());
+  assert(fourth["c"]->get_type() == b2.get_function_type({b2.get_int_type()}));
+}
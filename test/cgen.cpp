@@ -0,0 +1,84 @@
+// Tests that the C backend evaluates operands in the same order as the
+// evaluator when one operand changes an object another one reads.
+
+#include "builder.hpp"
+#include "cgen.hpp"
+#include "decl.hpp"
+#include "eval.hpp"
+#include "stmt.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  Type* ri = b.get_reference_type(i);
+  auto var = [&](char const* n, Type* t) { return b.make_variable(b.get_name(n), t); };
+
+  // fun bump(ref r : int, n : int) -> int { r = r + n; return r; }
+  Fn_decl* bump = b.make_function(b.get_name("bump"), b.get_function_type({ri, i, i}));
+  Var_decl* r = var("r", ri);
+  Var_decl* n1 = var("n", i);
+  bump->add_parameter(r);
+  bump->add_parameter(n1);
+  bump->set_return(var("ret", i));
+  bump->set_body(b.make_block({
+    b.make_expression(b.make_assign(b.make_id(r), b.make_add(b.make_id(r), b.make_id(n1)))),
+    b.make_return(bump->get_return(), b.make_id(r)),
+  }));
+
+  // fun pair(a : int, b : int) -> int { return a * 1000 + b; }
+  Fn_decl* pair = b.make_function(b.get_name("pair"), b.get_function_type({i, i, i}));
+  Var_decl* a = var("a", i);
+  Var_decl* c = var("b", i);
+  pair->add_parameter(a);
+  pair->add_parameter(c);
+  pair->set_return(var("ret", i));
+  pair->set_body(b.make_block({
+    b.make_return(pair->get_return(),
+                  b.make_add(b.make_mul(b.make_id(a), b.make_int(1000)), b.make_id(c))),
+  }));
+
+  // fun binary(n : int) -> int { var l : int = 0; return bump(l, n) + l; }
+  Fn_decl* binary = b.make_function(b.get_name("binary"), b.get_function_type({i, i}));
+  Var_decl* n2 = var("n", i);
+  Var_decl* l2 = var("l", i);
+  binary->add_parameter(n2);
+  binary->set_return(var("ret", i));
+  b.copy_initialize(l2, b.make_int(0));
+  binary->set_body(b.make_block({
+    b.make_declaration(l2),
+    b.make_return(binary->get_return(),
+                  b.make_add(b.make_call({b.make_id(bump), b.make_id(l2), b.make_id(n2)}),
+                             b.make_id(l2))),
+  }));
+
+  // fun call(n : int) -> int { var l : int = 0; return pair(bump(l, n), l); }
+  Fn_decl* call = b.make_function(b.get_name("call"), b.get_function_type({i, i}));
+  Var_decl* n3 = var("n", i);
+  Var_decl* l3 = var("l", i);
+  call->add_parameter(n3);
+  call->set_return(var("ret", i));
+  b.copy_initialize(l3, b.make_int(0));
+  call->set_body(b.make_block({
+    b.make_declaration(l3),
+    b.make_return(call->get_return(),
+                  b.make_call({b.make_id(pair),
+                               b.make_call({b.make_id(bump), b.make_id(l3), b.make_id(n3)}),
+                               b.make_id(l3)})),
+  }));
+
+  assert(!b.has_errors());
+  Prog_decl* prog = new Prog_decl({bump, pair, binary, call});
+  int statics = b.layout_program(prog);
+  Evaluator ev(prog, statics);
+  C_module cm(prog);
+
+  Value arg(Int_value(10));
+  assert(ev.call(binary, {arg}).get_int() == 20);
+  assert(cm.call(binary, {arg}).get_int() == 20);
+  assert(ev.call(call, {arg}).get_int() == 10010);
+  assert(cm.call(call, {arg}).get_int() == 10010);
+}
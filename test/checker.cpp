@@ -0,0 +1,186 @@
+// Tests that check_functions gives the same result on any number of
+// threads: diagnostics in job order, types interned by one job shared
+// with every other, and the exception of the first failing job
+// rethrown only after all jobs have run.
+
+#include "builder.hpp"
+#include "checker.hpp"
+#include "decl.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr int num_shapes = 8;
+/// The number of distinct function types interned by the jobs.
+
+/// Returns the function type of shape `k`. Every shape but the first
+/// is missing from a fresh table, so jobs of the same shape race to
+/// intern it.
+Type*
+get_shape(Builder& b, int k)
+{
+  std::vector<Type*> ts;
+  for (int n = 0; n <= k; ++n)
+    ts.push_back(n % 2 ? b.get_float_type() : b.get_reference_type(b.get_int_type()));
+  ts.push_back(b.get_int_type());
+  return b.get_function_type(ts);
+}
+
+/// The diagnostics issued by job `i`: none, one or two of a kind that
+/// depends on `i`, so that any reordering of jobs changes the result.
+std::vector<std::string>
+expected_diagnostics(int i)
+{
+  char const* msgs[] = {
+    "",
+    "operands have different type",
+    "Found arithmetic expected boolean",
+  };
+  return std::vector<std::string>(i % 3, msgs[i % 3]);
+}
+
+/// The job list of a run, and what its jobs recorded.
+struct Run
+{
+  Run(Type_table& types, int n, std::vector<int> const& throwing = {});
+
+  std::vector<std::string> check(unsigned threads);
+
+  Type_table& types;
+  Builder b;
+  std::vector<Check_job> jobs;
+
+  std::vector<Type*> shapes;
+  /// The type interned by each job.
+
+  std::atomic<int> built{0};
+  /// The number of jobs whose build function ran.
+};
+
+Run::Run(Type_table& types, int n, std::vector<int> const& throwing)
+  : types(types), b(types), shapes(n)
+{
+  Type* i = b.get_int_type();
+  for (int k = 0; k < n; ++k) {
+    std::string name = "f" + std::to_string(k);
+    Fn_decl* fn = b.make_function(b.get_name(name.c_str()), b.get_function_type({i}));
+    bool fail = false;
+    for (int t : throwing)
+      fail |= t == k;
+    jobs.push_back({fn, [this, k, fail](Builder& b, Fn_decl*) -> Stmt* {
+      ++built;
+      shapes[k] = get_shape(b, k % num_shapes);
+      if (fail)
+        throw std::runtime_error("job " + std::to_string(k));
+      Expr* e = b.make_int(k);
+      switch (k % 3) {
+      case 1:
+        e = b.make_add(e, b.make_bool(true));
+        break;
+      case 2:
+        b.make_not(b.make_int(k));
+        b.make_not(b.make_int(k));
+        break;
+      }
+      return b.make_block({b.make_expression(e)});
+    }});
+  }
+}
+
+std::vector<std::string>
+Run::check(unsigned threads)
+{
+  built = 0;
+  return check_functions(types, jobs, threads);
+}
+
+/// Checks that the types interned by jobs of the same shape are the
+/// same object, and that those of different shapes are not.
+void
+check_shapes(Run const& run)
+{
+  std::vector<Type*> first(num_shapes);
+  for (std::size_t k = 0; k < run.shapes.size(); ++k) {
+    Type*& t = first[k % num_shapes];
+    if (!t)
+      t = run.shapes[k];
+    assert(run.shapes[k] == t);
+  }
+  for (int k = 0; k < num_shapes; ++k)
+    for (int j = 0; j < k; ++j)
+      assert(first[j] != first[k]);
+}
+
+/// Returns the message of the exception thrown by checking `run`, or
+/// the empty string if none was.
+std::string
+check_error(Run& run, unsigned threads)
+{
+  try {
+    run.check(threads);
+  }
+  catch (std::runtime_error const& err) {
+    return err.what();
+  }
+  return "";
+}
+
+} // namespace
+
+int
+main()
+{
+  const int num_jobs = 200;
+  unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+
+  std::vector<std::string> expected;
+  for (int k = 0; k < num_jobs; ++k)
+    for (std::string& d : expected_diagnostics(k))
+      expected.push_back(d);
+
+  // The diagnostics are those of each job in job order, whatever the
+  // number of threads, and each run defines every function.
+  Type_table types;
+  Run run(types, num_jobs);
+  std::vector<std::string> serial = run.check(1);
+  assert(serial == expected);
+  assert(run.built == num_jobs);
+  check_shapes(run);
+  std::vector<Type*> serial_shapes = run.shapes;
+  for (int pass = 0; pass < 10; ++pass) {
+    assert(run.check(threads) == expected);
+    assert(run.built == num_jobs);
+    assert(run.shapes == serial_shapes);
+  }
+  for (Check_job const& job : run.jobs)
+    assert(job.fn->get_body());
+
+  // Jobs interning the same type at the same time get the same object.
+  for (int pass = 0; pass < 10; ++pass) {
+    Type_table fresh;
+    Run race(fresh, num_jobs);
+    assert(race.check(threads) == expected);
+    check_shapes(race);
+  }
+
+  // When two jobs throw, every job still runs and the exception of the
+  // first in job order is rethrown. The later job is placed where a
+  // worker other than the first is likely to reach it first.
+  Type_table failing;
+  Run fail(failing, num_jobs, {num_jobs - 3, 7});
+  assert(check_error(fail, 1) == "job 7");
+  assert(fail.built == num_jobs);
+  for (int pass = 0; pass < 10; ++pass) {
+    assert(check_error(fail, threads) == "job 7");
+    assert(fail.built == num_jobs);
+  }
+}
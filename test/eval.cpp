@@ -0,0 +1,77 @@
+// Tests the results of the evaluator on the shared test programs, and
+// that a call abandoned by an exception leaves the evaluator usable.
+
+#include "programs.hpp"
+
+#include "eval.hpp"
+#include "frame.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+
+/// Returns true if calling `fn` throws an exception of type `E`.
+template<typename E>
+bool
+throws(Evaluator& ev, Fn_decl* fn, std::vector<Value> const& args)
+{
+  try {
+    ev.call(fn, args);
+    return false;
+  }
+  catch (E const&) {
+    return true;
+  }
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Evaluator ev(t.prog, t.statics);
+
+  // The results of get_calls, in order. The result of hyp is checked
+  // separately.
+  Int_value expect[] = {
+    610, 499500, 77, 820, 300000000000000, -499999999999998999, 155, 201,
+    1653, 0, 500500, 0, 1, 144, 125250,
+  };
+  std::vector<Test_call> calls = t.get_calls();
+  assert(calls.size() == std::size(expect));
+  for (std::size_t n = 0; n < calls.size(); ++n) {
+    Value v = ev.call(calls[n].fn, calls[n].args);
+    if (calls[n].fn == t.hyp)
+      assert(std::abs(v.get_float() - (1.5 * 1.5 + 3.0 * 3.0 / 2.0 - 1 / 1.5)) < 1e-9);
+    else
+      assert(v.get_int() == expect[n]);
+    assert(ev.get_stack().size() == 0);
+  }
+
+  // An error in the outermost call, and one made 50 calls deep. Every
+  // frame pushed for the call is popped.
+  assert(throws<std::runtime_error>(ev, t.fail, {Value(Int_value(0))}));
+  assert(ev.get_stack().size() == 0);
+  assert(throws<std::runtime_error>(ev, t.fail, {Value(Int_value(50))}));
+  assert(ev.get_stack().size() == 0);
+
+  // A reference parameter cannot be bound to a value. The call is
+  // rejected before a frame is pushed.
+  assert(throws<std::logic_error>(ev, t.incr, {Value(Int_value(1))}));
+  assert(ev.get_stack().size() == 0);
+
+  // The evaluator is still usable, including for tail calls, which save
+  // their arguments on the evaluator.
+  Value v = ev.call(t.sum, {Value(Int_value(1000)), Value(Int_value(0))});
+  assert(v.get_int() == 500500);
+  v = ev.call(t.twice, {Value(Int_value(5))});
+  assert(v.get_int() == 77);
+  v = ev.call(t.fib, {Value(Int_value(15))});
+  assert(v.get_int() == 610);
+  assert(ev.get_stack().size() == 0);
+}
@@ -0,0 +1,53 @@
+// Tests that a flat tree stores an expression in postorder with its
+// operands, values, declarations and types, and that a cleared tree
+// counts the same bytes as a fresh one.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "flat.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  Type* bt = b.get_bool_type();
+  Var_decl* x = b.make_variable(b.get_name("x"), i);
+
+  // (x + 1) * 2, with the id-expression converted to a value.
+  Expr* e = b.make_mul(b.make_add(b.make_id(x), b.make_int(1)), b.make_int(2));
+  Flat_tree t;
+  std::uint32_t root = t.add(e);
+  assert(root == t.size() - 1);
+  assert(t.get_kind(root) == Expr::mul_expr);
+  assert(t.get_type(root) == i);
+
+  // Operands precede the nodes that use them.
+  for (std::uint32_t n = 0; n < t.size(); ++n) {
+    for (int k = 0; k < t.get_node(n).arity; ++k)
+      assert(t.get_operand(n, k) < n);
+  }
+  std::uint32_t add = t.get_operand(root, 0);
+  std::uint32_t two = t.get_operand(root, 1);
+  assert(t.get_kind(add) == Expr::add_expr);
+  assert(t.get_value(two).get_int() == 2);
+
+  std::uint32_t id = add;
+  while (t.get_kind(id) != Expr::id_expr)
+    id = t.get_operand(id, 0);
+  assert(t.get_declaration(id) == x);
+  assert(t.get_type(id) != i);
+
+  // A tree reused for an expression of other types counts only the
+  // types of that expression.
+  Expr* g = b.make_and(b.make_true(), b.make_not(b.make_false()));
+  t.clear();
+  assert(t.size() == 0 && t.get_bytes() == 0);
+  t.add(g);
+  Flat_tree fresh;
+  fresh.add(g);
+  assert(t.get_bytes() == fresh.get_bytes());
+  assert(t.get_type(t.size() - 1) == bt);
+}
@@ -0,0 +1,109 @@
+// Tests that the builder folds operators whose operands are literals when
+// folding is enabled, that it diagnoses division by a literal zero, and
+// that it builds every operator node when folding is disabled.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+
+#include <cassert>
+#include <limits>
+
+namespace
+{
+
+/// Returns the value of the integer or boolean literal `e`.
+Int_value
+literal(Expr const* e)
+{
+  assert(e->get_kind() == Expr::int_lit || e->get_kind() == Expr::bool_lit);
+  return static_cast<Literal_expr const*>(e)->get_value().get_int();
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  assert(!b.is_folding());
+  Var_decl* x = b.make_variable(b.get_name("x"), b.get_int_type());
+  auto num = [&](int n) { return b.make_int(n); };
+  auto var = [&] { return b.convert_to_value(b.make_id(x)); };
+
+  // Without folding, each builder makes its operator.
+  Expr* e = b.make_add(num(1), num(2));
+  assert(e->get_kind() == Expr::add_expr);
+  e = b.make_lt(num(1), num(2));
+  assert(e->get_kind() == Expr::lt_expr);
+  e = b.make_not(b.make_true());
+  assert(e->get_kind() == Expr::not_expr);
+  e = b.make_neg(num(4));
+  assert(e->get_kind() == Expr::neg_expr);
+
+  // Division by zero is left for evaluation to report.
+  e = b.make_div(num(1), num(0));
+  assert(e->get_kind() == Expr::div_expr);
+  assert(!b.has_errors());
+
+  b.set_folding(true);
+  assert(b.is_folding());
+
+  // Arithmetic.
+  assert(literal(b.make_add(num(1), num(2))) == 3);
+  assert(literal(b.make_sub(num(1), num(2))) == -1);
+  assert(literal(b.make_mul(num(-6), num(7))) == -42);
+  assert(literal(b.make_div(num(7), num(2))) == 3);
+  assert(literal(b.make_div(num(-7), num(2))) == -3);
+  assert(literal(b.make_rem(num(-7), num(2))) == -1);
+  assert(literal(b.make_neg(num(4))) == -4);
+
+  // Nested operators fold bottom up.
+  e = b.make_mul(b.make_add(num(1), num(2)), b.make_sub(num(10), num(4)));
+  assert(literal(e) == 18);
+
+  // Results are integers or booleans according to the operator.
+  e = b.make_add(num(1), num(2));
+  assert(e->get_kind() == Expr::int_lit);
+  e = b.make_le(num(2), num(2));
+  assert(e->get_kind() == Expr::bool_lit && literal(e) == 1);
+  assert(literal(b.make_eq(num(3), num(4))) == 0);
+  assert(literal(b.make_ne(num(3), num(4))) == 1);
+  assert(literal(b.make_lt(num(3), num(4))) == 1);
+  assert(literal(b.make_gt(num(3), num(4))) == 0);
+  assert(literal(b.make_ge(num(3), num(4))) == 0);
+  assert(literal(b.make_and(b.make_true(), b.make_false())) == 0);
+  assert(literal(b.make_or(b.make_true(), b.make_false())) == 1);
+  assert(literal(b.make_not(b.make_false())) == 1);
+
+  // Overflow wraps.
+  Int_value min = std::numeric_limits<Int_value>::min();
+  Expr* lo = new Int_expr(b.get_int_type(), Value(min));
+  assert(literal(b.make_div(lo, num(-1))) == min);
+  lo = new Int_expr(b.get_int_type(), Value(min));
+  assert(literal(b.make_rem(lo, num(-1))) == 0);
+  lo = new Int_expr(b.get_int_type(), Value(min));
+  assert(literal(b.make_sub(lo, num(1))) == std::numeric_limits<Int_value>::max());
+  assert(!b.has_errors());
+
+  // Operators with an operand that is not a literal are built.
+  e = b.make_add(var(), num(2));
+  assert(e->get_kind() == Expr::add_expr);
+  e = b.make_mul(b.make_add(num(1), num(2)), var());
+  assert(e->get_kind() == Expr::mul_expr);
+  assert(literal(e->get_children().begin()[0]) == 3);
+
+  // Division by a literal zero is diagnosed.
+  e = b.make_div(num(1), num(0));
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 1);
+  e = b.make_rem(num(1), num(0));
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 2);
+
+  // Operands are checked before they are folded.
+  b.clear_diagnostics();
+  e = b.make_add(b.make_true(), num(1));
+  assert(b.is_error(e));
+  assert(b.get_diagnostics().size() == 1);
+}
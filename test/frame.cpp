@@ -0,0 +1,83 @@
+// Tests that popping a frame destroys its objects, so values that own
+// storage (boxed integers) are released when a call returns. Run under
+// a leak checker, or rely on the allocation count kept below.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "eval.hpp"
+#include "stmt.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+long live = 0;
+/// The number of allocations not yet freed.
+
+} // namespace
+
+void*
+operator new(std::size_t n)
+{
+  if (void* p = std::malloc(n ? n : 1)) {
+    ++live;
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+  if (p) {
+    --live;
+    std::free(p);
+  }
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+
+  // fun f(n : int) -> int { var x : int = n + 1; return x; }
+  Fn_decl* f = b.make_function(b.get_name("f"), b.get_function_type({i, i}));
+  Var_decl* n = b.make_variable(b.get_name("n"), i);
+  Var_decl* x = b.make_variable(b.get_name("x"), i);
+  f->add_parameter(n);
+  f->set_return(b.make_variable(b.get_name("ret"), i));
+  b.copy_initialize(x, b.make_add(b.make_id(n), b.make_int(1)));
+  f->set_body(b.make_block({
+    b.make_declaration(x),
+    b.make_return(f->get_return(), b.make_id(x)),
+  }));
+
+  assert(!b.has_errors());
+  // Trees are never freed. The program is kept reachable so that a leak
+  // checker reports only what the evaluator loses.
+  static Prog_decl* prog = new Prog_decl({f});
+  int statics = b.layout_program(prog);
+  Evaluator ev(prog, statics);
+
+  // The argument and the local are both boxed.
+  Int_value big = Int_value(1) << 60;
+  std::vector<Value> args{Value(big)};
+  Value v = ev.call(f, args);
+  assert(v.get_int() == big + 1);
+
+  long before = live;
+  for (int k = 0; k < 1000; ++k)
+    v = ev.call(f, args);
+  assert(v.get_int() == big + 1);
+  assert(live == before);
+}
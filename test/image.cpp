@@ -0,0 +1,117 @@
+// Tests that a program read back from its image evaluates as the original
+// does, and that corrupt images are rejected with std::runtime_error
+// instead of crashing or allocating without bound.
+
+#include "programs.hpp"
+
+#include "eval.hpp"
+#include "image.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// Returns the image of `prog`.
+std::string
+write(Prog_decl const* prog)
+{
+  std::ostringstream os;
+  write_image(os, prog);
+  return os.str();
+}
+
+/// Returns true if `data` is read without error, and false if it is
+/// rejected. Any other outcome fails the test.
+bool
+try_read(std::string const& data)
+{
+  Builder b;
+  try {
+    read_image(b, data.data(), data.size());
+    return true;
+  }
+  catch (std::runtime_error const&) {
+    return false;
+  }
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  std::string data = write(t.prog);
+
+  // The program read back has the same members in the same order, and
+  // each function computes the same results.
+  Builder c;
+  Prog_decl* prog = read_image(c, data.data(), data.size());
+  int statics = c.layout_program(prog);
+  assert(statics == t.statics);
+
+  std::vector<Decl*> before(t.prog->get_children().begin(), t.prog->get_children().end());
+  std::vector<Decl*> after(prog->get_children().begin(), prog->get_children().end());
+  assert(before.size() == after.size());
+
+  Evaluator ev1(t.prog, t.statics);
+  Evaluator ev2(prog, statics);
+  for (Test_call const& call : t.get_calls()) {
+    std::size_t n = 0;
+    while (before[n] != call.fn)
+      ++n;
+    assert(after[n]->is_function());
+    Value v1 = ev1.call(call.fn, call.args);
+    Value v2 = ev2.call(static_cast<Fn_decl*>(after[n]), call.args);
+    assert(same_value(v1, v2));
+  }
+
+  // Writing the program read back gives the same image.
+  assert(write(prog) == data);
+
+  // Replace each word of the image in turn. Every result is either read
+  // or rejected; none crashes or exhausts memory.
+  assert(data.size() % 4 == 0);
+  int rejected = 0;
+  for (std::size_t i = 0; i < data.size(); i += 4) {
+    std::uint32_t word;
+    std::memcpy(&word, &data[i], 4);
+    for (std::uint32_t bad : {~word, ~std::uint32_t(0), word + 1, 0x7fffffffu}) {
+      if (bad == word)
+        continue;
+      std::string copy = data;
+      std::memcpy(&copy[i], &bad, 4);
+      rejected += !try_read(copy);
+    }
+  }
+  assert(rejected > 0);
+
+  // Truncated images are rejected.
+  for (std::size_t n = 0; n < data.size(); n += 4)
+    assert(!try_read(data.substr(0, n)));
+
+  // An image that does not start on a word boundary is rejected, even
+  // though its bytes are intact.
+  std::vector<std::uint32_t> words(data.size() / 4 + 1);
+  char* buf = reinterpret_cast<char*>(words.data());
+  for (std::size_t off = 1; off < 4; ++off) {
+    std::memcpy(buf + off, data.data(), data.size());
+    Builder d;
+    bool rejected = false;
+    try {
+      read_image(d, buf + off, data.size());
+    }
+    catch (std::runtime_error const&) {
+      rejected = true;
+    }
+    assert(rejected);
+  }
+}
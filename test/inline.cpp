@@ -0,0 +1,234 @@
+// Tests that inlining does not change what a program computes: calls in
+// each position the inliner expands, reference parameters bound to locals
+// and to a global, and arguments with side effects, which must be
+// evaluated once and in order.
+
+#include "programs.hpp"
+
+#include "bytecode.hpp"
+#include "eval.hpp"
+#include "inline.hpp"
+#include "vm.hpp"
+
+#include <cassert>
+
+namespace
+{
+
+/// A program whose functions call small helpers:
+///
+///   var g : int = 0;
+///   fun bump(ref r : int, n : int) -> int { r = r + n; return r; }
+///   fun sq(a : int) -> int { return a * a; }
+///   fun stmt(n : int) -> int { var x = n; bump(x, 3); bump(g, n); return x * 1000 + g; }
+///   fun init(n : int) -> int { var x = n; var y = bump(x, 5); return x * 1000 + y; }
+///   fun assign(n : int) -> int { var x = n; x = bump(x, 2); return x; }
+///   fun pure(n : int) -> int { return sq(n + 1) + sq(n) * 2; }
+///   fun once(n : int) -> int { var x = n; return sq(bump(x, 1)) + x; }
+///   fun order(n : int) -> int { var x = n; return bump(x, 1) * 10 + x; }
+struct Helpers
+{
+  explicit Helpers(Builder& b);
+
+  Builder& b;
+  Fn_decl* stmt;
+  Fn_decl* init;
+  Fn_decl* assign;
+  Fn_decl* pure;
+  Fn_decl* once;
+  Fn_decl* order;
+  std::vector<Fn_decl*> entries;
+  /// The functions above, in order.
+
+  Prog_decl* prog;
+  int statics;
+
+  Fn_decl* function(char const* name, std::vector<Type*> parms);
+  Expr* parm(Fn_decl* fn, int n);
+  Var_decl* local(char const* name, Expr* init);
+  Expr* id(Decl* d) { return b.make_id(d); }
+  Expr* num(int n) { return b.make_int(n); }
+  Stmt* ret(Expr* e) { return b.make_return(b.make_variable(nullptr, b.get_int_type()), e); }
+};
+
+Helpers::Helpers(Builder& b)
+  : b(b)
+{
+  Type* i = b.get_int_type();
+  auto call = [&](Fn_decl* fn, std::vector<Expr*> args) {
+    args.insert(args.begin(), id(fn));
+    return b.make_call(std::move(args));
+  };
+
+  Var_decl* g = b.make_variable(b.get_name("g"), i);
+  b.copy_initialize(g, num(0));
+
+  Fn_decl* bump = function("bump", {b.get_reference_type(i), i});
+  bump->set_body(b.make_block({
+    b.make_expression(b.make_assign(parm(bump, 0), b.make_add(parm(bump, 0), parm(bump, 1)))),
+    ret(parm(bump, 0)),
+  }));
+
+  Fn_decl* sq = function("sq", {i});
+  sq->set_body(b.make_block({
+    ret(b.make_mul(parm(sq, 0), parm(sq, 0))),
+  }));
+
+  stmt = function("stmt", {i});
+  {
+    Var_decl* x = local("x", parm(stmt, 0));
+    stmt->set_body(b.make_block({
+      b.make_declaration(x),
+      b.make_expression(call(bump, {id(x), num(3)})),
+      b.make_expression(call(bump, {id(g), parm(stmt, 0)})),
+      ret(b.make_add(b.make_mul(id(x), num(1000)), id(g))),
+    }));
+  }
+
+  init = function("init", {i});
+  {
+    Var_decl* x = local("x", parm(init, 0));
+    Var_decl* y = local("y", call(bump, {id(x), num(5)}));
+    init->set_body(b.make_block({
+      b.make_declaration(x),
+      b.make_declaration(y),
+      ret(b.make_add(b.make_mul(id(x), num(1000)), id(y))),
+    }));
+  }
+
+  assign = function("assign", {i});
+  {
+    Var_decl* x = local("x", parm(assign, 0));
+    assign->set_body(b.make_block({
+      b.make_declaration(x),
+      b.make_expression(b.make_assign(id(x), call(bump, {id(x), num(2)}))),
+      ret(id(x)),
+    }));
+  }
+
+  pure = function("pure", {i});
+  pure->set_body(b.make_block({
+    ret(b.make_add(call(sq, {b.make_add(parm(pure, 0), num(1))}),
+                   b.make_mul(call(sq, {parm(pure, 0)}), num(2)))),
+  }));
+
+  once = function("once", {i});
+  {
+    Var_decl* x = local("x", parm(once, 0));
+    once->set_body(b.make_block({
+      b.make_declaration(x),
+      ret(b.make_add(call(sq, {call(bump, {id(x), num(1)})}), id(x))),
+    }));
+  }
+
+  order = function("order", {i});
+  {
+    Var_decl* x = local("x", parm(order, 0));
+    order->set_body(b.make_block({
+      b.make_declaration(x),
+      ret(b.make_add(b.make_mul(call(bump, {id(x), num(1)}), num(10)), id(x))),
+    }));
+  }
+
+  assert(!b.has_errors());
+  entries = {stmt, init, assign, pure, once, order};
+  prog = new Prog_decl({g, bump, sq, stmt, init, assign, pure, once, order});
+  statics = b.layout_program(prog);
+}
+
+Fn_decl*
+Helpers::function(char const* name, std::vector<Type*> parms)
+{
+  Type* i = b.get_int_type();
+  std::vector<Type*> ts = parms;
+  ts.push_back(i);
+  Fn_decl* fn = b.make_function(b.get_name(name), b.get_function_type(ts));
+  for (Type* t : parms)
+    fn->add_parameter(b.make_variable(b.get_name("p"), t));
+  fn->set_return(b.make_variable(b.get_name("ret"), i));
+  return fn;
+}
+
+Expr*
+Helpers::parm(Fn_decl* fn, int n)
+{
+  auto iter = fn->get_parameters().begin();
+  while (n--)
+    ++iter;
+  return id(*iter);
+}
+
+Var_decl*
+Helpers::local(char const* name, Expr* init)
+{
+  Var_decl* var = b.make_variable(b.get_name(name), b.get_int_type());
+  b.copy_initialize(var, init);
+  return var;
+}
+
+} // namespace
+
+int
+main()
+{
+  // The helpers, called in each position. The global updated by stmt
+  // persists across calls, so the calls are made in the same order on
+  // each engine.
+  {
+    Builder b1;
+    Builder b2;
+    Helpers h1(b1);
+    Helpers h2(b2);
+    std::size_t inlined = inline_calls(b2, h2.prog);
+    assert(inlined > 0);
+    assert(!b2.has_errors());
+
+    Evaluator ev1(h1.prog, h1.statics);
+    Evaluator ev2(h2.prog, h2.statics);
+    Bytecode bc(h2.prog, h2.statics);
+    Machine vm(bc);
+    for (int rep = 0; rep < 2; ++rep) {
+      for (std::size_t k = 0; k < h1.entries.size(); ++k) {
+        for (Int_value n : {0, 1, -4, 37}) {
+          Value v1 = ev1.call(h1.entries[k], {Value(n)});
+          Value v2 = ev2.call(h2.entries[k], {Value(n)});
+          Value v3 = vm.call(h2.entries[k], {Value(n)});
+          assert(same_value(v1, v2));
+          assert(same_value(v1, v3));
+        }
+      }
+    }
+  }
+
+  // Inlining every call that qualifies, hot or not, leaves the results
+  // of the shared test program unchanged.
+  {
+    Builder b1;
+    Builder b2;
+    Test_program t1(b1);
+    Test_program t2(b2);
+    Inline_options opts;
+    opts.max_size = opts.max_hot_size;
+    assert(inline_calls(b2, t2.prog, opts) > 0);
+
+    std::vector<Test_call> calls1 = t1.get_calls();
+    std::vector<Test_call> calls2 = t2.get_calls();
+    Evaluator ev1(t1.prog, t1.statics);
+    Evaluator ev2(t2.prog, t2.statics);
+    for (std::size_t n = 0; n < calls1.size(); ++n) {
+      Value v1 = ev1.call(calls1[n].fn, calls1[n].args);
+      Value v2 = ev2.call(calls2[n].fn, calls2[n].args);
+      assert(same_value(v1, v2));
+    }
+  }
+
+  // Nothing is inlined when no callee is small enough.
+  {
+    Builder b;
+    Helpers h(b);
+    Inline_options opts;
+    opts.max_size = 0;
+    opts.max_hot_size = 0;
+    assert(inline_calls(b, h.prog, opts) == 0);
+  }
+}
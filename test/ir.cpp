@@ -0,0 +1,73 @@
+// Tests that the SSA form of the shared test programs, run by
+// Ir_machine, computes what the evaluator computes, and that tail calls
+// and deep recursion run without exhausting the native stack.
+
+#include "programs.hpp"
+
+#include "eval.hpp"
+#include "ir_machine.hpp"
+
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Evaluator ev(t.prog, t.statics);
+  Ir_machine ir(t.prog);
+
+  std::stringstream ss;
+  assert(ir.get_program().verify(ss));
+
+  for (Test_call const& call : t.get_calls()) {
+    Value v1 = ev.call(call.fn, call.args);
+    Value v2 = ir.call(call.fn, call.args);
+    assert(same_value(v1, v2));
+  }
+
+  // Wrapping arithmetic on values wider than 48 bits.
+  Int_value big = Int_value(1) << 62;
+  for (Int_value n : {big, -big, big - 1}) {
+    Value v1 = ev.call(t.boxed, {Value(n)});
+    Value v2 = ir.call(t.boxed, {Value(n)});
+    assert(same_value(v1, v2));
+  }
+
+  // Errors are raised as in the evaluator, and leave the machine usable.
+  for (Int_value n : {0, 50}) {
+    bool thrown = false;
+    try {
+      ir.call(t.fail, {Value(n)});
+    }
+    catch (std::runtime_error const&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  bool rejected = false;
+  try {
+    ir.call(t.incr, {Value(Int_value(1))});
+  }
+  catch (std::logic_error const&) {
+    rejected = true;
+  }
+  assert(rejected);
+
+  // A million tail calls, and a million nested calls.
+  Value n(Int_value(1000000));
+  Value s = ir.call(t.sum, {n, Value(Int_value(0))});
+  assert(s.get_int() == 500000500000);
+  assert(ir.call(t.even, {n}).get_int() == 1);
+  assert(ir.call(t.odd, {n}).get_int() == 0);
+  std::vector<Value> eight{n};
+  for (int k = 1; k < 8; ++k)
+    eight.push_back(Value(Int_value(k)));
+  Value v1 = ev.call(t.tm8, eight);
+  Value v2 = ir.call(t.tm8, eight);
+  assert(same_value(v1, v2));
+  Value r = ir.call(t.rsum, {n});
+  assert(r.get_int() == 500000500000);
+}
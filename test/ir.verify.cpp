@@ -0,0 +1,214 @@
+// Tests that the SSA verifier reports each kind of malformed function it
+// checks for, and that the listing of a function with a loop is exactly
+// as expected.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "ir.hpp"
+
+#include <cassert>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+/// The function
+///
+///   fun sum(n : int) -> int {
+///     var s = 0; var i = 0;
+///     while (i < n) { s = s + i; i = i + 1; }
+///     return s;
+///   }
+///
+/// in SSA form, built by hand so that each test can break one part.
+struct Loop
+{
+  Loop(Fn_decl const* d);
+
+  Ir_function fn;
+  Ir_block* entry;
+  Ir_block* head;
+  Ir_block* body;
+  Ir_block* exit;
+
+  Ir_inst* n;
+  Ir_inst* zero;
+  Ir_inst* one;
+  Ir_inst* s;
+  Ir_inst* i;
+  Ir_inst* cmp;
+  Ir_inst* next_s;
+  Ir_inst* next_i;
+  Ir_inst* ret;
+};
+
+/// Appends a branch from `from` to `to` and records the edge.
+void
+branch(Ir_function& fn, Ir_block* from, Ir_block* to)
+{
+  Ir_inst* br = fn.make(br_ir, no_ty);
+  br->set_target(0, to);
+  from->append(br);
+  to->add_predecessor(from);
+}
+
+Loop::Loop(Fn_decl const* d)
+  : fn(d)
+{
+  entry = fn.make_block();
+  head = fn.make_block();
+  body = fn.make_block();
+  exit = fn.make_block();
+
+  n = fn.make(param_ir, int_ty);
+  zero = fn.make(const_i_ir, int_ty);
+  one = fn.make(const_i_ir, int_ty);
+  one->set_int(1);
+  entry->append(n);
+  entry->append(zero);
+  entry->append(one);
+  branch(fn, entry, head);
+
+  // The phis refer to values of the body, which are created first and
+  // given their operands once the phis exist.
+  next_s = fn.make(add_i_ir, int_ty);
+  next_i = fn.make(add_i_ir, int_ty);
+  s = fn.make(phi_ir, int_ty, {zero, next_s});
+  i = fn.make(phi_ir, int_ty, {zero, next_i});
+  cmp = fn.make(lt_i_ir, bool_ty, {i, n});
+  next_s->add_operand(s);
+  next_s->add_operand(i);
+  next_i->add_operand(i);
+  next_i->add_operand(one);
+  head->append(s);
+  head->append(i);
+  head->append(cmp);
+  Ir_inst* cbr = fn.make(cbr_ir, no_ty, {cmp});
+  cbr->set_target(0, body);
+  cbr->set_target(1, exit);
+  head->append(cbr);
+  body->add_predecessor(head);
+  exit->add_predecessor(head);
+
+  body->append(next_s);
+  body->append(next_i);
+  branch(fn, body, head);
+
+  ret = fn.make(ret_ir, no_ty, {s});
+  exit->append(ret);
+}
+
+/// Returns the number of lines of `str` that report an error.
+int
+count_errors(std::string const& str)
+{
+  int n = 0;
+  for (std::size_t p = str.find("error: "); p != std::string::npos; p = str.find("error: ", p + 1))
+    ++n;
+  return n;
+}
+
+/// Checks that `loop` fails to verify with exactly one error whose
+/// message contains `msg`.
+void
+check_rejected(Loop const& loop, char const* msg)
+{
+  std::ostringstream os;
+  assert(!loop.fn.verify(os));
+  std::string out = os.str();
+  assert(count_errors(out) == 1);
+  assert(out.find(msg) != std::string::npos);
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  Type* t = b.get_int_type();
+  Fn_decl* sum = b.make_function(b.get_name("sum"), b.get_function_type({t, t}));
+
+  // The function as built is well formed.
+  {
+    Loop loop(sum);
+    std::ostringstream os;
+    assert(loop.fn.verify(os));
+    assert(os.str().empty());
+  }
+
+  // The listing numbers values in order, gives the predecessors of each
+  // block, and the operands of each phi in predecessor order.
+  {
+    Loop loop(sum);
+    std::ostringstream os;
+    loop.fn.dump(os);
+    std::string expected =
+      "function sum\n"
+      "b0:\n"
+      "  %0 = param 0 : int\n"
+      "  %1 = const_i 0 : int\n"
+      "  %2 = const_i 1 : int\n"
+      "  br b1\n"
+      "b1:  // preds: b0 b2\n"
+      "  %3 = phi %1, %6 : int\n"
+      "  %4 = phi %1, %7 : int\n"
+      "  %5 = lt_i %4, %0 : bool\n"
+      "  cbr %5 b2 b3\n"
+      "b2:  // preds: b1\n"
+      "  %6 = add_i %3, %4 : int\n"
+      "  %7 = add_i %4, %2 : int\n"
+      "  br b1\n"
+      "b3:  // preds: b1\n"
+      "  ret %3\n"
+      "\n";
+    assert(os.str() == expected);
+  }
+
+  // A block without a terminator.
+  {
+    Loop loop(sum);
+    loop.exit->erase(loop.ret);
+    check_rejected(loop, "b3: missing terminator");
+  }
+
+  // A phi with more operands than its block has predecessors, and one
+  // with fewer.
+  {
+    Loop loop(sum);
+    loop.s->add_operand(loop.zero);
+    check_rejected(loop, "b1, phi: phi operands do not match predecessors");
+  }
+  {
+    Loop loop(sum);
+    loop.i->remove_operand(1);
+    check_rejected(loop, "b1, phi: phi operands do not match predecessors");
+  }
+
+  // A use in a block that the definition does not dominate: the exit
+  // returns a value computed only in the loop body.
+  {
+    Loop loop(sum);
+    loop.fn.renumber();
+    loop.ret->set_operand(0, loop.next_s);
+    check_rejected(loop, "b3, ret: operand %6 does not dominate its use");
+  }
+
+  // A use that precedes its definition in the same block.
+  {
+    Loop loop(sum);
+    loop.fn.renumber();
+    loop.next_s->set_operand(1, loop.next_i);
+    check_rejected(loop, "b2, add_i: operand %7 does not dominate its use");
+  }
+
+  // A phi operand that does not dominate the predecessor it flows from:
+  // the value entering from the entry is computed in the body.
+  {
+    Loop loop(sum);
+    loop.fn.renumber();
+    loop.s->set_operand(0, loop.next_i);
+    check_rejected(loop, "b1, phi: operand %7 does not dominate its predecessor");
+  }
+}
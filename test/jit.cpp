@@ -0,0 +1,58 @@
+// Tests that compiled code computes what the interpreter computes,
+// including on boxed integers, and that deep recursion through compiled
+// code does not exhaust the native stack.
+
+#include "programs.hpp"
+
+#include "bytecode.hpp"
+#include "vm.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Bytecode bc(t.prog, t.statics);
+  Machine vm(bc);
+  Machine jit(bc);
+  jit.enable_jit(1);
+  if (!jit.get_jit())
+    return 0;
+
+  // Each function is compiled on its first call, and later calls run
+  // the compiled code.
+  for (Test_call const& call : t.get_calls()) {
+    Value v1 = vm.call(call.fn, call.args);
+    Value v2 = jit.call(call.fn, call.args);
+    Value v3 = jit.call(call.fn, call.args);
+    assert(same_value(v1, v2));
+    assert(same_value(v1, v3));
+  }
+  assert(jit.get_jit()->get_num_functions() > 0);
+
+  // Boxed values through the inline templates' slow paths.
+  Int_value big = Int_value(1) << 50;
+  for (Fn_decl* fn : {t.boxed, t.loop, t.twice}) {
+    for (Int_value n : {big, -big, big - 1}) {
+      if (fn == t.loop && n > 0)
+        continue;
+      Value v1 = vm.call(fn, {Value(n)});
+      Value v2 = jit.call(fn, {Value(n)});
+      assert(same_value(v1, v2));
+    }
+  }
+  Value s1 = vm.call(t.sum, {Value(Int_value(1000)), Value(big)});
+  Value s2 = jit.call(t.sum, {Value(Int_value(1000)), Value(big)});
+  assert(same_value(s1, s2));
+  assert(s2.get_int() == big + 500500);
+
+  // A million nested calls run on the machine's stack, not the native
+  // stack.
+  Value deep(Int_value(1000000));
+  Value r1 = vm.call(t.rsum, {deep});
+  Value r2 = jit.call(t.rsum, {deep});
+  assert(r1.get_int() == 500000500000);
+  assert(same_value(r1, r2));
+}
@@ -0,0 +1,160 @@
+// Tests that frame layout gives each variable a slot within its frame
+// that no other variable in scope at the same time uses, and that the
+// locals of disjoint blocks share slots.
+
+#include "programs.hpp"
+
+#include "visitor.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+
+/// Checks the slots of the locals of a function body. The slots in use
+/// are those of the parameters, the return value, and the locals of the
+/// enclosing blocks declared so far.
+struct Check_slots : Const_stmt_visitor<Check_slots>
+{
+  explicit Check_slots(Fn_decl const* fn)
+    : size(fn->get_frame_size())
+  {
+    for (Decl* p : fn->get_parameters())
+      use(p);
+    if (Decl const* r = fn->get_return())
+      use(r);
+  }
+
+  void visit_block_stmt(Block_stmt const* s)
+  {
+    std::size_t mark = live.size();
+    for (Stmt const* sub : *s)
+      visit(sub);
+    live.resize(mark);
+  }
+
+  void visit_if_stmt(If_stmt const* s)
+  {
+    visit(s->get_true_statement());
+    if (Stmt const* f = s->get_false_statement())
+      visit(f);
+  }
+
+  void visit_while_stmt(While_stmt const* s) { visit(s->get_body()); }
+  void visit_decl_stmt(Decl_stmt const* s) { use(s->get_declaration()); }
+  void visit_stmt(Stmt const*) { }
+
+  /// Checks that the slot of `d` is in the frame and not in use, and
+  /// marks it in use.
+  void use(Decl const* d)
+  {
+    int slot = static_cast<Var_decl const*>(d)->get_slot();
+    assert(slot >= 0 && slot < size);
+    assert(std::find(live.begin(), live.end(), slot) == live.end());
+    live.push_back(slot);
+  }
+
+  int size;
+  std::vector<int> live;
+};
+
+/// Checks the layout of every function of `p`, and that its global
+/// variables have distinct static slots below `statics`.
+void
+check(Prog_decl const* p, int statics)
+{
+  std::vector<int> slots;
+  for (Decl* d : p->get_children()) {
+    if (d->is_variable()) {
+      Var_decl const* var = static_cast<Var_decl const*>(d);
+      assert(var->has_static_storage());
+      assert(var->get_slot() >= 0 && var->get_slot() < statics);
+      assert(std::find(slots.begin(), slots.end(), var->get_slot()) == slots.end());
+      slots.push_back(var->get_slot());
+    }
+    else if (d->is_function()) {
+      Fn_decl const* fn = static_cast<Fn_decl const*>(d);
+      Check_slots c(fn);
+      if (Stmt const* s = fn->get_body())
+        c.visit(s);
+    }
+  }
+  assert(int(slots.size()) == statics);
+}
+
+} // namespace
+
+int
+main()
+{
+  {
+    Builder b;
+    Test_program t(b);
+    check(t.prog, t.statics);
+  }
+
+  // var g1 : int = 1; var g2 : int = 2;
+  // fun f(a : int, b : int) -> int {
+  //   var x = a;
+  //   { var y = 1; { var z = 2; } var w = 3; }
+  //   { var u = 4; }
+  //   while (x < b) { var v = x; x = v + 1; }
+  //   if (x < 0) { var p = 5; } else { var q = 6; }
+  //   var t = 7;
+  //   return x;
+  // }
+  Builder b;
+  Type* i = b.get_int_type();
+  auto local = [&](char const* name, int n) {
+    Var_decl* var = b.make_variable(b.get_name(name), i);
+    b.copy_initialize(var, b.make_int(n));
+    return var;
+  };
+  auto decl = [&](char const* name, int n) { return b.make_declaration(local(name, n)); };
+
+  Var_decl* g1 = local("g1", 1);
+  Var_decl* g2 = local("g2", 2);
+  Fn_decl* f = b.make_function(b.get_name("f"), b.get_function_type({i, i, i}));
+  Var_decl* a = b.make_variable(b.get_name("a"), i);
+  Var_decl* c = b.make_variable(b.get_name("b"), i);
+  f->add_parameter(a);
+  f->add_parameter(c);
+  f->set_return(b.make_variable(b.get_name("ret"), i));
+  Var_decl* x = b.make_variable(b.get_name("x"), i);
+  b.copy_initialize(x, b.make_id(a));
+  Var_decl* v = b.make_variable(b.get_name("v"), i);
+  b.copy_initialize(v, b.make_id(x));
+  Var_decl* t = local("t", 7);
+  f->set_body(b.make_block({
+    b.make_declaration(x),
+    b.make_block({decl("y", 1), b.make_block({decl("z", 2)}), decl("w", 3)}),
+    b.make_block({decl("u", 4)}),
+    b.make_while(b.make_lt(b.make_id(x), b.make_id(c)), b.make_block({
+      b.make_declaration(v),
+      b.make_expression(b.make_assign(b.make_id(x), b.make_add(b.make_id(v), b.make_int(1)))),
+    })),
+    b.make_if(b.make_lt(b.make_id(x), b.make_int(0)),
+              b.make_block({decl("p", 5)}),
+              b.make_block({decl("q", 6)})),
+    b.make_declaration(t),
+    b.make_return(b.make_variable(nullptr, i), b.make_id(x)),
+  }));
+  assert(!b.has_errors());
+
+  Prog_decl* prog = new Prog_decl({g1, f, g2});
+  int statics = b.layout_program(prog);
+  assert(statics == 2);
+  check(prog, statics);
+
+  // Parameters come first, then the return value. At most three locals
+  // are in scope at once: x, y, and z or w.
+  assert(a->get_slot() == 0);
+  assert(c->get_slot() == 1);
+  assert(static_cast<Var_decl*>(f->get_return())->get_slot() == 2);
+  assert(x->get_slot() == 3);
+  assert(v->get_slot() == 4);
+  assert(t->get_slot() == 4);
+  assert(f->get_frame_size() == 6);
+}
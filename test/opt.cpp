@@ -0,0 +1,257 @@
+// Tests that each optimization level computes the same results as the
+// evaluator, and that the passes fold constants, remove dead code, reuse
+// redundant values, and hoist loop invariants where they should, without
+// folding or moving a division that may trap.
+
+#include "programs.hpp"
+
+#include "eval.hpp"
+#include "ir_machine.hpp"
+
+#include <cassert>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+/// Returns the number of instructions of `fn` with the opcode `op`.
+int
+count(Ir_function const* fn, Ir_opcode op)
+{
+  int n = 0;
+  for (std::size_t k = 0; k < fn->get_num_blocks(); ++k) {
+    for (Ir_inst* i : *fn->get_block(k))
+      n += i->get_opcode() == op;
+  }
+  return n;
+}
+
+/// Returns the only instruction of `fn` with the opcode `op`.
+Ir_inst*
+find(Ir_function const* fn, Ir_opcode op)
+{
+  assert(count(fn, op) == 1);
+  for (std::size_t k = 0; k < fn->get_num_blocks(); ++k) {
+    for (Ir_inst* i : *fn->get_block(k)) {
+      if (i->get_opcode() == op)
+        return i;
+    }
+  }
+  return nullptr;
+}
+
+/// Returns the result of calling `fn`, or nothing if the call divides by
+/// zero.
+template<typename Engine>
+Value
+run(Engine& e, Fn_decl* fn, std::vector<Value> const& args)
+{
+  try {
+    return e.call(fn, args);
+  }
+  catch (std::runtime_error const&) {
+    return Value();
+  }
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  auto var = [&](char const* n) { return b.make_variable(b.get_name(n), i); };
+  auto id = [&](Var_decl* v) { return b.make_id(v); };
+  auto num = [&](int n) { return b.make_int(n); };
+  auto assign = [&](Var_decl* v, Expr* e) { return b.make_expression(b.make_assign(id(v), e)); };
+  auto ret = [&](Expr* e) { return b.make_return(b.make_variable(nullptr, i), e); };
+  auto function = [&](char const* name, std::vector<Var_decl*> parms) {
+    std::vector<Type*> ts(parms.size() + 1, i);
+    Fn_decl* fn = b.make_function(b.get_name(name), b.get_function_type(ts));
+    for (Var_decl* p : parms)
+      fn->add_parameter(p);
+    fn->set_return(var("ret"));
+    return fn;
+  };
+  auto local = [&](char const* n, Expr* init) {
+    Var_decl* v = var(n);
+    b.copy_initialize(v, init);
+    return v;
+  };
+
+  // fun fold(n : int) -> int {
+  //   var a = 6 * 7; var c = a - 40;
+  //   if (c == 2) return n + a; return n * 1000;
+  // }
+  Var_decl* n1 = var("n");
+  Fn_decl* fold = function("fold", {n1});
+  {
+    Var_decl* a = local("a", b.make_mul(num(6), num(7)));
+    Var_decl* c = local("c", b.make_sub(id(a), num(40)));
+    fold->set_body(b.make_block({
+      b.make_declaration(a),
+      b.make_declaration(c),
+      b.make_if(b.make_eq(id(c), num(2)), ret(b.make_add(id(n1), id(a))), nullptr),
+      ret(b.make_mul(id(n1), num(1000))),
+    }));
+  }
+
+  // fun dead(n : int) -> int { var x = n * 3; var y = x + 1; return n; }
+  Var_decl* n2 = var("n");
+  Fn_decl* dead = function("dead", {n2});
+  {
+    Var_decl* x = local("x", b.make_mul(id(n2), num(3)));
+    Var_decl* y = local("y", b.make_add(id(x), num(1)));
+    dead->set_body(b.make_block({
+      b.make_declaration(x),
+      b.make_declaration(y),
+      ret(id(n2)),
+    }));
+  }
+
+  // fun same(p : int, q : int) -> int { return (p * q + 1) * (p * q + 1); }
+  Var_decl* p = var("p");
+  Var_decl* q = var("q");
+  Fn_decl* same = function("same", {p, q});
+  same->set_body(b.make_block({
+    ret(b.make_mul(b.make_add(b.make_mul(id(p), id(q)), num(1)),
+                   b.make_add(b.make_mul(id(p), id(q)), num(1)))),
+  }));
+
+  // fun hoist(n : int, k : int) -> int {
+  //   var s = 0; var j = 0;
+  //   while (j < n) { s = s + k * k; j = j + 1; }
+  //   return s;
+  // }
+  Var_decl* n4 = var("n");
+  Var_decl* k4 = var("k");
+  Fn_decl* hoist = function("hoist", {n4, k4});
+  {
+    Var_decl* s = local("s", num(0));
+    Var_decl* j = local("j", num(0));
+    hoist->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(j),
+      b.make_while(b.make_lt(id(j), id(n4)), b.make_block({
+        assign(s, b.make_add(id(s), b.make_mul(id(k4), id(k4)))),
+        assign(j, b.make_add(id(j), num(1))),
+      })),
+      ret(id(s)),
+    }));
+  }
+
+  // fun guard(n : int, d : int) -> int {
+  //   var s = 0; var j = 0;
+  //   while (j < n) { s = s + 100 / d; j = j + 1; }
+  //   return s;
+  // }
+  Var_decl* n5 = var("n");
+  Var_decl* d5 = var("d");
+  Fn_decl* guard = function("guard", {n5, d5});
+  {
+    Var_decl* s = local("s", num(0));
+    Var_decl* j = local("j", num(0));
+    guard->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(j),
+      b.make_while(b.make_lt(id(j), id(n5)), b.make_block({
+        assign(s, b.make_add(id(s), b.make_div(num(100), id(d5)))),
+        assign(j, b.make_add(id(j), num(1))),
+      })),
+      ret(id(s)),
+    }));
+  }
+
+  // fun trap(n : int) -> int { var z = 0; if (n > 0) return 1 / z; return 7; }
+  Var_decl* n6 = var("n");
+  Fn_decl* trap = function("trap", {n6});
+  {
+    Var_decl* z = local("z", num(0));
+    trap->set_body(b.make_block({
+      b.make_declaration(z),
+      b.make_if(b.make_gt(id(n6), num(0)), ret(b.make_div(num(1), id(z))), nullptr),
+      ret(num(7)),
+    }));
+  }
+
+  assert(!b.has_errors());
+  Prog_decl* prog = new Prog_decl({fold, dead, same, hoist, guard, trap});
+  int statics = b.layout_program(prog);
+  Evaluator ev(prog, statics);
+
+  std::vector<Test_call> calls;
+  for (Int_value x : {-3, 0, 1, 5}) {
+    calls.push_back({fold, {Value(x)}});
+    calls.push_back({dead, {Value(x)}});
+    calls.push_back({trap, {Value(x)}});
+    for (Int_value y : {-2, 0, 7}) {
+      calls.push_back({same, {Value(x), Value(y)}});
+      calls.push_back({hoist, {Value(x), Value(y)}});
+      calls.push_back({guard, {Value(x), Value(y)}});
+    }
+  }
+
+  // The shared test programs give the same results at every level.
+  Builder tb;
+  Test_program t(tb);
+  Evaluator tev(t.prog, t.statics);
+
+  for (int level = 0; level <= 3; ++level) {
+    Ir_machine ir(prog, level);
+    std::stringstream ss;
+    assert(ir.get_program().verify(ss));
+    for (Test_call const& call : calls) {
+      Value v1 = run(ev, call.fn, call.args);
+      Value v2 = run(ir, call.fn, call.args);
+      assert(v1.is_indeterminate() == v2.is_indeterminate());
+      assert(v1.is_indeterminate() || same_value(v1, v2));
+    }
+
+    Ir_machine tir(t.prog, level);
+    for (Test_call const& call : t.get_calls()) {
+      Value v1 = tev.call(call.fn, call.args);
+      Value v2 = tir.call(call.fn, call.args);
+      assert(same_value(v1, v2));
+    }
+
+    Ir_program const& p = ir.get_program();
+    Ir_function const* f = p.get_function(fold);
+    Ir_function const* d = p.get_function(dead);
+    Ir_function const* s = p.get_function(same);
+    Ir_function const* h = p.get_function(hoist);
+    Ir_function const* g = p.get_function(guard);
+    Ir_function const* z = p.get_function(trap);
+    if (level == 0) {
+      assert(count(f, mul_i_ir) == 2 && count(f, cbr_ir) == 1);
+      assert(count(d, mul_i_ir) == 1 && count(d, add_i_ir) == 1);
+      assert(count(s, mul_i_ir) == 3);
+      continue;
+    }
+
+    // Constants are folded, and the branch on them and the code it
+    // skips are removed.
+    assert(count(f, mul_i_ir) == 0 && count(f, sub_i_ir) == 0 && count(f, cbr_ir) == 0);
+    // Unused values are removed.
+    assert(count(d, mul_i_ir) == 0 && count(d, add_i_ir) == 0);
+    // The division that traps is kept.
+    assert(count(z, div_i_ir) == 1);
+    if (level == 1)
+      continue;
+
+    // The repeated product and sum are computed once.
+    assert(count(s, mul_i_ir) == 2 && count(s, add_i_ir) == 1);
+
+    // The square is computed before the loop, in a block that dominates
+    // the loop condition. The division is not moved.
+    Ir_dominators dom(*h);
+    Ir_inst* sq = find(h, mul_i_ir);
+    Ir_inst* cond = find(h, lt_i_ir);
+    assert(sq->get_block() != cond->get_block());
+    assert(dom.dominates(sq->get_block(), cond->get_block()));
+    Ir_inst* div = find(g, div_i_ir);
+    assert(div->get_block() != find(g, lt_i_ir)->get_block());
+    assert(!Ir_dominators(*g).dominates(div->get_block(), find(g, lt_i_ir)->get_block()));
+  }
+}
@@ -0,0 +1,200 @@
+// Tests the edges of the Packed_value encoding: the largest integers
+// stored inline, NaNs and the other special floats, ownership of boxed
+// integers, and pointer payloads.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "object.hpp"
+#include "packed.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace
+{
+
+long live = 0;
+/// The number of allocations not yet freed.
+
+/// Returns the bits of `n`.
+std::uint64_t
+bits(Float_value n)
+{
+  std::uint64_t b;
+  std::memcpy(&b, &n, sizeof b);
+  return b;
+}
+
+/// Returns the float whose bits are `b`.
+Float_value
+from_bits(std::uint64_t b)
+{
+  Float_value n;
+  std::memcpy(&n, &b, sizeof n);
+  return n;
+}
+
+/// Checks that `n` is stored inline or boxed as `boxed` says and that
+/// it survives packing.
+void
+check_int(Int_value n, bool boxed)
+{
+  long before = live;
+  {
+    Packed_value v(n);
+    assert(v.is_int() && !v.is_float());
+    assert(v.is_boxed() == boxed);
+    assert(v.get_int() == n);
+    assert(v.to_value().get_int() == n);
+    assert(live == before + boxed);
+  }
+  assert(live == before);
+}
+
+/// Checks that `n` is stored as its own bits.
+void
+check_float(Float_value n)
+{
+  Packed_value v(n);
+  assert(v.is_float() && !v.is_int() && !v.is_indeterminate());
+  assert(v.get_bits() == bits(n));
+  assert(bits(v.get_float()) == bits(n));
+}
+
+} // namespace
+
+void*
+operator new(std::size_t n)
+{
+  if (void* p = std::malloc(n ? n : 1)) {
+    ++live;
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+  if (p) {
+    --live;
+    std::free(p);
+  }
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+int
+main()
+{
+  // Integers are inline exactly when they fit in 48 bits.
+  constexpr Int_value max48 = (Int_value(1) << 47) - 1;
+  constexpr Int_value min48 = -(Int_value(1) << 47);
+  check_int(0, false);
+  check_int(-1, false);
+  check_int(max48, false);
+  check_int(min48, false);
+  check_int(max48 + 1, true);
+  check_int(min48 - 1, true);
+  check_int(std::numeric_limits<Int_value>::max(), true);
+  check_int(std::numeric_limits<Int_value>::min(), true);
+  assert(Packed_value(true).get_int() == 1);
+  assert(Packed_value(false).get_int() == 0);
+
+  // Every NaN is packed as the canonical quiet NaN, including those
+  // whose bits would otherwise read as a tagged value.
+  std::uint64_t canon = bits(std::numeric_limits<Float_value>::quiet_NaN());
+  Float_value nans[] = {
+    std::numeric_limits<Float_value>::quiet_NaN(),
+    std::numeric_limits<Float_value>::signaling_NaN(),
+    -std::numeric_limits<Float_value>::quiet_NaN(),
+    from_bits(0xfffa000000000001ull),
+    from_bits(0xfffd123456789abcull),
+    from_bits(0xffffffffffffffffull),
+  };
+  for (Float_value n : nans) {
+    Packed_value v(n);
+    assert(v.is_float());
+    assert(v.get_bits() == canon);
+    assert(std::isnan(v.get_float()));
+  }
+
+  // Infinities, signed zeros and the extreme finite values are stored
+  // as themselves.
+  check_float(std::numeric_limits<Float_value>::infinity());
+  check_float(-std::numeric_limits<Float_value>::infinity());
+  check_float(0.0);
+  check_float(-0.0);
+  check_float(std::numeric_limits<Float_value>::max());
+  check_float(-std::numeric_limits<Float_value>::max());
+  check_float(std::numeric_limits<Float_value>::denorm_min());
+  assert(std::signbit(Packed_value(-0.0).get_float()));
+  assert(Packed_value(-0.0).get_bits() != Packed_value(0.0).get_bits());
+
+  // An indeterminate value is neither an integer nor a float.
+  Packed_value none;
+  assert(none.is_indeterminate() && !none.is_int() && !none.is_float());
+
+  // Copying a boxed integer boxes it again, and moving one transfers the
+  // box and leaves the source indeterminate.
+  Int_value big = max48 + 5;
+  long before = live;
+  {
+    Packed_value a(big);
+    Packed_value b(a);
+    assert(b.is_boxed() && b.get_int() == big);
+    assert(b.get_bits() != a.get_bits());
+    assert(live == before + 2);
+
+    Packed_value c(std::move(a));
+    assert(c.is_boxed() && c.get_int() == big);
+    assert(a.is_indeterminate());
+    assert(live == before + 2);
+
+    // Assigning over a box frees it; assigning a box copies it.
+    Packed_value d(Int_value(7));
+    d = c;
+    assert(d.is_boxed() && d.get_int() == big);
+    assert(live == before + 3);
+    d = Packed_value(Int_value(8));
+    assert(!d.is_boxed() && d.get_int() == 8);
+    assert(live == before + 2);
+    d = std::move(c);
+    assert(d.get_int() == big && c.is_indeterminate());
+    assert(live == before + 2);
+
+    Packed_value const& self = d;
+    d = self;
+    d = std::move(d);
+    assert(d.get_int() == big);
+    assert(live == before + 2);
+  }
+  assert(live == before);
+
+  // Functions, objects and cells round trip through the payload.
+  Builder b;
+  Type* i = b.get_int_type();
+  Fn_decl* fn = b.make_function(b.get_name("f"), b.get_function_type({i}));
+  Packed_value f(fn);
+  assert(f.is_function() && !f.is_int() && !f.is_float());
+  assert(f.get_function() == fn);
+  assert(f.to_value().get_function() == fn);
+
+  Object obj(i, Packed_value(Int_value(1)));
+  Packed_value addr(&obj);
+  assert(addr.is_address() && !addr.is_function() && !addr.is_float());
+  assert(addr.get_address() == &obj);
+
+  Packed_value cell;
+  Packed_value ref(&cell);
+  assert(ref.is_address() && ref.get_cell() == &cell);
+}
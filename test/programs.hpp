@@ -0,0 +1,392 @@
+// Programs shared by the tests that compare execution engines.
+
+#pragma once
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "value.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// A call of a test program and its arguments.
+struct Test_call
+{
+  Fn_decl* fn;
+  std::vector<Value> args;
+};
+
+
+/// A checked and laid out program whose functions exercise each kind of
+/// expression and statement, calls through references and function
+/// values, integers too wide for an unboxed value, and tail calls.
+///
+/// The functions are:
+///
+///   var g : int = 7;
+///   fun fib(n : int) -> int
+///   fun loop(n : int) -> int               // while, assignment
+///   fun incr(ref x : int) -> int           // reference parameter
+///   fun twice(n : int) -> int              // calls incr(x) twice
+///   fun flow(n : int) -> int               // break, continue, &&, ||, !, %
+///   fun boxed(n : int) -> int              // values wider than 48 bits
+///   fun apply(n : int) -> int              // call through a variable
+///   fun pressure(n : int) -> int           // many values live across a call
+///   fun hyp(x : float, y : float) -> float
+///   fun sum(n : int, acc : int) -> int     // self tail call
+///   fun even(n : int) -> int               // mutual tail calls
+///   fun odd(n : int) -> int
+///   fun tm8(n : int, a1 ... a7 : int) -> int // tail call with 8 arguments
+///   fun rsum(n : int) -> int               // non-tail recursion
+///   fun fail(n : int) -> int               // divides by zero n calls deep
+class Test_program
+{
+public:
+  explicit Test_program(Builder& b);
+
+  std::vector<Test_call> get_calls();
+  /// Returns calls of each function with arguments that finish quickly.
+
+  Builder& b;
+  Type* int_type;
+  Type* float_type;
+
+  Var_decl* g;
+  Fn_decl* fib;
+  Fn_decl* loop;
+  Fn_decl* incr;
+  Fn_decl* twice;
+  Fn_decl* flow;
+  Fn_decl* boxed;
+  Fn_decl* apply;
+  Fn_decl* pressure;
+  Fn_decl* hyp;
+  Fn_decl* sum;
+  Fn_decl* even;
+  Fn_decl* odd;
+  Fn_decl* tm8;
+  Fn_decl* rsum;
+  Fn_decl* fail;
+
+  Prog_decl* prog;
+  int statics;
+
+private:
+  Fn_decl* function(char const* name, std::vector<Type*> const& parms, Type* ret);
+  Var_decl* local(char const* name, Expr* init);
+
+  Expr* id(Decl* d) { return b.make_id(d); }
+  Expr* num(int n) { return b.make_int(n); }
+  Expr* parm(Fn_decl* fn, int n);
+  Expr* call(Fn_decl* fn, std::vector<Expr*> args);
+  Stmt* ret(Fn_decl* fn, Expr* e);
+  Stmt* assign(Decl* d, Expr* e) { return b.make_expression(b.make_assign(id(d), e)); }
+};
+
+inline Fn_decl*
+Test_program::function(char const* name, std::vector<Type*> const& parms, Type* ret)
+{
+  std::vector<Type*> ts = parms;
+  ts.push_back(ret);
+  Fn_decl* fn = b.make_function(b.get_name(name), b.get_function_type(ts));
+  for (std::size_t n = 0; n < parms.size(); ++n) {
+    std::string p = "p" + std::to_string(n);
+    fn->add_parameter(b.make_variable(b.get_name(p.c_str()), parms[n]));
+  }
+  fn->set_return(b.make_variable(b.get_name("ret"), ret));
+  return fn;
+}
+
+inline Var_decl*
+Test_program::local(char const* name, Expr* init)
+{
+  Var_decl* var = b.make_variable(b.get_name(name), int_type);
+  b.copy_initialize(var, init);
+  return var;
+}
+
+inline Expr*
+Test_program::parm(Fn_decl* fn, int n)
+{
+  auto iter = fn->get_parameters().begin();
+  while (n--)
+    ++iter;
+  return id(*iter);
+}
+
+/// Returns `return e;` in `fn`. Each return statement initializes a
+/// variable of the return type with its operand.
+inline Stmt*
+Test_program::ret(Fn_decl* fn, Expr* e)
+{
+  Type* t = fn->get_function_type()->get_return_type();
+  return b.make_return(b.make_variable(nullptr, t), e);
+}
+
+inline Expr*
+Test_program::call(Fn_decl* fn, std::vector<Expr*> args)
+{
+  args.insert(args.begin(), id(fn));
+  return b.make_call(std::move(args));
+}
+
+inline
+Test_program::Test_program(Builder& b)
+  : b(b), int_type(b.get_int_type()), float_type(b.get_float_type())
+{
+  Type* i = int_type;
+  Type* f = float_type;
+
+  g = b.make_variable(b.get_name("g"), i);
+  b.copy_initialize(g, num(7));
+
+  // fun fib(n : int) -> int
+  // { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }
+  fib = function("fib", {i}, i);
+  fib->set_body(b.make_block({
+    b.make_if(b.make_lt(parm(fib, 0), num(2)), ret(fib, parm(fib, 0)), nullptr),
+    ret(fib, b.make_add(call(fib, {b.make_sub(parm(fib, 0), num(1))}),
+                        call(fib, {b.make_sub(parm(fib, 0), num(2))}))),
+  }));
+
+  // fun loop(n : int) -> int
+  // { var s = 0; var k = 0; while (k < n) { s = s + k; k = k + 1; } return s; }
+  loop = function("loop", {i}, i);
+  {
+    Var_decl* s = local("s", num(0));
+    Var_decl* k = local("k", num(0));
+    loop->set_body(b.make_block({
+      b.make_declaration(s),
+      b.make_declaration(k),
+      b.make_while(b.make_lt(id(k), parm(loop, 0)), b.make_block({
+        assign(s, b.make_add(id(s), id(k))),
+        assign(k, b.make_add(id(k), num(1))),
+      })),
+      ret(loop, id(s)),
+    }));
+  }
+
+  // fun incr(ref x : int) -> int { x = x + 1; return x; }
+  incr = function("incr", {b.get_reference_type(i)}, i);
+  incr->set_body(b.make_block({
+    b.make_expression(b.make_assign(parm(incr, 0), b.make_add(parm(incr, 0), num(1)))),
+    ret(incr, parm(incr, 0)),
+  }));
+
+  // fun twice(n : int) -> int { var x = n; incr(x); return incr(x) * 10 + x; }
+  twice = function("twice", {i}, i);
+  {
+    Var_decl* x = local("x", parm(twice, 0));
+    twice->set_body(b.make_block({
+      b.make_declaration(x),
+      b.make_expression(call(incr, {id(x)})),
+      ret(twice, b.make_add(b.make_mul(call(incr, {id(x)}), num(10)), id(x))),
+    }));
+  }
+
+  // fun flow(n : int) -> int {
+  //   var k = 0; var s = 0;
+  //   while (true) {
+  //     k = k + 1;
+  //     if (k > n) break;
+  //     if (k % 3 == 0 || !(k % 5 != 0)) continue;
+  //     if (k > 2 && k < 6) s = s - -k; else s = s + k * 2;
+  //   }
+  //   return s;
+  // }
+  flow = function("flow", {i}, i);
+  {
+    Var_decl* k = local("k", num(0));
+    Var_decl* s = local("s", num(0));
+    Expr* skip = b.make_or(b.make_eq(b.make_rem(id(k), num(3)), num(0)),
+                           b.make_not(b.make_ne(b.make_rem(id(k), num(5)), num(0))));
+    flow->set_body(b.make_block({
+      b.make_declaration(k),
+      b.make_declaration(s),
+      b.make_while(b.make_true(), b.make_block({
+        assign(k, b.make_add(id(k), num(1))),
+        b.make_if(b.make_gt(id(k), parm(flow, 0)), b.make_break(), nullptr),
+        b.make_if(skip, b.make_continue(), nullptr),
+        b.make_if(b.make_and(b.make_gt(id(k), num(2)), b.make_lt(id(k), num(6))),
+                  assign(s, b.make_sub(id(s), b.make_neg(id(k)))),
+                  assign(s, b.make_add(id(s), b.make_mul(id(k), num(2))))),
+      })),
+      ret(flow, id(s)),
+    }));
+  }
+
+  // fun boxed(n : int) -> int
+  // { var x = n * 1000000 * 1000000 * 1000 + g; return x / 10 - x % 1000 + g; }
+  boxed = function("boxed", {i}, i);
+  {
+    Expr* big = b.make_mul(b.make_mul(b.make_mul(parm(boxed, 0), num(1000000)), num(1000000)),
+                           num(1000));
+    Var_decl* x = local("x", b.make_add(big, id(g)));
+    boxed->set_body(b.make_block({
+      b.make_declaration(x),
+      ret(boxed, b.make_add(b.make_sub(b.make_div(id(x), num(10)),
+                                       b.make_rem(id(x), num(1000))),
+                            id(g))),
+    }));
+  }
+
+  // fun apply(n : int) -> int
+  // { var h = fib; return h(n) + (n > 3 ? 100 : 200); }
+  apply = function("apply", {i}, i);
+  {
+    Var_decl* h = b.make_variable(b.get_name("h"), fib->get_type());
+    b.copy_initialize(h, id(fib));
+    apply->set_body(b.make_block({
+      b.make_declaration(h),
+      ret(apply, b.make_add(b.make_call({id(h), parm(apply, 0)}),
+                            b.make_conditional(b.make_gt(parm(apply, 0), num(3)),
+                                               num(100), num(200)))),
+    }));
+  }
+
+  // fun pressure(n : int) -> int {
+  //   var v0 = n + 1; ... var v13 = n + 14;
+  //   var c = fib(n);
+  //   return v0 * 1 + v1 * 2 + ... + v13 * 14 + c;
+  // }
+  pressure = function("pressure", {i}, i);
+  {
+    std::vector<Stmt*> ss;
+    std::vector<Var_decl*> vs;
+    for (int n = 0; n < 14; ++n) {
+      std::string name = "v" + std::to_string(n);
+      vs.push_back(local(name.c_str(), b.make_add(parm(pressure, 0), num(n + 1))));
+      ss.push_back(b.make_declaration(vs.back()));
+    }
+    Var_decl* c = local("c", call(fib, {parm(pressure, 0)}));
+    ss.push_back(b.make_declaration(c));
+    Expr* e = id(c);
+    for (int n = 0; n < 14; ++n)
+      e = b.make_add(e, b.make_mul(id(vs[n]), num(n + 1)));
+    ss.push_back(ret(pressure, e));
+    pressure->set_body(b.make_block(ss));
+  }
+
+  // fun hyp(x : float, y : float) -> float
+  // { return x * x + y * y / 2.0 - /x; }
+  //
+  // Builder declares but does not define make_float and make_rec, so
+  // those nodes are made directly.
+  hyp = function("hyp", {f, f}, f);
+  {
+    Expr* two = new Float_expr(f, Value(2.0));
+    Expr* rec = new Rec_expr(f, b.convert_to_value(parm(hyp, 0)));
+    hyp->set_body(b.make_block({
+      ret(hyp, b.make_sub(b.make_add(b.make_mul(parm(hyp, 0), parm(hyp, 0)),
+                                     b.make_div(b.make_mul(parm(hyp, 1), parm(hyp, 1)), two)),
+                          rec)),
+    }));
+  }
+
+  // fun sum(n : int, acc : int) -> int
+  // { if (n == 0) return acc; return sum(n - 1, acc + n); }
+  sum = function("sum", {i, i}, i);
+  sum->set_body(b.make_block({
+    b.make_if(b.make_eq(parm(sum, 0), num(0)), ret(sum, parm(sum, 1)), nullptr),
+    ret(sum, call(sum, {b.make_sub(parm(sum, 0), num(1)),
+                        b.make_add(parm(sum, 1), parm(sum, 0))})),
+  }));
+
+  // fun even(n : int) -> int { if (n == 0) return 1; return odd(n - 1); }
+  // fun odd(n : int) -> int { if (n == 0) return 0; return even(n - 1); }
+  even = function("even", {i}, i);
+  odd = function("odd", {i}, i);
+  even->set_body(b.make_block({
+    b.make_if(b.make_eq(parm(even, 0), num(0)), ret(even, num(1)), nullptr),
+    ret(even, call(odd, {b.make_sub(parm(even, 0), num(1))})),
+  }));
+  odd->set_body(b.make_block({
+    b.make_if(b.make_eq(parm(odd, 0), num(0)), ret(odd, num(0)), nullptr),
+    ret(odd, call(even, {b.make_sub(parm(odd, 0), num(1))})),
+  }));
+
+  // fun tm8(n : int, a1 ... a7 : int) -> int {
+  //   if (n == 0) return a1 * 1 + a2 * 2 + ... + a7 * 7;
+  //   return tm8(n - 1, a2, ..., a7, a1 + 1);
+  // }
+  tm8 = function("tm8", std::vector<Type*>(8, i), i);
+  {
+    Expr* e = num(0);
+    for (int n = 1; n < 8; ++n)
+      e = b.make_add(e, b.make_mul(parm(tm8, n), num(n)));
+    std::vector<Expr*> args{b.make_sub(parm(tm8, 0), num(1))};
+    for (int n = 2; n < 8; ++n)
+      args.push_back(parm(tm8, n));
+    args.push_back(b.make_add(parm(tm8, 1), num(1)));
+    tm8->set_body(b.make_block({
+      b.make_if(b.make_eq(parm(tm8, 0), num(0)), ret(tm8, e), nullptr),
+      ret(tm8, call(tm8, args)),
+    }));
+  }
+
+  // fun rsum(n : int) -> int { return n == 0 ? 0 : n + rsum(n - 1); }
+  rsum = function("rsum", {i}, i);
+  rsum->set_body(b.make_block({
+    ret(rsum, b.make_conditional(b.make_eq(parm(rsum, 0), num(0)), num(0),
+                                 b.make_add(parm(rsum, 0),
+                                            call(rsum, {b.make_sub(parm(rsum, 0), num(1))})))),
+  }));
+
+  // fun fail(n : int) -> int { if (n == 0) return 1 / n; return fail(n - 1) + 1; }
+  fail = function("fail", {i}, i);
+  fail->set_body(b.make_block({
+    b.make_if(b.make_eq(parm(fail, 0), num(0)), ret(fail, b.make_div(num(1), parm(fail, 0))),
+              nullptr),
+    ret(fail, b.make_add(call(fail, {b.make_sub(parm(fail, 0), num(1))}), num(1))),
+  }));
+
+  prog = new Prog_decl({g, fib, loop, incr, twice, flow, boxed, apply, pressure,
+                        hyp, sum, even, odd, tm8, rsum, fail});
+  statics = b.layout_program(prog);
+}
+
+inline std::vector<Test_call>
+Test_program::get_calls()
+{
+  auto n = [](Int_value v) { return Value(v); };
+  std::vector<Value> eight{n(10)};
+  for (int k = 1; k < 8; ++k)
+    eight.push_back(n(k));
+  return {
+    {fib, {n(15)}},
+    {loop, {n(1000)}},
+    {twice, {n(5)}},
+    {flow, {n(40)}},
+    {boxed, {n(3)}},
+    {boxed, {n(-5000)}},
+    {apply, {n(10)}},
+    {apply, {n(2)}},
+    {pressure, {n(6)}},
+    {hyp, {Value(1.5), Value(-3.0)}},
+    {sum, {n(1000), n(0)}},
+    {even, {n(101)}},
+    {odd, {n(101)}},
+    {tm8, eight},
+    {rsum, {n(500)}},
+  };
+}
+
+/// Returns true if `a` and `b` are the same integer or floating point
+/// value. Floating point values are compared by their bits.
+inline bool
+same_value(Value const& a, Value const& b)
+{
+  if (a.get_kind() != b.get_kind())
+    return false;
+  if (a.is_int())
+    return a.get_int() == b.get_int();
+  if (a.is_float()) {
+    Float_value x = a.get_float();
+    Float_value y = b.get_float();
+    return std::memcmp(&x, &y, sizeof x) == 0;
+  }
+  return false;
+}
@@ -0,0 +1,67 @@
+// Tests symbol resolution with the undo log of Resolver.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "scope.hpp"
+#include "symbol.hpp"
+
+#include <cassert>
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  Decl* x1 = b.make_variable(b.get_name("x"), i);
+  Decl* x2 = b.make_variable(b.get_name("x"), i);
+  Decl* x3 = b.make_variable(b.get_name("x"), i);
+  Decl* y = b.make_variable(b.get_name("y"), i);
+
+  Symbol_table syms;
+  Symbol x = syms.get("x");
+  Symbol ys = syms.get("y");
+  Symbol z = syms.get("z");
+
+  Resolver r;
+  assert(r.get_depth() == 0);
+  assert(r.lookup(x) == nullptr);
+
+  // Declarations at depth 0 are visible in every scope.
+  assert(r.declare(x, x1));
+  assert(r.lookup(x) == x1);
+  assert(!r.declare(x, x2));
+  assert(r.lookup(x) == x1);
+
+  // An inner declaration shadows an outer one until its scope ends.
+  r.enter_scope();
+  assert(r.get_depth() == 1);
+  assert(r.lookup(x) == x1);
+  assert(r.declare(x, x2));
+  assert(r.lookup(x) == x2);
+
+  // Redeclaration in the same scope fails and keeps the first binding.
+  assert(!r.declare(x, x3));
+  assert(r.lookup(x) == x2);
+
+  r.enter_scope();
+  assert(r.declare(x, x3));
+  assert(r.declare(ys, y));
+  assert(r.lookup(x) == x3);
+  assert(r.lookup(ys) == y);
+  assert(r.lookup(z) == nullptr);
+
+  // Leaving a scope restores the bindings it shadowed.
+  r.leave_scope();
+  assert(r.lookup(x) == x2);
+  assert(r.lookup(ys) == nullptr);
+  r.leave_scope();
+  assert(r.get_depth() == 0);
+  assert(r.lookup(x) == x1);
+
+  // A symbol may be declared again once its scope has ended.
+  r.enter_scope();
+  assert(r.declare(ys, y));
+  assert(r.lookup(ys) == y);
+  r.leave_scope();
+  assert(r.lookup(ys) == nullptr);
+}
@@ -0,0 +1,260 @@
+// Tests that stack code computes the value of the expression it was
+// emitted from, that its text form assembles back to the same bytes, and
+// that Generator emits code that follows the precedence, associativity
+// and wrapping of the language.
+
+#include "generator.hpp"
+#include "stack_code.hpp"
+#include "symbol.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+/// An expression tree of integer literals and arithmetic operators.
+struct Node
+{
+  Stack_op op;
+  Int_value value;
+  Node* left;
+  Node* right;
+};
+
+/// Returns interesting literals: the bounds of each immediate encoding
+/// and of the integers.
+Int_value
+make_literal(std::mt19937& gen)
+{
+  static Int_value const edges[] = {
+    0, 1, -1, 2, 7, 127, -128, 128, -129, 100000,
+    std::numeric_limits<Int_value>::max(),
+    std::numeric_limits<Int_value>::min(),
+  };
+  if (gen() % 2)
+    return edges[gen() % (sizeof edges / sizeof *edges)];
+  return Int_value(gen() % 2001) - 1000;
+}
+
+/// Returns a random expression of at most `depth` levels.
+Node*
+make_tree(std::mt19937& gen, int depth)
+{
+  if (depth == 0 || gen() % 4 == 0)
+    return new Node{push64_sop, make_literal(gen), nullptr, nullptr};
+  static Stack_op const ops[] = {add_sop, sub_sop, mul_sop, div_sop, rem_sop};
+  Stack_op op = ops[gen() % 5];
+  Node* l = make_tree(gen, depth - 1);
+  Node* r = make_tree(gen, depth - 1);
+  return new Node{op, 0, l, r};
+}
+
+/// Returns the value of `n`, computed with wrapping arithmetic. Throws
+/// on division by zero.
+Int_value
+evaluate(Node const* n)
+{
+  if (!n->left)
+    return n->value;
+  std::uint64_t a = evaluate(n->left);
+  std::uint64_t b = evaluate(n->right);
+  switch (n->op) {
+  case add_sop: return Int_value(a + b);
+  case sub_sop: return Int_value(a - b);
+  case mul_sop: return Int_value(a * b);
+  case div_sop:
+  case rem_sop:
+    if (b == 0)
+      throw std::runtime_error("division by zero");
+    if (Int_value(b) == -1)
+      return n->op == div_sop ? Int_value(-a) : 0;
+    if (n->op == div_sop)
+      return Int_value(a) / Int_value(b);
+    return Int_value(a) % Int_value(b);
+  default:
+    assert(false);
+    return 0;
+  }
+}
+
+/// Emits the code of `n` in postfix order.
+void
+emit(Stack_code& code, Node const* n)
+{
+  if (!n->left) {
+    code.emit_push(n->value);
+    return;
+  }
+  emit(code, n->left);
+  emit(code, n->right);
+  code.emit(n->op);
+}
+
+/// Returns the code whose text form is `text`.
+Stack_code
+assemble(std::string const& text)
+{
+  Stack_code code;
+  std::istringstream is(text);
+  std::string word;
+  while (is >> word) {
+    if (word == "push") {
+      Int_value n;
+      is >> n;
+      code.emit_push(n);
+    }
+    else if (word == "add")
+      code.emit(add_sop);
+    else if (word == "sub")
+      code.emit(sub_sop);
+    else if (word == "mul")
+      code.emit(mul_sop);
+    else if (word == "div")
+      code.emit(div_sop);
+    else if (word == "rem")
+      code.emit(rem_sop);
+    else
+      assert(false);
+  }
+  return code;
+}
+
+/// Returns the result of `f`, or the message of the runtime error it
+/// throws.
+template<typename F>
+std::string
+run(F f)
+{
+  try {
+    return std::to_string(f());
+  }
+  catch (std::runtime_error& err) {
+    return err.what();
+  }
+}
+
+/// Returns the value of the expression `src`, run from the code that
+/// Generator emits for it.
+Int_value
+generate(std::string const& src)
+{
+  Symbol_table syms;
+  Generator gen(syms, src);
+  gen.parse_expression();
+  return execute(gen.get_code());
+}
+
+} // namespace
+
+int
+main()
+{
+  // Multiplicative operators bind tighter than additive ones, and
+  // parentheses override both.
+  assert(generate("2 + 3 * 4") == 14);
+  assert(generate("(2 + 3) * 4") == 20);
+  assert(generate("2 * 3 + 4 * 5") == 26);
+  assert(generate("20 - 6 / 3") == 18);
+  assert(generate("20 - 6 % 4") == 18);
+  assert(generate("2 * (3 + 4) * 5") == 70);
+
+  // Binary operators are left associative.
+  assert(generate("10 - 4 - 3") == 3);
+  assert(generate("100 / 10 / 5") == 2);
+  assert(generate("50 % 17 % 5") == 1);
+  assert(generate("12 / 3 * 2") == 8);
+  assert(generate("1 - 2 + 3") == 2);
+
+  // Prefix '-' negates and prefix '/' takes the reciprocal, both binding
+  // tighter than any binary operator.
+  assert(generate("-5") == -5);
+  assert(generate("--5") == 5);
+  assert(generate("-2 * 3") == -6);
+  assert(generate("7 - -3") == 10);
+  assert(generate("/1") == 1);
+  assert(generate("/2") == 0);
+  assert(generate("/-1") == -1);
+  assert(generate("8 / /1") == 8);
+  assert(generate("/2 * 4") == 0);
+
+  // Literals past the largest integer wrap modulo 2^64, as arithmetic
+  // does.
+  Int_value min = std::numeric_limits<Int_value>::min();
+  assert(generate("9223372036854775807") == std::numeric_limits<Int_value>::max());
+  assert(generate("9223372036854775808") == min);
+  assert(generate("-9223372036854775808") == min);
+  assert(generate("18446744073709551615") == -1);
+  assert(generate("18446744073709551617") == 1);
+  assert(generate("9223372036854775807 + 1") == min);
+
+  // Immediates take one byte when they fit in a signed byte.
+  {
+    Stack_code code;
+    code.emit_push(127);
+    assert(code.size() == 2);
+    code.emit_push(-128);
+    assert(code.size() == 4);
+    code.emit_push(128);
+    assert(code.size() == 13);
+    code.emit_push(-129);
+    assert(code.size() == 22);
+    assert(code.get_max_depth() == 4);
+    code.emit(add_sop);
+    code.emit(sub_sop);
+    code.emit(mul_sop);
+    assert(code.size() == 25);
+    assert(code.get_max_depth() == 4);
+    assert(execute(code) == 127 * (-128 - (128 + -129)));
+  }
+
+  // Division by zero throws, and the most negative integer divided by -1
+  // wraps.
+  {
+    Stack_code code;
+    code.emit_push(5);
+    code.emit_push(0);
+    code.emit(rem_sop);
+    bool thrown = false;
+    try {
+      execute(code);
+    }
+    catch (std::runtime_error&) {
+      thrown = true;
+    }
+    assert(thrown);
+
+    Int_value min = std::numeric_limits<Int_value>::min();
+    Stack_code wrap;
+    wrap.emit_push(min);
+    wrap.emit_push(-1);
+    wrap.emit(div_sop);
+    assert(execute(wrap) == min);
+  }
+
+  // Random expressions run to their values, and their text assembles to
+  // the same code.
+  std::mt19937 gen(7);
+  for (int k = 0; k < 2000; ++k) {
+    Node* tree = make_tree(gen, 1 + k % 8);
+    Stack_code code;
+    emit(code, tree);
+
+    std::ostringstream os;
+    code.disassemble(os);
+    Stack_code again = assemble(os.str());
+    assert(again.size() == code.size());
+    assert(std::equal(code.data(), code.data() + code.size(), again.data()));
+    assert(again.get_max_depth() == code.get_max_depth());
+
+    std::string expected = run([&] { return evaluate(tree); });
+    assert(run([&] { return execute(code); }) == expected);
+    assert(run([&] { return execute(again); }) == expected);
+  }
+}
@@ -0,0 +1,105 @@
+// Tests that node statistics count each construction of a known tree by
+// kind, including the operands of k-ary nodes, and that reset and
+// disable stop them from accumulating.
+
+#include "builder.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stats.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <cassert>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+bool
+same(Node_count a, Node_count b)
+{
+  return a.constructed == b.constructed && a.bytes == b.bytes;
+}
+
+/// Returns the count of `n` nodes of class `T` with `ops` operands in all.
+template<typename T>
+Node_count
+expected(std::size_t n, std::size_t ops = 0)
+{
+  return {n, n * sizeof(T) + ops * sizeof(void*)};
+}
+
+} // namespace
+
+int
+main()
+{
+  // The builder and its base types are made before counting starts.
+  Builder b;
+  Type* i = b.get_int_type();
+  Type* ft = b.get_function_type({i, i, i});
+
+  enable_node_stats(false);
+  reset_node_stats();
+
+  // fun f(a : int, b : int) -> int;
+  // { f(1, 2); f(3, 4) + 5; }
+  Fn_decl* f = b.make_function(b.get_name("f"), ft);
+  f->add_parameter(b.make_variable(b.get_name("a"), i));
+  f->add_parameter(b.make_variable(b.get_name("b"), i));
+  f->set_return(b.make_variable(b.get_name("ret"), i));
+  Stmt* s = b.make_block({
+    b.make_expression(b.make_call({b.make_id(f), b.make_int(1), b.make_int(2)})),
+    b.make_expression(b.make_add(b.make_call({b.make_id(f), b.make_int(3), b.make_int(4)}),
+                                 b.make_int(5))),
+  });
+  disable_node_stats();
+
+  // Nodes made while counting is disabled are not counted.
+  b.make_int(6);
+  b.make_variable(b.get_name("c"), i);
+
+  assert(same(get_node_count(decl_node, Decl::fn_decl), expected<Fn_decl>(1, 3)));
+  assert(same(get_node_count(decl_node, Decl::var_decl), expected<Var_decl>(3)));
+  assert(same(get_node_count(expr_node, Expr::int_lit), expected<Int_expr>(5)));
+  assert(same(get_node_count(expr_node, Expr::call_expr), expected<Call_expr>(2, 6)));
+  assert(same(get_node_count(expr_node, Expr::add_expr), expected<Add_expr>(1)));
+  assert(same(get_node_count(stmt_node, Stmt::block_stmt), expected<Block_stmt>(1, 2)));
+  assert(same(get_node_count(stmt_node, Stmt::expr_stmt), expected<Expr_stmt>(2)));
+
+  // Each id-expression names the function, whose reference type already
+  // exists, so no type is constructed.
+  Node_count ids = get_node_count(expr_node, Expr::id_expr);
+  assert(ids.constructed == 2 && ids.bytes == 2 * sizeof(Id_expr));
+  assert(get_node_total(type_node).constructed == 0);
+
+  // The totals are the sums of the kinds.
+  Node_count exprs = get_node_total(expr_node);
+  assert(exprs.constructed == 5 + 2 + 1 + 2 + get_node_count(expr_node, Expr::value_conv).constructed);
+  assert(get_node_total(stmt_node).constructed == 3);
+  assert(get_node_total(decl_node).constructed == 4);
+
+  // The report lists each kind constructed and the totals.
+  std::ostringstream os;
+  report_node_stats(os);
+  std::string report = os.str();
+  assert(report.find("call_expr") != std::string::npos);
+  assert(report.find("total expr") != std::string::npos);
+  assert(report.find("fn_decl") != std::string::npos);
+
+  // Resetting discards every count.
+  reset_node_stats();
+  for (Node_category c : {expr_node, stmt_node, decl_node, type_node})
+    assert(same(get_node_total(c), {0, 0}));
+
+  // Counting again starts from zero, and adding a member to a program
+  // counts its operand.
+  enable_node_stats(false);
+  Prog_decl* prog = new Prog_decl(std::vector<Decl*>());
+  prog->add_child(f);
+  disable_node_stats();
+  assert(same(get_node_count(decl_node, Decl::prog_decl), expected<Prog_decl>(1, 1)));
+  assert(get_node_total(expr_node).constructed == 0);
+  (void)s;
+}
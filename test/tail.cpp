@@ -0,0 +1,125 @@
+// Tests that each engine runs a million tail calls in constant space:
+// self tail calls, mutual tail calls, and tail calls with more arguments
+// than fit in registers. Space is measured as the growth of the peak
+// resident set size, which a frame for each call, on the native stack or
+// on an engine's own stack, would exceed many times over.
+
+#include "programs.hpp"
+
+#include "asmgen.hpp"
+#include "bytecode.hpp"
+#include "cgen.hpp"
+#include "eval.hpp"
+#include "ir_machine.hpp"
+#include "vm.hpp"
+
+#include <sys/resource.h>
+
+#include <cassert>
+
+namespace
+{
+
+#if defined(__SANITIZE_ADDRESS__)
+// Freed memory is held in quarantine, so the resident set grows with
+// every allocation made, even by code that runs in constant space.
+bool const check_space = false;
+#else
+bool const check_space = true;
+#endif
+
+/// The greatest growth of the resident set allowed for a million calls,
+/// in kilobytes. One 8-byte word for each call would take 7800.
+long const max_growth = 4096;
+
+/// Returns the peak resident set size, in kilobytes.
+long
+peak_rss()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/// Checks that `call` computes what `ev` computes on calls of sum, even,
+/// odd, and tm8 a million calls deep, and that it does so in constant
+/// space. The engine is first run on shallow calls, so that any code it
+/// compiles on a first call and any storage it keeps is in place.
+template<typename F>
+void
+check(Test_program& t, Evaluator& ev, F call)
+{
+  Value n(Int_value(1000000));
+  std::vector<Value> eight{n};
+  for (int k = 1; k < 8; ++k)
+    eight.push_back(Value(Int_value(k)));
+  std::vector<Test_call> deep = {
+    {t.sum, {n, Value(Int_value(0))}},
+    {t.even, {n}},
+    {t.odd, {n}},
+    {t.tm8, eight},
+  };
+
+  for (Test_call const& c : deep) {
+    std::vector<Value> args = c.args;
+    args[0] = Value(Int_value(10));
+    assert(same_value(call(c.fn, args), ev.call(c.fn, args)));
+  }
+
+  long before = peak_rss();
+  std::vector<Value> results;
+  for (Test_call const& c : deep)
+    results.push_back(call(c.fn, c.args));
+  long growth = peak_rss() - before;
+  assert(!check_space || growth < max_growth);
+
+  assert(results[0].get_int() == 500000500000);
+  assert(results[1].get_int() == 1);
+  assert(results[2].get_int() == 0);
+  assert(same_value(results[3], ev.call(t.tm8, eight)));
+}
+
+} // namespace
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Evaluator ev(t.prog, t.statics);
+  Bytecode bc(t.prog, t.statics);
+
+  check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+    return ev.call(fn, args);
+  });
+
+  Machine vm(bc);
+  check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+    return vm.call(fn, args);
+  });
+
+  Machine jit(bc);
+  jit.enable_jit(1);
+  if (jit.get_jit()) {
+    check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+      return jit.call(fn, args);
+    });
+  }
+
+  for (int level : {0, 2}) {
+    Ir_machine ir(t.prog, level);
+    check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+      return ir.call(fn, args);
+    });
+  }
+
+  C_module cm(t.prog);
+  check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+    return cm.call(fn, args);
+  });
+
+  Asm_module am(t.prog, bc);
+  check(t, ev, [&](Fn_decl* fn, std::vector<Value> const& args) {
+    return am.call(fn, args);
+  });
+}
@@ -0,0 +1,48 @@
+// Tests that constructed types are interned.
+
+#include "builder.hpp"
+#include "type.hpp"
+
+#include <cassert>
+#include <vector>
+
+int
+main()
+{
+  Builder b;
+  Type* i = b.get_int_type();
+  Type* f = b.get_float_type();
+
+  // Reference types are unique per object type.
+  Type* ri = b.get_reference_type(i);
+  assert(b.get_reference_type(i) == ri);
+  assert(b.get_reference_type(f) != ri);
+  assert(ri->is_reference_to(i));
+
+  // Function types are unique per sequence of children.
+  Type* fn1 = b.get_function_type({ri, i, f});
+  assert(b.get_function_type({b.get_reference_type(i), i, f}) == fn1);
+  assert(b.get_function_type({i, ri, f}) != fn1);
+  assert(b.get_function_type({ri, i}) != fn1);
+  assert(b.get_function_type({fn1, i}) == b.get_function_type({fn1, i}));
+
+  // The table grows past its first chunks without moving types.
+  std::vector<Type*> fns;
+  Type* t = i;
+  for (int n = 0; n < 2000; ++n) {
+    t = b.get_function_type({t, i});
+    fns.push_back(t);
+  }
+  for (int n = 0; n < 2000; ++n)
+    assert(b.get_reference_type(fns[n]) == b.get_reference_type(fns[n]));
+
+  // Each type has an id that indexes the table.
+  Type_table& tt = b.get_type_table();
+  for (std::size_t n = 0; n < tt.size(); ++n)
+    assert(tt.get_type(n)->get_id() == int(n));
+
+  // Types shared between builders are the same.
+  Builder c(tt);
+  assert(c.get_reference_type(i) == ri);
+  assert(c.get_function_type({ri, i, f}) == fn1);
+}
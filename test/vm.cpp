@@ -0,0 +1,63 @@
+// Tests that the bytecode machine computes what the evaluator computes on
+// the shared test programs, raises the same errors, and runs deep
+// recursion on its own stack.
+
+#include "programs.hpp"
+
+#include "bytecode.hpp"
+#include "eval.hpp"
+#include "vm.hpp"
+
+#include <cassert>
+#include <stdexcept>
+
+int
+main()
+{
+  Builder b;
+  Test_program t(b);
+  Evaluator ev(t.prog, t.statics);
+  Bytecode bc(t.prog, t.statics);
+  Machine vm(bc);
+
+  for (Test_call const& call : t.get_calls()) {
+    Value v1 = ev.call(call.fn, call.args);
+    Value v2 = vm.call(call.fn, call.args);
+    assert(same_value(v1, v2));
+  }
+
+  // Values wider than 48 bits are boxed in registers.
+  Int_value big = Int_value(1) << 60;
+  for (Int_value n : {big, -big, big - 1}) {
+    Value v1 = ev.call(t.boxed, {Value(n)});
+    Value v2 = vm.call(t.boxed, {Value(n)});
+    assert(same_value(v1, v2));
+  }
+
+  // Division by zero, at the top and 50 calls deep, and a value bound
+  // to a reference parameter. The machine remains usable.
+  for (Int_value n : {0, 50}) {
+    bool thrown = false;
+    try {
+      vm.call(t.fail, {Value(n)});
+    }
+    catch (std::runtime_error const&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  bool rejected = false;
+  try {
+    vm.call(t.incr, {Value(Int_value(1))});
+  }
+  catch (std::logic_error const&) {
+    rejected = true;
+  }
+  assert(rejected);
+  Value v = vm.call(t.twice, {Value(Int_value(5))});
+  assert(v.get_int() == 77);
+
+  // A million nested calls.
+  Value r = vm.call(t.rsum, {Value(Int_value(1000000))});
+  assert(r.get_int() == 500000500000);
+}
@@ -110,7 +110,7 @@ template<typename T>
 inline Node_range<T>
 tail(std::vector<T*>& vec)
 {
-  assert(vec.size() > 1);
+  assert(!vec.empty());
   T** first = vec.data() + 1;
   T** last = vec.data() + vec.size();
   return Node_range<T>(first, last);
@@ -121,7 +121,7 @@ template<typename T>
 inline Node_range<T>
 rtail(std::vector<T*>& vec)
 {
-  assert(vec.size() > 1);
+  assert(!vec.empty());
   T** first = vec.data();
   T** last = vec.data() - 1;
   return Node_range<T>(first, last);
@@ -1,17 +1,22 @@
 #include "type.hpp"
 
-#include <algorithm>
+#include <functional>
+#include <stdexcept>
 
 char const*
 Type::get_kind_name() const
 {
-  switch (m_kind) {
-  case bool_type: return "bool_type";
-  case int_type: return "int_type";
-  case float_type: return "float_type";
-  case ref_type: return "ref_type";
-  case fn_type: return "fn_type";
+  return get_kind_name(m_kind);
+}
+
+char const*
+Type::get_kind_name(Kind k)
+{
+  switch (k) {
+#define def_type(K, T) case K: return #K;
+#include "type.def"
   }
+  return "<unknown>";
 }
 
 bool
@@ -31,35 +36,79 @@ Type::is_same_as(Type const* that) const
   return is_same(this, that);
 }
 
-static bool
-is_same_ref(Ref_type const* a, Ref_type const* b)
+std::size_t
+Type_seq_hash::operator()(std::vector<Type*> const& ts) const noexcept
 {
-  return is_same(a->get_child(), b->get_child());
+  std::hash<Type*> h;
+  std::size_t seed = ts.size();
+  for (Type* t : ts)
+    seed ^= h(t) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  return seed;
 }
 
-static bool
-is_same_fn(Fn_type const* a, Fn_type const* b)
+Type_table::Type_table()
+  : m_size(0)
 {
-  return std::equal(a->begin(), a->end(), b->begin(), b->end(), is_same);
+  add_type(&m_bool_type);
+  add_type(&m_int_type);
+  add_type(&m_float_type);
+  add_type(&m_error_type);
 }
 
-bool
-is_same(Type const* a, Type const* b)
+Type*
+Type_table::add_type(Type* t)
 {
-  if (a->get_kind() != b->get_kind())
-    return false;
+  std::size_t n = m_size.load(std::memory_order_relaxed);
+  if (n == first_chunk * ((std::size_t(1) << max_chunks) - 1))
+    throw std::length_error("too many types");
 
-  switch (a->get_kind()) {
-  case Type::bool_type:
-  case Type::int_type:
-  case Type::float_type:
-    return true;
-  case Type::ref_type:
-    return is_same_ref(static_cast<Ref_type const*>(a), 
-                       static_cast<Ref_type const*>(b));
-  case Type::fn_type:
-    return is_same_fn(static_cast<Fn_type const*>(a), 
-                      static_cast<Fn_type const*>(b));
+  // Allocate the chunk when its first entry is added.
+  std::size_t m = n / first_chunk + 1;
+  if ((m & (m - 1)) == 0 && n % first_chunk == 0) {
+    int k = 0;
+    while (m >>= 1)
+      ++k;
+    m_list[k].reset(new Type*[first_chunk << k]);
   }
+
+  t->m_id = n;
+  *get_slot(n) = t;
+  m_size.store(n + 1, std::memory_order_release);
+  return t;
 }
 
+Type*
+Type_table::get_reference_type(Type* t)
+{
+  if (Ref_type* ref = t->m_ref.load(std::memory_order_acquire))
+    return ref;
+
+  std::lock_guard<std::shared_mutex> lock(m_mutex);
+  if (Ref_type* ref = t->m_ref.load(std::memory_order_relaxed))
+    return ref;
+  std::unique_ptr<Ref_type> ref(new Ref_type(t));
+  add_type(ref.get());
+  t->m_ref.store(ref.get(), std::memory_order_release);
+  m_ref_types.push_back(std::move(ref));
+  return m_ref_types.back().get();
+}
+
+Type*
+Type_table::get_function_type(std::vector<Type*> const& ts)
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    auto iter = m_fn_types.find(ts);
+    if (iter != m_fn_types.end())
+      return iter->second.get();
+  }
+
+  std::lock_guard<std::shared_mutex> lock(m_mutex);
+  auto iter = m_fn_types.find(ts);
+  if (iter == m_fn_types.end()) {
+    std::unique_ptr<Fn_type> fn(new Fn_type(ts));
+    add_type(fn.get());
+    iter = m_fn_types.emplace(ts, std::move(fn)).first;
+  }
+  return iter->second.get();
+}
@@ -1,5 +1,6 @@
 #include "type.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -17,22 +18,28 @@ debug_literal(Printer& p, char const* str)
   p.get_stream() << "type='" << str << "' ";
 }
 
+namespace
+{
+
+struct Debug_attrs : Const_type_visitor<Debug_attrs>
+{
+  Debug_attrs(Printer& p) : p(p) { }
+
+  void visit_bool_type(Bool_type const* t) { debug_literal(p, "bool"); }
+  void visit_int_type(Int_type const* t) { debug_literal(p, "int"); }
+  void visit_float_type(Float_type const* t) { debug_literal(p, "float"); }
+  void visit_type(Type const* t) { }
+
+  Printer& p;
+};
+
+} // namespace
+
 static void
 debug_attrs(Printer& p, Type const* t)
 {
   Print_final_newline nl(p);
-
-  switch (t->get_kind()) {
-  case Type::bool_type:
-    return debug_literal(p, "bool");
-  case Type::int_type:
-    return debug_literal(p, "int");
-  case Type::float_type:
-    return debug_literal(p, "float");
-  case Type::ref_type:
-  case Type::fn_type:
-    break;
-  }
+  Debug_attrs(p).visit(t);
 }
 
 static void
@@ -1,22 +1,29 @@
 #pragma once
 
 #include "tree.hpp"
+#include "stats.hpp"
 #include "value.hpp"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
 class Printer;
+class Ref_type;
+class Type_table;
 
 
 /// Represents the types in the language.
 class Type
 {
+  friend class Type_table;
 public:
   enum Kind
   {
-    bool_type,
-    int_type,
-    float_type,
-    ref_type,
-    fn_type,
+#define def_type(K, T) K,
+#include "type.def"
   };
 
 protected:
@@ -31,6 +38,12 @@ public:
   char const* get_kind_name() const;
   /// Returns the spelling of the kind.
 
+  static char const* get_kind_name(Kind k);
+  /// Returns the spelling of the kind `k`.
+
+  int get_id() const { return m_id; }
+  /// Returns the index of the type in its type table.
+
   bool is_bool() const { return m_kind == bool_type; }
   /// Returns true if this is `bool`.
   
@@ -49,6 +62,9 @@ public:
   bool is_function() const { return m_kind == fn_type; }
   /// Returns true if this is a function type `(t1, t2, ..., n-1)->tn`.
 
+  bool is_error() const { return m_kind == error_type; }
+  /// Returns true if this is the type of an ill-formed expression.
+
   bool is_object() const  { return m_kind != ref_type; }
   /// Returns true if this is an object type.
 
@@ -77,12 +93,20 @@ public:
 private:
   Kind m_kind;
   /// The kind of expression.
+
+  int m_id;
+  /// The index of the type in its type table.
+
+  std::atomic<Ref_type*> m_ref;
+  /// The type `ref t` of this type `t`, once the table has created it.
 };
 
 inline
 Type::Type(Kind k)
-  : m_kind(k)
-{ }
+  : m_kind(k), m_id(-1), m_ref(nullptr)
+{
+  note_node(type_node, k);
+}
 
 inline bool
 Type::is_arithmetic() const
@@ -161,17 +185,23 @@ public:
 inline
 Kary_type::Kary_type(Kind k, std::initializer_list<Type*> list)
   : Type(k), Base(list)
-{ }
+{
+  note_operands(type_node, k, get_arity());
+}
 
 inline
 Kary_type::Kary_type(Kind k, std::vector<Type*> const& vec)
   : Type(k), Base(vec)
-{ }
+{
+  note_operands(type_node, k, get_arity());
+}
 
 inline
 Kary_type::Kary_type(Kind k, std::vector<Type*>&& vec)
   : Type(k), Base(std::move(vec))
-{ }
+{
+  note_operands(type_node, k, get_arity());
+}
 
 
 // Base types
@@ -219,6 +249,21 @@ Float_type::Float_type()
 { }
 
 
+/// The type of ill-formed expressions. Operations on an operand of this
+/// type are not diagnosed again; they simply produce another error.
+class Error_type : public Nullary_type
+{
+public:
+  Error_type();
+  /// Constructs the error type.
+};
+
+inline
+Error_type::Error_type()
+  : Nullary_type(error_type)
+{ }
+
+
 // Type constructors
 
 /// Represents types of the form `ref t`.
@@ -283,10 +328,135 @@ Fn_type::Fn_type(std::vector<Type*>&& vec)
 { }
 
 
+// Type table
+
+/// Hashes a sequence of (unique) types by the identity of its elements.
+struct Type_seq_hash
+{
+  std::size_t operator()(std::vector<Type*> const& ts) const noexcept;
+};
+
+
+/// The type table maintains the unique representation of each type.
+/// Every type is constructed exactly once, so two types are the same
+/// exactly when they have the same address.
+///
+/// The table is safe to use from multiple threads. Finding an existing
+/// reference type and indexing the table take no lock, and finding an
+/// existing function type takes a shared lock. Only creating a type
+/// excludes other threads. Types are never moved once listed, so an id
+/// obtained from a type remains valid without synchronization.
+class Type_table
+{
+public:
+  Type_table();
+  /// Constructs the table with the base types.
+
+  Type_table(Type_table const&) = delete;
+  Type_table& operator=(Type_table const&) = delete;
+
+  Type* get_type(int n) const;
+  /// Returns the type whose id is `n`.
+
+  std::size_t size() const;
+  /// Returns the number of types in the table. Every id less than the
+  /// result can be passed to get_type.
+
+  Type* get_bool_type() { return &m_bool_type; }
+  /// Returns the type `bool`.
+
+  Type* get_int_type() { return &m_int_type; }
+  /// Returns the type `int`.
+
+  Type* get_float_type() { return &m_float_type; }
+  /// Returns the type `float`.
+
+  Type* get_error_type() { return &m_error_type; }
+  /// Returns the error type.
+
+  Type* get_reference_type(Type* t);
+  /// Returns the unique type `ref t`.
+
+  Type* get_function_type(std::vector<Type*> const& ts);
+  /// Returns the unique type `(t1, t2, ..., tn) -> tr`.
+
+private:
+  static constexpr int first_chunk = 256;
+  /// The number of types in the first chunk of the list. Each further
+  /// chunk is twice the size of the one before.
+
+  static constexpr int max_chunks = 23;
+  /// The number of chunks. Their total size is just under 2^31, so every
+  /// id fits in an int.
+
+  Type** get_slot(std::size_t n) const;
+  /// Returns the entry of the list for the id `n`.
+
+  Type* add_type(Type* t);
+  /// Assigns the next id to `t`. The caller holds the exclusive lock.
+
+  Bool_type m_bool_type;
+  /// The type `bool`.
+
+  Int_type m_int_type;
+  /// The type `int`.
+
+  Float_type m_float_type;
+  /// The type `float`.
+
+  Error_type m_error_type;
+  /// The error type.
+
+  std::vector<std::unique_ptr<Ref_type>> m_ref_types;
+  /// Reference types. Each is found through its object type.
+
+  std::unordered_map<std::vector<Type*>, std::unique_ptr<Fn_type>, Type_seq_hash> m_fn_types;
+  /// Function types, keyed by their parameter and return types. The
+  /// table owns them.
+
+  std::unique_ptr<Type*[]> m_list[max_chunks];
+  /// All types, indexed by id. The list is split into chunks that are
+  /// allocated as it grows, so entries are never moved.
+
+  std::atomic<std::size_t> m_size;
+  /// The number of types in the list.
+
+  mutable std::shared_mutex m_mutex;
+  /// Guards the creation of types when the table is shared between
+  /// threads.
+};
+
+inline Type**
+Type_table::get_slot(std::size_t n) const
+{
+  // Chunk k starts at first_chunk * (2^k - 1).
+  std::size_t m = n / first_chunk + 1;
+  int k = 0;
+  while (m >>= 1)
+    ++k;
+  std::size_t start = first_chunk * ((std::size_t(1) << k) - 1);
+  return &m_list[k][n - start];
+}
+
+inline Type*
+Type_table::get_type(int n) const
+{
+  assert(0 <= n && std::size_t(n) < size());
+  return *get_slot(n);
+}
+
+inline std::size_t
+Type_table::size() const
+{
+  return m_size.load(std::memory_order_acquire);
+}
+
+
 // Operations
 
 bool is_same(Type const* a, Type const* b);
-/// Returns true if `a` and `b` are the same type.
+/// Returns true if `a` and `b` are the same type. Because types are
+/// unique, this is an identity comparison.
 
 void print_type(Printer& p, Type const* t);
 /// Print `t` using the given printer.
@@ -297,3 +467,9 @@ void debug_type(Printer& p, Type const* t);
 std::ostream& operator<<(std::ostream& os, Type const& t);
 /// Write `t` to the output stream.
 
+
+inline bool
+is_same(Type const* a, Type const* b)
+{
+  return a == b;
+}
@@ -1,5 +1,6 @@
 #include "type.hpp"
 #include "printer.hpp"
+#include "visitor.hpp"
 
 #include <iostream>
 
@@ -31,21 +32,29 @@ print_fn(Printer& p, Fn_type const* t)
   print_type(p, t->get_return_type());
 }
 
+namespace
+{
+
+struct Print_type : Const_type_visitor<Print_type>
+{
+  Print_type(Printer& p) : p(p) { }
+
+  void visit_bool_type(Bool_type const* t) { print_literal(p, "bool"); }
+  void visit_int_type(Int_type const* t) { print_literal(p, "int"); }
+  void visit_float_type(Float_type const* t) { print_literal(p, "float"); }
+  void visit_ref_type(Ref_type const* t) { print_ref(p, t); }
+  void visit_fn_type(Fn_type const* t) { print_fn(p, t); }
+  void visit_error_type(Error_type const* t) { print_literal(p, "<error>"); }
+
+  Printer& p;
+};
+
+} // namespace
+
 void
 print_type(Printer& p, Type const* t)
 {
-  switch (t->get_kind()) {
-  case Type::bool_type:
-    return print_literal(p, "bool");
-  case Type::int_type:
-    return print_literal(p, "int");
-  case Type::float_type:
-    return print_literal(p, "float");
-  case Type::ref_type:
-    return print_ref(p, static_cast<Ref_type const*>(t));
-  case Type::fn_type:
-    return print_fn(p, static_cast<Fn_type const*>(t));
-  }
+  Print_type(p).visit(t);
 }
 
 std::ostream&
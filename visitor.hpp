@@ -0,0 +1,197 @@
+#pragma once
+
+#include "type.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "decl.hpp"
+
+#include <type_traits>
+
+// Visitors
+//
+// A visitor dispatches on the kind of a node and calls the member of the
+// derived class `D` for that kind. For a node of kind `k`, the function
+// `visit_k` is called with the node cast to its class. Dispatch is
+// generated from the node kind lists (e.g., expr.def) and is resolved
+// statically, so each handler can be inlined into the switch.
+//
+// Handlers that are not declared in `D` forward to the category fallback
+// (e.g., `visit_expr`). If `D` does not declare the fallback either, using
+// the visitor on an unhandled kind is a compile-time error. A pass that
+// must be exhaustive simply omits the fallback.
+//
+// The `Const` parameter selects between read-only visitors, which receive
+// const nodes, and rewriting visitors, which receive mutable nodes and
+// typically return a replacement node.
+
+/// Returns `T const*` if `C` is true and `T*` otherwise.
+template<bool C, typename T>
+using Visitor_ptr = std::conditional_t<C, T const*, T*>;
+
+
+/// The visitor for expressions.
+template<typename D, typename R = void, bool Const = true>
+class Basic_expr_visitor
+{
+public:
+  using Node = Visitor_ptr<Const, Expr>;
+
+  R visit(Node e)
+  {
+    switch (e->get_kind()) {
+#define def_expr(K, T) \
+    case Expr::K: return derived().visit_##K(static_cast<Visitor_ptr<Const, T>>(e));
+#include "expr.def"
+    }
+    assert(false && "invalid expression kind");
+    return R();
+  }
+
+#define def_expr(K, T) \
+  R visit_##K(Visitor_ptr<Const, T> e) { return derived().visit_expr(e); }
+#include "expr.def"
+
+  template<typename T>
+  R visit_expr(T)
+  {
+    static_assert(sizeof(T) == 0, "unhandled expression kind");
+    return R();
+  }
+
+private:
+  D& derived() { return static_cast<D&>(*this); }
+};
+
+template<typename D, typename R = void>
+using Const_expr_visitor = Basic_expr_visitor<D, R, true>;
+/// A read-only expression visitor.
+
+template<typename D, typename R = void>
+using Expr_visitor = Basic_expr_visitor<D, R, false>;
+/// A rewriting expression visitor.
+
+
+/// The visitor for statements.
+template<typename D, typename R = void, bool Const = true>
+class Basic_stmt_visitor
+{
+public:
+  using Node = Visitor_ptr<Const, Stmt>;
+
+  R visit(Node s)
+  {
+    switch (s->get_kind()) {
+#define def_stmt(K, T) \
+    case Stmt::K: return derived().visit_##K(static_cast<Visitor_ptr<Const, T>>(s));
+#include "stmt.def"
+    }
+    assert(false && "invalid statement kind");
+    return R();
+  }
+
+#define def_stmt(K, T) \
+  R visit_##K(Visitor_ptr<Const, T> s) { return derived().visit_stmt(s); }
+#include "stmt.def"
+
+  template<typename T>
+  R visit_stmt(T)
+  {
+    static_assert(sizeof(T) == 0, "unhandled statement kind");
+    return R();
+  }
+
+private:
+  D& derived() { return static_cast<D&>(*this); }
+};
+
+template<typename D, typename R = void>
+using Const_stmt_visitor = Basic_stmt_visitor<D, R, true>;
+/// A read-only statement visitor.
+
+template<typename D, typename R = void>
+using Stmt_visitor = Basic_stmt_visitor<D, R, false>;
+/// A rewriting statement visitor.
+
+
+/// The visitor for declarations.
+template<typename D, typename R = void, bool Const = true>
+class Basic_decl_visitor
+{
+public:
+  using Node = Visitor_ptr<Const, Decl>;
+
+  R visit(Node d)
+  {
+    switch (d->get_kind()) {
+#define def_decl(K, T) \
+    case Decl::K: return derived().visit_##K(static_cast<Visitor_ptr<Const, T>>(d));
+#include "decl.def"
+    }
+    assert(false && "invalid declaration kind");
+    return R();
+  }
+
+#define def_decl(K, T) \
+  R visit_##K(Visitor_ptr<Const, T> d) { return derived().visit_decl(d); }
+#include "decl.def"
+
+  template<typename T>
+  R visit_decl(T)
+  {
+    static_assert(sizeof(T) == 0, "unhandled declaration kind");
+    return R();
+  }
+
+private:
+  D& derived() { return static_cast<D&>(*this); }
+};
+
+template<typename D, typename R = void>
+using Const_decl_visitor = Basic_decl_visitor<D, R, true>;
+/// A read-only declaration visitor.
+
+template<typename D, typename R = void>
+using Decl_visitor = Basic_decl_visitor<D, R, false>;
+/// A rewriting declaration visitor.
+
+
+/// The visitor for types.
+template<typename D, typename R = void, bool Const = true>
+class Basic_type_visitor
+{
+public:
+  using Node = Visitor_ptr<Const, Type>;
+
+  R visit(Node t)
+  {
+    switch (t->get_kind()) {
+#define def_type(K, T) \
+    case Type::K: return derived().visit_##K(static_cast<Visitor_ptr<Const, T>>(t));
+#include "type.def"
+    }
+    assert(false && "invalid type kind");
+    return R();
+  }
+
+#define def_type(K, T) \
+  R visit_##K(Visitor_ptr<Const, T> t) { return derived().visit_type(t); }
+#include "type.def"
+
+  template<typename T>
+  R visit_type(T)
+  {
+    static_assert(sizeof(T) == 0, "unhandled type kind");
+    return R();
+  }
+
+private:
+  D& derived() { return static_cast<D&>(*this); }
+};
+
+template<typename D, typename R = void>
+using Const_type_visitor = Basic_type_visitor<D, R, true>;
+/// A read-only type visitor.
+
+template<typename D, typename R = void>
+using Type_visitor = Basic_type_visitor<D, R, false>;
+/// A rewriting type visitor.
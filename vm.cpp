@@ -0,0 +1,348 @@
+#include "vm.hpp"
+#include "decl.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+// Arithmetic
+//
+// Integer arithmetic wraps on overflow, as it does in the evaluator.
+
+static inline Packed_value
+add_int(Packed_value const& a, Packed_value const& b)
+{
+  return Packed_value(Int_value(std::uint64_t(a.get_int()) + std::uint64_t(b.get_int())));
+}
+
+static inline Packed_value
+sub_int(Packed_value const& a, Packed_value const& b)
+{
+  return Packed_value(Int_value(std::uint64_t(a.get_int()) - std::uint64_t(b.get_int())));
+}
+
+static inline Packed_value
+mul_int(Packed_value const& a, Packed_value const& b)
+{
+  return Packed_value(Int_value(std::uint64_t(a.get_int()) * std::uint64_t(b.get_int())));
+}
+
+static Packed_value
+div_int(Int_value a, Int_value b)
+{
+  if (b == 0)
+    throw std::runtime_error("division by zero");
+  if (b == -1)
+    return Packed_value(Int_value(-std::uint64_t(a)));
+  return Packed_value(a / b);
+}
+
+static Packed_value
+rem_int(Int_value a, Int_value b)
+{
+  if (b == 0)
+    throw std::runtime_error("division by zero");
+  if (b == -1)
+    return Packed_value(Int_value(0));
+  return Packed_value(a % b);
+}
+
+
+/// The minimum number of registers in a segment of the stack.
+static constexpr std::size_t min_segment_size = 64 * 1024;
+
+Machine::Machine(Bytecode const& bc)
+  : m_bc(bc), m_statics(new Packed_value[bc.get_num_statics()]),
+    m_segs(), m_seg(), m_top(), m_end(), m_marks(), m_acts(), m_args(),
+    m_jit(), m_threshold(), m_native(), m_tried(), m_error()
+{
+  Code const* init = bc.get_init();
+  run(init, push_frame(init->get_num_registers()));
+}
+
+Value
+Machine::call(Fn_decl const* fn, std::vector<Value> const& args)
+{
+  Code const* code = m_bc.get_code(fn);
+  if (!code)
+    throw std::runtime_error("call to undefined function");
+  assert(args.size() == std::size_t(code->get_num_parameters()));
+  for (Decl const* p : fn->get_parameters()) {
+    if (p->is_reference())
+      throw std::logic_error("cannot bind reference parameter to a value");
+  }
+
+  // Discard the state of a call that was abandoned by an exception.
+  m_acts.clear();
+  while (!m_marks.empty())
+    pop_frame();
+
+  Packed_value* fp = push_frame(code->get_num_registers());
+  for (std::size_t i = 0; i < args.size(); ++i)
+    fp[i] = Packed_value(args[i]);
+  return run(code, fp).to_value();
+}
+
+void
+Machine::enable_jit(unsigned threshold)
+{
+  if (!Jit::is_supported())
+    return;
+  m_jit = std::make_unique<Jit>(&Machine::jit_step);
+  m_threshold = threshold;
+  m_native.assign(m_bc.get_num_functions(), nullptr);
+  m_tried.assign(m_bc.get_num_functions(), false);
+}
+
+Native_fn
+Machine::find_native(Code const* code)
+{
+  std::size_t n = code->get_index();
+  Native_fn& f = m_native[n];
+  // The count may already be past the threshold when the evaluator has
+  // also run the function, so any count from the threshold on compiles.
+  // A function that failed to compile stays interpreted.
+  if (!m_tried[n] && code->get_function()->count_call() >= m_threshold) {
+    m_tried[n] = true;
+    f = m_jit->compile(*code);
+  }
+  return f;
+}
+
+int
+Machine::run_native(Native_fn f, Packed_value* fp, int start)
+{
+  int r = f(fp, this, start);
+  if (r == -1) {
+    std::exception_ptr e = std::move(m_error);
+    m_error = nullptr;
+    std::rethrow_exception(e);
+  }
+  return r;
+}
+
+void
+Machine::step(Code const* code, Instr const* pc, Packed_value* fp)
+{
+  Packed_value const* k = code->get_constants();
+  Packed_value* s = m_statics.get();
+  switch (pc->op) {
+#define def_exec(K, S) case K##_op: S; return;
+#include "vm.def"
+  default:
+    break;
+  }
+  throw std::logic_error("instruction cannot be executed by a step");
+}
+
+int
+Machine::jit_step(Machine* m, Packed_value* fp, Instr const* pc, Code const* code) noexcept
+{
+  try {
+    m->step(code, pc, fp);
+    return 0;
+  }
+  catch (...) {
+    m->m_error = std::current_exception();
+    return -1;
+  }
+}
+
+Packed_value*
+Machine::push_frame(int n)
+{
+  m_marks.push_back(Mark{m_seg, m_top});
+  if (m_end - m_top < n) {
+    // Move to the next segment that is large enough, dropping any that
+    // are too small to be useful.
+    std::size_t next = m_top ? m_seg + 1 : 0;
+    while (next < m_segs.size() && m_segs[next].size < std::size_t(n))
+      m_segs.erase(m_segs.begin() + next);
+    if (next == m_segs.size()) {
+      std::size_t size = std::max(std::size_t(n), min_segment_size);
+      m_segs.push_back(Segment{std::unique_ptr<Packed_value[]>(new Packed_value[size]), size});
+    }
+    m_seg = next;
+    m_top = m_segs[next].regs.get();
+    m_end = m_top + m_segs[next].size;
+  }
+  Packed_value* p = m_top;
+  m_top += n;
+  return p;
+}
+
+Packed_value*
+Machine::replace_frame(Packed_value* fp, Code const* code, Packed_value const* args)
+{
+  int n = code->get_num_parameters();
+  if (m_end - fp >= code->get_num_registers()) {
+    // The arguments are temporaries above the parameters, so copying
+    // upwards reads each before it is overwritten.
+    for (int i = 0; i < n; ++i)
+      fp[i] = args[i];
+    m_top = fp + code->get_num_registers();
+    return fp;
+  }
+
+  // The frame does not fit in the rest of the segment. Moving to another
+  // segment may release this one, so save the arguments first.
+  m_args.assign(args, args + n);
+  pop_frame();
+  Packed_value* p = push_frame(code->get_num_registers());
+  std::move(m_args.begin(), m_args.end(), p);
+  return p;
+}
+
+void
+Machine::pop_frame()
+{
+  // Registers are not cleared; a frame's variables are initialized
+  // before they are read.
+  Mark m = m_marks.back();
+  m_marks.pop_back();
+  m_seg = m.seg;
+  m_top = m.top;
+  m_end = m_top ? m_segs[m_seg].regs.get() + m_segs[m_seg].size : nullptr;
+}
+
+#if defined(__GNUC__) && !defined(VM_USE_SWITCH)
+#  define vm_target(K) L_##K: case K##_op
+#  define vm_dispatch() goto *targets[pc->op]
+#else
+#  define vm_target(K) case K##_op
+#  define vm_dispatch() continue
+#endif
+
+#define vm_next() { ++pc; vm_dispatch(); }
+#define vm_jump(n) { pc = first + (n); vm_dispatch(); }
+
+Packed_value
+Machine::run(Code const* code, Packed_value* fp)
+{
+#if defined(__GNUC__) && !defined(VM_USE_SWITCH)
+  static void* const targets[] = {
+#define def_op(K) &&L_##K,
+#include "bytecode.def"
+  };
+#endif
+
+  std::size_t base = m_acts.size();
+  Instr const* first = code->get_instructions();
+  Instr const* pc = first;
+  Packed_value const* k = code->get_constants();
+  Packed_value* s = m_statics.get();
+  Code const* callee;
+  Packed_value result;
+  Native_fn native = nullptr;
+  int entry = 0;
+
+  if (m_jit && (native = find_native(code)))
+    goto resume;
+
+  for (;;) {
+    switch (pc->op) {
+#define def_exec(K, S) vm_target(K): S; vm_next();
+#include "vm.def"
+
+    // Control
+    vm_target(jmp):
+      vm_jump(pc->a);
+    vm_target(jt):
+      if (fp[pc->a].get_int())
+        vm_jump(pc->b);
+      vm_next();
+    vm_target(jf):
+      if (!fp[pc->a].get_int())
+        vm_jump(pc->b);
+      vm_next();
+    vm_target(call):
+      callee = code->get_callee(pc->b);
+      goto invoke;
+    vm_target(calli):
+      callee = m_bc.get_code(fp[pc->b].get_function());
+      goto invoke;
+    vm_target(ret):
+      result = std::move(fp[pc->a]);
+      pop_frame();
+      goto leave;
+    vm_target(tcall):
+      callee = code->get_callee(pc->b);
+      goto replace;
+    vm_target(tcalli):
+      callee = m_bc.get_code(fp[pc->b].get_function());
+      goto replace;
+    }
+    assert(false && "invalid opcode");
+
+  leave: {
+      // Resume the suspended caller with the result.
+      if (m_acts.size() == base)
+        return result;
+      Activation const& act = m_acts.back();
+      code = act.code;
+      pc = act.pc;
+      fp = act.fp;
+      m_acts.pop_back();
+      first = code->get_instructions();
+      k = code->get_constants();
+      fp[pc->a] = std::move(result);
+      if (m_jit && (native = m_native[code->get_index()])) {
+        entry = pc + 1 - first;
+        goto resume;
+      }
+      vm_next();
+    }
+
+  resume: {
+      // Run the native code of `code` from instruction `entry`. It
+      // returns here to make each call, which resumes it afterwards.
+      int r = run_native(native, fp, entry);
+      if (r < 0)
+        vm_jump(-2 - r);
+      result = std::move(fp[r]);
+      pop_frame();
+      goto leave;
+    }
+
+  replace: {
+      // Run the callee in the frame of the returning function. The
+      // suspended caller of that function receives the callee's result.
+      if (!callee)
+        throw std::runtime_error("call to undefined function");
+      fp = replace_frame(fp, callee, fp + pc->c);
+      code = callee;
+      first = pc = code->get_instructions();
+      k = code->get_constants();
+      if (m_jit && (native = find_native(callee))) {
+        entry = 0;
+        goto resume;
+      }
+      vm_dispatch();
+    }
+
+  invoke: {
+      // Copy the arguments into the parameters of a new frame and
+      // suspend the caller at the call instruction.
+      if (!callee)
+        throw std::runtime_error("call to undefined function");
+      Packed_value* args = fp + pc->c;
+      Packed_value* callee_fp = push_frame(callee->get_num_registers());
+      for (int i = 0, n = callee->get_num_parameters(); i < n; ++i)
+        callee_fp[i] = args[i];
+      m_acts.push_back(Activation{code, pc, fp});
+      code = callee;
+      first = pc = code->get_instructions();
+      k = code->get_constants();
+      fp = callee_fp;
+      if (m_jit && (native = find_native(callee))) {
+        entry = 0;
+        goto resume;
+      }
+    }
+  }
+}
+
+#undef vm_target
+#undef vm_dispatch
+#undef vm_next
+#undef vm_jump
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+
+#include <exception>
+#include <memory>
+#include <vector>
+
+
+/// Executes bytecode.
+///
+/// Each call pushes a frame of registers onto a stack of segments, so a
+/// call is a pointer bump and the registers of a frame stay in place
+/// while it is active. Addresses of variables are pointers to their
+/// registers or static cells. Calls do not recurse on the native stack:
+/// the machine keeps its own stack of suspended activations. A tail call
+/// moves its arguments to the bottom of the caller's frame and runs the
+/// callee there, so tail recursion runs in constant space.
+///
+/// The dispatch loop uses computed goto where the compiler supports it,
+/// and a switch otherwise. Defining VM_USE_SWITCH selects the switch.
+///
+/// When the JIT is enabled, each call counts against the callee's
+/// Fn_decl, and a function is compiled to native code when its count
+/// reaches the threshold. Calls to compiled functions, from either the
+/// interpreter or compiled code, run the native code on the same frames.
+/// Compiled code returns to the machine to make each call, and is
+/// re-entered after the call when the callee returns, so compiled code
+/// does not recurse on the native stack either. Functions that cannot be
+/// compiled stay interpreted.
+class Machine
+{
+public:
+  Machine(Bytecode const& bc);
+  /// Constructs a machine for `bc` and initializes the global variables.
+
+  Machine(Machine const&) = delete;
+  Machine& operator=(Machine const&) = delete;
+
+  Value call(Fn_decl const* fn, std::vector<Value> const& args);
+  /// Calls `fn` with `args`, which must be values of its parameter types,
+  /// and returns the result.
+
+  void enable_jit(unsigned threshold);
+  /// Compiles functions once they have been called `threshold` times.
+  /// Has no effect if the host is not supported.
+
+  Jit const* get_jit() const { return m_jit.get(); }
+  /// Returns the JIT, or null if it is not enabled.
+
+private:
+  Packed_value run(Code const* code, Packed_value* fp);
+  /// Calls `code` in the frame at `fp`, which must be on top of the
+  /// stack, and runs until it returns. The frame is popped.
+
+  Native_fn find_native(Code const* code);
+  /// Counts a call of `code` and returns its native code, compiling it if
+  /// it has become hot. Each function is compiled at most once. Returns
+  /// null if the code is interpreted.
+
+  int run_native(Native_fn f, Packed_value* fp, int start);
+  /// Runs `f` in the frame at `fp` from instruction `start` and returns
+  /// its result (see Native_fn). Rethrows any exception raised by its
+  /// helpers.
+
+  Packed_value* replace_frame(Packed_value* fp, Code const* code, Packed_value const* args);
+  /// Replaces the top frame, at `fp`, with a frame for `code` whose
+  /// parameters are copied from `args`, and returns the new frame. The
+  /// arguments may lie in the replaced frame.
+
+  void step(Code const* code, Instr const* pc, Packed_value* fp);
+  /// Executes the instruction `pc`, which must not be a jump, call, or
+  /// return.
+
+  static int jit_step(Machine* m, Packed_value* fp, Instr const* pc, Code const* code) noexcept;
+  /// The step helper of compiled code. Exceptions are saved in `m_error`
+  /// because they cannot unwind through native frames.
+
+  Packed_value* push_frame(int n);
+  /// Returns a frame of `n` registers on top of the stack.
+
+  void pop_frame();
+  /// Pops the top frame.
+
+  /// A block of registers holding frames.
+  struct Segment
+  {
+    std::unique_ptr<Packed_value[]> regs;
+    std::size_t size;
+  };
+
+  /// The top of the stack before a frame was pushed.
+  struct Mark
+  {
+    std::size_t seg;
+    Packed_value* top;
+  };
+
+  /// A suspended caller.
+  struct Activation
+  {
+    Code const* code;
+    /// The calling code.
+
+    Instr const* pc;
+    /// The call instruction.
+
+    Packed_value* fp;
+    /// The caller's registers.
+  };
+
+  Bytecode const& m_bc;
+  /// The program.
+
+  std::unique_ptr<Packed_value[]> m_statics;
+  /// The static store.
+
+  std::vector<Segment> m_segs;
+  /// The segments of the stack.
+
+  std::size_t m_seg;
+  /// The segment containing the top of the stack.
+
+  Packed_value* m_top;
+  /// The first free register in the current segment.
+
+  Packed_value* m_end;
+  /// The end of the current segment.
+
+  std::vector<Mark> m_marks;
+  /// The top of the stack before each frame was pushed.
+
+  std::vector<Activation> m_acts;
+  /// The suspended callers.
+
+  std::vector<Packed_value> m_args;
+  /// The arguments of a tail call whose frame must be moved.
+
+  std::unique_ptr<Jit> m_jit;
+  /// The compiler, if enabled.
+
+  unsigned m_threshold;
+  /// The number of calls after which a function is compiled.
+
+  std::vector<Native_fn> m_native;
+  /// The native code of each function, if compiled.
+
+  std::vector<bool> m_tried;
+  /// Whether each function has been given to the compiler, so that one
+  /// that failed to compile is not compiled again.
+
+  std::exception_ptr m_error;
+  /// The exception raised in a helper of compiled code.
+};